@@ -4,6 +4,7 @@
 #include "address.h"
 #include <QString>
 #include <QList>
+#include <QHash>
 
 class AddressList {
 public:
@@ -20,7 +21,9 @@ public:
     void removeAddress(int addressId);
     void updateAddress(const Address& address);
     Address getAddress(int addressId) const;
+    bool containsAddress(int addressId) const { return m_index.contains(addressId); }
     QList<Address> getAddresses() const { return m_addresses; }
+    void setAddresses(const QList<Address>& addresses);
     
     int getAddressCount() const { return m_addresses.size(); }
     void clear();
@@ -29,8 +32,10 @@ private:
     int m_id;
     QString m_name;
     QList<Address> m_addresses;
+    QHash<int, int> m_index; // Address id -> position in m_addresses
     
     int findAddressIndex(int addressId) const;
+    void reindexFrom(int position);
 };
 
 #endif // ADDRESSLIST_H
@@ -0,0 +1,73 @@
+#ifndef ADDRESSLISTMODEL_H
+#define ADDRESSLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include "address.h"
+
+// Flat list model for the address panel. Only the fields shown in the list
+// are kept; display strings are built in data() for the rows the view
+// actually paints. Filtering is done in the model as a vector of store
+// indices so no per-row objects are created or hidden.
+class AddressListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        AddressIdRole = Qt::UserRole
+    };
+
+    explicit AddressListModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void setAddresses(const QList<Address>& addresses);
+    void addAddress(const Address& address);
+    void updateAddress(const Address& address);
+    void removeAddress(int addressId);
+    void clear();
+
+    void setFilterText(const QString& text);
+    QString getFilterText() const { return m_filterText; }
+    // Shows only the given addresses, e.g. hits from the search index.
+    // Replaces any text filter until setFilterText() is called again.
+    void setFilterIds(const QSet<int>& ids);
+
+    // Start/end points are shown as a prefix on the matching rows
+    void setRouteEndpoints(int startId, int endId);
+
+    int addressIdAt(int row) const;
+    int rowForAddressId(int addressId) const;
+    int getTotalCount() const { return m_entries.size(); }
+
+    static QString displayText(const Address& address);
+
+private:
+    struct Entry {
+        int id;
+        QString street;
+        QString city;
+        QString state;
+    };
+
+    QVector<Entry> m_entries;
+    QHash<int, int> m_index;   // address id -> position in m_entries
+    QVector<int> m_visible;    // ascending positions in m_entries
+    QString m_filterText;
+    QSet<int> m_filterIds;
+    bool m_filterByIds;
+    int m_startId;
+    int m_endId;
+
+    static Entry makeEntry(const Address& address);
+    bool matches(const Entry& entry) const;
+    int visibleRowForEntry(int entryIndex) const;
+    void rebuildVisible();
+    void emitRowChanged(int addressId);
+};
+
+#endif // ADDRESSLISTMODEL_H
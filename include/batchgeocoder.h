@@ -0,0 +1,80 @@
+#ifndef BATCHGEOCODER_H
+#define BATCHGEOCODER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QQueue>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "address.h"
+#include "geocodingservice.h"
+#include "tokenbucket.h"
+
+// Geocodes every address of a list that has no coordinates. Requests are
+// paced by a token bucket (Nominatim allows one per second), up to
+// maxInFlight are outstanding at once, transient failures are retried with
+// exponential backoff, and progress is checkpointed in the database so an
+// interrupted job can be resumed.
+class BatchGeocoder : public QObject {
+    Q_OBJECT
+
+public:
+    explicit BatchGeocoder(GeocodingService* service, QObject* parent = nullptr);
+    ~BatchGeocoder() override;
+
+    // start() forgets earlier failures; resume() continues a checkpointed job
+    bool start(int listId);
+    bool resume(int listId);
+    // Stops dispatching; the checkpoint is kept so the job can be resumed
+    void cancel();
+
+    bool isRunning() const { return m_listId != -1; }
+    int getListId() const { return m_listId; }
+
+    void setRequestsPerSecond(double rate) { m_bucket.setRate(rate, 1.0); }
+    void setMaxInFlight(int count) { m_maxInFlight = qMax(1, count); }
+    void setMaxAttempts(int attempts) { m_maxAttempts = qMax(1, attempts); }
+
+signals:
+    void progress(int processed, int total);
+    void addressGeocoded(const Address& address);
+    void addressFailed(int addressId, const QString& error);
+    void finished(int geocoded, int failed, bool cancelled);
+
+private slots:
+    void dispatch();
+    void onResultReady(int requestId, const QVector<GeocodingCandidate>& candidates, bool fromCache);
+    void onRequestFailed(int requestId, const QString& error, bool retryable);
+
+private:
+    struct Task {
+        Address address;
+        int attempts;
+        qint64 notBeforeMs;
+    };
+
+    GeocodingService* m_service;
+    TokenBucket m_bucket;
+    QTimer m_dispatchTimer;
+    QElapsedTimer m_clock;
+    int m_maxInFlight;
+    int m_maxAttempts;
+
+    int m_listId;
+    QQueue<Task> m_pending;
+    QList<Task> m_retries;
+    QHash<int, Task> m_inFlight;
+    int m_total;
+    int m_processed;
+    int m_geocoded;
+    int m_failed;
+    int m_sinceCheckpoint;
+
+    bool begin(int listId, const QList<Address>& addresses, int total, int processed, int failed);
+    void completeTask();
+    void checkpoint();
+    void finish(bool cancelled);
+};
+
+#endif // BATCHGEOCODER_H
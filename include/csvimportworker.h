@@ -0,0 +1,44 @@
+#ifndef CSVIMPORTWORKER_H
+#define CSVIMPORTWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <atomic>
+#include "address.h"
+#include "csvreader.h"
+
+// Parses an address CSV file on a worker thread and hands the rows back in
+// batches. Expected column order:
+// street, city, state, zip, country[, latitude, longitude]
+class CsvImportWorker : public QObject {
+    Q_OBJECT
+
+public:
+    explicit CsvImportWorker(const QString& filePath, int batchSize = 5000,
+                             QObject* parent = nullptr);
+
+    // Thread-safe; the worker stops at the next record boundary
+    void cancel();
+    bool isCancelled() const { return m_cancelled.load(); }
+
+    static bool isHeaderRecord(const QVector<CsvField>& fields);
+    static bool parseAddress(const QVector<CsvField>& fields, Address& address);
+
+public slots:
+    void run();
+
+signals:
+    void batchReady(const QList<Address>& addresses);
+    void progress(qint64 bytesRead, qint64 totalBytes);
+    void finished(int parsedCount, int errorCount, bool cancelled);
+    void failed(const QString& error);
+
+private:
+    QString m_filePath;
+    int m_batchSize;
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // CSVIMPORTWORKER_H
@@ -0,0 +1,45 @@
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <QString>
+#include <QVector>
+
+// A single field inside a CSV buffer. It points into the buffer owned by
+// the reader's caller, so no memory is allocated until it is converted.
+struct CsvField {
+    const char* data = nullptr;
+    int size = 0;
+    bool quoted = false;
+    bool hasEscapedQuotes = false;
+
+    bool isEmpty() const { return size == 0; }
+    QString toString() const;
+    double toDouble(bool* ok = nullptr) const;
+};
+
+// RFC 4180 reader over an in-memory (typically memory-mapped) buffer.
+// Handles quoted fields with embedded delimiters, doubled quotes and line
+// breaks, CRLF/LF line endings and a leading UTF-8 BOM.
+class CsvReader {
+public:
+    CsvReader(const char* data, qint64 size, char delimiter = ',');
+
+    // Reads the next record into fields, reusing its capacity.
+    // Returns false once the end of the buffer has been reached.
+    bool readRecord(QVector<CsvField>& fields);
+
+    bool atEnd() const { return m_pos >= m_size; }
+    qint64 position() const { return m_pos; }
+    qint64 size() const { return m_size; }
+
+private:
+    const char* m_data;
+    qint64 m_size;
+    qint64 m_pos;
+    char m_delimiter;
+
+    void readQuotedField(CsvField& field);
+    void readPlainField(CsvField& field);
+};
+
+#endif // CSVREADER_H
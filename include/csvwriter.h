@@ -0,0 +1,16 @@
+#ifndef CSVWRITER_H
+#define CSVWRITER_H
+
+#include <QIODevice>
+#include <QList>
+#include "address.h"
+
+// Writes address lists as CSV in the column order CsvImportWorker reads
+// back: street, city, state, zip, country, latitude, longitude
+class CsvWriter {
+public:
+    // Returns false if the device reports a write error
+    static bool writeAddresses(QIODevice* device, const QList<Address>& addresses);
+};
+
+#endif // CSVWRITER_H
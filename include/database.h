@@ -6,6 +6,17 @@
 #include <QSqlDatabase>
 #include <QString>
 #include <QList>
+#include <QByteArray>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+#include <QPair>
+
+struct AddressSearchHit {
+    Address address;
+    int listId;
+    double score; // Lower is a better match
+};
 
 class Database {
 public:
@@ -24,9 +35,42 @@ public:
     
     // Address operations
     int addAddress(int listId, const Address& address);
+    QList<int> addAddresses(int listId, const QList<Address>& addresses);
     bool deleteAddress(int addressId);
     bool updateAddress(const Address& address);
+    // The most recently loaded list is kept in memory and updated by every
+    // write above, so repeated reads of it do not touch SQLite
     QList<Address> getAddressesForList(int listId);
+    Address getAddress(int addressId);
+    
+    // Full-text search over street, city, state, zip and country in all
+    // lists, or in one list when listId is given. Every term is matched as a
+    // word prefix and all terms must match. Hits are ordered best first.
+    QList<AddressSearchHit> searchAddresses(const QString& text, int limit = 50, int listId = -1);
+    QSet<int> searchAddressIds(const QString& text, int listId);
+    bool hasSearchIndex() const { return m_hasSearchIndex; }
+    static QStringList searchTerms(const QString& text);
+    static QString ftsQuery(const QStringList& terms);
+    
+    // Spatial queries over addresses that have coordinates, in all lists or
+    // in one list when listId is given. Bounds may cross the antimeridian
+    // (west > east). Radius and nearest-neighbor results are closest first.
+    QList<Address> getAddressesInBounds(double south, double west, double north, double east,
+                                        int listId = -1);
+    QList<Address> getAddressesWithinRadius(double latitude, double longitude, double radiusKm,
+                                            int listId = -1);
+    QList<Address> getNearestAddresses(double latitude, double longitude, int count, int listId = -1);
+    bool hasSpatialIndex() const { return m_hasSpatialIndex; }
+    
+    // Batch geocoding operations. Addresses whose geocoding failed
+    // permanently are recorded so a resumed job skips them.
+    QList<Address> getAddressesWithoutCoordinates(int listId);
+    bool updateAddressCoordinates(int addressId, double latitude, double longitude);
+    bool saveGeocodeJob(int listId, int total, int processed, int failed);
+    bool loadGeocodeJob(int listId, int& total, int& processed, int& failed);
+    QList<int> getPendingGeocodeJobs();
+    void recordGeocodeFailure(int listId, int addressId, const QString& error);
+    void clearGeocodeJob(int listId, bool clearFailures);
     
     // Route info operations
     void saveRouteInfo(int listId, int startAddressId, int endAddressId,
@@ -35,7 +79,29 @@ public:
                       Address& startPoint, Address& endPoint);
     void clearRouteInfo(int listId);
     
+    // Geocoding cache operations; entries older than the TTL count as misses
+    bool getCachedGeocode(const QString& key, QByteArray& payload);
+    bool storeCachedGeocode(const QString& key, const QByteArray& payload);
+    int purgeExpiredGeocodes();
+    void clearGeocodeCache();
+    void setGeocodeCacheTtl(qint64 seconds) { m_geocodeCacheTtl = seconds; }
+    qint64 getGeocodeCacheTtl() const { return m_geocodeCacheTtl; }
+    int getGeocodeCacheHits() const { return m_geocodeCacheHits; }
+    int getGeocodeCacheMisses() const { return m_geocodeCacheMisses; }
+    
+    // Route cache operations; geometry and legs are stored as encoded by
+    // RouteCache. An empty profile clears routes of every profile.
+    bool getCachedRoute(const QString& key, QByteArray& geometry, QByteArray& legs,
+                        double& distanceKm, double& durationSeconds);
+    bool storeCachedRoute(const QString& key, const QString& profile, const QByteArray& geometry,
+                          const QByteArray& legs, double distanceKm, double durationSeconds);
+    int purgeExpiredRoutes();
+    void clearRouteCache(const QString& profile = QString());
+    void setRouteCacheTtl(qint64 seconds) { m_routeCacheTtl = seconds; }
+    qint64 getRouteCacheTtl() const { return m_routeCacheTtl; }
+    
     QString getLastError() const { return m_lastError; }
+    int schemaVersion();
     
 private:
     Database();
@@ -43,11 +109,31 @@ private:
     Database(const Database&) = delete;
     Database& operator=(const Database&) = delete;
     
+    void configureConnection();
     bool createTables();
+    bool migrateSchema();
+    void ensureSearchIndex();
+    void ensureSpatialIndex();
+    bool ensureOptionalIndex(const QString& table, const QString& module, const QString& probeColumns,
+                             const QStringList& triggers, const QStringList& statements);
+    bool isModuleAvailable(const QString& module, const QString& columns);
+    QList<Address> queryAddressesInBox(double south, double west, double north, double east, int listId);
+    QList<QPair<double, Address>> queryAddressesNear(double latitude, double longitude, double radiusKm,
+                                                     int listId);
+    QString searchCondition(const QStringList& terms, QVariantList& values) const;
+    QList<Address> queryAddressesForList(int listId, bool* ok = nullptr);
+    void invalidateCache();
     void setLastError(const QString& error);
     
     QSqlDatabase m_db;
     QString m_lastError;
+    AddressList m_cachedList; // Id -1 when nothing is cached
+    bool m_hasSearchIndex;
+    bool m_hasSpatialIndex;
+    qint64 m_geocodeCacheTtl;
+    int m_geocodeCacheHits;
+    int m_geocodeCacheMisses;
+    qint64 m_routeCacheTtl;
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,150 @@
+#ifndef DISTANCEMATRIXSERVICE_H
+#define DISTANCEMATRIXSERVICE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QPair>
+#include <QQueue>
+#include <QThreadPool>
+#include <QVector>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include "address.h"
+#include "roadgraph.h"
+
+// Dense travel costs between every ordered pair of addresses. Entries are
+// row-major from row to column; pairs without a route are infinite.
+struct DistanceMatrix {
+    int count = 0;
+    QVector<float> distancesKm;
+    QVector<float> durationsSeconds;
+    // Pairs that fell back to the straight-line estimate because a table
+    // request failed or an address is away from the road graph
+    int estimatedPairs = 0;
+
+    float distanceKm(int from, int to) const { return distancesKm[from * count + to]; }
+    float durationSeconds(int from, int to) const { return durationsSeconds[from * count + to]; }
+};
+
+Q_DECLARE_METATYPE(DistanceMatrix)
+
+// Computes distance matrices from the OSRM table service, in tiles small
+// enough for the server's table size limit, or locally from a road graph
+// or straight-line distances. Local matrices are computed in row blocks on
+// a thread pool. Every computed pair is cached by its coordinates, so
+// overlapping requests only compute the pairs they haven't seen.
+class DistanceMatrixService : public QObject {
+    Q_OBJECT
+
+public:
+    enum Source {
+        OsrmTable,
+        LocalGraph,
+        StraightLine
+    };
+
+    explicit DistanceMatrixService(QObject* parent = nullptr);
+    ~DistanceMatrixService() override;
+
+    // Returns an id that identifies the request in the signals below.
+    // Results are always delivered asynchronously.
+    int computeMatrix(const QList<Address>& addresses);
+    void cancel(int requestId);
+    void cancelAll();
+    bool isBusy() const { return !m_jobs.isEmpty(); }
+
+    // Changing where costs come from empties the cache. Requests already
+    // running keep the source they started with.
+    void setSource(Source source);
+    Source getSource() const { return m_source; }
+    void setOsrmServerUrl(const QString& url);
+    QString getOsrmServerUrl() const { return m_serverUrl; }
+    void setRoadGraph(const RoadGraph& graph);
+
+    // Addresses per tile side; OSRM tiles send up to twice as many coordinates
+    void setTileSize(int count) { m_tileSize = qMax(1, count); }
+    int getTileSize() const { return m_tileSize; }
+    void setMaxConcurrentRequests(int count) { m_maxConcurrentRequests = qMax(1, count); }
+    void setMaxThreads(int count) { m_threadPool.setMaxThreadCount(qMax(1, count)); }
+    // Speed used to turn straight-line distances into durations
+    void setStraightLineSpeed(double kmPerHour) { m_straightLineSpeedKmh = qMax(1.0, kmPerHour); }
+
+    int getCacheSize() const { return m_cache.size(); }
+    // The cache is emptied whenever it grows past this many pairs
+    void setMaxCacheSize(int pairs) { m_maxCacheSize = qMax(0, pairs); }
+    void clearCache() { m_cache.clear(); }
+
+signals:
+    void matrixReady(int requestId, const DistanceMatrix& matrix);
+    void matrixFailed(int requestId, const QString& error);
+    void matrixProgress(int requestId, int completedTiles, int totalTiles);
+
+private slots:
+    void onTableReplyFinished();
+
+private:
+    struct Tile {
+        int firstRow;
+        int rowCount;
+        int firstColumn;
+        int columnCount;
+    };
+
+    struct TileResult {
+        QVector<float> distancesKm;
+        QVector<float> durationsSeconds;
+        QVector<bool> estimated;
+    };
+
+    struct Job {
+        Source source;
+        QVector<double> latitudes;
+        QVector<double> longitudes;
+        QVector<quint64> pointKeys;
+        QVector<int> graphNodes;
+        DistanceMatrix matrix;
+        QQueue<Tile> pending;
+        int activeTiles;
+        int totalTiles;
+        int completedTiles;
+    };
+
+    struct CachedCost {
+        float distanceKm;
+        float durationSeconds;
+    };
+
+    Source m_source;
+    QString m_serverUrl;
+    RoadGraph m_graph;
+    QNetworkAccessManager* m_networkManager;
+    QThreadPool m_threadPool;
+    int m_tileSize;
+    int m_maxConcurrentRequests;
+    double m_straightLineSpeedKmh;
+    int m_maxCacheSize;
+    int m_nextRequestId;
+    int m_activeRequests;
+    QHash<int, Job> m_jobs;
+    QHash<QNetworkReply*, QPair<int, Tile>> m_replies;
+    QHash<QPair<quint64, quint64>, CachedCost> m_cache;
+
+    static quint64 pointKey(double latitude, double longitude);
+    void planTiles(Job& job);
+    void dispatch();
+    void startLocalTile(int requestId, const Job& job, const Tile& tile);
+    void startTableRequest(int requestId, const Job& job, const Tile& tile);
+    void applyTile(int requestId, const Tile& tile, const TileResult& result);
+    void finishJob(int requestId);
+    QString buildTableUrl(const Job& job, const Tile& tile) const;
+    bool parseTableResponse(const QByteArray& data, const Tile& tile, TileResult& result) const;
+    static TileResult straightLineTile(const QVector<double>& latitudes, const QVector<double>& longitudes,
+                                       const Tile& tile, double speedKmh);
+    static TileResult graphTile(const RoadGraph& graph, const QVector<double>& latitudes,
+                                const QVector<double>& longitudes, const QVector<int>& nodes,
+                                const Tile& tile, double speedKmh);
+};
+
+#endif // DISTANCEMATRIXSERVICE_H
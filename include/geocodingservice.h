@@ -7,6 +7,9 @@
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <QStringList>
+
+class QJsonArray;
 
 struct GeocodingCandidate {
   double latitude;
@@ -23,14 +26,27 @@ public:
   explicit GeocodingService(QObject *parent = nullptr);
   ~GeocodingService() override;
 
-  void geocode(const Address &address, int maxResults = 1);
+  // Results are served from the persistent cache when available; cache
+  // hits are still delivered asynchronously through the signals below
+  // Returns an id that identifies the request in geocodingResultReady and
+  // geocodingRequestFailed
+  int geocode(const Address &address, int maxResults = 1);
   void reverseGeocode(double latitude, double longitude);
 
+  // Case-folded, whitespace-collapsed query parts plus the result limit
+  static QString cacheKey(const Address &address, int maxResults);
+
 signals:
   void geocodingCompleted(double latitude, double longitude,
                           const QString &formattedAddress);
   void geocodingMultipleResults(const QVector<GeocodingCandidate> &candidates);
   void geocodingFailed(const QString &error);
+  void geocodingResultReady(int requestId,
+                            const QVector<GeocodingCandidate> &candidates,
+                            bool fromCache);
+  // retryable is set for transient failures (network, throttling, server)
+  void geocodingRequestFailed(int requestId, const QString &error,
+                              bool retryable);
   void reverseGeocodingCompleted(const QString &street, const QString &city,
                                  const QString &state, const QString &country);
   void reverseGeocodingFailed(const QString &error);
@@ -41,7 +57,10 @@ private slots:
 
 private:
   QNetworkAccessManager *m_networkManager;
-  int m_maxResults;
+  int m_nextRequestId;
+  static QStringList queryParts(const Address &address);
+  void handleGeocodeResults(int requestId, const QJsonArray &results,
+                            int maxResults, bool fromCache);
   QString buildGeocodeUrl(const Address &address, int maxResults) const;
   QString buildReverseGeocodeUrl(double latitude, double longitude) const;
 };
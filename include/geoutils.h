@@ -0,0 +1,53 @@
+#ifndef GEOUTILS_H
+#define GEOUTILS_H
+
+#include <QList>
+#include <QPointF>
+#include <QtMath>
+#include <cmath>
+#include <vector>
+
+const double kEarthRadiusKm = 6371.0088;
+
+// Great-circle distance between two WGS84 coordinates, in kilometers
+inline double haversineDistanceKm(double lat1, double lng1, double lat2, double lng2) {
+    double dLat = qDegreesToRadians(lat2 - lat1);
+    double dLng = qDegreesToRadians(lng2 - lng1);
+    double sinLat = std::sin(dLat * 0.5);
+    double sinLng = std::sin(dLng * 0.5);
+    double h = sinLat * sinLat +
+               std::cos(qDegreesToRadians(lat1)) * std::cos(qDegreesToRadians(lat2)) * sinLng * sinLng;
+    return 2.0 * kEarthRadiusKm * std::asin(std::sqrt(qMin(1.0, h)));
+}
+
+// Length of a polyline of (longitude, latitude) points, in kilometers, on
+// the same sphere as haversineDistanceKm(). Vertices are converted to unit
+// vectors once, so each segment costs a chord length and one asin instead
+// of four trigonometric calls; the chord is taken from coordinate
+// differences and stays accurate for segments of a few centimeters.
+inline double polylineLengthKm(const QList<QPointF>& points) {
+    const int count = points.size();
+    if (count < 2) return 0.0;
+
+    std::vector<double> x(count), y(count), z(count);
+    for (int i = 0; i < count; ++i) {
+        double lat = qDegreesToRadians(points[i].y());
+        double lng = qDegreesToRadians(points[i].x());
+        double cosLat = std::cos(lat);
+        x[i] = cosLat * std::cos(lng);
+        y[i] = cosLat * std::sin(lng);
+        z[i] = std::sin(lat);
+    }
+
+    double angle = 0.0;
+    for (int i = 1; i < count; ++i) {
+        double dx = x[i] - x[i - 1];
+        double dy = y[i] - y[i - 1];
+        double dz = z[i] - z[i - 1];
+        double halfChord = 0.5 * std::sqrt(dx * dx + dy * dy + dz * dz);
+        angle += std::asin(qMin(1.0, halfChord));
+    }
+    return 2.0 * kEarthRadiusKm * angle;
+}
+
+#endif // GEOUTILS_H
@@ -0,0 +1,15 @@
+#ifndef GZIPUTILS_H
+#define GZIPUTILS_H
+
+#include <QByteArray>
+
+// CRC-32 as used by gzip and zip (reflected polynomial 0xEDB88320)
+quint32 crc32(const QByteArray& data);
+
+// Wraps data in a gzip member that gzip, zcat and log viewers can read.
+// Qt only exposes zlib through qCompress(), whose output is a zlib stream
+// behind a length prefix; its deflate payload is reused as is, so no zlib
+// dependency is needed. Returns an empty array if compression fails.
+QByteArray gzipCompress(const QByteArray& data, int level = 6);
+
+#endif // GZIPUTILS_H
@@ -0,0 +1,56 @@
+#ifndef LOCALROUTINGBACKEND_H
+#define LOCALROUTINGBACKEND_H
+
+#include "routingbackend.h"
+#include "roadgraph.h"
+#include <QThreadPool>
+#include <atomic>
+
+// Routes in-process over a road graph loaded from disk, so routing works
+// offline. Waypoints are snapped to the nearest graph node. Queries run on
+// a thread pool and their results are delivered on the owner's thread.
+class LocalRoutingBackend : public RoutingBackend {
+    Q_OBJECT
+
+public:
+    explicit LocalRoutingBackend(QObject* parent = nullptr);
+    ~LocalRoutingBackend() override;
+
+    // Binary graphs from RoadGraph::save(), or a DIMACS .gr file with its
+    // .co coordinates next to it
+    bool loadGraph(const QString& path);
+    // Same as loadGraph() on a worker thread; reports through graphLoaded()
+    void loadGraphAsync(const QString& path);
+    void setGraph(const RoadGraph& graph);
+    const RoadGraph& getGraph() const { return m_graph; }
+    QString getGraphPath() const { return m_graphPath; }
+    QString getLastError() const { return m_lastError; }
+
+    void setMaxSnapDistance(double km) { m_maxSnapDistanceKm = km; }
+    double getMaxSnapDistance() const { return m_maxSnapDistanceKm; }
+
+    void requestRoute(int requestId, const QList<Address>& waypoints) override;
+    void cancelAll() override;
+    BackendType getType() const override { return Local; }
+    // Graphs set in memory have no profile, so their routes are not cached
+    QString getProfile() const override { return m_profile; }
+
+signals:
+    void graphLoaded(bool loaded);
+
+private:
+    RoadGraph m_graph;
+    QString m_graphPath;
+    QString m_profile;
+    QString m_lastError;
+    double m_maxSnapDistanceKm;
+    std::atomic<int> m_generation;
+    QThreadPool m_threadPool;
+
+    static bool readGraph(const QString& path, RoadGraph& graph);
+    bool applyGraph(const QString& path, const RoadGraph& graph, bool loaded);
+    static RoutePath route(const RoadGraph& graph, const QList<Address>& waypoints,
+                           double maxSnapDistanceKm, QString& error);
+};
+
+#endif // LOCALROUTINGBACKEND_H
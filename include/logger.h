@@ -5,8 +5,16 @@
 #include <QFile>
 #include <QTextStream>
 #include <QDateTime>
-#include <QMutex>
+#include <QVariant>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "mpscringbuffer.h"
 
+// Messages are queued without locking and written by a background thread,
+// which batches console and file output and flushes once per batch, so a
+// log call costs the caller little more than building its message.
 class Logger {
 public:
     enum Level {
@@ -16,36 +24,149 @@ public:
         Error
     };
 
+    // What a log call does while the queue is full
+    enum OverflowPolicy {
+        DropMessages,   // Discard the message; the count is logged later
+        BlockCaller     // Wait for the writer thread to make room
+    };
+
     static Logger& instance();
-    
+
     void log(Level level, const QString& message);
+    // Queues the format string and arguments; the writer thread replaces
+    // %1..%99 with the arguments, so the caller never builds the message
+    void logFormat(Level level, const QString& format, const QVariantList& args);
+    template <typename... Args>
+    void logFormat(Level level, const QString& format, const Args&... args) {
+        logFormat(level, format, QVariantList{toLogArgument(args)...});
+    }
     void debug(const QString& message);
     void info(const QString& message);
     void warning(const QString& message);
     void error(const QString& message);
-    
+
     void setLogFile(const QString& filePath);
     void setLogLevel(Level level);
-    
+    bool isEnabled(Level level) const {
+        return level >= m_logLevel.load(std::memory_order_relaxed);
+    }
+    // The log file is archived once it grows past maxBytes or its first
+    // message is older than maxAgeSeconds; 0 turns either check off. The
+    // writer thread gzips archives while it is idle and keeps only the
+    // newest maxArchives of them.
+    void setRotation(qint64 maxBytes, qint64 maxAgeSeconds, int maxArchives);
+    // Warnings and errors go to stderr, the rest to stdout
+    void setConsoleOutput(bool enabled) { m_consoleOutput.store(enabled); }
+
+    void setOverflowPolicy(OverflowPolicy policy) { m_overflowPolicy.store(policy); }
+    OverflowPolicy getOverflowPolicy() const { return m_overflowPolicy.load(); }
+    quint64 getDroppedCount() const { return m_droppedTotal.load(); }
+
+    // Returns once every message logged before the call is written and the
+    // file is flushed
+    void flush();
+
+    // Writes queued messages from the calling thread before the process
+    // dies on a fatal signal or std::terminate. Best effort: the handler
+    // is not async-signal-safe, but the process is going down anyway.
+    static void installCrashHandler();
+
+    // Single pass, so %N inside an argument is left alone. Placeholders
+    // without a matching argument are kept as they are.
+    static QString formatMessage(const QString& format, const QVariantList& args);
+
 private:
+    struct Record {
+        qint64 timestamp = 0;
+        Level level = Info;
+        QString message;
+        QVariantList args;  // Not empty when message is a format string
+    };
+
+    template <typename T>
+    static QVariant toLogArgument(const T& value) { return QVariant::fromValue(value); }
+    static QVariant toLogArgument(const char* value) { return QString::fromUtf8(value); }
+
     Logger();
     ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
-    
+
     QString levelToString(Level level) const;
-    void writeToFile(const QString& message);
-    
+    void enqueue(Record&& record);
+    void run();
+    int drain(int maxRecords);
+    QString formatRecord(const Record& record) const;
+    void writeRecord(const Record& record);
+    void flushOutput();
+    void openLogFile();
+    bool rotationDue(qint64 fileSize) const;
+    void rotate();
+    void archiveLogFile();
+    void compressArchives();
+    static qint64 firstMessageTime(const QString& filePath);
+    void wakeWriter();
+    void flushAfterCrash();
+    static void onFatalSignal(int signal);
+    static void onTerminate();
+
+    MpscRingBuffer<Record> m_queue;
+    std::atomic<int> m_logLevel;
+    std::atomic<OverflowPolicy> m_overflowPolicy;
+    std::atomic<bool> m_consoleOutput;
+    std::atomic<quint64> m_dropped;      // Not yet reported in the log
+    std::atomic<quint64> m_droppedTotal;
+
+    // Only the writer thread, setLogFile() and the crash handler touch the outputs
+    std::mutex m_outputMutex;
     QFile m_logFile;
     QTextStream m_stream;
-    Level m_logLevel;
-    QMutex m_mutex;
+    qint64 m_fileStartedAt;     // ms since epoch of the file's first message
+    qint64 m_maxFileSize;
+    qint64 m_maxFileAge;        // seconds
+    int m_maxArchives;
+    std::atomic<bool> m_archivesPending;
+
+    std::thread m_writer;
+    std::mutex m_stateMutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_flushedCondition;
+    std::atomic<bool> m_writerIdle;
+    bool m_wakeRequested;
+    bool m_stopping;
+    std::size_t m_writtenCount; // Records popped and flushed, under m_stateMutex
 };
 
-// Convenience macros
-#define LOG_DEBUG(msg) Logger::instance().debug(msg)
-#define LOG_INFO(msg) Logger::instance().info(msg)
-#define LOG_WARNING(msg) Logger::instance().warning(msg)
-#define LOG_ERROR(msg) Logger::instance().error(msg)
+// Convenience macros. The message is only evaluated when its level is
+// enabled, so building it may be as expensive as it needs to be.
+#define LOG_AT_LEVEL(level, msg) \
+    do { \
+        Logger& logger_ = Logger::instance(); \
+        if (logger_.isEnabled(level)) logger_.log(level, msg); \
+    } while (0)
+
+// Deferred formatting: LOG_INFOF("Loaded %1 rows from %2", count, path)
+#define LOG_AT_LEVEL_F(level, ...) \
+    do { \
+        Logger& logger_ = Logger::instance(); \
+        if (logger_.isEnabled(level)) logger_.logFormat(level, __VA_ARGS__); \
+    } while (0)
+
+// Release builds define MAPADDRESS_NO_DEBUG_LOG (see the
+// MAPADDRESS_STRIP_DEBUG_LOG CMake option); debug calls are still type
+// checked but generate no code
+#ifdef MAPADDRESS_NO_DEBUG_LOG
+#define LOG_DEBUG(msg) do { if (false) Logger::instance().debug(msg); } while (0)
+#define LOG_DEBUGF(...) do { if (false) Logger::instance().logFormat(Logger::Debug, __VA_ARGS__); } while (0)
+#else
+#define LOG_DEBUG(msg) LOG_AT_LEVEL(Logger::Debug, msg)
+#define LOG_DEBUGF(...) LOG_AT_LEVEL_F(Logger::Debug, __VA_ARGS__)
+#endif
+#define LOG_INFO(msg) LOG_AT_LEVEL(Logger::Info, msg)
+#define LOG_WARNING(msg) LOG_AT_LEVEL(Logger::Warning, msg)
+#define LOG_ERROR(msg) LOG_AT_LEVEL(Logger::Error, msg)
+#define LOG_INFOF(...) LOG_AT_LEVEL_F(Logger::Info, __VA_ARGS__)
+#define LOG_WARNINGF(...) LOG_AT_LEVEL_F(Logger::Warning, __VA_ARGS__)
+#define LOG_ERRORF(...) LOG_AT_LEVEL_F(Logger::Error, __VA_ARGS__)
 
 #endif // LOGGER_H
@@ -2,9 +2,20 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QThreadPool>
 #include "mapwidget.h"
 #include "geocodingservice.h"
 #include "routingservice.h"
+#include "database.h"
+#include "routeoptimizer.h"
+
+class QThread;
+class QSettings;
+class QProgressDialog;
+class QTimer;
+class CsvImportWorker;
+class BatchGeocoder;
+class AddressListModel;
 
 namespace Ui {
 class MainWindow;
@@ -28,6 +39,8 @@ private slots:
     void onListChanged(int index);
     void onAddressSelected();
     void onSearchTextChanged(const QString& text);
+    void onSearchSubmitted();
+    void runSearch();
     void onFitAllMarkers();
     void onZoomIn();
     void onZoomOut();
@@ -41,16 +54,28 @@ private slots:
     void onSetEndPoint();
     void onClearRoute();
     void onShowAddressContextMenu(const QPoint& pos);
-    void onRouteCalculated(const QList<QPointF>& routePoints);
+    void onRouteCalculated(const RouteResult& route);
     void onRouteFailed(const QString& error);
+    void onRouteProgress(int completedSegments, int totalSegments);
     void onReverseGeocodeCompleted(const QString& street, const QString& city,
                                    const QString& state, const QString& country);
     void onReverseGeocodeFailed(const QString& error);
+    void onImportBatchReady(const QList<Address>& addresses);
+    void onImportProgress(qint64 bytesRead, qint64 totalBytes);
+    void onImportFinished(int parsedCount, int errorCount, bool cancelled);
+    void onImportFailed(const QString& error);
+    void onGeocodeMissing();
+    void onBatchGeocodeProgress(int processed, int total);
+    void onBatchAddressGeocoded(const Address& address);
+    void onBatchGeocodeFinished(int geocoded, int failed, bool cancelled);
+    void offerGeocodeResume();
 
 private:
     Ui::MainWindow *ui;
+    AddressListModel* m_addressModel;
     MapWidget* m_mapWidget;
     GeocodingService* m_geocodingService;
+    BatchGeocoder* m_batchGeocoder;
     RoutingService* m_routingService;
     int m_currentListId;
     int m_routeStartId;
@@ -59,6 +84,17 @@ private:
     Address m_mapClickEndAddr;
     double m_pendingAddressLat;
     double m_pendingAddressLng;
+    QThread* m_importThread;
+    CsvImportWorker* m_importWorker;
+    QProgressDialog* m_importProgress;
+    int m_importListId;
+    int m_importedCount;
+    int m_importErrorCount;
+    QTimer* m_searchTimer;
+    QList<AddressSearchHit> m_searchHits;
+    QString m_loadingGraphPath; // Road graph being loaded, if any
+    QThreadPool m_optimizerPool;
+    int m_routePlanGeneration;
 
     void setupConnections();
     void setupMapWidget();
@@ -67,11 +103,17 @@ private:
     void updateAddressButtons();
     void updateListButtons();
     void applySettings();
+    void applyRoutingSettings(QSettings& settings);
+    void loadRoadGraph(const QString& graphPath);
+    void useOsrmBackend(const QString& serverUrl);
     void updateAddressListDisplay();
+    int currentAddressId() const;
     void planRoute();
+    void startRoute(const QList<Address>& waypoints, const RouteOptimizationResult& optimization);
     void planMapClickRoute();
     void saveRouteInfo();
     void loadRouteInfo(int listId);
+    void stopImport();
 };
 
 #endif // MAINWINDOW_H
@@ -3,9 +3,29 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QList>
+#include <QVector>
+#include <QHash>
 #include "address.h"
 
+struct MapMarker {
+    int id;
+    double latitude;
+    double longitude;
+    int title; // Index into the provider's title table
+};
+
+// Markers packed for the page. The arrays are base64 encoded typed arrays
+// in native byte order; titles holds each distinct title once.
+struct MarkerPayload {
+    int count = 0;
+    QString ids;          // Int32Array
+    QString coords;       // Float64Array of lat,lng pairs
+    QString titleIndexes; // Int32Array of indexes into titles
+    QStringList titles;
+};
+
 class MapProvider : public QObject {
     Q_OBJECT
 
@@ -20,16 +40,42 @@ public:
 
     virtual void initialize() = 0;
     virtual void setCenter(double latitude, double longitude, int zoom = 13) = 0;
-    virtual void addMarker(int id, double latitude, double longitude, const QString& title) = 0;
-    virtual void removeMarker(int id) = 0;
-    virtual void clearMarkers() = 0;
     virtual void fitBounds(const QList<Address>& addresses) = 0;
+    // The page starts without markers; it reports its viewport and renders
+    // the markers or clusters MapWidget streams back for it
     virtual QString getHtml() const = 0;
     virtual ProviderType getType() const = 0;
 
+    // Marker store shared by all providers. Records are kept in a flat
+    // array (removal swaps in the last one) and equal titles are stored once.
+    void addMarker(int id, double latitude, double longitude, const QString& title);
+    void removeMarker(int id);
+    void clearMarkers();
+    void copyMarkers(const MapProvider& other);
+    const QVector<MapMarker>& getMarkers() const { return m_markers; }
+    int getMarkerCount() const { return m_markers.size(); }
+    int findMarker(int id) const { return m_markerIndex.value(id, -1); }
+    QString getMarkerTitle(const MapMarker& marker) const { return m_titles[marker.title]; }
+    int getTitleCount() const { return m_titleLookup.size(); }
+
+    MarkerPayload packMarkers(const QVector<int>& ids) const;
+    MarkerPayload packAllMarkers() const;
+
 signals:
     void markerClicked(int markerId);
     void mapClicked(double latitude, double longitude);
+
+private:
+    QVector<MapMarker> m_markers;
+    QHash<int, int> m_markerIndex; // id -> position in m_markers
+    QVector<QString> m_titles;
+    QVector<int> m_titleRefs;
+    QVector<int> m_freeTitles;
+    QHash<QString, int> m_titleLookup;
+
+    int internTitle(const QString& title);
+    void releaseTitle(int index);
+    MarkerPayload pack(const QVector<int>& positions) const;
 };
 
 #endif // MAPPROVIDER_H
@@ -5,9 +5,16 @@
 #include <QWebEngineView>
 #include <QWebEnginePage>
 #include <QWebChannel>
+#include <QMap>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVariant>
+#include <functional>
 #include "mapprovider.h"
 #include "googlemapsprovider.h"
 #include "openstreetmapprovider.h"
+#include "markerclusterer.h"
+#include "polylinesimplifier.h"
 
 // Custom page to capture console messages
 class ConsolePage : public QWebEnginePage {
@@ -35,9 +42,33 @@ public slots:
         emit mapClickedSignal(lat, lng);
     }
 
+    // Called by the page once the map and the channel are both initialized
+    void pageReady() {
+        emit pageReadySignal();
+    }
+
+    void viewportChanged(double south, double west, double north, double east, int zoom) {
+        emit viewportChangedSignal(south, west, north, east, zoom);
+    }
+
 signals:
     void markerClickedSignal(int markerId);
     void mapClickedSignal(double lat, double lng);
+    void pageReadySignal();
+    void viewportChangedSignal(double south, double west, double north, double east, int zoom);
+
+    // Delivered to the page through QWebChannel
+    void markersChanged(const QVariantList& upserts, const QVariantList& removedIds);
+    // Markers inside the viewport, replacing those shown. The arguments
+    // are the fields of a MarkerPayload.
+    void viewportMarkers(const QString& ids, const QString& coords, const QString& titleIndexes,
+                         const QStringList& titles);
+    void centerRequested(double lat, double lng, int zoom);
+    void fitBoundsRequested(double south, double west, double north, double east);
+    void clustersUpdated(const QVariantList& clusters);
+    // The route simplified for the page's zoom, packed by
+    // PolylineSimplifier::pack(); the page fits its view to it on request
+    void routeChanged(const QString& coords, bool fitBounds);
 };
 
 class MapWidget : public QWidget {
@@ -54,6 +85,17 @@ public:
     void centerOnAddress(const Address& address);
     void clearMap();
     void loadMap();
+
+    // Incremental updates; pushed to the loaded page without reloading it
+    void addMarker(int id, double latitude, double longitude, const QString& title);
+    void removeMarker(int id);
+    void clearMarkers();
+    void setCenter(double latitude, double longitude, int zoom);
+    void fitToAddresses(const QList<Address>& addresses);
+
+    void setClusteringEnabled(bool enabled);
+    bool isClusteringEnabled() const { return m_clusteringEnabled; }
+
     void zoomIn();
     void zoomOut();
     void highlightMarker(int markerId);
@@ -65,6 +107,11 @@ signals:
     void markerClicked(int markerId);
     void mapClicked(double latitude, double longitude);
 
+private slots:
+    void onPageReady();
+    void onViewportChanged(double south, double west, double north, double east, int zoom);
+    void flushMarkerChanges();
+
 private:
     QWebEngineView* m_webView;
     MapProvider* m_currentProvider;
@@ -73,7 +120,44 @@ private:
     MapBridge* m_bridge;
     QWebChannel* m_channel;
 
+    // Page state and marker changes waiting for the next flush
+    bool m_pageReady;
+    bool m_resyncPending;
+    bool m_flushScheduled;
+    qint64 m_pageLoadStart; // Tracer start time of the page being loaded
+    QMap<int, QVariantMap> m_pendingUpserts;
+    QList<int> m_pendingRemovals;
+    std::function<void()> m_pendingViewRequest;
+
+    // Spatial index over all markers, rebuilt lazily after marker changes.
+    // Clusters are only built when they are going to be shown.
+    bool m_clusteringEnabled;
+    bool m_indexDirty;
+    bool m_showingClusters;
+    MarkerClusterer m_clusterer;
+
+    // The route is ranked for simplification off the GUI thread, then sent
+    // again for every zoom level the page shows it at
+    QThreadPool m_routePool;
+    QSharedPointer<const PolylineSimplifier> m_route;
+    int m_routeGeneration;
+    int m_routeZoom; // -1 until the current page has the route
+    bool m_hasViewport;
+    double m_viewSouth;
+    double m_viewWest;
+    double m_viewNorth;
+    double m_viewEast;
+    int m_viewZoom;
+
     void setupProviders();
+    void scheduleFlush();
+    void requestView(const std::function<void()>& request);
+    void ensureIndex(bool withClusters);
+    void sendClusters();
+    void sendViewportMarkers();
+    void sendRoute(bool fitBounds);
+    void resetRoute();
+    bool isInViewport(double latitude, double longitude) const;
 };
 
 #endif // MAPWIDGET_H
@@ -0,0 +1,76 @@
+#ifndef MARKERCLUSTERER_H
+#define MARKERCLUSTERER_H
+
+#include <QVector>
+#include <QHash>
+
+struct ClusterItem {
+    int id;
+    double latitude;
+    double longitude;
+};
+
+struct MarkerCluster {
+    double latitude;
+    double longitude;
+    int count;
+    int markerId; // Only meaningful when count == 1
+};
+
+// Hierarchical greedy clustering in Web Mercator space. All zoom levels are
+// computed up front in load(); clusters() then answers viewport queries
+// from a per-level grid without touching points outside the viewport.
+// Loading without clusters only indexes the raw points, which is enough
+// for points() and much cheaper for large inputs.
+class MarkerClusterer {
+public:
+    explicit MarkerClusterer(int radiusPx = 60, int minZoom = 0, int maxZoom = 16);
+
+    void load(const QVector<ClusterItem>& items, bool buildClusters = true);
+    void clear();
+
+    // Without built clusters every zoom level answers with the raw points
+    QVector<MarkerCluster> clusters(double south, double west, double north, double east,
+                                    int zoom) const;
+    QVector<MarkerCluster> points(double south, double west, double north, double east) const;
+
+    bool hasClusters() const { return m_clustersBuilt; }
+    int minZoom() const { return m_minZoom; }
+    int maxZoom() const { return m_maxZoom; }
+    int itemCount() const { return m_itemCount; }
+
+private:
+    struct Node {
+        double x;
+        double y;
+        int count;
+        int markerId;
+    };
+
+    struct Level {
+        QVector<Node> nodes;
+        QHash<quint64, QVector<int>> cells;
+        double cellSize;
+    };
+
+    int m_radiusPx;
+    int m_minZoom;
+    int m_maxZoom;
+    int m_itemCount;
+    bool m_clustersBuilt;
+    // Index i holds zoom m_minZoom + i; the last level holds the raw points
+    QVector<Level> m_levels;
+
+    static double lngToX(double lng);
+    static double latToY(double lat);
+    static double xToLng(double x);
+    static double yToLat(double y);
+    static quint64 cellKey(int cx, int cy);
+
+    void indexLevel(Level& level, int zoom);
+    QVector<Node> clusterLevel(const QVector<Node>& points, int zoom) const;
+    void collect(const Level& level, double x0, double x1, double y0, double y1,
+                 QVector<MarkerCluster>& result) const;
+};
+
+#endif // MARKERCLUSTERER_H
@@ -0,0 +1,102 @@
+#ifndef MPSCRINGBUFFER_H
+#define MPSCRINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue after Dmitry Vyukov's design. Any number of
+// threads may push; pops are meant for one consumer thread but are safe
+// from several, which lets a crashing thread drain what the consumer has
+// not written yet. Every slot carries a sequence number that tells
+// producers and consumers whose turn it is, so neither side ever waits on
+// a lock; a push only fails when the buffer is full.
+template <typename T>
+class MpscRingBuffer {
+public:
+    // Capacity is rounded up to a power of two
+    explicit MpscRingBuffer(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+        for (std::size_t i = 0; i < size; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_pushPosition.store(0, std::memory_order_relaxed);
+        m_popPosition.store(0, std::memory_order_relaxed);
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    bool tryPush(T&& value) {
+        std::size_t position = m_pushPosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_slots[position & m_mask];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position);
+            if (difference == 0) {
+                if (m_pushPosition.compare_exchange_weak(position, position + 1,
+                                                         std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        std::size_t position = m_popPosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_slots[position & m_mask];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position + 1);
+            if (difference == 0) {
+                if (m_popPosition.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_popPosition.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(slot->value);
+        slot->value = T();
+        slot->sequence.store(position + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capacity() const { return m_mask + 1; }
+    // Pushes claimed so far, including ones still being written
+    std::size_t pushCount() const { return m_pushPosition.load(std::memory_order_acquire); }
+    std::size_t popCount() const { return m_popPosition.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // Producers and the consumer update different cache lines
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+    alignas(64) std::atomic<std::size_t> m_pushPosition;
+    alignas(64) std::atomic<std::size_t> m_popPosition;
+};
+
+#endif // MPSCRINGBUFFER_H
@@ -0,0 +1,41 @@
+#ifndef OSRMROUTINGBACKEND_H
+#define OSRMROUTINGBACKEND_H
+
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include "routingbackend.h"
+
+// Routes through an OSRM server's route service. Defaults to the public
+// demo server, which is rate limited and needs a network connection.
+class OsrmRoutingBackend : public RoutingBackend {
+    Q_OBJECT
+
+public:
+    explicit OsrmRoutingBackend(QObject* parent = nullptr);
+    ~OsrmRoutingBackend() override;
+
+    void requestRoute(int requestId, const QList<Address>& waypoints) override;
+    void cancelAll() override;
+    BackendType getType() const override { return Osrm; }
+    QString getProfile() const override { return "osrm:" + m_serverUrl + "/driving"; }
+
+    void setServerUrl(const QString& url);
+    QString getServerUrl() const { return m_serverUrl; }
+
+    // Parses a route service response; the path has no points on failure
+    static RoutePath parseRouteResponse(const QByteArray& data);
+
+private slots:
+    void onReplyFinished();
+
+private:
+    QNetworkAccessManager* m_networkManager;
+    QString m_serverUrl;
+    QHash<QNetworkReply*, int> m_replies; // reply -> request id
+
+    QString buildRouteUrl(const QList<Address>& waypoints) const;
+    QString describeError(QNetworkReply* reply) const;
+};
+
+#endif // OSRMROUTINGBACKEND_H
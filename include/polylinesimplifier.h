@@ -0,0 +1,46 @@
+#ifndef POLYLINESIMPLIFIER_H
+#define POLYLINESIMPLIFIER_H
+
+#include <QList>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+// Douglas-Peucker simplification of a (longitude, latitude) polyline in
+// Web Mercator space. load() ranks every vertex once by the tolerance at
+// which Douglas-Peucker would drop it, so the polyline for any zoom level
+// is then a single pass over the ranks.
+class PolylineSimplifier {
+public:
+    PolylineSimplifier();
+
+    void load(const QList<QPointF>& points);
+    void clear();
+    bool isEmpty() const { return m_points.isEmpty(); }
+    int getPointCount() const { return m_points.size(); }
+    const QList<QPointF>& getPoints() const { return m_points; }
+
+    // Indexes of the vertices kept at a tolerance in world units, where the
+    // whole map is 1 x 1. The first and last vertices are always kept.
+    QVector<int> simplify(double tolerance) const;
+    QVector<int> simplifyForZoom(int zoom, double tolerancePx = 0.5) const;
+
+    // Highest zoom at which the whole polyline fits in a view of this size
+    int fitZoom(int widthPx, int heightPx, int maxZoom = 18) const;
+
+    // Base64 of little-endian int32 (latitude, longitude) pairs in 1e-6
+    // degrees, the layout the map pages decode into an Int32Array
+    QString pack(const QVector<int>& indexes) const;
+
+    static double toleranceForZoom(int zoom, double tolerancePx);
+
+private:
+    QList<QPointF> m_points;
+    QVector<double> m_x;
+    QVector<double> m_y;
+    QVector<double> m_significance;
+
+    static double segmentDistance(double px, double py, double ax, double ay, double bx, double by);
+};
+
+#endif // POLYLINESIMPLIFIER_H
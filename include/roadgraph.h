@@ -0,0 +1,82 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <QString>
+#include <QVector>
+
+// Directed road network in compressed sparse row form: the outgoing edges
+// of node n are m_edgeHead[m_firstOut[n] .. m_firstOut[n + 1]). Incoming
+// edges are kept the same way for the backward search. Weights are travel
+// times in seconds; coordinates are stored in 1e-7 degrees like OSM.
+//
+// Graphs are loaded from the binary format written by save(), or imported
+// from a DIMACS shortest-path extract (.gr arcs plus .co coordinates).
+class RoadGraph {
+public:
+    struct Node {
+        double latitude;
+        double longitude;
+    };
+
+    struct Edge {
+        int from;
+        int to;
+        double seconds;
+    };
+
+    RoadGraph();
+
+    bool build(const QVector<Node>& nodes, const QVector<Edge>& edges);
+    bool load(const QString& path);
+    bool save(const QString& path) const;
+    // DIMACS arc weights are integers; secondsPerUnit converts them
+    bool importDimacs(const QString& graphPath, const QString& coordinatePath,
+                      double secondsPerUnit = 0.1);
+    void clear();
+
+    bool isEmpty() const { return m_latE7.isEmpty(); }
+    int getNodeCount() const { return m_latE7.size(); }
+    int getEdgeCount() const { return m_edgeHead.size(); }
+    double getLatitude(int node) const { return m_latE7[node] * 1e-7; }
+    double getLongitude(int node) const { return m_lngE7[node] * 1e-7; }
+    QString getLastError() const { return m_lastError; }
+
+    // Closest node within maxDistanceKm, or -1
+    int nearestNode(double latitude, double longitude, double maxDistanceKm = 5.0) const;
+
+    // Fastest path as a node sequence from source to target, found with
+    // bidirectional A*. Empty when target is unreachable.
+    QVector<int> shortestPath(int source, int target, double* seconds = nullptr) const;
+
+    // Travel times from source to each target from a single Dijkstra search
+    // that stops once every target is settled; infinity when unreachable.
+    // distancesKm receives the length of each path when given.
+    QVector<double> travelTimes(int source, const QVector<int>& targets,
+                                QVector<double>* distancesKm = nullptr) const;
+
+private:
+    QVector<qint32> m_latE7;
+    QVector<qint32> m_lngE7;
+    QVector<quint32> m_firstOut;
+    QVector<quint32> m_edgeHead;
+    QVector<float> m_edgeSeconds;
+    QVector<quint32> m_firstIn;
+    QVector<quint32> m_edgeTail;
+    QVector<float> m_inEdgeSeconds;
+    // Nodes sorted by grid cell for nearestNode()
+    QVector<qint64> m_cellKeys;
+    QVector<quint32> m_cellNodes;
+    // Upper bound on straight-line speed over any edge, for the A* heuristic
+    double m_maxSpeedKmPerSecond;
+    QString m_lastError;
+
+    void finish();
+    void buildReverse();
+    void buildCellIndex();
+    bool validate();
+    void setLastError(const QString& error);
+    double heuristicSeconds(int from, int to) const;
+    static qint64 cellKey(int row, int column);
+};
+
+#endif // ROADGRAPH_H
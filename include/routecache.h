@@ -0,0 +1,53 @@
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QList>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include "address.h"
+#include "routingbackend.h"
+
+// Routes keyed by the routing profile and the waypoint sequence. Recently
+// used routes are kept in memory; every route is also written to the
+// database's route_cache table when it is open, so routes seen in earlier
+// sessions load without a routing request.
+class RouteCache {
+public:
+    // The memory cache holds up to this many route points in total
+    explicit RouteCache(int maxPoints = 1000000);
+
+    // Waypoints are quantized to 1e-5 degrees (about a meter), so the same
+    // stops reloaded from the database hash to the same key
+    static QString cacheKey(const QString& profile, const QList<Address>& waypoints);
+
+    bool find(const QString& key, RoutePath& path);
+    void insert(const QString& key, const QString& profile, const RoutePath& path);
+    // Empties the memory cache only; see Database::clearRouteCache()
+    void clear() { m_routes.clear(); }
+
+    void setPersistent(bool persistent) { m_persistent = persistent; }
+    bool isPersistent() const { return m_persistent; }
+    void setMaxPoints(int points) { m_routes.setMaxCost(qMax(1, points)); }
+    int getMaxPoints() const { return int(m_routes.maxCost()); }
+    int getSize() const { return int(m_routes.size()); }
+    int getHits() const { return m_hits; }
+    int getMisses() const { return m_misses; }
+
+    // Compressed (longitude, latitude) deltas in 1e-6 degrees
+    static QByteArray encodeGeometry(const QList<QPointF>& points);
+    static QList<QPointF> decodeGeometry(const QByteArray& data);
+    // Little-endian float64 (distance, duration) pairs
+    static QByteArray encodeLegs(const QVector<RouteLeg>& legs);
+    static QVector<RouteLeg> decodeLegs(const QByteArray& data);
+
+private:
+    QCache<QString, RoutePath> m_routes;
+    bool m_persistent;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // ROUTECACHE_H
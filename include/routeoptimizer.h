@@ -0,0 +1,45 @@
+#ifndef ROUTEOPTIMIZER_H
+#define ROUTEOPTIMIZER_H
+
+#include <QList>
+#include <QVector>
+#include "address.h"
+
+struct RouteOptimizationResult {
+    QVector<int> order;             // Indices into the input stops, in visiting order
+    double originalDistance = 0.0;  // Input order, with fixed endpoints moved to the ends
+    double optimizedDistance = 0.0;
+    int improvements = 0;
+    qint64 elapsedMs = 0;
+    bool timedOut = false;
+
+    double savedDistance() const { return originalDistance - optimizedDistance; }
+};
+
+// Orders route stops to shorten an open path: nearest-neighbor construction
+// followed by 2-opt and Or-opt moves restricted to each stop's nearest
+// neighbors, until no move improves or the time budget runs out. The
+// budget covers construction too; stops not reached by then keep their
+// input order. optimize() is reentrant and may run on a worker thread.
+// Distances are straight-line kilometers for addresses, or the units of the
+// supplied matrix (assumed symmetric).
+class RouteOptimizer {
+public:
+    explicit RouteOptimizer(int timeBudgetMs = 500);
+
+    void setTimeBudget(int timeBudgetMs) { m_timeBudgetMs = timeBudgetMs; }
+    int getTimeBudget() const { return m_timeBudgetMs; }
+
+    // startIndex/endIndex pin the first/last stop; -1 leaves it free
+    RouteOptimizationResult optimize(const QList<Address>& stops,
+                                     int startIndex = -1, int endIndex = -1) const;
+
+    // matrix holds count * count row-major distances
+    RouteOptimizationResult optimize(const QVector<double>& matrix, int count,
+                                     int startIndex = -1, int endIndex = -1) const;
+
+private:
+    int m_timeBudgetMs;
+};
+
+#endif // ROUTEOPTIMIZER_H
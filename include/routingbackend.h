@@ -0,0 +1,58 @@
+#ifndef ROUTINGBACKEND_H
+#define ROUTINGBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include <QMetaType>
+#include "address.h"
+
+// Length and travel time between two consecutive waypoints
+struct RouteLeg {
+    double distanceKm = 0.0;
+    double durationSeconds = 0.0;
+};
+
+// Road geometry through a request's waypoints, as (longitude, latitude)
+// points, with the length and travel time of the whole path and of each
+// of its legs
+struct RoutePath {
+    QList<QPointF> points;
+    double distanceKm = 0.0;
+    double durationSeconds = 0.0;
+    QVector<RouteLeg> legs;
+};
+
+Q_DECLARE_METATYPE(RoutePath)
+
+// Computes the road geometry through a sequence of waypoints. RoutingService
+// splits long routes into requests and stitches the results back together.
+class RoutingBackend : public QObject {
+    Q_OBJECT
+
+public:
+    enum BackendType {
+        Osrm,
+        Local
+    };
+
+    explicit RoutingBackend(QObject* parent = nullptr) : QObject(parent) {}
+    virtual ~RoutingBackend() = default;
+
+    // routeFinished is emitted once per request, never from inside this
+    // call, unless the request is cancelled first
+    virtual void requestRoute(int requestId, const QList<Address>& waypoints) = 0;
+    virtual void cancelAll() = 0;
+    virtual BackendType getType() const = 0;
+    // Identifies the road data and travel mode routes come from; routes are
+    // only cached when it is not empty
+    virtual QString getProfile() const = 0;
+
+signals:
+    // Error is empty on success
+    void routeFinished(int requestId, const RoutePath& path, const QString& error);
+};
+
+#endif // ROUTINGBACKEND_H
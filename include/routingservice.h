@@ -3,33 +3,85 @@
 
 #include <QObject>
 #include <QString>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QList>
+#include <QVector>
 #include <QPointF>
 #include "address.h"
+#include "routecache.h"
+#include "routingbackend.h"
+
+// A route through all requested waypoints. Legs are in waypoint order,
+// one per pair of consecutive waypoints, and empty when the backend did
+// not report them.
+struct RouteResult {
+    QList<QPointF> points;
+    double distanceKm = 0.0;
+    double durationSeconds = 0.0;
+    QVector<RouteLeg> legs;
+};
+
+Q_DECLARE_METATYPE(RouteResult)
 
 class RoutingService : public QObject {
     Q_OBJECT
 
 public:
+    // Routes through the OSRM backend until another one is set
     explicit RoutingService(QObject* parent = nullptr);
     ~RoutingService() override;
 
-    // Calculate route through multiple waypoints
+    // Takes ownership of the backend and cancels any route in progress
+    void setBackend(RoutingBackend* backend);
+    RoutingBackend* getBackend() const { return m_backend; }
+
+    // Calculate route through multiple waypoints. Long lists are split into
+    // segments that share their boundary waypoint and are requested in
+    // parallel; a new call cancels any route still in progress.
     void calculateRoute(const QList<Address>& waypoints);
+    void cancel();
+    bool isBusy() const { return m_activeRequests > 0; }
+
+    void setMaxWaypointsPerRequest(int count) { m_maxWaypointsPerRequest = qMax(2, count); }
+    int getMaxWaypointsPerRequest() const { return m_maxWaypointsPerRequest; }
+    void setMaxConcurrentRequests(int count) { m_maxConcurrentRequests = qMax(1, count); }
+    int getMaxConcurrentRequests() const { return m_maxConcurrentRequests; }
+
+    // Segments found in the cache are delivered without a backend request
+    RouteCache& getCache() { return m_cache; }
 
 signals:
-    void routeCalculated(const QList<QPointF>& routePoints);
+    void routeCalculated(const RouteResult& route);
     void routeFailed(const QString& error);
+    void routeProgress(int completedSegments, int totalSegments);
+    void segmentFailed(int segment, int firstWaypoint, int lastWaypoint, const QString& error);
 
 private slots:
-    void onRouteRequestFinished();
+    void onSegmentFinished(int index, const RoutePath& path, const QString& error);
 
 private:
-    QNetworkAccessManager* m_networkManager;
-    QString buildRouteUrl(const QList<Address>& waypoints) const;
-    QList<QPointF> parseRouteResponse(const QByteArray& data) const;
+    struct RouteSegment {
+        int firstWaypoint;
+        int lastWaypoint;
+        QString cacheKey; // Empty when the backend's routes aren't cached
+        bool cached;
+        RoutePath path;
+        QString error;
+    };
+
+    RoutingBackend* m_backend;
+    RouteCache m_cache;
+    int m_maxWaypointsPerRequest;
+    int m_maxConcurrentRequests;
+    QList<Address> m_waypoints;
+    QVector<RouteSegment> m_segments;
+    int m_activeRequests;
+    int m_nextSegment;
+    int m_completedSegments;
+    int m_generation; // Drops cache hits queued before a cancel
+    qint64 m_traceStart;
+
+    void startPendingSegments();
+    void finishRoute();
 };
 
 #endif // ROUTINGSERVICE_H
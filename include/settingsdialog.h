@@ -19,11 +19,17 @@ public:
     // Getters for settings
     QString getGoogleMapsApiKey() const;
     QString getDefaultMapProvider() const;
+    bool getClusterMarkers() const;
+    QString getRoutingBackend() const;
+    QString getOsrmServer() const;
+    QString getRoadGraphPath() const;
     int getLogLevel() const;
     bool getLoadLastList() const;
 
 private slots:
     void onShowGoogleKeyToggled(bool checked);
+    void onBrowseRoadGraph();
+    void updateRoutingControls();
     void onRestoreDefaults();
     void accept() override;
 
@@ -0,0 +1,38 @@
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QElapsedTimer>
+
+// Rate limiter: tokens refill continuously at ratePerSecond up to capacity
+// and each request takes one. The overloads taking nowMs exist for callers
+// (and tests) that supply their own clock.
+class TokenBucket {
+public:
+    explicit TokenBucket(double ratePerSecond = 1.0, double capacity = 1.0);
+
+    void setRate(double ratePerSecond, double capacity);
+    double getRate() const { return m_rate; }
+    double getCapacity() const { return m_capacity; }
+
+    bool tryAcquire();
+    bool tryAcquire(qint64 nowMs);
+    // Gives back a token that turned out not to be needed
+    void refund();
+
+    qint64 msUntilAvailable() const;
+    qint64 msUntilAvailable(qint64 nowMs) const;
+
+    void reset();
+    void reset(qint64 nowMs);
+
+private:
+    double m_rate;
+    double m_capacity;
+    double m_tokens;
+    qint64 m_lastRefillMs;
+    QElapsedTimer m_clock;
+
+    double tokensAt(qint64 nowMs) const;
+};
+
+#endif // TOKENBUCKET_H
@@ -0,0 +1,110 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QByteArray>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Records timed spans for profiling real sessions. Each thread appends to
+// its own ring buffer, which keeps the newest events once full, and the
+// whole trace is exported as Chrome trace-event JSON for chrome://tracing
+// or Perfetto. While tracing is off a span costs one relaxed atomic load.
+class Tracer {
+public:
+    struct Event {
+        const char* category = nullptr;   // String literals only; never copied
+        const char* name = nullptr;
+        qint64 start = 0;                 // Nanoseconds, see now()
+        qint64 duration = 0;
+        quint64 asyncId = 0;              // 0 for spans within one call
+    };
+
+    static Tracer& instance();
+
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Monotonic clock in nanoseconds
+    static qint64 now();
+    // Start time for addAsyncSpan(), or 0 while tracing is off
+    static qint64 startTime() { return isEnabled() ? now() : 0; }
+
+    // A span from start until now on the calling thread. Spans on one
+    // thread must nest; TraceSpan takes care of that.
+    void addSpan(const char* category, const char* name, qint64 start);
+    // A span that began in another call, such as a network round trip.
+    // It may overlap anything, so viewers show it on its own track.
+    // Ignored when start is 0.
+    void addAsyncSpan(const char* category, const char* name, qint64 start);
+
+    // Events kept per thread; changing it discards the recorded events
+    void setBufferCapacity(int events);
+    int getBufferCapacity() const;
+    int getEventCount() const;
+    void clear();
+
+    QByteArray toChromeTrace() const;
+    bool exportChromeTrace(const QString& filePath);
+    QString getLastError() const { return m_lastError; }
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::vector<Event> events;
+        std::size_t next = 0;       // Slot of the next event once the ring is full
+        int threadId = 0;
+        QString threadName;
+    };
+
+    Tracer();
+    ~Tracer() = default;
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    ThreadBuffer& threadBuffer();
+    void record(const Event& event);
+
+    static std::atomic<bool> s_enabled;
+
+    qint64 m_epoch;
+    std::atomic<int> m_capacity;
+    std::atomic<quint64> m_nextAsyncId;
+    mutable std::mutex m_registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    QString m_lastError;
+};
+
+// Records the enclosing scope as a span
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name)
+        : m_category(category), m_name(name), m_start(Tracer::startTime()) {}
+    ~TraceSpan() {
+        if (m_start != 0) {
+            Tracer::instance().addSpan(m_category, m_name, m_start);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* m_category;
+    const char* m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Builds configured with MAPADDRESS_TRACING=OFF define MAPADDRESS_NO_TRACING
+#ifdef MAPADDRESS_NO_TRACING
+#define TRACE_SCOPE(category, name) do { } while (0)
+#else
+#define TRACE_SCOPE(category, name) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(category, name)
+#endif
+
+#endif // TRACER_H
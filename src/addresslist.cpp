@@ -9,13 +9,23 @@ AddressList::AddressList(int id, const QString& name)
 }
 
 void AddressList::addAddress(const Address& address) {
+    m_index.insert(address.getId(), m_addresses.size());
     m_addresses.append(address);
 }
 
+void AddressList::setAddresses(const QList<Address>& addresses) {
+    m_addresses = addresses;
+    m_index.clear();
+    m_index.reserve(m_addresses.size());
+    reindexFrom(0);
+}
+
 void AddressList::removeAddress(int addressId) {
     int index = findAddressIndex(addressId);
     if (index >= 0) {
         m_addresses.removeAt(index);
+        m_index.remove(addressId);
+        reindexFrom(index);
     }
 }
 
@@ -36,13 +46,15 @@ Address AddressList::getAddress(int addressId) const {
 
 void AddressList::clear() {
     m_addresses.clear();
+    m_index.clear();
 }
 
 int AddressList::findAddressIndex(int addressId) const {
-    for (int i = 0; i < m_addresses.size(); ++i) {
-        if (m_addresses[i].getId() == addressId) {
-            return i;
-        }
+    return m_index.value(addressId, -1);
+}
+
+void AddressList::reindexFrom(int position) {
+    for (int i = position; i < m_addresses.size(); ++i) {
+        m_index.insert(m_addresses[i].getId(), i);
     }
-    return -1;
 }
@@ -0,0 +1,228 @@
+#include "addresslistmodel.h"
+#include <algorithm>
+
+AddressListModel::AddressListModel(QObject* parent)
+    : QAbstractListModel(parent), m_filterByIds(false), m_startId(-1), m_endId(-1) {
+}
+
+QString AddressListModel::displayText(const Address& address) {
+    return QString("%1, %2, %3")
+        .arg(address.getStreet())
+        .arg(address.getCity())
+        .arg(address.getState());
+}
+
+AddressListModel::Entry AddressListModel::makeEntry(const Address& address) {
+    return Entry{address.getId(), address.getStreet(), address.getCity(), address.getState()};
+}
+
+int AddressListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : m_visible.size();
+}
+
+QVariant AddressListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_visible.size()) {
+        return QVariant();
+    }
+    const Entry& entry = m_entries[m_visible[index.row()]];
+
+    if (role == Qt::DisplayRole) {
+        QString text = QString("%1, %2, %3").arg(entry.street, entry.city, entry.state);
+        if (entry.id == m_startId) {
+            text.prepend("🚩 ");
+        } else if (entry.id == m_endId) {
+            text.prepend("🏁 ");
+        }
+        return text;
+    }
+    if (role == AddressIdRole) {
+        return entry.id;
+    }
+    return QVariant();
+}
+
+void AddressListModel::setAddresses(const QList<Address>& addresses) {
+    beginResetModel();
+    m_entries.clear();
+    m_entries.reserve(addresses.size());
+    m_index.clear();
+    m_index.reserve(addresses.size());
+    for (const Address& address : addresses) {
+        m_index.insert(address.getId(), m_entries.size());
+        m_entries.append(makeEntry(address));
+    }
+    rebuildVisible();
+    endResetModel();
+}
+
+void AddressListModel::addAddress(const Address& address) {
+    if (m_index.contains(address.getId())) {
+        updateAddress(address);
+        return;
+    }
+
+    int entryIndex = m_entries.size();
+    m_index.insert(address.getId(), entryIndex);
+    m_entries.append(makeEntry(address));
+
+    // New entries always land after every visible row
+    if (matches(m_entries.last())) {
+        int row = m_visible.size();
+        beginInsertRows(QModelIndex(), row, row);
+        m_visible.append(entryIndex);
+        endInsertRows();
+    }
+}
+
+void AddressListModel::updateAddress(const Address& address) {
+    auto it = m_index.constFind(address.getId());
+    if (it == m_index.constEnd()) return;
+
+    int entryIndex = it.value();
+    m_entries[entryIndex] = makeEntry(address);
+
+    int row = visibleRowForEntry(entryIndex);
+    bool visible = matches(m_entries[entryIndex]);
+    if (row >= 0 && visible) {
+        QModelIndex changed = index(row);
+        emit dataChanged(changed, changed);
+    } else if (row >= 0) {
+        beginRemoveRows(QModelIndex(), row, row);
+        m_visible.remove(row);
+        endRemoveRows();
+    } else if (visible) {
+        row = int(std::lower_bound(m_visible.begin(), m_visible.end(), entryIndex) - m_visible.begin());
+        beginInsertRows(QModelIndex(), row, row);
+        m_visible.insert(row, entryIndex);
+        endInsertRows();
+    }
+}
+
+void AddressListModel::removeAddress(int addressId) {
+    auto it = m_index.constFind(addressId);
+    if (it == m_index.constEnd()) return;
+
+    int entryIndex = it.value();
+    int row = visibleRowForEntry(entryIndex);
+    if (row >= 0) {
+        beginRemoveRows(QModelIndex(), row, row);
+        m_visible.remove(row);
+        endRemoveRows();
+    }
+
+    m_entries.remove(entryIndex);
+    m_index.remove(addressId);
+    for (int i = entryIndex; i < m_entries.size(); ++i) {
+        m_index[m_entries[i].id] = i;
+    }
+    // Visible rows past the removed entry keep their order but shift down
+    auto first = std::lower_bound(m_visible.begin(), m_visible.end(), entryIndex);
+    for (auto v = first; v != m_visible.end(); ++v) {
+        --*v;
+    }
+}
+
+void AddressListModel::clear() {
+    beginResetModel();
+    m_entries.clear();
+    m_index.clear();
+    m_visible.clear();
+    endResetModel();
+}
+
+void AddressListModel::setFilterText(const QString& text) {
+    if (text == m_filterText && !m_filterByIds) return;
+
+    // Typing more characters can only narrow the current result
+    bool narrowing = !m_filterByIds && !m_filterText.isEmpty()
+        && text.contains(m_filterText, Qt::CaseInsensitive);
+
+    beginResetModel();
+    m_filterText = text;
+    m_filterIds.clear();
+    m_filterByIds = false;
+    if (narrowing) {
+        QVector<int> kept;
+        kept.reserve(m_visible.size());
+        for (int entryIndex : m_visible) {
+            if (matches(m_entries[entryIndex])) {
+                kept.append(entryIndex);
+            }
+        }
+        m_visible.swap(kept);
+    } else {
+        rebuildVisible();
+    }
+    endResetModel();
+}
+
+void AddressListModel::setFilterIds(const QSet<int>& ids) {
+    beginResetModel();
+    m_filterText.clear();
+    m_filterIds = ids;
+    m_filterByIds = true;
+    rebuildVisible();
+    endResetModel();
+}
+
+void AddressListModel::setRouteEndpoints(int startId, int endId) {
+    int oldStart = m_startId;
+    int oldEnd = m_endId;
+    m_startId = startId;
+    m_endId = endId;
+
+    emitRowChanged(oldStart);
+    emitRowChanged(oldEnd);
+    emitRowChanged(startId);
+    emitRowChanged(endId);
+}
+
+int AddressListModel::addressIdAt(int row) const {
+    if (row < 0 || row >= m_visible.size()) return -1;
+    return m_entries[m_visible[row]].id;
+}
+
+int AddressListModel::rowForAddressId(int addressId) const {
+    auto it = m_index.constFind(addressId);
+    if (it == m_index.constEnd()) return -1;
+    return visibleRowForEntry(it.value());
+}
+
+bool AddressListModel::matches(const Entry& entry) const {
+    if (m_filterByIds) return m_filterIds.contains(entry.id);
+    if (m_filterText.isEmpty()) return true;
+
+    // Text that can span the ", " separators needs the joined display text
+    if (m_filterText.contains(',') || m_filterText.startsWith(' ') || m_filterText.endsWith(' ')) {
+        return QString("%1, %2, %3").arg(entry.street, entry.city, entry.state)
+            .contains(m_filterText, Qt::CaseInsensitive);
+    }
+    return entry.street.contains(m_filterText, Qt::CaseInsensitive)
+        || entry.city.contains(m_filterText, Qt::CaseInsensitive)
+        || entry.state.contains(m_filterText, Qt::CaseInsensitive);
+}
+
+int AddressListModel::visibleRowForEntry(int entryIndex) const {
+    auto it = std::lower_bound(m_visible.begin(), m_visible.end(), entryIndex);
+    if (it == m_visible.end() || *it != entryIndex) return -1;
+    return int(it - m_visible.begin());
+}
+
+void AddressListModel::rebuildVisible() {
+    m_visible.clear();
+    m_visible.reserve(m_entries.size());
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (matches(m_entries[i])) {
+            m_visible.append(i);
+        }
+    }
+}
+
+void AddressListModel::emitRowChanged(int addressId) {
+    if (addressId < 0) return;
+    int row = rowForAddressId(addressId);
+    if (row >= 0) {
+        QModelIndex changed = index(row);
+        emit dataChanged(changed, changed, {Qt::DisplayRole});
+    }
+}
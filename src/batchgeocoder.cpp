@@ -0,0 +1,217 @@
+#include "batchgeocoder.h"
+#include "database.h"
+#include "logger.h"
+
+namespace {
+const int kCheckpointInterval = 25;
+const qint64 kBaseBackoffMs = 2000;
+const qint64 kMaxBackoffMs = 60000;
+}
+
+BatchGeocoder::BatchGeocoder(GeocodingService* service, QObject* parent)
+    : QObject(parent), m_service(service), m_bucket(1.0, 1.0), m_maxInFlight(2), m_maxAttempts(4),
+      m_listId(-1), m_total(0), m_processed(0), m_geocoded(0), m_failed(0), m_sinceCheckpoint(0) {
+    m_clock.start();
+    m_dispatchTimer.setSingleShot(true);
+    connect(&m_dispatchTimer, &QTimer::timeout, this, &BatchGeocoder::dispatch);
+    connect(m_service, &GeocodingService::geocodingResultReady, this, &BatchGeocoder::onResultReady);
+    connect(m_service, &GeocodingService::geocodingRequestFailed, this, &BatchGeocoder::onRequestFailed);
+}
+
+BatchGeocoder::~BatchGeocoder() {
+    if (isRunning()) {
+        checkpoint();
+    }
+}
+
+bool BatchGeocoder::start(int listId) {
+    if (isRunning()) return false;
+
+    Database::instance().clearGeocodeJob(listId, true);
+    QList<Address> addresses = Database::instance().getAddressesWithoutCoordinates(listId);
+    return begin(listId, addresses, addresses.size(), 0, 0);
+}
+
+bool BatchGeocoder::resume(int listId) {
+    if (isRunning()) return false;
+
+    int total = 0;
+    int processed = 0;
+    int failed = 0;
+    if (!Database::instance().loadGeocodeJob(listId, total, processed, failed)) {
+        return start(listId);
+    }
+
+    // Coordinates are saved as results arrive, so the remaining work is
+    // whatever still lacks them; the checkpoint may lag behind that
+    QList<Address> addresses = Database::instance().getAddressesWithoutCoordinates(listId);
+    total = qMax(total, processed + int(addresses.size()));
+    processed = total - addresses.size();
+    return begin(listId, addresses, total, processed, failed);
+}
+
+bool BatchGeocoder::begin(int listId, const QList<Address>& addresses, int total, int processed, int failed) {
+    if (addresses.isEmpty()) {
+        Database::instance().clearGeocodeJob(listId, false);
+        return false;
+    }
+
+    m_listId = listId;
+    m_total = total;
+    m_processed = processed;
+    m_geocoded = 0;
+    m_failed = failed;
+    m_sinceCheckpoint = 0;
+    m_pending.clear();
+    m_retries.clear();
+    m_inFlight.clear();
+    for (const Address& address : addresses) {
+        m_pending.enqueue(Task{address, 0, 0});
+    }
+
+    LOG_INFO(QString("Batch geocoding list %1: %2 of %3 addresses remaining")
+        .arg(listId).arg(addresses.size()).arg(total));
+
+    checkpoint();
+    emit progress(m_processed, m_total);
+    dispatch();
+    return true;
+}
+
+void BatchGeocoder::cancel() {
+    if (!isRunning()) return;
+    LOG_INFO(QString("Batch geocoding list %1 cancelled at %2 of %3").arg(m_listId).arg(m_processed).arg(m_total));
+    finish(true);
+}
+
+void BatchGeocoder::dispatch() {
+    if (!isRunning()) return;
+
+    while (m_inFlight.size() < m_maxInFlight) {
+        // Retries whose backoff has elapsed go before fresh addresses
+        qint64 now = m_clock.elapsed();
+        int retryIndex = -1;
+        qint64 nextRetryMs = -1;
+        for (int i = 0; i < m_retries.size(); ++i) {
+            if (m_retries[i].notBeforeMs <= now) {
+                retryIndex = i;
+                break;
+            }
+            if (nextRetryMs < 0 || m_retries[i].notBeforeMs < nextRetryMs) {
+                nextRetryMs = m_retries[i].notBeforeMs;
+            }
+        }
+
+        if (retryIndex < 0 && m_pending.isEmpty()) {
+            if (nextRetryMs >= 0) {
+                m_dispatchTimer.start(int(nextRetryMs - now));
+            }
+            return;
+        }
+
+        qint64 waitMs = m_bucket.msUntilAvailable();
+        if (waitMs != 0) {
+            if (waitMs > 0) {
+                m_dispatchTimer.start(int(waitMs));
+            }
+            return;
+        }
+        m_bucket.tryAcquire();
+
+        Task task = retryIndex >= 0 ? m_retries.takeAt(retryIndex) : m_pending.dequeue();
+        task.attempts++;
+        int requestId = m_service->geocode(task.address, 1);
+        m_inFlight.insert(requestId, task);
+    }
+}
+
+void BatchGeocoder::onResultReady(int requestId, const QVector<GeocodingCandidate>& candidates, bool fromCache) {
+    auto it = m_inFlight.find(requestId);
+    if (it == m_inFlight.end()) return;
+    Task task = it.value();
+    m_inFlight.erase(it);
+
+    // Cache hits never reached the server
+    if (fromCache) {
+        m_bucket.refund();
+    }
+
+    Address address = task.address;
+    address.setLatitude(candidates.first().latitude);
+    address.setLongitude(candidates.first().longitude);
+
+    if (Database::instance().updateAddressCoordinates(address.getId(), address.getLatitude(), address.getLongitude())) {
+        m_geocoded++;
+        emit addressGeocoded(address);
+        completeTask();
+    } else {
+        QString error = Database::instance().getLastError();
+        Database::instance().recordGeocodeFailure(m_listId, address.getId(), error);
+        m_failed++;
+        emit addressFailed(address.getId(), error);
+        completeTask();
+    }
+
+    dispatch();
+}
+
+void BatchGeocoder::onRequestFailed(int requestId, const QString& error, bool retryable) {
+    auto it = m_inFlight.find(requestId);
+    if (it == m_inFlight.end()) return;
+    Task task = it.value();
+    m_inFlight.erase(it);
+
+    if (retryable && task.attempts < m_maxAttempts) {
+        qint64 backoffMs = qMin(kMaxBackoffMs, kBaseBackoffMs << (task.attempts - 1));
+        task.notBeforeMs = m_clock.elapsed() + backoffMs;
+        m_retries.append(task);
+        LOG_WARNING(QString("Geocoding address %1 failed (attempt %2), retrying in %3 s: %4")
+            .arg(task.address.getId()).arg(task.attempts).arg(backoffMs / 1000).arg(error));
+    } else {
+        Database::instance().recordGeocodeFailure(m_listId, task.address.getId(), error);
+        m_failed++;
+        emit addressFailed(task.address.getId(), error);
+        completeTask();
+    }
+
+    dispatch();
+}
+
+void BatchGeocoder::completeTask() {
+    m_processed++;
+    emit progress(m_processed, m_total);
+
+    if (++m_sinceCheckpoint >= kCheckpointInterval) {
+        checkpoint();
+    }
+
+    if (m_pending.isEmpty() && m_retries.isEmpty() && m_inFlight.isEmpty()) {
+        LOG_INFO(QString("Batch geocoding list %1 finished: %2 geocoded, %3 failed")
+            .arg(m_listId).arg(m_geocoded).arg(m_failed));
+        finish(false);
+    }
+}
+
+void BatchGeocoder::checkpoint() {
+    Database::instance().saveGeocodeJob(m_listId, m_total, m_processed, m_failed);
+    m_sinceCheckpoint = 0;
+}
+
+void BatchGeocoder::finish(bool cancelled) {
+    m_dispatchTimer.stop();
+
+    // Failures stay recorded after a completed job so a later resume does
+    // not retry them; start() clears them
+    if (cancelled) {
+        checkpoint();
+    } else {
+        Database::instance().clearGeocodeJob(m_listId, false);
+    }
+
+    m_pending.clear();
+    m_retries.clear();
+    m_inFlight.clear();
+    m_listId = -1;
+
+    emit finished(m_geocoded, m_failed, cancelled);
+}
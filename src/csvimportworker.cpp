@@ -0,0 +1,125 @@
+#include "csvimportworker.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QFile>
+#include <QByteArray>
+
+CsvImportWorker::CsvImportWorker(const QString& filePath, int batchSize, QObject* parent)
+    : QObject(parent), m_filePath(filePath), m_batchSize(batchSize), m_cancelled(false) {
+    qRegisterMetaType<QList<Address>>("QList<Address>");
+}
+
+void CsvImportWorker::cancel() {
+    m_cancelled.store(true);
+}
+
+bool CsvImportWorker::isHeaderRecord(const QVector<CsvField>& fields) {
+    for (const CsvField& field : fields) {
+        QString value = field.toString().toLower();
+        if (value.contains("street") || value.contains("address")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CsvImportWorker::parseAddress(const QVector<CsvField>& fields, Address& address) {
+    if (fields.size() < 5) {
+        return false;
+    }
+
+    address.setStreet(fields[0].toString().trimmed());
+    address.setCity(fields[1].toString().trimmed());
+    address.setState(fields[2].toString().trimmed());
+    address.setZip(fields[3].toString().trimmed());
+    address.setCountry(fields[4].toString().trimmed());
+
+    // Optional latitude and longitude
+    if (fields.size() >= 7) {
+        bool latOk, lngOk;
+        double lat = fields[5].toDouble(&latOk);
+        double lng = fields[6].toDouble(&lngOk);
+        if (latOk && lngOk) {
+            address.setLatitude(lat);
+            address.setLongitude(lng);
+        }
+    }
+
+    return true;
+}
+
+void CsvImportWorker::run() {
+    TRACE_SCOPE("import", "CsvImportWorker::run");
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit failed("Could not open file: " + file.errorString());
+        return;
+    }
+
+    // Map the file when possible; fall back to reading it for devices
+    // that cannot be mapped (or empty files)
+    QByteArray buffer;
+    const char* data = nullptr;
+    qint64 size = file.size();
+    if (size > 0) {
+        data = reinterpret_cast<const char*>(file.map(0, size));
+    }
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    LOG_INFO(QString("Importing CSV file %1 (%2 bytes)").arg(m_filePath).arg(size));
+
+    CsvReader reader(data, size);
+    QVector<CsvField> fields;
+    fields.reserve(8);
+
+    QList<Address> batch;
+    batch.reserve(m_batchSize);
+
+    int parsedCount = 0;
+    int errorCount = 0;
+    bool firstRecord = true;
+
+    while (!m_cancelled.load(std::memory_order_relaxed) && reader.readRecord(fields)) {
+        if (firstRecord) {
+            firstRecord = false;
+            if (isHeaderRecord(fields)) {
+                continue;
+            }
+        }
+
+        // Skip blank lines
+        if (fields.size() == 1 && fields[0].isEmpty()) {
+            continue;
+        }
+
+        Address address;
+        if (!parseAddress(fields, address)) {
+            errorCount++;
+            continue;
+        }
+
+        batch.append(address);
+        parsedCount++;
+
+        if (batch.size() >= m_batchSize) {
+            emit batchReady(batch);
+            emit progress(reader.position(), reader.size());
+            batch.clear();
+        }
+    }
+
+    bool cancelled = m_cancelled.load();
+    if (!batch.isEmpty() && !cancelled) {
+        emit batchReady(batch);
+    }
+    emit progress(reader.position(), reader.size());
+
+    LOG_INFO(QString("CSV parsing %1: %2 rows, %3 errors")
+        .arg(cancelled ? "cancelled" : "finished").arg(parsedCount).arg(errorCount));
+
+    emit finished(parsedCount, errorCount, cancelled);
+}
@@ -0,0 +1,120 @@
+#include "csvreader.h"
+#include <QByteArray>
+#include <cstring>
+
+QString CsvField::toString() const {
+    QString value = QString::fromUtf8(data, size);
+    if (hasEscapedQuotes) {
+        value.replace(QLatin1String("\"\""), QLatin1String("\""));
+    }
+    return value;
+}
+
+double CsvField::toDouble(bool* ok) const {
+    // fromRawData wraps the buffer without copying it
+    return QByteArray::fromRawData(data, size).trimmed().toDouble(ok);
+}
+
+CsvReader::CsvReader(const char* data, qint64 size, char delimiter)
+    : m_data(data), m_size(size), m_pos(0), m_delimiter(delimiter) {
+    // Skip UTF-8 byte order mark
+    if (m_size >= 3 && std::memcmp(m_data, "\xEF\xBB\xBF", 3) == 0) {
+        m_pos = 3;
+    }
+}
+
+bool CsvReader::readRecord(QVector<CsvField>& fields) {
+    fields.clear();
+    if (m_pos >= m_size) {
+        return false;
+    }
+
+    while (true) {
+        CsvField field;
+        if (m_data[m_pos] == '"') {
+            readQuotedField(field);
+        } else {
+            readPlainField(field);
+        }
+        fields.append(field);
+
+        if (m_pos >= m_size) {
+            return true;
+        }
+
+        char c = m_data[m_pos];
+        if (c == m_delimiter) {
+            ++m_pos;
+            if (m_pos >= m_size) {
+                // Trailing delimiter at end of input means one more empty field
+                fields.append(CsvField());
+                return true;
+            }
+            continue;
+        }
+
+        if (c == '\r') {
+            ++m_pos;
+            if (m_pos < m_size && m_data[m_pos] == '\n') {
+                ++m_pos;
+            }
+            return true;
+        }
+
+        // c == '\n'
+        ++m_pos;
+        return true;
+    }
+}
+
+void CsvReader::readQuotedField(CsvField& field) {
+    field.quoted = true;
+    ++m_pos; // opening quote
+    const qint64 start = m_pos;
+
+    while (true) {
+        const void* found = std::memchr(m_data + m_pos, '"', size_t(m_size - m_pos));
+        if (!found) {
+            // Unterminated quote: take the rest of the buffer
+            field.data = m_data + start;
+            field.size = int(m_size - start);
+            m_pos = m_size;
+            return;
+        }
+
+        qint64 quote = static_cast<const char*>(found) - m_data;
+        if (quote + 1 < m_size && m_data[quote + 1] == '"') {
+            field.hasEscapedQuotes = true;
+            m_pos = quote + 2;
+            continue;
+        }
+
+        field.data = m_data + start;
+        field.size = int(quote - start);
+        m_pos = quote + 1;
+        break;
+    }
+
+    // Be lenient about stray characters between the closing quote and the
+    // next delimiter; they are ignored rather than failing the record
+    while (m_pos < m_size) {
+        char c = m_data[m_pos];
+        if (c == m_delimiter || c == '\n' || c == '\r') {
+            break;
+        }
+        ++m_pos;
+    }
+}
+
+void CsvReader::readPlainField(CsvField& field) {
+    const qint64 start = m_pos;
+    while (m_pos < m_size) {
+        char c = m_data[m_pos];
+        if (c == m_delimiter || c == '\n' || c == '\r') {
+            break;
+        }
+        ++m_pos;
+    }
+    field.data = m_data + start;
+    field.size = int(m_pos - start);
+}
@@ -0,0 +1,41 @@
+#include "csvwriter.h"
+#include <QTextStream>
+
+namespace {
+// Text fields are always quoted, with quotes doubled per RFC 4180
+void appendQuoted(QString& line, const QString& value) {
+    line += QLatin1Char('"');
+    if (value.contains(QLatin1Char('"'))) {
+        QString escaped = value;
+        line += escaped.replace(QLatin1String("\""), QLatin1String("\"\""));
+    } else {
+        line += value;
+    }
+    line += QLatin1String("\",");
+}
+}
+
+bool CsvWriter::writeAddresses(QIODevice* device, const QList<Address>& addresses) {
+    QTextStream out(device);
+    out << "Street,City,State,ZIP,Country,Latitude,Longitude\n";
+
+    // Fields are appended rather than substituted with QString::arg(),
+    // which would also replace a "%1" typed into a street name
+    QString line;
+    for (const Address& address : addresses) {
+        line.clear();
+        appendQuoted(line, address.getStreet());
+        appendQuoted(line, address.getCity());
+        appendQuoted(line, address.getState());
+        appendQuoted(line, address.getZip());
+        appendQuoted(line, address.getCountry());
+        line += QString::number(address.getLatitude(), 'f', 6);
+        line += QLatin1Char(',');
+        line += QString::number(address.getLongitude(), 'f', 6);
+        line += QLatin1Char('\n');
+        out << line;
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
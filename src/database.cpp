@@ -1,17 +1,30 @@
 #include "database.h"
 #include "logger.h"
+#include "tracer.h"
+#include "geoutils.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QVariant>
 #include <QStandardPaths>
 #include <QDir>
+#include <QDateTime>
+#include <QStringList>
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace {
+// Bump together with a new step in Database::migrateSchema()
+const int kSchemaVersion = 2;
+}
 
 Database& Database::instance() {
     static Database instance;
     return instance;
 }
 
-Database::Database() {
+Database::Database()
+    : m_hasSearchIndex(false), m_hasSpatialIndex(false), m_geocodeCacheTtl(30 * 24 * 3600),
+      m_geocodeCacheHits(0), m_geocodeCacheMisses(0), m_routeCacheTtl(30 * 24 * 3600) {
 }
 
 Database::~Database() {
@@ -19,6 +32,7 @@ Database::~Database() {
 }
 
 bool Database::initialize(const QString& dbPath) {
+    TRACE_SCOPE("db", "Database::initialize");
     QString path = dbPath;
     if (path.isEmpty()) {
         QString appData = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -31,6 +45,7 @@ bool Database::initialize(const QString& dbPath) {
     
     LOG_INFO("Database path: " + path);
     
+    invalidateCache();
     m_db = QSqlDatabase::addDatabase("QSQLITE");
     m_db.setDatabaseName(path);
     
@@ -42,7 +57,236 @@ bool Database::initialize(const QString& dbPath) {
     }
     
     LOG_INFO("Database opened successfully");
-    return createTables();
+    configureConnection();
+    return createTables() && migrateSchema();
+}
+
+void Database::configureConnection() {
+    // Tuned for an interactive single-user app: WAL lets reads proceed during
+    // writes and NORMAL sync is durable across application crashes
+    const QStringList pragmas = {
+        "PRAGMA journal_mode = WAL",
+        "PRAGMA synchronous = NORMAL",
+        "PRAGMA cache_size = -32000",      // 32 MB
+        "PRAGMA mmap_size = 268435456",    // 256 MB
+        "PRAGMA temp_store = MEMORY",
+        "PRAGMA foreign_keys = ON"
+    };
+    
+    QSqlQuery query(m_db);
+    for (const QString& pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            LOG_WARNING("Failed to apply '" + pragma + "': " + query.lastError().text());
+        }
+    }
+}
+
+int Database::schemaVersion() {
+    QSqlQuery query(m_db);
+    if (!query.exec("PRAGMA user_version") || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+bool Database::migrateSchema() {
+    int version = schemaVersion();
+    if (version < 0) {
+        setLastError("Failed to read schema version");
+        return false;
+    }
+    
+    while (version < kSchemaVersion) {
+        int target = version + 1;
+        QStringList statements;
+        
+        switch (target) {
+            case 1:
+                // Rows orphaned while foreign keys were not enforced
+                statements << "DELETE FROM addresses WHERE list_id NOT IN (SELECT id FROM address_lists)"
+                           << "DELETE FROM route_info WHERE list_id NOT IN (SELECT id FROM address_lists)"
+                           << "CREATE INDEX IF NOT EXISTS idx_addresses_list_id ON addresses(list_id)"
+                           << "CREATE INDEX IF NOT EXISTS idx_geocode_failures_list_id ON geocode_failures(list_id)";
+                break;
+            case 2:
+                // Routes keyed by a hash of the routing profile and the
+                // quantized waypoints; geometry is compressed and delta
+                // encoded, legs hold per-leg distance and duration
+                statements << R"(
+                    CREATE TABLE IF NOT EXISTS route_cache (
+                        cache_key TEXT PRIMARY KEY,
+                        profile TEXT NOT NULL,
+                        geometry BLOB NOT NULL,
+                        legs BLOB NOT NULL DEFAULT x'',
+                        distance_km REAL NOT NULL,
+                        duration_seconds REAL NOT NULL,
+                        created_at INTEGER NOT NULL
+                    )
+                )" << "CREATE INDEX IF NOT EXISTS idx_route_cache_profile ON route_cache(profile)";
+                break;
+        }
+        
+        m_db.transaction();
+        QSqlQuery query(m_db);
+        for (const QString& statement : statements) {
+            if (!query.exec(statement)) {
+                setLastError(QString("Schema migration to version %1 failed: %2")
+                    .arg(target).arg(query.lastError().text()));
+                m_db.rollback();
+                return false;
+            }
+        }
+        
+        if (!query.exec(QString("PRAGMA user_version = %1").arg(target)) || !m_db.commit()) {
+            setLastError(QString("Failed to record schema version %1: %2")
+                .arg(target).arg(m_db.lastError().text()));
+            m_db.rollback();
+            return false;
+        }
+        
+        LOG_INFO(QString("Database schema migrated to version %1").arg(target));
+        version = target;
+    }
+    
+    ensureSearchIndex();
+    ensureSpatialIndex();
+    purgeExpiredRoutes();
+    return true;
+}
+
+void Database::ensureSearchIndex() {
+    // External-content FTS5 index over the text columns, kept in sync by
+    // triggers. Coordinate-only updates do not touch it.
+    const QStringList statements = {
+        R"(
+            CREATE VIRTUAL TABLE IF NOT EXISTS addresses_fts USING fts5(
+                street, city, state, zip, country,
+                content='addresses', content_rowid='id',
+                tokenize='unicode61 remove_diacritics 2'
+            )
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_fts_insert AFTER INSERT ON addresses BEGIN
+                INSERT INTO addresses_fts(rowid, street, city, state, zip, country)
+                VALUES (new.id, new.street, new.city, new.state, new.zip, new.country);
+            END
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_fts_delete AFTER DELETE ON addresses BEGIN
+                INSERT INTO addresses_fts(addresses_fts, rowid, street, city, state, zip, country)
+                VALUES ('delete', old.id, old.street, old.city, old.state, old.zip, old.country);
+            END
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_fts_update
+            AFTER UPDATE OF street, city, state, zip, country ON addresses BEGIN
+                INSERT INTO addresses_fts(addresses_fts, rowid, street, city, state, zip, country)
+                VALUES ('delete', old.id, old.street, old.city, old.state, old.zip, old.country);
+                INSERT INTO addresses_fts(rowid, street, city, state, zip, country)
+                VALUES (new.id, new.street, new.city, new.state, new.zip, new.country);
+            END
+        )",
+        "INSERT INTO addresses_fts(addresses_fts) VALUES ('rebuild')"
+    };
+    
+    m_hasSearchIndex = ensureOptionalIndex("addresses_fts", "fts5", "x",
+        {"addresses_fts_insert", "addresses_fts_delete", "addresses_fts_update"}, statements);
+    if (!m_hasSearchIndex) {
+        LOG_WARNING("Full-text index unavailable; address search will use LIKE");
+    }
+}
+
+void Database::ensureSpatialIndex() {
+    // R*Tree over geocoded addresses only; rows at 0,0 have no coordinates
+    // and are left out
+    const QStringList statements = {
+        R"(
+            CREATE VIRTUAL TABLE IF NOT EXISTS addresses_rtree
+            USING rtree(id, min_lat, max_lat, min_lng, max_lng)
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_rtree_insert AFTER INSERT ON addresses
+            WHEN new.latitude <> 0 OR new.longitude <> 0 BEGIN
+                INSERT INTO addresses_rtree
+                VALUES (new.id, new.latitude, new.latitude, new.longitude, new.longitude);
+            END
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_rtree_delete AFTER DELETE ON addresses BEGIN
+                DELETE FROM addresses_rtree WHERE id = old.id;
+            END
+        )", R"(
+            CREATE TRIGGER IF NOT EXISTS addresses_rtree_update
+            AFTER UPDATE OF latitude, longitude ON addresses BEGIN
+                DELETE FROM addresses_rtree WHERE id = old.id;
+                INSERT INTO addresses_rtree
+                SELECT new.id, new.latitude, new.latitude, new.longitude, new.longitude
+                WHERE new.latitude <> 0 OR new.longitude <> 0;
+            END
+        )",
+        "DELETE FROM addresses_rtree",
+        R"(
+            INSERT INTO addresses_rtree
+            SELECT id, latitude, latitude, longitude, longitude FROM addresses
+            WHERE latitude <> 0 OR longitude <> 0
+        )"
+    };
+    
+    m_hasSpatialIndex = ensureOptionalIndex("addresses_rtree", "rtree", "id, x0, x1",
+        {"addresses_rtree_insert", "addresses_rtree_delete", "addresses_rtree_update"}, statements);
+    if (!m_hasSpatialIndex) {
+        LOG_WARNING("Spatial index unavailable; spatial queries will scan addresses");
+    }
+}
+
+bool Database::ensureOptionalIndex(const QString& table, const QString& module, const QString& probeColumns,
+                                   const QStringList& triggers, const QStringList& statements) {
+    // Indexes on SQLite modules are checked on every open instead of being
+    // a schema version step, so a database first opened by a build without
+    // the module gets its index once opened by one that has it
+    QSqlQuery query(m_db);
+    if (!isModuleAvailable(module, probeColumns)) {
+        // Triggers writing to a table whose module is missing would make
+        // every address write fail. The index is rebuilt when they return.
+        for (const QString& trigger : triggers) {
+            query.exec("DROP TRIGGER IF EXISTS " + trigger);
+        }
+        return false;
+    }
+    
+    int present = 0;
+    const QStringList names = QStringList(table) + triggers;
+    for (const QString& name : names) {
+        query.prepare("SELECT 1 FROM sqlite_master WHERE name = ?");
+        query.addBindValue(name);
+        if (query.exec() && query.next()) {
+            present++;
+        }
+    }
+    if (present == names.size()) {
+        return true;
+    }
+    
+    // Missing triggers mean the table may be stale, so it is rebuilt too
+    m_db.transaction();
+    for (const QString& statement : statements) {
+        if (!query.exec(statement)) {
+            LOG_WARNING(QString("Failed to create %1: %2").arg(table, query.lastError().text()));
+            m_db.rollback();
+            return false;
+        }
+    }
+    if (!m_db.commit()) {
+        LOG_WARNING(QString("Failed to create %1: %2").arg(table, m_db.lastError().text()));
+        m_db.rollback();
+        return false;
+    }
+    LOG_INFO("Built " + table);
+    return true;
+}
+
+bool Database::isModuleAvailable(const QString& module, const QString& columns) {
+    QSqlQuery query(m_db);
+    if (!query.exec(QString("CREATE VIRTUAL TABLE temp.%1_probe USING %1(%2)").arg(module, columns))) {
+        return false;
+    }
+    query.exec(QString("DROP TABLE temp.%1_probe").arg(module));
+    return true;
 }
 
 bool Database::isOpen() const {
@@ -50,6 +294,9 @@ bool Database::isOpen() const {
 }
 
 void Database::close() {
+    invalidateCache();
+    m_hasSearchIndex = false;
+    m_hasSpatialIndex = false;
     if (m_db.isOpen()) {
         m_db.close();
     }
@@ -111,6 +358,54 @@ bool Database::createTables() {
         return false;
     }
     
+    // Geocoding results keyed by normalized address; payload is the JSON
+    // candidate list as returned by the geocoder
+    QString createGeocodeCacheTable = R"(
+        CREATE TABLE IF NOT EXISTS geocode_cache (
+            cache_key TEXT PRIMARY KEY,
+            payload BLOB NOT NULL,
+            created_at INTEGER NOT NULL
+        )
+    )";
+    
+    if (!query.exec(createGeocodeCacheTable)) {
+        setLastError("Failed to create geocode_cache table: " + query.lastError().text());
+        return false;
+    }
+    
+    purgeExpiredGeocodes();
+    
+    // Checkpoints for batch geocoding jobs, one per list
+    QString createGeocodeJobsTable = R"(
+        CREATE TABLE IF NOT EXISTS geocode_jobs (
+            list_id INTEGER PRIMARY KEY,
+            total INTEGER NOT NULL,
+            processed INTEGER NOT NULL,
+            failed INTEGER NOT NULL,
+            updated_at INTEGER NOT NULL,
+            FOREIGN KEY(list_id) REFERENCES address_lists(id) ON DELETE CASCADE
+        )
+    )";
+    
+    if (!query.exec(createGeocodeJobsTable)) {
+        setLastError("Failed to create geocode_jobs table: " + query.lastError().text());
+        return false;
+    }
+    
+    QString createGeocodeFailuresTable = R"(
+        CREATE TABLE IF NOT EXISTS geocode_failures (
+            address_id INTEGER PRIMARY KEY,
+            list_id INTEGER NOT NULL,
+            error TEXT,
+            FOREIGN KEY(address_id) REFERENCES addresses(id) ON DELETE CASCADE
+        )
+    )";
+    
+    if (!query.exec(createGeocodeFailuresTable)) {
+        setLastError("Failed to create geocode_failures table: " + query.lastError().text());
+        return false;
+    }
+    
     return true;
 }
 
@@ -145,6 +440,11 @@ bool Database::deleteList(int listId) {
         return false;
     }
     
+    clearGeocodeJob(listId, true);
+    
+    if (m_cachedList.getId() == listId) {
+        invalidateCache();
+    }
     return true;
 }
 
@@ -175,11 +475,8 @@ QList<AddressList> Database::getAllLists() {
         int id = query.value(0).toInt();
         QString name = query.value(1).toString();
         AddressList list(id, name);
-        
-        QList<Address> addresses = getAddressesForList(id);
-        for (const Address& addr : addresses) {
-            list.addAddress(addr);
-        }
+        // Bypass the cache so listing every list does not evict the current one
+        list.setAddresses(queryAddressesForList(id));
         
         lists.append(list);
     }
@@ -201,11 +498,7 @@ AddressList Database::getList(int listId) {
         int id = query.value(0).toInt();
         QString name = query.value(1).toString();
         AddressList list(id, name);
-        
-        QList<Address> addresses = getAddressesForList(id);
-        for (const Address& addr : addresses) {
-            list.addAddress(addr);
-        }
+        list.setAddresses(getAddressesForList(id));
         
         return list;
     }
@@ -234,7 +527,85 @@ int Database::addAddress(int listId, const Address& address) {
         return -1;
     }
     
-    return query.lastInsertId().toInt();
+    int addressId = query.lastInsertId().toInt();
+    if (m_cachedList.getId() == listId) {
+        Address cached = address;
+        cached.setId(addressId);
+        m_cachedList.addAddress(cached);
+    }
+    return addressId;
+}
+
+QList<int> Database::addAddresses(int listId, const QList<Address>& addresses) {
+    TRACE_SCOPE("db", "Database::addAddresses");
+    // Rows per transaction; keeps the journal small on very large imports
+    const int chunkSize = 10000;
+
+    QList<int> ids;
+    ids.reserve(addresses.size());
+
+    QSqlQuery query(m_db);
+    if (!query.prepare(R"(
+        INSERT INTO addresses (list_id, street, city, state, zip, country, latitude, longitude)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+    )")) {
+        setLastError("Failed to prepare address insert: " + query.lastError().text());
+        for (int i = 0; i < addresses.size(); ++i) {
+            ids.append(-1);
+        }
+        return ids;
+    }
+
+    for (int start = 0; start < addresses.size(); start += chunkSize) {
+        int end = qMin(start + chunkSize, int(addresses.size()));
+
+        if (!m_db.transaction()) {
+            setLastError("Failed to begin transaction: " + m_db.lastError().text());
+            for (int i = start; i < addresses.size(); ++i) {
+                ids.append(-1);
+            }
+            return ids;
+        }
+
+        for (int i = start; i < end; ++i) {
+            const Address& address = addresses[i];
+            query.bindValue(0, listId);
+            query.bindValue(1, address.getStreet());
+            query.bindValue(2, address.getCity());
+            query.bindValue(3, address.getState());
+            query.bindValue(4, address.getZip());
+            query.bindValue(5, address.getCountry());
+            query.bindValue(6, address.getLatitude());
+            query.bindValue(7, address.getLongitude());
+
+            if (query.exec()) {
+                ids.append(query.lastInsertId().toInt());
+            } else {
+                setLastError("Failed to add address: " + query.lastError().text());
+                ids.append(-1);
+            }
+        }
+
+        if (!m_db.commit()) {
+            setLastError("Failed to commit addresses: " + m_db.lastError().text());
+            m_db.rollback();
+            for (int i = start; i < end; ++i) {
+                ids[i] = -1;
+            }
+        }
+    }
+
+    if (m_cachedList.getId() == listId) {
+        for (int i = 0; i < addresses.size(); ++i) {
+            if (ids[i] > 0) {
+                Address cached = addresses[i];
+                cached.setId(ids[i]);
+                m_cachedList.addAddress(cached);
+            }
+        }
+    }
+
+    return ids;
 }
 
 bool Database::deleteAddress(int addressId) {
@@ -247,6 +618,7 @@ bool Database::deleteAddress(int addressId) {
         return false;
     }
     
+    m_cachedList.removeAddress(addressId);
     return true;
 }
 
@@ -272,12 +644,344 @@ bool Database::updateAddress(const Address& address) {
         return false;
     }
     
+    m_cachedList.updateAddress(address);
     return true;
 }
 
 QList<Address> Database::getAddressesForList(int listId) {
+    if (m_cachedList.getId() == listId && listId != -1) {
+        return m_cachedList.getAddresses();
+    }
+    
+    bool ok = false;
+    QList<Address> addresses = queryAddressesForList(listId, &ok);
+    if (ok) {
+        m_cachedList = AddressList(listId, QString());
+        m_cachedList.setAddresses(addresses);
+    }
+    return addresses;
+}
+
+Address Database::getAddress(int addressId) {
+    if (m_cachedList.containsAddress(addressId)) {
+        return m_cachedList.getAddress(addressId);
+    }
+    
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        SELECT id, street, city, state, zip, country, latitude, longitude
+        FROM addresses WHERE id = ?
+    )");
+    query.addBindValue(addressId);
+    
+    if (!query.exec()) {
+        setLastError("Failed to get address: " + query.lastError().text());
+        return Address();
+    }
+    
+    if (!query.next()) {
+        return Address();
+    }
+    
+    return Address(
+        query.value(0).toInt(),
+        query.value(1).toString(),
+        query.value(2).toString(),
+        query.value(3).toString(),
+        query.value(4).toString(),
+        query.value(5).toString(),
+        query.value(6).toDouble(),
+        query.value(7).toDouble()
+    );
+}
+
+QStringList Database::searchTerms(const QString& text) {
+    static const QRegularExpression separators("[^\\w]+", QRegularExpression::UseUnicodePropertiesOption);
+    return text.split(separators, Qt::SkipEmptyParts);
+}
+
+QString Database::ftsQuery(const QStringList& terms) {
+    // Terms contain only word characters, so quoting them is enough to keep
+    // FTS5 operators such as AND/NOT/NEAR from being interpreted
+    QStringList parts;
+    for (const QString& term : terms) {
+        parts << QString("\"%1\"*").arg(term);
+    }
+    return parts.join(' ');
+}
+
+QString Database::searchCondition(const QStringList& terms, QVariantList& values) const {
+    if (m_hasSearchIndex) {
+        values << ftsQuery(terms);
+        return "addresses_fts MATCH ?";
+    }
+    
+    // Without FTS5 every term is a substring match on any text column
+    QStringList clauses;
+    for (QString term : terms) {
+        term.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+        QString pattern = "%" + term + "%";
+        QStringList columns;
+        for (const char* column : {"street", "city", "state", "zip", "country"}) {
+            columns << QString("a.%1 LIKE ? ESCAPE '\\'").arg(column);
+            values << pattern;
+        }
+        clauses << "(" + columns.join(" OR ") + ")";
+    }
+    return clauses.join(" AND ");
+}
+
+QList<AddressSearchHit> Database::searchAddresses(const QString& text, int limit, int listId) {
+    TRACE_SCOPE("db", "Database::searchAddresses");
+    QList<AddressSearchHit> hits;
+    QStringList terms = searchTerms(text);
+    if (terms.isEmpty()) return hits;
+    
+    QVariantList values;
+    QString condition = searchCondition(terms, values);
+    // bm25() weights follow the column order: street matches rank highest
+    QString sql = m_hasSearchIndex
+        ? QString(R"(
+            SELECT a.id, a.list_id, a.street, a.city, a.state, a.zip, a.country,
+                   a.latitude, a.longitude, bm25(addresses_fts, 4.0, 2.0, 1.0, 1.0, 0.5) AS score
+            FROM addresses_fts JOIN addresses a ON a.id = addresses_fts.rowid
+            WHERE %1
+        )").arg(condition)
+        : QString(R"(
+            SELECT a.id, a.list_id, a.street, a.city, a.state, a.zip, a.country,
+                   a.latitude, a.longitude, 0.0 AS score
+            FROM addresses a
+            WHERE %1
+        )").arg(condition);
+    if (listId >= 0) {
+        sql += " AND a.list_id = ?";
+        values << listId;
+    }
+    sql += " ORDER BY score, a.id";
+    if (limit > 0) {
+        sql += " LIMIT ?";
+        values << limit;
+    }
+    
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    for (const QVariant& value : values) {
+        query.addBindValue(value);
+    }
+    
+    if (!query.exec()) {
+        setLastError("Failed to search addresses: " + query.lastError().text());
+        return hits;
+    }
+    
+    while (query.next()) {
+        Address addr(
+            query.value(0).toInt(),
+            query.value(2).toString(),
+            query.value(3).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            query.value(6).toString(),
+            query.value(7).toDouble(),
+            query.value(8).toDouble()
+        );
+        hits.append(AddressSearchHit{addr, query.value(1).toInt(), query.value(9).toDouble()});
+    }
+    
+    return hits;
+}
+
+QSet<int> Database::searchAddressIds(const QString& text, int listId) {
+    TRACE_SCOPE("db", "Database::searchAddressIds");
+    QSet<int> ids;
+    QStringList terms = searchTerms(text);
+    if (terms.isEmpty()) return ids;
+    
+    QVariantList values;
+    QString condition = searchCondition(terms, values);
+    QString sql = m_hasSearchIndex
+        ? QString("SELECT a.id FROM addresses_fts JOIN addresses a ON a.id = addresses_fts.rowid "
+                  "WHERE %1 AND a.list_id = ?").arg(condition)
+        : QString("SELECT a.id FROM addresses a WHERE %1 AND a.list_id = ?").arg(condition);
+    values << listId;
+    
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    for (const QVariant& value : values) {
+        query.addBindValue(value);
+    }
+    
+    if (!query.exec()) {
+        setLastError("Failed to search addresses: " + query.lastError().text());
+        return ids;
+    }
+    
+    while (query.next()) {
+        ids.insert(query.value(0).toInt());
+    }
+    return ids;
+}
+
+QList<Address> Database::queryAddressesInBox(double south, double west, double north, double east,
+                                             int listId) {
+    QList<Address> addresses;
+    // The R*Tree stores 32-bit bounds, so its hits are re-checked against
+    // the exact coordinates in addresses
+    QString sql = m_hasSpatialIndex
+        ? QString(R"(
+            SELECT a.id, a.street, a.city, a.state, a.zip, a.country, a.latitude, a.longitude
+            FROM addresses_rtree r JOIN addresses a ON a.id = r.id
+            WHERE r.max_lat >= ? AND r.min_lat <= ? AND r.max_lng >= ? AND r.min_lng <= ?
+              AND a.latitude BETWEEN ? AND ? AND a.longitude BETWEEN ? AND ?
+        )")
+        : QString(R"(
+            SELECT a.id, a.street, a.city, a.state, a.zip, a.country, a.latitude, a.longitude
+            FROM addresses a
+            WHERE (a.latitude <> 0 OR a.longitude <> 0)
+              AND a.latitude BETWEEN ? AND ? AND a.longitude BETWEEN ? AND ?
+        )");
+    if (listId >= 0) {
+        sql += " AND a.list_id = ?";
+    }
+    
+    QSqlQuery query(m_db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    if (m_hasSpatialIndex) {
+        query.addBindValue(south);
+        query.addBindValue(north);
+        query.addBindValue(west);
+        query.addBindValue(east);
+    }
+    query.addBindValue(south);
+    query.addBindValue(north);
+    query.addBindValue(west);
+    query.addBindValue(east);
+    if (listId >= 0) {
+        query.addBindValue(listId);
+    }
+    
+    if (!query.exec()) {
+        setLastError("Failed to query addresses in bounds: " + query.lastError().text());
+        return addresses;
+    }
+    
+    while (query.next()) {
+        Address addr(
+            query.value(0).toInt(),
+            query.value(1).toString(),
+            query.value(2).toString(),
+            query.value(3).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            query.value(6).toDouble(),
+            query.value(7).toDouble()
+        );
+        addresses.append(addr);
+    }
+    
+    return addresses;
+}
+
+QList<Address> Database::getAddressesInBounds(double south, double west, double north, double east,
+                                              int listId) {
+    if (south > north) {
+        std::swap(south, north);
+    }
+    if (east - west >= 360.0) {
+        return queryAddressesInBox(south, -180.0, north, 180.0, listId);
+    }
+    
+    west = std::remainder(west, 360.0);
+    east = std::remainder(east, 360.0);
+    if (west <= east) {
+        return queryAddressesInBox(south, west, north, east, listId);
+    }
+    
+    // Split at the antimeridian
+    QList<Address> addresses = queryAddressesInBox(south, west, north, 180.0, listId);
+    addresses += queryAddressesInBox(south, -180.0, north, east, listId);
+    return addresses;
+}
+
+QList<QPair<double, Address>> Database::queryAddressesNear(double latitude, double longitude,
+                                                          double radiusKm, int listId) {
+    // Bounding box of the circle, then an exact great-circle check
+    double angle = radiusKm / kEarthRadiusKm;
+    double dLat = qRadiansToDegrees(angle);
+    double south = latitude - dLat;
+    double north = latitude + dLat;
+    double west = -180.0;
+    double east = 180.0;
+    
+    double sinRatio = std::sin(qMin(angle, M_PI_2)) / std::cos(qDegreesToRadians(latitude));
+    if (north < 90.0 && south > -90.0 && sinRatio < 1.0) {
+        double dLng = qRadiansToDegrees(std::asin(sinRatio));
+        west = longitude - dLng;
+        east = longitude + dLng;
+    }
+    
+    QList<QPair<double, Address>> result;
+    const QList<Address> candidates = getAddressesInBounds(qMax(south, -90.0), west, qMin(north, 90.0), east,
+                                                           listId);
+    for (const Address& address : candidates) {
+        double distance = haversineDistanceKm(latitude, longitude, address.getLatitude(), address.getLongitude());
+        if (distance <= radiusKm) {
+            result.append(qMakePair(distance, address));
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const QPair<double, Address>& a, const QPair<double, Address>& b) {
+        return a.first < b.first;
+    });
+    return result;
+}
+
+QList<Address> Database::getAddressesWithinRadius(double latitude, double longitude, double radiusKm,
+                                                  int listId) {
+    QList<Address> addresses;
+    if (radiusKm < 0.0) return addresses;
+    
+    const auto hits = queryAddressesNear(latitude, longitude, radiusKm, listId);
+    addresses.reserve(hits.size());
+    for (const auto& hit : hits) {
+        addresses.append(hit.second);
+    }
+    return addresses;
+}
+
+QList<Address> Database::getNearestAddresses(double latitude, double longitude, int count, int listId) {
+    TRACE_SCOPE("db", "Database::getNearestAddresses");
+    QList<Address> addresses;
+    if (count <= 0) return addresses;
+    
+    // Grow the search circle until it holds enough addresses; anything
+    // outside a circle is farther than everything inside it
+    const double maxRadiusKm = M_PI * kEarthRadiusKm;
+    double radiusKm = 1.0;
+    QList<QPair<double, Address>> hits;
+    while (true) {
+        hits = queryAddressesNear(latitude, longitude, radiusKm, listId);
+        if (hits.size() >= count || radiusKm >= maxRadiusKm) break;
+        radiusKm = qMin(radiusKm * 4.0, maxRadiusKm);
+    }
+    
+    for (int i = 0; i < hits.size() && i < count; ++i) {
+        addresses.append(hits[i].second);
+    }
+    return addresses;
+}
+
+void Database::invalidateCache() {
+    m_cachedList = AddressList();
+}
+
+QList<Address> Database::queryAddressesForList(int listId, bool* ok) {
+    TRACE_SCOPE("db", "Database::queryAddressesForList");
     QList<Address> addresses;
     QSqlQuery query(m_db);
+    query.setForwardOnly(true);
     query.prepare(R"(
         SELECT id, street, city, state, zip, country, latitude, longitude
         FROM addresses WHERE list_id = ?
@@ -286,8 +990,10 @@ QList<Address> Database::getAddressesForList(int listId) {
     
     if (!query.exec()) {
         setLastError("Failed to get addresses: " + query.lastError().text());
+        if (ok) *ok = false;
         return addresses;
     }
+    if (ok) *ok = true;
     
     while (query.next()) {
         Address addr(
@@ -385,3 +1091,267 @@ void Database::clearRouteInfo(int listId) {
         LOG_ERROR("Failed to clear route info: " + query.lastError().text());
     }
 }
+
+bool Database::getCachedGeocode(const QString& key, QByteArray& payload) {
+    QSqlQuery query(m_db);
+    query.prepare("SELECT payload FROM geocode_cache WHERE cache_key = ? AND created_at > ?");
+    query.addBindValue(key);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch() - m_geocodeCacheTtl);
+    
+    if (!query.exec() || !query.next()) {
+        m_geocodeCacheMisses++;
+        return false;
+    }
+    
+    payload = query.value(0).toByteArray();
+    m_geocodeCacheHits++;
+    return true;
+}
+
+bool Database::storeCachedGeocode(const QString& key, const QByteArray& payload) {
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO geocode_cache (cache_key, payload, created_at) VALUES (?, ?, ?)");
+    query.addBindValue(key);
+    query.addBindValue(payload);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    
+    if (!query.exec()) {
+        setLastError("Failed to store geocode: " + query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+int Database::purgeExpiredGeocodes() {
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM geocode_cache WHERE created_at <= ?");
+    query.addBindValue(QDateTime::currentSecsSinceEpoch() - m_geocodeCacheTtl);
+    
+    if (!query.exec()) {
+        LOG_ERROR("Failed to purge geocode cache: " + query.lastError().text());
+        return 0;
+    }
+    
+    return query.numRowsAffected();
+}
+
+void Database::clearGeocodeCache() {
+    QSqlQuery query(m_db);
+    if (!query.exec("DELETE FROM geocode_cache")) {
+        LOG_ERROR("Failed to clear geocode cache: " + query.lastError().text());
+    }
+    m_geocodeCacheHits = 0;
+    m_geocodeCacheMisses = 0;
+}
+
+bool Database::getCachedRoute(const QString& key, QByteArray& geometry, QByteArray& legs,
+                              double& distanceKm, double& durationSeconds) {
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        SELECT geometry, legs, distance_km, duration_seconds FROM route_cache
+        WHERE cache_key = ? AND created_at > ?
+    )");
+    query.addBindValue(key);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch() - m_routeCacheTtl);
+    
+    if (!query.exec() || !query.next()) {
+        return false;
+    }
+    
+    geometry = query.value(0).toByteArray();
+    legs = query.value(1).toByteArray();
+    distanceKm = query.value(2).toDouble();
+    durationSeconds = query.value(3).toDouble();
+    return true;
+}
+
+bool Database::storeCachedRoute(const QString& key, const QString& profile, const QByteArray& geometry,
+                                const QByteArray& legs, double distanceKm, double durationSeconds) {
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        INSERT OR REPLACE INTO route_cache
+        (cache_key, profile, geometry, legs, distance_km, duration_seconds, created_at)
+        VALUES (?, ?, ?, ?, ?, ?, ?)
+    )");
+    query.addBindValue(key);
+    query.addBindValue(profile);
+    query.addBindValue(geometry);
+    query.addBindValue(legs);
+    query.addBindValue(distanceKm);
+    query.addBindValue(durationSeconds);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    
+    if (!query.exec()) {
+        setLastError("Failed to store route: " + query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+int Database::purgeExpiredRoutes() {
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM route_cache WHERE created_at <= ?");
+    query.addBindValue(QDateTime::currentSecsSinceEpoch() - m_routeCacheTtl);
+    
+    if (!query.exec()) {
+        LOG_ERROR("Failed to purge route cache: " + query.lastError().text());
+        return 0;
+    }
+    
+    return query.numRowsAffected();
+}
+
+void Database::clearRouteCache(const QString& profile) {
+    QSqlQuery query(m_db);
+    if (profile.isEmpty()) {
+        query.prepare("DELETE FROM route_cache");
+    } else {
+        query.prepare("DELETE FROM route_cache WHERE profile = ?");
+        query.addBindValue(profile);
+    }
+    
+    if (!query.exec()) {
+        LOG_ERROR("Failed to clear route cache: " + query.lastError().text());
+    }
+}
+
+QList<Address> Database::getAddressesWithoutCoordinates(int listId) {
+    QList<Address> addresses;
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        SELECT id, street, city, state, zip, country, latitude, longitude
+        FROM addresses
+        WHERE list_id = ?
+          AND COALESCE(latitude, 0) = 0 AND COALESCE(longitude, 0) = 0
+          AND id NOT IN (SELECT address_id FROM geocode_failures WHERE list_id = ?)
+        ORDER BY id
+    )");
+    query.addBindValue(listId);
+    query.addBindValue(listId);
+    
+    if (!query.exec()) {
+        setLastError("Failed to get addresses without coordinates: " + query.lastError().text());
+        return addresses;
+    }
+    
+    while (query.next()) {
+        Address addr(
+            query.value(0).toInt(),
+            query.value(1).toString(),
+            query.value(2).toString(),
+            query.value(3).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            query.value(6).toDouble(),
+            query.value(7).toDouble()
+        );
+        addresses.append(addr);
+    }
+    
+    return addresses;
+}
+
+bool Database::updateAddressCoordinates(int addressId, double latitude, double longitude) {
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE addresses SET latitude = ?, longitude = ? WHERE id = ?");
+    query.addBindValue(latitude);
+    query.addBindValue(longitude);
+    query.addBindValue(addressId);
+    
+    if (!query.exec()) {
+        setLastError("Failed to update coordinates: " + query.lastError().text());
+        return false;
+    }
+    
+    if (m_cachedList.containsAddress(addressId)) {
+        Address cached = m_cachedList.getAddress(addressId);
+        cached.setLatitude(latitude);
+        cached.setLongitude(longitude);
+        m_cachedList.updateAddress(cached);
+    }
+    return true;
+}
+
+bool Database::saveGeocodeJob(int listId, int total, int processed, int failed) {
+    QSqlQuery query(m_db);
+    query.prepare(R"(
+        INSERT OR REPLACE INTO geocode_jobs (list_id, total, processed, failed, updated_at)
+        VALUES (?, ?, ?, ?, ?)
+    )");
+    query.addBindValue(listId);
+    query.addBindValue(total);
+    query.addBindValue(processed);
+    query.addBindValue(failed);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    
+    if (!query.exec()) {
+        setLastError("Failed to save geocode job: " + query.lastError().text());
+        return false;
+    }
+    
+    return true;
+}
+
+bool Database::loadGeocodeJob(int listId, int& total, int& processed, int& failed) {
+    QSqlQuery query(m_db);
+    query.prepare("SELECT total, processed, failed FROM geocode_jobs WHERE list_id = ?");
+    query.addBindValue(listId);
+    
+    if (!query.exec() || !query.next()) {
+        return false;
+    }
+    
+    total = query.value(0).toInt();
+    processed = query.value(1).toInt();
+    failed = query.value(2).toInt();
+    return true;
+}
+
+QList<int> Database::getPendingGeocodeJobs() {
+    QList<int> listIds;
+    QSqlQuery query(m_db);
+    
+    if (!query.exec("SELECT list_id FROM geocode_jobs ORDER BY updated_at DESC")) {
+        setLastError("Failed to get geocode jobs: " + query.lastError().text());
+        return listIds;
+    }
+    
+    while (query.next()) {
+        listIds.append(query.value(0).toInt());
+    }
+    
+    return listIds;
+}
+
+void Database::recordGeocodeFailure(int listId, int addressId, const QString& error) {
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO geocode_failures (address_id, list_id, error) VALUES (?, ?, ?)");
+    query.addBindValue(addressId);
+    query.addBindValue(listId);
+    query.addBindValue(error);
+    
+    if (!query.exec()) {
+        LOG_ERROR("Failed to record geocode failure: " + query.lastError().text());
+    }
+}
+
+void Database::clearGeocodeJob(int listId, bool clearFailures) {
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM geocode_jobs WHERE list_id = ?");
+    query.addBindValue(listId);
+    
+    if (!query.exec()) {
+        LOG_ERROR("Failed to clear geocode job: " + query.lastError().text());
+    }
+    
+    if (clearFailures) {
+        query.prepare("DELETE FROM geocode_failures WHERE list_id = ?");
+        query.addBindValue(listId);
+        
+        if (!query.exec()) {
+            LOG_ERROR("Failed to clear geocode failures: " + query.lastError().text());
+        }
+    }
+}
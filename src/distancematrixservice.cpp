@@ -0,0 +1,445 @@
+#include "distancematrixservice.h"
+#include "geoutils.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTimer>
+#include <cmath>
+#include <limits>
+
+namespace {
+const char* kDefaultServerUrl = "https://router.project-osrm.org";
+const float kInfinity = std::numeric_limits<float>::infinity();
+}
+
+DistanceMatrixService::DistanceMatrixService(QObject* parent)
+    : QObject(parent), m_source(OsrmTable), m_serverUrl(kDefaultServerUrl),
+      m_networkManager(new QNetworkAccessManager(this)), m_tileSize(50), m_maxConcurrentRequests(4),
+      m_straightLineSpeedKmh(40.0), m_maxCacheSize(500000), m_nextRequestId(1), m_activeRequests(0) {
+    m_networkManager->setTransferTimeout(30000); // 30 seconds
+}
+
+DistanceMatrixService::~DistanceMatrixService() {
+    cancelAll();
+    // Workers post their results to this object; let them finish first
+    m_threadPool.waitForDone();
+}
+
+quint64 DistanceMatrixService::pointKey(double latitude, double longitude) {
+    // 1e-5 degrees is about a meter, well below geocoding precision
+    qint32 lat = qint32(std::lround(latitude * 1e5));
+    qint32 lng = qint32(std::lround(longitude * 1e5));
+    return (quint64(quint32(lat)) << 32) | quint64(quint32(lng));
+}
+
+void DistanceMatrixService::setSource(Source source) {
+    if (source == m_source) return;
+    m_source = source;
+    m_cache.clear();
+}
+
+void DistanceMatrixService::setOsrmServerUrl(const QString& url) {
+    QString trimmed = url.trimmed();
+    while (trimmed.endsWith('/')) {
+        trimmed.chop(1);
+    }
+    trimmed = trimmed.isEmpty() ? QString(kDefaultServerUrl) : trimmed;
+    if (trimmed == m_serverUrl) return;
+    m_serverUrl = trimmed;
+    if (m_source == OsrmTable) {
+        m_cache.clear();
+    }
+}
+
+void DistanceMatrixService::setRoadGraph(const RoadGraph& graph) {
+    // Copies share the graph's arrays, so workers can read it while the
+    // service switches to another one
+    m_graph = graph;
+    if (m_source == LocalGraph) {
+        m_cache.clear();
+    }
+}
+
+int DistanceMatrixService::computeMatrix(const QList<Address>& addresses) {
+    int requestId = m_nextRequestId++;
+
+    for (const Address& address : addresses) {
+        if (!address.hasCoordinates()) {
+            QTimer::singleShot(0, this, [this, requestId]() {
+                emit matrixFailed(requestId, "All addresses must have valid coordinates");
+            });
+            return requestId;
+        }
+    }
+
+    const int count = addresses.size();
+    Job job;
+    job.source = m_source;
+    job.latitudes.reserve(count);
+    job.longitudes.reserve(count);
+    job.pointKeys.reserve(count);
+    for (const Address& address : addresses) {
+        job.latitudes.append(address.getLatitude());
+        job.longitudes.append(address.getLongitude());
+        job.pointKeys.append(pointKey(address.getLatitude(), address.getLongitude()));
+    }
+    if (job.source == LocalGraph) {
+        job.graphNodes.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            job.graphNodes.append(m_graph.nearestNode(job.latitudes[i], job.longitudes[i]));
+        }
+    }
+
+    // Unknown pairs stay NaN until a tile fills them
+    job.matrix.count = count;
+    job.matrix.distancesKm.fill(std::numeric_limits<float>::quiet_NaN(), count * count);
+    job.matrix.durationsSeconds.fill(std::numeric_limits<float>::quiet_NaN(), count * count);
+    for (int from = 0; from < count; ++from) {
+        for (int to = 0; to < count; ++to) {
+            int index = from * count + to;
+            if (job.pointKeys[from] == job.pointKeys[to]) {
+                job.matrix.distancesKm[index] = 0.0f;
+                job.matrix.durationsSeconds[index] = 0.0f;
+                continue;
+            }
+            auto it = m_cache.constFind(qMakePair(job.pointKeys[from], job.pointKeys[to]));
+            if (it != m_cache.constEnd()) {
+                job.matrix.distancesKm[index] = it->distanceKm;
+                job.matrix.durationsSeconds[index] = it->durationSeconds;
+            }
+        }
+    }
+
+    job.activeTiles = 0;
+    job.completedTiles = 0;
+    planTiles(job);
+    job.totalTiles = job.pending.size();
+    m_jobs.insert(requestId, job);
+
+    LOG_INFO(QString("Distance matrix %1: %2 addresses, %3 tile(s) to compute")
+        .arg(requestId).arg(count).arg(job.totalTiles));
+    if (job.totalTiles == 0) {
+        QTimer::singleShot(0, this, [this, requestId]() { finishJob(requestId); });
+    } else {
+        dispatch();
+    }
+    return requestId;
+}
+
+void DistanceMatrixService::planTiles(Job& job) {
+    const int count = job.matrix.count;
+    auto missing = [&job, count](const Tile& tile) {
+        for (int row = tile.firstRow; row < tile.firstRow + tile.rowCount; ++row) {
+            for (int column = tile.firstColumn; column < tile.firstColumn + tile.columnCount; ++column) {
+                if (std::isnan(job.matrix.durationsSeconds[row * count + column])) return true;
+            }
+        }
+        return false;
+    };
+
+    // A local search from one origin reaches every destination at once, so
+    // local tiles are whole row blocks; OSRM tiles are square
+    for (int firstRow = 0; firstRow < count; firstRow += m_tileSize) {
+        int rowCount = qMin(m_tileSize, count - firstRow);
+        if (job.source != OsrmTable) {
+            Tile tile{firstRow, rowCount, 0, count};
+            if (missing(tile)) job.pending.enqueue(tile);
+            continue;
+        }
+        for (int firstColumn = 0; firstColumn < count; firstColumn += m_tileSize) {
+            Tile tile{firstRow, rowCount, firstColumn, qMin(m_tileSize, count - firstColumn)};
+            if (missing(tile)) job.pending.enqueue(tile);
+        }
+    }
+}
+
+void DistanceMatrixService::cancel(int requestId) {
+    if (!m_jobs.remove(requestId)) return;
+
+    // Replies of the job are dropped; local workers finish and are ignored
+    for (auto it = m_replies.begin(); it != m_replies.end();) {
+        if (it.value().first == requestId) {
+            QNetworkReply* reply = it.key();
+            it = m_replies.erase(it);
+            m_activeRequests--;
+            reply->abort();
+        } else {
+            ++it;
+        }
+    }
+    dispatch();
+}
+
+void DistanceMatrixService::cancelAll() {
+    m_jobs.clear();
+    QList<QNetworkReply*> replies = m_replies.keys();
+    m_replies.clear();
+    m_activeRequests = 0;
+    for (QNetworkReply* reply : replies) {
+        reply->abort();
+    }
+}
+
+void DistanceMatrixService::dispatch() {
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ++it) {
+        int requestId = it.key();
+        Job& job = it.value();
+        while (!job.pending.isEmpty()) {
+            if (job.source == OsrmTable) {
+                // Leave the rest queued; later local jobs can still start
+                if (m_activeRequests >= m_maxConcurrentRequests) break;
+                Tile tile = job.pending.dequeue();
+                job.activeTiles++;
+                startTableRequest(requestId, job, tile);
+            } else {
+                Tile tile = job.pending.dequeue();
+                job.activeTiles++;
+                startLocalTile(requestId, job, tile);
+            }
+        }
+    }
+}
+
+void DistanceMatrixService::startLocalTile(int requestId, const Job& job, const Tile& tile) {
+    // The worker gets its own (shared) copies of everything it reads
+    RoadGraph graph = m_graph;
+    QVector<double> latitudes = job.latitudes;
+    QVector<double> longitudes = job.longitudes;
+    QVector<int> nodes = job.graphNodes;
+    bool useGraph = job.source == LocalGraph;
+    double speedKmh = m_straightLineSpeedKmh;
+
+    m_threadPool.start([this, requestId, tile, graph, latitudes, longitudes, nodes, useGraph, speedKmh]() {
+        TRACE_SCOPE("routing", "DistanceMatrixService local tile");
+        TileResult result;
+        if (useGraph) {
+            result = graphTile(graph, latitudes, longitudes, nodes, tile, speedKmh);
+        } else {
+            // Straight lines are what was asked for here, not a fallback
+            result = straightLineTile(latitudes, longitudes, tile, speedKmh);
+            result.estimated.fill(false);
+        }
+        QMetaObject::invokeMethod(this, [this, requestId, tile, result]() {
+            applyTile(requestId, tile, result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DistanceMatrixService::startTableRequest(int requestId, const Job& job, const Tile& tile) {
+    QString url = buildTableUrl(job, tile);
+    LOG_DEBUGF("Table URL (matrix %1, rows %2-%3, columns %4-%5): %6",
+               requestId, tile.firstRow, tile.firstRow + tile.rowCount - 1,
+               tile.firstColumn, tile.firstColumn + tile.columnCount - 1, url);
+
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::UserAgentHeader, "MapAddress/1.0 Qt Application");
+
+    QNetworkReply* reply = m_networkManager->get(request);
+    reply->setProperty("traceStart", Tracer::startTime());
+    m_replies.insert(reply, qMakePair(requestId, tile));
+    m_activeRequests++;
+    connect(reply, &QNetworkReply::finished, this, &DistanceMatrixService::onTableReplyFinished);
+}
+
+QString DistanceMatrixService::buildTableUrl(const Job& job, const Tile& tile) const {
+    // Diagonal tiles list their addresses once; other tiles send the row
+    // addresses followed by the column addresses
+    bool diagonal = tile.firstRow == tile.firstColumn && tile.rowCount == tile.columnCount;
+    QStringList coordinates;
+    QStringList sources;
+    QStringList destinations;
+    for (int i = 0; i < tile.rowCount; ++i) {
+        int index = tile.firstRow + i;
+        coordinates << QString("%1,%2")
+            .arg(job.longitudes[index], 0, 'f', 6)
+            .arg(job.latitudes[index], 0, 'f', 6);
+        sources << QString::number(i);
+    }
+    for (int i = 0; i < tile.columnCount; ++i) {
+        if (diagonal) {
+            destinations << QString::number(i);
+            continue;
+        }
+        int index = tile.firstColumn + i;
+        coordinates << QString("%1,%2")
+            .arg(job.longitudes[index], 0, 'f', 6)
+            .arg(job.latitudes[index], 0, 'f', 6);
+        destinations << QString::number(tile.rowCount + i);
+    }
+
+    return QString("%1/table/v1/driving/%2?sources=%3&destinations=%4&annotations=duration,distance")
+        .arg(m_serverUrl, coordinates.join(";"), sources.join(";"), destinations.join(";"));
+}
+
+void DistanceMatrixService::onTableReplyFinished() {
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    reply->deleteLater();
+
+    // Replies of cancelled jobs are stale
+    auto it = m_replies.find(reply);
+    if (it == m_replies.end()) return;
+    int requestId = it.value().first;
+    Tile tile = it.value().second;
+    m_replies.erase(it);
+    m_activeRequests--;
+    Tracer::instance().addAsyncSpan("network", "OSRM table request", reply->property("traceStart").toLongLong());
+    TRACE_SCOPE("routing", "DistanceMatrixService::onTableReplyFinished");
+
+    auto job = m_jobs.constFind(requestId);
+    if (job == m_jobs.constEnd()) {
+        dispatch();
+        return;
+    }
+
+    TileResult result;
+    QString error;
+    if (reply->error() != QNetworkReply::NoError) {
+        error = reply->errorString();
+    } else if (!parseTableResponse(reply->readAll(), tile, result)) {
+        error = "Invalid table response";
+    }
+
+    // A failed tile is estimated rather than failing the whole matrix
+    if (!error.isEmpty()) {
+        LOG_WARNING(QString("Table request for matrix %1 failed, using straight-line estimates: %2")
+            .arg(requestId).arg(error));
+        result = straightLineTile(job->latitudes, job->longitudes, tile, m_straightLineSpeedKmh);
+    }
+    applyTile(requestId, tile, result);
+}
+
+bool DistanceMatrixService::parseTableResponse(const QByteArray& data, const Tile& tile,
+                                               TileResult& result) const {
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) return false;
+
+    QJsonObject root = doc.object();
+    if (root["code"].toString() != "Ok") {
+        LOG_ERROR("Table service returned error: " + root["code"].toString());
+        return false;
+    }
+
+    QJsonArray durations = root["durations"].toArray();
+    QJsonArray distances = root["distances"].toArray();
+    if (durations.size() != tile.rowCount || distances.size() != tile.rowCount) return false;
+
+    result.distancesKm.resize(tile.rowCount * tile.columnCount);
+    result.durationsSeconds.resize(tile.rowCount * tile.columnCount);
+    result.estimated.fill(false, tile.rowCount * tile.columnCount);
+    for (int row = 0; row < tile.rowCount; ++row) {
+        QJsonArray durationRow = durations[row].toArray();
+        QJsonArray distanceRow = distances[row].toArray();
+        if (durationRow.size() != tile.columnCount || distanceRow.size() != tile.columnCount) return false;
+
+        // null marks pairs without a route
+        for (int column = 0; column < tile.columnCount; ++column) {
+            int index = row * tile.columnCount + column;
+            QJsonValue duration = durationRow[column];
+            QJsonValue distance = distanceRow[column];
+            result.durationsSeconds[index] = duration.isNull() ? kInfinity : float(duration.toDouble());
+            result.distancesKm[index] = distance.isNull() ? kInfinity : float(distance.toDouble() / 1000.0);
+        }
+    }
+    return true;
+}
+
+DistanceMatrixService::TileResult DistanceMatrixService::straightLineTile(
+        const QVector<double>& latitudes, const QVector<double>& longitudes, const Tile& tile,
+        double speedKmh) {
+    TileResult result;
+    result.distancesKm.resize(tile.rowCount * tile.columnCount);
+    result.durationsSeconds.resize(tile.rowCount * tile.columnCount);
+    result.estimated.fill(true, tile.rowCount * tile.columnCount);
+    for (int row = 0; row < tile.rowCount; ++row) {
+        int from = tile.firstRow + row;
+        for (int column = 0; column < tile.columnCount; ++column) {
+            int to = tile.firstColumn + column;
+            double km = haversineDistanceKm(latitudes[from], longitudes[from], latitudes[to], longitudes[to]);
+            int index = row * tile.columnCount + column;
+            result.distancesKm[index] = float(km);
+            result.durationsSeconds[index] = float(km / speedKmh * 3600.0);
+        }
+    }
+    return result;
+}
+
+DistanceMatrixService::TileResult DistanceMatrixService::graphTile(
+        const RoadGraph& graph, const QVector<double>& latitudes, const QVector<double>& longitudes,
+        const QVector<int>& nodes, const Tile& tile, double speedKmh) {
+    // Addresses away from the road network keep the straight-line estimate
+    TileResult result = straightLineTile(latitudes, longitudes, tile, speedKmh);
+    QVector<int> targets = nodes.mid(tile.firstColumn, tile.columnCount);
+    for (int row = 0; row < tile.rowCount; ++row) {
+        int source = nodes[tile.firstRow + row];
+        if (source < 0) continue;
+
+        QVector<double> distancesKm;
+        QVector<double> seconds = graph.travelTimes(source, targets, &distancesKm);
+        for (int column = 0; column < tile.columnCount; ++column) {
+            if (targets[column] < 0) continue;
+            int index = row * tile.columnCount + column;
+            result.durationsSeconds[index] = float(seconds[column]);
+            result.distancesKm[index] = float(distancesKm[column]);
+            result.estimated[index] = false;
+        }
+    }
+    return result;
+}
+
+void DistanceMatrixService::applyTile(int requestId, const Tile& tile, const TileResult& result) {
+    auto it = m_jobs.find(requestId);
+    if (it == m_jobs.end()) return;
+    Job& job = it.value();
+    const int count = job.matrix.count;
+
+    // Diagonal entries stay zero; estimates are used but never cached
+    for (int row = 0; row < tile.rowCount; ++row) {
+        int from = tile.firstRow + row;
+        for (int column = 0; column < tile.columnCount; ++column) {
+            int to = tile.firstColumn + column;
+            int index = from * count + to;
+            if (!std::isnan(job.matrix.durationsSeconds[index])) continue;
+
+            int tileIndex = row * tile.columnCount + column;
+            job.matrix.distancesKm[index] = result.distancesKm[tileIndex];
+            job.matrix.durationsSeconds[index] = result.durationsSeconds[tileIndex];
+            if (result.estimated[tileIndex]) {
+                job.matrix.estimatedPairs++;
+            } else if (m_maxCacheSize > 0 && job.source == m_source) {
+                if (m_cache.size() >= m_maxCacheSize) {
+                    m_cache.clear();
+                }
+                m_cache.insert(qMakePair(job.pointKeys[from], job.pointKeys[to]),
+                               CachedCost{result.distancesKm[tileIndex], result.durationsSeconds[tileIndex]});
+            }
+        }
+    }
+
+    job.activeTiles--;
+    job.completedTiles++;
+    bool done = job.pending.isEmpty() && job.activeTiles == 0;
+    // Receivers may cancel the job, so it isn't touched after this
+    emit matrixProgress(requestId, job.completedTiles, job.totalTiles);
+
+    if (done) {
+        finishJob(requestId);
+    }
+    dispatch();
+}
+
+void DistanceMatrixService::finishJob(int requestId) {
+    auto it = m_jobs.find(requestId);
+    if (it == m_jobs.end()) return;
+    DistanceMatrix matrix = it->matrix;
+    m_jobs.erase(it);
+
+    if (matrix.estimatedPairs > 0) {
+        LOG_WARNING(QString("Distance matrix %1: %2 pair(s) are straight-line estimates")
+            .arg(requestId).arg(matrix.estimatedPairs));
+    }
+    emit matrixReady(requestId, matrix);
+}
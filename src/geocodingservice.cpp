@@ -1,5 +1,7 @@
 #include "geocodingservice.h"
 #include "logger.h"
+#include "tracer.h"
+#include "database.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -8,7 +10,7 @@
 #include <QTimer>
 
 GeocodingService::GeocodingService(QObject* parent)
-    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)) {
+    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)), m_nextRequestId(1) {
     // Set timeout for network requests
     m_networkManager->setTransferTimeout(15000); // 15 seconds
 }
@@ -16,11 +18,24 @@ GeocodingService::GeocodingService(QObject* parent)
 GeocodingService::~GeocodingService() {
 }
 
-void GeocodingService::geocode(const Address& address, int maxResults) {
-    m_maxResults = maxResults;
-    QString url = buildGeocodeUrl(address, maxResults);
+int GeocodingService::geocode(const Address& address, int maxResults) {
+    int requestId = m_nextRequestId++;
     QString fullAddress = address.getFullAddress();
     LOG_INFO("Geocoding address: " + fullAddress);
+    
+    QString key = cacheKey(address, maxResults);
+    QByteArray cached;
+    if (Database::instance().getCachedGeocode(key, cached)) {
+        LOG_DEBUG("Geocoding cache hit: " + key);
+        QJsonArray results = QJsonDocument::fromJson(cached).array();
+        // Keep the asynchronous contract callers rely on
+        QMetaObject::invokeMethod(this, [this, requestId, results, maxResults]() {
+            handleGeocodeResults(requestId, results, maxResults, true);
+        }, Qt::QueuedConnection);
+        return requestId;
+    }
+    
+    QString url = buildGeocodeUrl(address, maxResults);
     LOG_DEBUG("Geocoding URL: " + url);
     
     QNetworkRequest request(url);
@@ -28,7 +43,12 @@ void GeocodingService::geocode(const Address& address, int maxResults) {
     request.setHeader(QNetworkRequest::UserAgentHeader, "MapAddress/1.0 Qt Application");
     
     QNetworkReply* reply = m_networkManager->get(request);
+    reply->setProperty("cacheKey", key);
+    reply->setProperty("maxResults", maxResults);
+    reply->setProperty("requestId", requestId);
+    reply->setProperty("traceStart", Tracer::startTime());
     connect(reply, &QNetworkReply::finished, this, &GeocodingService::onGeocodeFinished);
+    return requestId;
 }
 
 void GeocodingService::reverseGeocode(double latitude, double longitude) {
@@ -44,27 +64,42 @@ void GeocodingService::reverseGeocode(double latitude, double longitude) {
     connect(reply, &QNetworkReply::finished, this, &GeocodingService::onReverseGeocodeFinished);
 }
 
-QString GeocodingService::buildGeocodeUrl(const Address& address, int maxResults) const {
-    // Build a structured query for better results
-    QStringList queryParts;
+QStringList GeocodingService::queryParts(const Address& address) {
+    QStringList parts;
     
     if (!address.getStreet().isEmpty()) {
-        queryParts << address.getStreet();
+        parts << address.getStreet();
     }
     if (!address.getCity().isEmpty()) {
-        queryParts << address.getCity();
+        parts << address.getCity();
     }
     if (!address.getState().isEmpty()) {
-        queryParts << address.getState();
+        parts << address.getState();
     }
     if (!address.getZip().isEmpty()) {
-        queryParts << address.getZip();
+        parts << address.getZip();
     }
     if (!address.getCountry().isEmpty()) {
-        queryParts << address.getCountry();
+        parts << address.getCountry();
     }
     
-    QString query = queryParts.join(", ");
+    return parts;
+}
+
+QString GeocodingService::cacheKey(const Address& address, int maxResults) {
+    QStringList parts;
+    for (const QString& part : queryParts(address)) {
+        QString normalized = part.simplified().toCaseFolded();
+        if (!normalized.isEmpty()) {
+            parts << normalized;
+        }
+    }
+    return parts.join('|') + QString("#%1").arg(maxResults);
+}
+
+QString GeocodingService::buildGeocodeUrl(const Address& address, int maxResults) const {
+    // Build a structured query for better results
+    QString query = queryParts(address).join(", ");
     QString encodedQuery = QUrl::toPercentEncoding(query);
     
     // Add countrycodes parameter if country is specified to improve results
@@ -84,6 +119,9 @@ void GeocodingService::onGeocodeFinished() {
     if (!reply) return;
 
     reply->deleteLater();
+    int requestId = reply->property("requestId").toInt();
+    Tracer::instance().addAsyncSpan("network", "Geocoding request", reply->property("traceStart").toLongLong());
+    TRACE_SCOPE("geocoding", "GeocodingService::onGeocodeFinished");
 
     // Handle network errors with user-friendly messages
     if (reply->error() != QNetworkReply::NoError) {
@@ -96,6 +134,7 @@ void GeocodingService::onGeocodeFinished() {
                 errorMsg = "Geocoding service not found. Please check your internet connection.";
                 break;
             case QNetworkReply::TimeoutError:
+            case QNetworkReply::OperationCanceledError:
                 errorMsg = "Request timed out. Please try again.";
                 break;
             case QNetworkReply::NetworkSessionFailedError:
@@ -104,53 +143,73 @@ void GeocodingService::onGeocodeFinished() {
             default:
                 errorMsg = "Network error: " + reply->errorString();
         }
+        // Everything but client errors (other than throttling) may succeed later
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        bool retryable = status == 0 || status == 429 || status >= 500;
         LOG_ERROR("Geocoding network error: " + errorMsg);
+        emit geocodingRequestFailed(requestId, errorMsg, retryable);
         emit geocodingFailed(errorMsg);
         return;
     }
 
     QByteArray data = reply->readAll();
-    LOG_DEBUG("Geocoding response: " + QString(data));
+    LOG_DEBUGF("Geocoding response: %1", data);
     
     QJsonDocument doc = QJsonDocument::fromJson(data);
+    QJsonArray results = doc.array();
+    
+    // Only successful lookups are cached, so a retry can still find the address
+    if (!results.isEmpty()) {
+        Database::instance().storeCachedGeocode(reply->property("cacheKey").toString(),
+                                                QJsonDocument(results).toJson(QJsonDocument::Compact));
+    }
+    
+    handleGeocodeResults(requestId, results, reply->property("maxResults").toInt(), false);
+}
 
-    if (!doc.isArray() || doc.array().isEmpty()) {
+void GeocodingService::handleGeocodeResults(int requestId, const QJsonArray& results,
+                                            int maxResults, bool fromCache) {
+    if (results.isEmpty()) {
         LOG_WARNING("Geocoding failed: Address not found in Nominatim response");
+        emit geocodingRequestFailed(requestId, "Address not found", false);
         emit geocodingFailed("Address not found. Please verify the address and try again.");
         return;
     }
-
-    QJsonArray results = doc.array();
     
-    // If requesting multiple results, emit all candidates (even if just one)
-    if (m_maxResults > 1) {
-        QVector<GeocodingCandidate> candidates;
+    QVector<GeocodingCandidate> candidates;
+    for (const QJsonValue &value : results) {
+        QJsonObject result = value.toObject();
+        
+        if (!result.contains("lat") || !result.contains("lon")) {
+            continue;
+        }
+        
+        bool latOk, lonOk;
+        double lat = result["lat"].toString().toDouble(&latOk);
+        double lon = result["lon"].toString().toDouble(&lonOk);
         
-        for (const QJsonValue &value : results) {
-            QJsonObject result = value.toObject();
-            
-            if (!result.contains("lat") || !result.contains("lon")) {
-                continue;
-            }
-            
-            bool latOk, lonOk;
-            double lat = result["lat"].toString().toDouble(&latOk);
-            double lon = result["lon"].toString().toDouble(&lonOk);
-            
-            if (!latOk || !lonOk) {
-                continue;
-            }
-            
-            GeocodingCandidate candidate;
-            candidate.latitude = lat;
-            candidate.longitude = lon;
-            candidate.displayName = result["display_name"].toString();
-            candidate.type = result["type"].toString();
-            candidate.importance = result["importance"].toDouble();
-            
-            candidates.append(candidate);
+        if (!latOk || !lonOk) {
+            continue;
         }
         
+        GeocodingCandidate candidate;
+        candidate.latitude = lat;
+        candidate.longitude = lon;
+        candidate.displayName = result["display_name"].toString();
+        candidate.type = result["type"].toString();
+        candidate.importance = result["importance"].toDouble();
+        
+        candidates.append(candidate);
+    }
+    
+    if (candidates.isEmpty()) {
+        emit geocodingRequestFailed(requestId, "No valid coordinates in response", false);
+    } else {
+        emit geocodingResultReady(requestId, candidates, fromCache);
+    }
+    
+    // If requesting multiple results, emit all candidates (even if just one)
+    if (maxResults > 1) {
         if (candidates.isEmpty()) {
             LOG_ERROR("No valid candidates found in response");
             emit geocodingFailed("No valid addresses found. Please try again.");
@@ -1,4 +1,5 @@
 #include "googlemapsprovider.h"
+#include "tracer.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QProcessEnvironment>
@@ -9,7 +10,7 @@ GoogleMapsProvider::GoogleMapsProvider(QObject* parent)
 }
 
 void GoogleMapsProvider::initialize() {
-    m_markers.clear();
+    clearMarkers();
     m_centerLat = 0.0;
     m_centerLng = 0.0;
     m_zoom = 2;
@@ -21,19 +22,6 @@ void GoogleMapsProvider::setCenter(double latitude, double longitude, int zoom)
     m_zoom = zoom;
 }
 
-void GoogleMapsProvider::addMarker(int id, double latitude, double longitude, const QString& title) {
-    QString markerData = QString("%1,%2,%3").arg(latitude).arg(longitude).arg(title);
-    m_markers[id] = markerData;
-}
-
-void GoogleMapsProvider::removeMarker(int id) {
-    m_markers.remove(id);
-}
-
-void GoogleMapsProvider::clearMarkers() {
-    m_markers.clear();
-}
-
 void GoogleMapsProvider::fitBounds(const QList<Address>& addresses) {
     if (addresses.isEmpty()) return;
 
@@ -82,24 +70,7 @@ QString GoogleMapsProvider::getHtml() const {
 }
 
 QString GoogleMapsProvider::generateHtml() const {
-    QString markers;
-    for (auto it = m_markers.constBegin(); it != m_markers.constEnd(); ++it) {
-        QStringList parts = it.value().split(',');
-        if (parts.size() >= 3) {
-            QString title = parts.mid(2).join(',');
-            // Escape single quotes in title
-            QString escapedTitle = title;
-            escapedTitle.replace("'", "\\'");
-            markers += QString(R"(
-                {
-                    id: %1,
-                    position: { lat: %2, lng: %3 },
-                    title: '%4'
-                },
-            )").arg(it.key()).arg(parts[0]).arg(parts[1]).arg(escapedTitle);
-        }
-    }
-
+    TRACE_SCOPE("map", "GoogleMapsProvider::generateHtml");
     // Get API key from settings (fallback to environment variable)
     QSettings settings("DataInquiry", "MapAddress");
     QString apiKey = settings.value("Map/GoogleMapsApiKey", "").toString();
@@ -145,65 +116,219 @@ QString GoogleMapsProvider::generateHtml() const {
         let markers = {};
         let infoWindow;
         let currentHighlighted = null;
-        
-        const normalIcon = {
-            path: google.maps.SymbolPath.CIRCLE,
-            scale: 8,
-            fillColor: '#EA4335',
-            fillOpacity: 1,
-            strokeColor: '#ffffff',
-            strokeWeight: 2
-        };
-        
-        const highlightedIcon = {
-            path: google.maps.SymbolPath.CIRCLE,
-            scale: 12,
-            fillColor: '#ef4444',
-            fillOpacity: 1,
-            strokeColor: '#ffffff',
-            strokeWeight: 3
-        };
+        let normalIcon;
+        let highlightedIcon;
+        let mapReady = false;
+        let channelReady = false;
+        // Only markers or clusters inside the padded viewport are on the map
+        let clusterMarkers = [];
 
-        function initMap() {
-            map = new google.maps.Map(document.getElementById('map'), {
-                center: { lat: %1, lng: %2 },
-                zoom: %3,
-                mapTypeControl: true,
-                streetViewControl: true,
-                fullscreenControl: true
+        function infoHtml(title) {
+            return '<div style="padding: 5px;"><strong>' + title + '</strong></div>';
+        }
+
+        function createMarker(data) {
+            const marker = new google.maps.Marker({
+                position: { lat: data.lat, lng: data.lng },
+                map: map,
+                title: data.title,
+                icon: normalIcon
             });
 
-            infoWindow = new google.maps.InfoWindow();
+            // Add info window on marker hover
+            marker.addListener('mouseover', () => {
+                infoWindow.setContent(infoHtml(marker.getTitle()));
+                infoWindow.open(map, marker);
+            });
+
+            marker.addListener('mouseout', () => {
+                infoWindow.close();
+            });
+
+            marker.addListener('click', () => {
+                if (window.qtBridge) {
+                    window.qtBridge.markerClicked(data.id);
+                }
+            });
+
+            markers[data.id] = marker;
+        }
+
+        // Incremental updates pushed from MapWidget
+        function upsertMarker(data) {
+            const marker = markers[data.id];
+            if (marker) {
+                marker.setPosition({ lat: data.lat, lng: data.lng });
+                marker.setTitle(data.title);
+            } else {
+                createMarker(data);
+            }
+        }
 
-            const markerData = [%4];
+        function removeMarker(id) {
+            if (markers[id]) {
+                markers[id].setMap(null);
+                delete markers[id];
+                if (currentHighlighted === id) {
+                    currentHighlighted = null;
+                }
+            }
+        }
+
+        function decodeBase64(text) {
+            const binary = atob(text);
+            const bytes = new Uint8Array(binary.length);
+            for (let i = 0; i < binary.length; i++) {
+                bytes[i] = binary.charCodeAt(i);
+            }
+            return bytes.buffer;
+        }
+
+        // Markers already on the map are kept unless they moved or were
+        // renamed; the rest are diffed in
+        function showViewportMarkers(idsBase64, coordsBase64, titleIndexesBase64, titles) {
+            const ids = new Int32Array(decodeBase64(idsBase64));
+            const coords = new Float64Array(decodeBase64(coordsBase64));
+            const titleIndexes = new Int32Array(decodeBase64(titleIndexesBase64));
+            clusterMarkers.forEach(m => m.setMap(null));
+            clusterMarkers = [];
+
+            const visible = new Set();
+            for (let i = 0; i < ids.length; i++) {
+                visible.add(ids[i]);
+                const marker = markers[ids[i]];
+                const lat = coords[2 * i];
+                const lng = coords[2 * i + 1];
+                const title = titles[titleIndexes[i]];
+                if (!marker) {
+                    createMarker({ id: ids[i], lat: lat, lng: lng, title: title });
+                } else if (marker.getPosition().lat() !== lat || marker.getPosition().lng() !== lng
+                           || marker.getTitle() !== title) {
+                    upsertMarker({ id: ids[i], lat: lat, lng: lng, title: title });
+                }
+            }
+            Object.keys(markers).forEach(key => {
+                if (!visible.has(Number(key))) {
+                    removeMarker(Number(key));
+                }
+            });
+        }
 
-            markerData.forEach(data => {
+        function setView(lat, lng, zoom) {
+            map.setCenter({ lat: lat, lng: lng });
+            map.setZoom(zoom);
+        }
+
+        function fitToBounds(south, west, north, east) {
+            if (south === north && west === east) {
+                setView(south, west, 15);
+                return;
+            }
+            map.fitBounds(new google.maps.LatLngBounds(
+                { lat: south, lng: west }, { lat: north, lng: east }));
+        }
+
+        // Clustering: only the clusters inside the viewport exist on the map
+        function clusterIcon(count) {
+            return {
+                path: google.maps.SymbolPath.CIRCLE,
+                scale: count < 100 ? 15 : (count < 1000 ? 19 : 23),
+                fillColor: '#EA4335',
+                fillOpacity: 0.85,
+                strokeColor: '#ffffff',
+                strokeWeight: 3
+            };
+        }
+
+        function showClusters(list) {
+            const highlighted = currentHighlighted;
+            clusterMarkers.forEach(m => m.setMap(null));
+            clusterMarkers = [];
+            Object.keys(markers).forEach(id => markers[id].setMap(null));
+            markers = {};
+            currentHighlighted = null;
+
+            list.forEach(c => {
+                if (c.count === 1) {
+                    createMarker(c);
+                    return;
+                }
                 const marker = new google.maps.Marker({
-                    position: data.position,
+                    position: { lat: c.lat, lng: c.lng },
                     map: map,
-                    title: data.title,
-                    animation: google.maps.Animation.DROP,
-                    icon: normalIcon
+                    icon: clusterIcon(c.count),
+                    label: { text: String(c.count), color: '#ffffff', fontWeight: 'bold' }
                 });
-
-                // Add info window on marker hover
-                marker.addListener('mouseover', () => {
-                    infoWindow.setContent('<div style="padding: 5px;"><strong>' + data.title + '</strong></div>');
-                    infoWindow.open(map, marker);
+                marker.addListener('click', () => {
+                    map.setCenter({ lat: c.lat, lng: c.lng });
+                    map.setZoom(map.getZoom() + 2);
                 });
+                clusterMarkers.push(marker);
+            });
 
-                marker.addListener('mouseout', () => {
-                    infoWindow.close();
-                });
+            if (highlighted !== null && markers[highlighted]) {
+                markers[highlighted].setIcon(highlightedIcon);
+                currentHighlighted = highlighted;
+            }
+        }
 
-                marker.addListener('click', () => {
-                    if (window.qtBridge) {
-                        window.qtBridge.markerClicked(data.id);
-                    }
-                });
+        function reportViewport() {
+            if (!mapReady || !window.qtBridge) return;
+            const bounds = map.getBounds();
+            if (!bounds) return;
+            const sw = bounds.getSouthWest();
+            const ne = bounds.getNorthEast();
+            const padLat = (ne.lat() - sw.lat()) * 0.25;
+            let west = sw.lng();
+            let east = ne.lng();
+            if (east < west) {
+                east += 360;
+            }
+            const padLng = (east - west) * 0.25;
+            window.qtBridge.viewportChanged(
+                Math.max(-90, sw.lat() - padLat), west - padLng,
+                Math.min(90, ne.lat() + padLat), east + padLng, map.getZoom());
+        }
+
+        // Both the map and the web channel must be up before Qt may push updates
+        function notifyReady() {
+            if (mapReady && channelReady && window.qtBridge) {
+                window.qtBridge.pageReady();
+                reportViewport();
+            }
+        }
 
-                markers[data.id] = marker;
+        function initMap() {
+            normalIcon = {
+                path: google.maps.SymbolPath.CIRCLE,
+                scale: 8,
+                fillColor: '#EA4335',
+                fillOpacity: 1,
+                strokeColor: '#ffffff',
+                strokeWeight: 2
+            };
+            
+            highlightedIcon = {
+                path: google.maps.SymbolPath.CIRCLE,
+                scale: 12,
+                fillColor: '#ef4444',
+                fillOpacity: 1,
+                strokeColor: '#ffffff',
+                strokeWeight: 3
+            };
+
+            map = new google.maps.Map(document.getElementById('map'), {
+                center: { lat: %1, lng: %2 },
+                zoom: %3,
+                mapTypeControl: true,
+                streetViewControl: true,
+                fullscreenControl: true
             });
+
+            infoWindow = new google.maps.InfoWindow();
+
+            // idle fires once panning and zooming have settled
+            map.addListener('idle', reportViewport);
             
             // Function to highlight a specific marker
             window.highlightMarker = function(markerId) {
@@ -261,19 +386,23 @@ QString GoogleMapsProvider::generateHtml() const {
                 console.log('Route displayed');
             };
             
-            window.showRoutePolyline = function(routePoints) {
+            window.showRoutePolyline = function(coordsBase64, fitBounds) {
                 // Clear existing route
                 if (routeLine) {
                     routeLine.setMap(null);
                 }
                 
-                // Convert to Google Maps format
-                const path = routePoints.map(p => ({lat: p[0], lng: p[1]}));
+                // Int32 (lat, lng) pairs in 1e-6 degrees, already simplified
+                // for the zoom they are shown at
+                const coords = new Int32Array(decodeBase64(coordsBase64));
+                const path = new Array(coords.length / 2);
+                for (let i = 0; i < path.length; i++) {
+                    path[i] = {lat: coords[2 * i] / 1e6, lng: coords[2 * i + 1] / 1e6};
+                }
                 
                 // Draw road-based route
                 routeLine = new google.maps.Polyline({
                     path: path,
-                    geodesic: true,
                     strokeColor: '#3b82f6',
                     strokeOpacity: 0.8,
                     strokeWeight: 5,
@@ -281,11 +410,13 @@ QString GoogleMapsProvider::generateHtml() const {
                 });
                 
                 // Fit bounds to show entire route
-                const bounds = new google.maps.LatLngBounds();
-                path.forEach(p => bounds.extend(p));
-                map.fitBounds(bounds);
+                if (fitBounds) {
+                    const bounds = new google.maps.LatLngBounds();
+                    path.forEach(p => bounds.extend(p));
+                    map.fitBounds(bounds, 50);
+                }
                 
-                console.log('Route polyline displayed with', routePoints.length, 'points');
+                console.log('Route polyline displayed with', path.length, 'points');
             };
             
             window.clearRoute = function() {
@@ -295,6 +426,9 @@ QString GoogleMapsProvider::generateHtml() const {
                     console.log('Route cleared');
                 }
             };
+
+            mapReady = true;
+            notifyReady();
         }
 
         window.onerror = function(msg, url, line) {
@@ -309,8 +443,33 @@ QString GoogleMapsProvider::generateHtml() const {
             script.onload = function() {
                 if (typeof QWebChannel !== 'undefined') {
                     new QWebChannel(qt.webChannelTransport, function(channel) {
-                        window.qtBridge = channel.objects.qtBridge;
+                        const bridge = channel.objects.qtBridge;
+                        window.qtBridge = bridge;
+
+                        bridge.markersChanged.connect(function(upserts, removedIds) {
+                            if (!mapReady) return;
+                            removedIds.forEach(removeMarker);
+                            upserts.forEach(upsertMarker);
+                        });
+                        bridge.viewportMarkers.connect(function(ids, coords, titleIndexes, titles) {
+                            if (mapReady) showViewportMarkers(ids, coords, titleIndexes, titles);
+                        });
+                        bridge.centerRequested.connect(function(lat, lng, zoom) {
+                            if (mapReady) setView(lat, lng, zoom);
+                        });
+                        bridge.fitBoundsRequested.connect(function(south, west, north, east) {
+                            if (mapReady) fitToBounds(south, west, north, east);
+                        });
+                        bridge.clustersUpdated.connect(function(list) {
+                            if (mapReady) showClusters(list);
+                        });
+                        bridge.routeChanged.connect(function(coords, fitBounds) {
+                            if (mapReady) window.showRoutePolyline(coords, fitBounds);
+                        });
+
                         console.log('QWebChannel initialized');
+                        channelReady = true;
+                        notifyReady();
                     });
                 }
             };
@@ -321,11 +480,11 @@ QString GoogleMapsProvider::generateHtml() const {
         })();
     </script>
     <script async defer
-        src="https://maps.googleapis.com/maps/api/js?key=%5&callback=initMap">
+        src="https://maps.googleapis.com/maps/api/js?key=%4&callback=initMap">
     </script>
 </body>
 </html>
-    )").arg(m_centerLat).arg(m_centerLng).arg(m_zoom).arg(markers).arg(apiKey);
+    )").arg(m_centerLat).arg(m_centerLng).arg(m_zoom).arg(apiKey);
 
     return html;
 }
@@ -0,0 +1,53 @@
+#include "gziputils.h"
+#include <array>
+
+namespace {
+// qCompress() prefixes the zlib stream with the uncompressed length
+const int kLengthPrefixSize = 4;
+const int kZlibHeaderSize = 2;
+const int kZlibTrailerSize = 4;     // Adler-32
+
+void appendLittleEndian(QByteArray& out, quint32 value) {
+    for (int i = 0; i < 4; ++i) {
+        out.append(char((value >> (8 * i)) & 0xFF));
+    }
+}
+}
+
+quint32 crc32(const QByteArray& data) {
+    static const auto table = []() {
+        std::array<quint32, 256> values{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            values[i] = c;
+        }
+        return values;
+    }();
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (char byte : data) {
+        crc = table[(crc ^ quint8(byte)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QByteArray gzipCompress(const QByteArray& data, int level) {
+    QByteArray zlib = qCompress(data, level);
+    const int overhead = kLengthPrefixSize + kZlibHeaderSize + kZlibTrailerSize;
+    if (zlib.size() <= overhead) {
+        return QByteArray();
+    }
+
+    QByteArray out;
+    out.reserve(zlib.size() - overhead + 18);
+    // Magic, deflate, no flags, no modification time, no extra flags, unknown OS
+    const char header[] = {'\x1f', '\x8b', '\x08', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\xff'};
+    out.append(header, sizeof(header));
+    out.append(zlib.constData() + kLengthPrefixSize + kZlibHeaderSize, zlib.size() - overhead);
+    appendLittleEndian(out, crc32(data));
+    appendLittleEndian(out, quint32(data.size()));
+    return out;
+}
@@ -0,0 +1,138 @@
+#include "localroutingbackend.h"
+#include "geoutils.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QDateTime>
+#include <QFileInfo>
+
+LocalRoutingBackend::LocalRoutingBackend(QObject* parent)
+    : RoutingBackend(parent), m_maxSnapDistanceKm(5.0), m_generation(0) {
+}
+
+LocalRoutingBackend::~LocalRoutingBackend() {
+    cancelAll();
+    // Workers post their results to this object; let them finish first
+    m_threadPool.waitForDone();
+}
+
+bool LocalRoutingBackend::readGraph(const QString& path, RoadGraph& graph) {
+    TRACE_SCOPE("routing", "LocalRoutingBackend::readGraph");
+    QFileInfo info(path);
+    if (info.suffix().compare("gr", Qt::CaseInsensitive) == 0) {
+        QString coordinates = info.path() + "/" + info.completeBaseName() + ".co";
+        return graph.importDimacs(path, coordinates);
+    }
+    return graph.load(path);
+}
+
+bool LocalRoutingBackend::loadGraph(const QString& path) {
+    RoadGraph graph;
+    bool loaded = readGraph(path, graph);
+    return applyGraph(path, graph, loaded);
+}
+
+void LocalRoutingBackend::loadGraphAsync(const QString& path) {
+    // Reading and indexing a regional graph takes seconds
+    m_threadPool.start([this, path]() {
+        RoadGraph graph;
+        bool loaded = readGraph(path, graph);
+        QMetaObject::invokeMethod(this, [this, path, graph, loaded]() {
+            emit graphLoaded(applyGraph(path, graph, loaded));
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool LocalRoutingBackend::applyGraph(const QString& path, const RoadGraph& graph, bool loaded) {
+    m_graph = graph;
+    if (!loaded) {
+        m_lastError = m_graph.getLastError();
+        m_graphPath.clear();
+        m_profile.clear();
+        LOG_ERROR("Failed to load road graph: " + m_lastError);
+        return false;
+    }
+    m_graphPath = path;
+    // A rebuilt graph file gets a new profile, so older cached routes no
+    // longer match
+    QFileInfo info(path);
+    m_profile = QString("graph:%1@%2")
+        .arg(info.absoluteFilePath())
+        .arg(info.lastModified().toMSecsSinceEpoch());
+    return true;
+}
+
+void LocalRoutingBackend::setGraph(const RoadGraph& graph) {
+    m_graph = graph;
+    m_graphPath.clear();
+    m_profile.clear();
+}
+
+void LocalRoutingBackend::requestRoute(int requestId, const QList<Address>& waypoints) {
+    // The worker gets its own (shared) copy of the graph, so a graph set
+    // while queries are running does not affect them
+    RoadGraph graph = m_graph;
+    double maxSnapDistanceKm = m_maxSnapDistanceKm;
+    int generation = m_generation.load();
+    m_threadPool.start([this, requestId, waypoints, graph, maxSnapDistanceKm, generation]() {
+        if (generation != m_generation.load()) return;
+        QString error;
+        RoutePath path = route(graph, waypoints, maxSnapDistanceKm, error);
+        QMetaObject::invokeMethod(this, [this, requestId, path, error, generation]() {
+            if (generation != m_generation.load()) return;
+            emit routeFinished(requestId, path, error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LocalRoutingBackend::cancelAll() {
+    m_generation++;
+}
+
+RoutePath LocalRoutingBackend::route(const RoadGraph& graph, const QList<Address>& waypoints,
+                                     double maxSnapDistanceKm, QString& error) {
+    TRACE_SCOPE("routing", "LocalRoutingBackend::route");
+    RoutePath route;
+    if (graph.isEmpty()) {
+        error = "No road graph is loaded for offline routing";
+        return route;
+    }
+
+    QVector<int> nodes;
+    nodes.reserve(waypoints.size());
+    for (int i = 0; i < waypoints.size(); ++i) {
+        const Address& waypoint = waypoints[i];
+        int node = graph.nearestNode(waypoint.getLatitude(), waypoint.getLongitude(),
+                                     maxSnapDistanceKm);
+        if (node < 0) {
+            error = QString("%1 is not near any road in the road graph").arg(waypoint.getFullAddress());
+            return RoutePath();
+        }
+        nodes.append(node);
+    }
+
+    // Consecutive legs share their joining node
+    for (int i = 0; i + 1 < nodes.size(); ++i) {
+        double seconds = 0.0;
+        QVector<int> path = graph.shortestPath(nodes[i], nodes[i + 1], &seconds);
+        if (path.isEmpty()) {
+            error = QString("No road connects %1 and %2")
+                .arg(waypoints[i].getFullAddress(), waypoints[i + 1].getFullAddress());
+            return RoutePath();
+        }
+        QList<QPointF> legPoints;
+        legPoints.reserve(path.size());
+        for (int node : path) {
+            legPoints.append(QPointF(graph.getLongitude(node), graph.getLatitude(node)));
+        }
+        RouteLeg leg{polylineLengthKm(legPoints), seconds};
+        route.legs.append(leg);
+        route.distanceKm += leg.distanceKm;
+        route.durationSeconds += leg.durationSeconds;
+        route.points.append(route.points.isEmpty() ? legPoints : legPoints.mid(1));
+    }
+
+    LOG_DEBUG(QString("Local route through %1 waypoints: %2 points, %3 km, %4 s")
+        .arg(waypoints.size()).arg(route.points.size())
+        .arg(route.distanceKm, 0, 'f', 1).arg(route.durationSeconds, 0, 'f', 0));
+    return route;
+}
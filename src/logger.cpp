@@ -1,27 +1,69 @@
 #include "logger.h"
+#include "gziputils.h"
 #include <QStandardPaths>
 #include <QDir>
-#include <QMutexLocker>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <exception>
 #include <iostream>
 
+namespace {
+const std::size_t kQueueCapacity = 8192;
+const int kBatchSize = 256;
+// Upper bound on how long a message waits when a wake-up is missed
+const std::chrono::milliseconds kIdleWait(100);
+
+const qint64 kDefaultMaxFileSize = 10 * 1024 * 1024;
+const qint64 kDefaultMaxFileAge = 7 * 24 * 3600;
+const int kDefaultMaxArchives = 5;
+const char* const kTimestampFormat = "yyyy-MM-dd HH:mm:ss";
+const char* const kArchiveSuffixFormat = "yyyyMMdd-HHmmsszzz";
+
+std::terminate_handler previousTerminateHandler = nullptr;
+}
+
 Logger& Logger::instance() {
     static Logger instance;
     return instance;
 }
 
-Logger::Logger() : m_logLevel(Info) {
+Logger::Logger()
+    : m_queue(kQueueCapacity), m_logLevel(Info), m_overflowPolicy(DropMessages), m_consoleOutput(true),
+      m_dropped(0),
+      m_droppedTotal(0), m_fileStartedAt(0), m_maxFileSize(kDefaultMaxFileSize),
+      m_maxFileAge(kDefaultMaxFileAge), m_maxArchives(kDefaultMaxArchives), m_archivesPending(false),
+      m_writerIdle(false), m_wakeRequested(false), m_stopping(false), m_writtenCount(0) {
     // Default log file location
     QString appData = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir dir(appData);
     if (!dir.exists()) {
         dir.mkpath(".");
     }
-    
+
     QString logPath = appData + "/mapaddress.log";
     setLogFile(logPath);
+
+    m_writer = std::thread(&Logger::run, this);
 }
 
 Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> state(m_stateMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_one();
+    m_flushedCondition.notify_all();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+
+    // Whatever was logged while the writer shut down
+    drain(INT_MAX);
+    std::lock_guard<std::mutex> output(m_outputMutex);
     if (m_logFile.isOpen()) {
         m_stream.flush();
         m_logFile.close();
@@ -29,41 +71,69 @@ Logger::~Logger() {
 }
 
 void Logger::setLogFile(const QString& filePath) {
-    QMutexLocker locker(&m_mutex);
-    
+    std::lock_guard<std::mutex> output(m_outputMutex);
+
     if (m_logFile.isOpen()) {
         m_stream.flush();
         m_logFile.close();
     }
-    
+
     m_logFile.setFileName(filePath);
-    if (m_logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
-        m_stream.setDevice(&m_logFile);
-    }
+    openLogFile();
+}
+
+void Logger::setRotation(qint64 maxBytes, qint64 maxAgeSeconds, int maxArchives) {
+    std::lock_guard<std::mutex> output(m_outputMutex);
+    m_maxFileSize = qMax<qint64>(0, maxBytes);
+    m_maxFileAge = qMax<qint64>(0, maxAgeSeconds);
+    m_maxArchives = qMax(0, maxArchives);
+    m_archivesPending.store(true);
 }
 
 void Logger::setLogLevel(Level level) {
-    m_logLevel = level;
+    m_logLevel.store(level);
 }
 
 void Logger::log(Level level, const QString& message) {
-    if (level < m_logLevel) {
+    if (!isEnabled(level)) {
         return;
     }
-    
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss");
-    QString levelStr = levelToString(level);
-    QString logMessage = QString("[%1] [%2] %3").arg(timestamp).arg(levelStr).arg(message);
-    
-    // Write to console
-    if (level >= Warning) {
-        std::cerr << logMessage.toStdString() << std::endl;
-    } else {
-        std::cout << logMessage.toStdString() << std::endl;
+
+    Record record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.message = message;
+    enqueue(std::move(record));
+}
+
+void Logger::logFormat(Level level, const QString& format, const QVariantList& args) {
+    if (!isEnabled(level)) {
+        return;
+    }
+
+    Record record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.message = format;
+    record.args = args;
+    enqueue(std::move(record));
+}
+
+void Logger::enqueue(Record&& record) {
+    while (!m_queue.tryPush(std::move(record))) {
+        if (m_overflowPolicy.load(std::memory_order_relaxed) == DropMessages) {
+            m_dropped.fetch_add(1);
+            m_droppedTotal.fetch_add(1);
+            return;
+        }
+        wakeWriter();
+        std::this_thread::yield();
+    }
+
+    // Only one producer pays for waking an idle writer
+    if (m_writerIdle.exchange(false)) {
+        wakeWriter();
     }
-    
-    // Write to file
-    writeToFile(logMessage);
 }
 
 void Logger::debug(const QString& message) {
@@ -92,11 +162,317 @@ QString Logger::levelToString(Level level) const {
     }
 }
 
-void Logger::writeToFile(const QString& message) {
-    QMutexLocker locker(&m_mutex);
-    
+void Logger::flush() {
+    std::size_t target = m_queue.pushCount();
+    std::unique_lock<std::mutex> state(m_stateMutex);
+    m_wakeRequested = true;
+    m_wakeCondition.notify_one();
+    m_flushedCondition.wait(state, [this, target]() {
+        return m_writtenCount >= target || m_stopping;
+    });
+}
+
+void Logger::wakeWriter() {
+    std::lock_guard<std::mutex> state(m_stateMutex);
+    m_wakeRequested = true;
+    m_wakeCondition.notify_one();
+}
+
+void Logger::run() {
+    for (;;) {
+        if (drain(kBatchSize) > 0) {
+            continue;
+        }
+        // Compressing can take a while, so it waits until the queue is empty
+        if (m_archivesPending.exchange(false)) {
+            compressArchives();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> state(m_stateMutex);
+        if (m_stopping) {
+            break;
+        }
+
+        // Producers see the idle flag before this re-check sees their
+        // message, or the other way round, so no wake-up is lost
+        m_writerIdle.store(true);
+        if (m_queue.popCount() != m_queue.pushCount() || m_dropped.load() > 0) {
+            m_writerIdle.store(false);
+            continue;
+        }
+        m_wakeCondition.wait_for(state, kIdleWait, [this]() {
+            return m_wakeRequested || m_stopping;
+        });
+        m_wakeRequested = false;
+        m_writerIdle.store(false);
+    }
+}
+
+int Logger::drain(int maxRecords) {
+    int count = 0;
+    {
+        std::lock_guard<std::mutex> output(m_outputMutex);
+        quint64 dropped = m_dropped.exchange(0);
+        if (dropped > 0) {
+            Record notice;
+            notice.timestamp = QDateTime::currentMSecsSinceEpoch();
+            notice.level = Warning;
+            notice.message = QString("%1 log messages were dropped because the log queue was full")
+                .arg(dropped);
+            writeRecord(notice);
+        }
+
+        Record record;
+        while (count < maxRecords && m_queue.tryPop(record)) {
+            writeRecord(record);
+            ++count;
+        }
+        if (count > 0 || dropped > 0) {
+            flushOutput();
+            if (m_logFile.isOpen() && rotationDue(m_logFile.size())) {
+                rotate();
+            }
+        }
+    }
+
+    if (count > 0) {
+        std::lock_guard<std::mutex> state(m_stateMutex);
+        m_writtenCount += count;
+    }
+    m_flushedCondition.notify_all();
+    return count;
+}
+
+void Logger::openLogFile() {
+    // A file left by an earlier session may already be due
+    QString filePath = m_logFile.fileName();
+    m_fileStartedAt = firstMessageTime(filePath);
+    if (rotationDue(QFileInfo(filePath).size())) {
+        archiveLogFile();
+    }
+
+    if (m_logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        m_stream.setDevice(&m_logFile);
+        if (m_fileStartedAt == 0) {
+            m_fileStartedAt = QDateTime::currentMSecsSinceEpoch();
+        }
+    }
+    m_archivesPending.store(true);
+}
+
+bool Logger::rotationDue(qint64 fileSize) const {
+    if (fileSize <= 0) {
+        return false;
+    }
+    if (m_maxFileSize > 0 && fileSize >= m_maxFileSize) {
+        return true;
+    }
+    return m_maxFileAge > 0 && m_fileStartedAt > 0 &&
+           QDateTime::currentMSecsSinceEpoch() - m_fileStartedAt >= m_maxFileAge * 1000;
+}
+
+void Logger::rotate() {
+    m_stream.flush();
+    m_logFile.close();
+    archiveLogFile();
+    openLogFile();
+}
+
+void Logger::archiveLogFile() {
+    // Archive names sort by the time they were rotated
+    QString filePath = m_logFile.fileName();
+    QString base = filePath + "." + QDateTime::currentDateTime().toString(kArchiveSuffixFormat);
+    QString archivePath = base;
+    for (int n = 1; QFile::exists(archivePath) || QFile::exists(archivePath + ".gz"); ++n) {
+        archivePath = QString("%1-%2").arg(base).arg(n);
+    }
+
+    if (QFile::rename(filePath, archivePath)) {
+        m_fileStartedAt = 0;
+    } else {
+        std::cerr << "Failed to archive log file " << filePath.toStdString() << '\n';
+    }
+}
+
+void Logger::compressArchives() {
+    QString filePath;
+    int maxArchives;
+    {
+        std::lock_guard<std::mutex> output(m_outputMutex);
+        filePath = m_logFile.fileName();
+        maxArchives = m_maxArchives;
+    }
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    QFileInfo info(filePath);
+    QDir dir = info.absoluteDir();
+    QRegularExpression archivePattern(
+        "^" + QRegularExpression::escape(info.fileName()) + "\\.\\d{8}-\\d{9}(-\\d+)?(\\.gz)?$");
+
+    QStringList archives;
+    for (const QString& name : dir.entryList({info.fileName() + ".*"}, QDir::Files, QDir::Name)) {
+        if (!archivePattern.match(name).hasMatch()) {
+            continue;
+        }
+        if (name.endsWith(".gz")) {
+            // Already listed when its plain file came first
+            if (!archives.contains(name)) {
+                archives.append(name);
+            }
+            continue;
+        }
+
+        // A .gz next to the plain file means an earlier run was interrupted
+        // after compressing; QSaveFile never leaves a partial .gz behind
+        QString plainPath = dir.filePath(name);
+        QString gzipPath = plainPath + ".gz";
+        if (!QFile::exists(gzipPath)) {
+            QFile plain(plainPath);
+            if (!plain.open(QIODevice::ReadOnly)) {
+                continue;
+            }
+            QByteArray compressed = gzipCompress(plain.readAll());
+            plain.close();
+
+            QSaveFile gzip(gzipPath);
+            if (compressed.isEmpty() || !gzip.open(QIODevice::WriteOnly) ||
+                gzip.write(compressed) != compressed.size() || !gzip.commit()) {
+                archives.append(name);
+                continue;
+            }
+        }
+        QFile::remove(plainPath);
+        archives.append(name + ".gz");
+    }
+
+    // Oldest first
+    archives.sort();
+    while (archives.size() > maxArchives) {
+        dir.remove(archives.takeFirst());
+    }
+}
+
+qint64 Logger::firstMessageTime(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return 0;
+    }
+    // Every line starts with "[yyyy-MM-dd HH:mm:ss]"
+    QString line = QString::fromUtf8(file.readLine(64));
+    QDateTime time = QDateTime::fromString(line.mid(1, 19), kTimestampFormat);
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+QString Logger::formatMessage(const QString& format, const QVariantList& args) {
+    QString result;
+    result.reserve(format.size() + 16 * args.size());
+    int i = 0;
+    while (i < format.size()) {
+        QChar c = format[i];
+        if (c != '%' || i + 1 >= format.size() || !format[i + 1].isDigit()) {
+            result += c;
+            ++i;
+            continue;
+        }
+
+        int number = format[i + 1].digitValue();
+        int length = 2;
+        if (i + 2 < format.size() && format[i + 2].isDigit()) {
+            number = number * 10 + format[i + 2].digitValue();
+            length = 3;
+        }
+        if (number >= 1 && number <= args.size()) {
+            result += args[number - 1].toString();
+        } else {
+            result += format.mid(i, length);
+        }
+        i += length;
+    }
+    return result;
+}
+
+QString Logger::formatRecord(const Record& record) const {
+    QString timestamp = QDateTime::fromMSecsSinceEpoch(record.timestamp).toString(kTimestampFormat);
+    QString message = record.args.isEmpty() ? record.message : formatMessage(record.message, record.args);
+    return QString("[%1] [%2] %3").arg(timestamp, levelToString(record.level), message);
+}
+
+void Logger::writeRecord(const Record& record) {
+    QString logMessage = formatRecord(record);
+
+    // Write to console
+    if (m_consoleOutput.load(std::memory_order_relaxed)) {
+        if (record.level >= Warning) {
+            std::cerr << logMessage.toStdString() << '\n';
+        } else {
+            std::cout << logMessage.toStdString() << '\n';
+        }
+    }
+
+    // Write to file
+    if (m_logFile.isOpen()) {
+        m_stream << logMessage << "\n";
+    }
+}
+
+void Logger::flushOutput() {
+    std::cout.flush();
+    std::cerr.flush();
     if (m_logFile.isOpen()) {
-        m_stream << message << "\n";
         m_stream.flush();
     }
 }
+
+void Logger::installCrashHandler() {
+    instance();
+    std::signal(SIGSEGV, &Logger::onFatalSignal);
+    std::signal(SIGABRT, &Logger::onFatalSignal);
+    std::signal(SIGFPE, &Logger::onFatalSignal);
+    std::signal(SIGILL, &Logger::onFatalSignal);
+#ifdef SIGBUS
+    std::signal(SIGBUS, &Logger::onFatalSignal);
+#endif
+    previousTerminateHandler = std::set_terminate(&Logger::onTerminate);
+}
+
+void Logger::onFatalSignal(int signal) {
+    instance().flushAfterCrash();
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+void Logger::onTerminate() {
+    instance().flushAfterCrash();
+    if (previousTerminateHandler) {
+        previousTerminateHandler();
+    }
+    std::abort();
+}
+
+void Logger::flushAfterCrash() {
+    // The writer may be in the middle of a batch, or may be the thread
+    // that crashed while holding the lock; then only the console is used
+    std::unique_lock<std::mutex> output(m_outputMutex, std::try_to_lock);
+    for (int attempt = 0; attempt < 100 && !output.owns_lock(); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        output.try_lock();
+    }
+
+    Record record;
+    while (m_queue.tryPop(record)) {
+        if (output.owns_lock()) {
+            writeRecord(record);
+        } else {
+            std::cerr << formatRecord(record).toStdString() << '\n';
+        }
+    }
+
+    if (output.owns_lock()) {
+        flushOutput();
+    } else {
+        std::cerr.flush();
+    }
+}
@@ -4,6 +4,7 @@
 #include "mainwindow.h"
 #include "database.h"
 #include "logger.h"
+#include "tracer.h"
 
 int main(int argc, char *argv[])
 {
@@ -27,9 +28,18 @@ int main(int argc, char *argv[])
     appIcon.addFile(":/icons/icons/app-icon-512.png");
     app.setWindowIcon(appIcon);
     
-    // Initialize logger
+    // Initialize logger; queued messages are written out even on a crash
+    Logger::installCrashHandler();
     LOG_INFO("=== MapAddress Application Started ===");
     LOG_INFO(QString("Version: %1").arg(app.applicationVersion()));
+
+    // MAPADDRESS_TRACE=<file> records a Chrome trace of the session, for
+    // chrome://tracing or https://ui.perfetto.dev
+    QString tracePath = qEnvironmentVariable("MAPADDRESS_TRACE");
+    if (!tracePath.isEmpty()) {
+        Tracer::instance().setEnabled(true);
+        LOG_INFO("Tracing enabled, writing trace to " + tracePath + " on exit");
+    }
     
     // Initialize database
     LOG_INFO("Initializing database...");
@@ -48,6 +58,14 @@ int main(int argc, char *argv[])
     LOG_INFO("Main window displayed");
     
     int result = app.exec();
+    if (!tracePath.isEmpty()) {
+        Tracer::instance().setEnabled(false);
+        if (Tracer::instance().exportChromeTrace(tracePath)) {
+            LOG_INFO(QString("Trace with %1 events written").arg(Tracer::instance().getEventCount()));
+        } else {
+            LOG_ERROR(Tracer::instance().getLastError());
+        }
+    }
     LOG_INFO("=== MapAddress Application Closed ===");
     return result;
 }
@@ -2,46 +2,83 @@
 #include "ui_mainwindow.h"
 #include "address.h"
 #include "addresslist.h"
+#include "addresslistmodel.h"
 #include "addressdialog.h"
 #include "settingsdialog.h"
 #include "database.h"
 #include "logger.h"
+#include "tracer.h"
 #include "routingservice.h"
+#include "localroutingbackend.h"
+#include "osrmroutingbackend.h"
+#include "csvimportworker.h"
+#include "csvwriter.h"
+#include "batchgeocoder.h"
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QFileDialog>
 #include <QFile>
-#include <QTextStream>
 #include <QSettings>
 #include <QMenu>
-#include <QRegularExpression>
+#include <QThread>
+#include <QProgressDialog>
+#include <QTimer>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_addressModel(nullptr)
     , m_mapWidget(nullptr)
     , m_geocodingService(nullptr)
+    , m_batchGeocoder(nullptr)
     , m_routingService(nullptr)
     , m_currentListId(-1)
     , m_routeStartId(-1)
     , m_routeEndId(-1)
     , m_pendingAddressLat(0.0)
     , m_pendingAddressLng(0.0)
+    , m_importThread(nullptr)
+    , m_importWorker(nullptr)
+    , m_importProgress(nullptr)
+    , m_importListId(-1)
+    , m_importedCount(0)
+    , m_importErrorCount(0)
+    , m_searchTimer(nullptr)
+    , m_routePlanGeneration(0)
 {
     ui->setupUi(this);
     
+    m_addressModel = new AddressListModel(this);
+    ui->addressListView->setModel(m_addressModel);
+    
+    // Search runs once typing pauses rather than on every keystroke
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(200);
+    
+    // One plan at a time; a newer request supersedes a running one
+    m_optimizerPool.setMaxThreadCount(1);
+    
     // Initialize services
     m_geocodingService = new GeocodingService(this);
     m_routingService = new RoutingService(this);
+    m_batchGeocoder = new BatchGeocoder(m_geocodingService, this);
     
     setupMapWidget();
     setupConnections();
     applySettings();
     loadLists();
+    
+    // Ask about interrupted geocoding jobs once the window is up
+    QTimer::singleShot(0, this, &MainWindow::offerGeocodeResume);
 }
 
 MainWindow::~MainWindow()
 {
+    stopImport();
+    // Optimizer results are posted to this window
+    m_optimizerPool.clear();
+    m_optimizerPool.waitForDone();
     delete ui;
 }
 
@@ -58,12 +95,15 @@ void MainWindow::setupConnections()
     connect(ui->addAddressButton, &QPushButton::clicked, this, &MainWindow::onAddAddress);
     connect(ui->editAddressButton, &QPushButton::clicked, this, &MainWindow::onEditAddress);
     connect(ui->deleteAddressButton, &QPushButton::clicked, this, &MainWindow::onDeleteAddress);
-    connect(ui->addressListWidget, &QListWidget::itemSelectionChanged, this, &MainWindow::onAddressSelected);
+    connect(ui->addressListView->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &MainWindow::onAddressSelected);
     connect(ui->searchLineEdit, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
+    connect(ui->searchLineEdit, &QLineEdit::returnPressed, this, &MainWindow::onSearchSubmitted);
+    connect(m_searchTimer, &QTimer::timeout, this, &MainWindow::runSearch);
     
     // Context menu for address list
-    ui->addressListWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-    connect(ui->addressListWidget, &QListWidget::customContextMenuRequested, 
+    ui->addressListView->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->addressListView, &QListView::customContextMenuRequested, 
             this, &MainWindow::onShowAddressContextMenu);
     
     // Menu and toolbar actions
@@ -77,12 +117,15 @@ void MainWindow::setupConnections()
     connect(ui->actionExport, &QAction::triggered, this, &MainWindow::onExport);
     connect(ui->actionAbout, &QAction::triggered, this, &MainWindow::onAbout);
     connect(ui->actionSettings, &QAction::triggered, this, &MainWindow::onSettings);
+    connect(ui->actionGeocodeMissing, &QAction::triggered, this, &MainWindow::onGeocodeMissing);
     
     // Routing service
     connect(m_routingService, &RoutingService::routeCalculated, 
             this, &MainWindow::onRouteCalculated);
     connect(m_routingService, &RoutingService::routeFailed,
             this, &MainWindow::onRouteFailed);
+    connect(m_routingService, &RoutingService::routeProgress,
+            this, &MainWindow::onRouteProgress);
     
     // Geocoding service for reverse geocoding
     connect(m_geocodingService, &GeocodingService::reverseGeocodingCompleted,
@@ -90,6 +133,11 @@ void MainWindow::setupConnections()
     connect(m_geocodingService, &GeocodingService::reverseGeocodingFailed,
             this, &MainWindow::onReverseGeocodeFailed);
     
+    // Batch geocoding
+    connect(m_batchGeocoder, &BatchGeocoder::progress, this, &MainWindow::onBatchGeocodeProgress);
+    connect(m_batchGeocoder, &BatchGeocoder::addressGeocoded, this, &MainWindow::onBatchAddressGeocoded);
+    connect(m_batchGeocoder, &BatchGeocoder::finished, this, &MainWindow::onBatchGeocodeFinished);
+    
     // Map provider selector
     connect(ui->mapProviderComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), 
             this, [this](int index) {
@@ -104,7 +152,6 @@ void MainWindow::setupConnections()
 void MainWindow::setupMapWidget()
 {
     m_mapWidget = new MapWidget(this);
-    m_geocodingService = new GeocodingService(this);
     
     ui->mapLayout->addWidget(m_mapWidget);
     
@@ -131,31 +178,28 @@ void MainWindow::loadLists()
 
 void MainWindow::loadAddresses(int listId)
 {
+    TRACE_SCOPE("ui", "MainWindow::loadAddresses");
     // Save current route info before switching
     if (m_currentListId != -1 && m_currentListId != listId) {
         saveRouteInfo();
     }
     
-    ui->addressListWidget->clear();
-    
     auto addresses = Database::instance().getAddressesForList(listId);
     
-    if (m_mapWidget->getCurrentProvider()) {
-        m_mapWidget->getCurrentProvider()->clearMarkers();
-        m_mapWidget->clearRoute();
+    // Display strings are formatted by the model only for painted rows
+    m_addressModel->setAddresses(addresses);
+    if (!ui->searchLineEdit->text().trimmed().isEmpty()) {
+        m_searchTimer->stop();
+        runSearch();
     }
     
+    m_mapWidget->clearMarkers();
+    m_mapWidget->clearRoute();
+    
     for (const auto& address : addresses) {
-        QString displayText = QString("%1, %2, %3")
-            .arg(address.getStreet())
-            .arg(address.getCity())
-            .arg(address.getState());
-        
-        auto item = new QListWidgetItem(displayText, ui->addressListWidget);
-        item->setData(Qt::UserRole, address.getId());
-        
-        if (address.getLatitude() != 0.0 && address.getLongitude() != 0.0 && m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->addMarker(address.getId(), address.getLatitude(), address.getLongitude(), displayText);
+        if (address.getLatitude() != 0.0 && address.getLongitude() != 0.0) {
+            m_mapWidget->addMarker(address.getId(), address.getLatitude(), address.getLongitude(),
+                                   AddressListModel::displayText(address));
         }
     }
     
@@ -164,20 +208,15 @@ void MainWindow::loadAddresses(int listId)
     // Load route info for this list
     loadRouteInfo(listId);
     
-    // Fit map bounds and refresh display
-    if (!addresses.isEmpty() && m_mapWidget->getCurrentProvider()) {
-        m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-    }
-    
-    // Reload the map to display all markers
-    if (m_mapWidget) {
-        m_mapWidget->loadMap();
+    // Fit map bounds; markers are pushed to the page incrementally
+    if (!addresses.isEmpty()) {
+        m_mapWidget->fitToAddresses(addresses);
     }
 }
 
 void MainWindow::updateAddressButtons()
 {
-    bool hasSelection = ui->addressListWidget->currentItem() != nullptr;
+    bool hasSelection = currentAddressId() != -1;
     bool hasList = m_currentListId != -1;
     
     ui->addAddressButton->setEnabled(hasList);
@@ -210,22 +249,16 @@ void MainWindow::onAddAddress()
         if (addressId > 0) {
             address.setId(addressId);
             
-            QString displayText = QString("%1, %2, %3")
-                .arg(address.getStreet())
-                .arg(address.getCity())
-                .arg(address.getState());
-            
-            auto item = new QListWidgetItem(displayText, ui->addressListWidget);
-            item->setData(Qt::UserRole, addressId);
+            QString displayText = AddressListModel::displayText(address);
+            m_addressModel->addAddress(address);
             
-            if (address.hasCoordinates() && m_mapWidget->getCurrentProvider()) {
-                m_mapWidget->getCurrentProvider()->addMarker(addressId, 
+            if (address.hasCoordinates()) {
+                m_mapWidget->addMarker(addressId, 
                     address.getLatitude(), address.getLongitude(), displayText);
                 
                 // Refit map to show all markers including the new one
                 auto addresses = Database::instance().getAddressesForList(m_currentListId);
-                m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-                m_mapWidget->loadMap();
+                m_mapWidget->fitToAddresses(addresses);
             }
             
             ui->statusbar->showMessage("Address added", 2000);
@@ -237,25 +270,11 @@ void MainWindow::onAddAddress()
 
 void MainWindow::onEditAddress()
 {
-    auto currentItem = ui->addressListWidget->currentItem();
-    if (!currentItem || m_currentListId == -1) return;
-    
-    int addressId = currentItem->data(Qt::UserRole).toInt();
-    
-    // Find the current address
-    auto addresses = Database::instance().getAddressesForList(m_currentListId);
-    Address currentAddress;
-    bool found = false;
-    
-    for (const auto& addr : addresses) {
-        if (addr.getId() == addressId) {
-            currentAddress = addr;
-            found = true;
-            break;
-        }
-    }
+    int addressId = currentAddressId();
+    if (addressId == -1 || m_currentListId == -1) return;
     
-    if (!found) {
+    Address currentAddress = Database::instance().getAddress(addressId);
+    if (currentAddress.getId() != addressId) {
         QMessageBox::warning(this, "Error", "Address not found");
         return;
     }
@@ -270,27 +289,21 @@ void MainWindow::onEditAddress()
         updatedAddress.setId(addressId);
         
         if (Database::instance().updateAddress(updatedAddress)) {
-            QString displayText = QString("%1, %2, %3")
-                .arg(updatedAddress.getStreet())
-                .arg(updatedAddress.getCity())
-                .arg(updatedAddress.getState());
+            QString displayText = AddressListModel::displayText(updatedAddress);
+            m_addressModel->updateAddress(updatedAddress);
             
-            currentItem->setText(displayText);
+            // Moving or retitling a marker is a single update on the page
+            if (updatedAddress.hasCoordinates()) {
+                m_mapWidget->addMarker(addressId, 
+                    updatedAddress.getLatitude(), updatedAddress.getLongitude(), displayText);
+            } else {
+                m_mapWidget->removeMarker(addressId);
+            }
             
-            if (m_mapWidget->getCurrentProvider()) {
-                m_mapWidget->getCurrentProvider()->removeMarker(addressId);
-                
-                if (updatedAddress.hasCoordinates()) {
-                    m_mapWidget->getCurrentProvider()->addMarker(addressId, 
-                        updatedAddress.getLatitude(), updatedAddress.getLongitude(), displayText);
-                }
-                
-                // Refit map to show all markers after update
-                auto addresses = Database::instance().getAddressesForList(m_currentListId);
-                if (!addresses.isEmpty()) {
-                    m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-                }
-                m_mapWidget->loadMap();
+            // Refit map to show all markers after update
+            auto addresses = Database::instance().getAddressesForList(m_currentListId);
+            if (!addresses.isEmpty()) {
+                m_mapWidget->fitToAddresses(addresses);
             }
             
             ui->statusbar->showMessage("Address updated", 2000);
@@ -302,10 +315,8 @@ void MainWindow::onEditAddress()
 
 void MainWindow::onDeleteAddress()
 {
-    auto currentItem = ui->addressListWidget->currentItem();
-    if (!currentItem) return;
-    
-    int addressId = currentItem->data(Qt::UserRole).toInt();
+    int addressId = currentAddressId();
+    if (addressId == -1) return;
     
     auto reply = QMessageBox::question(this, "Delete Address",
         "Are you sure you want to delete this address?",
@@ -313,17 +324,14 @@ void MainWindow::onDeleteAddress()
     
     if (reply == QMessageBox::Yes) {
         if (Database::instance().deleteAddress(addressId)) {
-            if (m_mapWidget->getCurrentProvider()) {
-                m_mapWidget->getCurrentProvider()->removeMarker(addressId);
-                
-                // Refit map to show remaining markers after deletion
-                auto addresses = Database::instance().getAddressesForList(m_currentListId);
-                if (!addresses.isEmpty()) {
-                    m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-                }
-                m_mapWidget->loadMap();
+            m_mapWidget->removeMarker(addressId);
+            
+            // Refit map to show remaining markers after deletion
+            auto addresses = Database::instance().getAddressesForList(m_currentListId);
+            if (!addresses.isEmpty()) {
+                m_mapWidget->fitToAddresses(addresses);
             }
-            delete currentItem;
+            m_addressModel->removeAddress(addressId);
             ui->detailsLabel->setText("Select an address to view details");
             ui->statusbar->showMessage("Address deleted", 2000);
         } else {
@@ -378,6 +386,9 @@ void MainWindow::onDeleteList()
         QMessageBox::Yes | QMessageBox::No);
     
     if (reply == QMessageBox::Yes) {
+        if (m_batchGeocoder->getListId() == m_currentListId) {
+            m_batchGeocoder->cancel();
+        }
         if (Database::instance().deleteList(m_currentListId)) {
             ui->listComboBox->removeItem(ui->listComboBox->currentIndex());
             ui->statusbar->showMessage("List deleted", 2000);
@@ -389,16 +400,16 @@ void MainWindow::onDeleteList()
 
 void MainWindow::onListChanged(int index)
 {
+    // A plan still being optimized belongs to the previous list
+    m_routePlanGeneration++;
     if (index >= 0) {
         m_currentListId = ui->listComboBox->itemData(index).toInt();
         loadAddresses(m_currentListId);
     } else {
         m_currentListId = -1;
-        ui->addressListWidget->clear();
+        m_addressModel->clear();
         ui->detailsLabel->setText("Select an address to view details");
-        if (m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->clearMarkers();
-        }
+        m_mapWidget->clearMarkers();
     }
     updateAddressButtons();
     updateListButtons();
@@ -408,37 +419,31 @@ void MainWindow::onAddressSelected()
 {
     updateAddressButtons();
     
-    auto currentItem = ui->addressListWidget->currentItem();
-    if (currentItem) {
-        int addressId = currentItem->data(Qt::UserRole).toInt();
-        
-        // Find the address to get full details
-        auto addresses = Database::instance().getAddressesForList(m_currentListId);
-        for (const auto& address : addresses) {
-            if (address.getId() == addressId) {
-                // Show address details
-                QString details = QString(
-                    "<b>Street:</b> %1<br>"
-                    "<b>City:</b> %2<br>"
-                    "<b>State:</b> %3<br>"
-                    "<b>ZIP:</b> %4<br>"
-                    "<b>Country:</b> %5<br>"
-                    "<b>Coordinates:</b> %6, %7"
-                ).arg(address.getStreet())
-                 .arg(address.getCity())
-                 .arg(address.getState())
-                 .arg(address.getZip())
-                 .arg(address.getCountry())
-                 .arg(address.getLatitude(), 0, 'f', 6)
-                 .arg(address.getLongitude(), 0, 'f', 6);
-                
-                ui->detailsLabel->setText(details);
-                
-                // Highlight marker on map with auto-refresh
-                if (m_mapWidget && address.hasCoordinates()) {
-                    m_mapWidget->highlightMarker(addressId);
-                }
-                break;
+    int addressId = currentAddressId();
+    if (addressId != -1) {
+        Address address = Database::instance().getAddress(addressId);
+        if (address.getId() == addressId) {
+            // Show address details
+            QString details = QString(
+                "<b>Street:</b> %1<br>"
+                "<b>City:</b> %2<br>"
+                "<b>State:</b> %3<br>"
+                "<b>ZIP:</b> %4<br>"
+                "<b>Country:</b> %5<br>"
+                "<b>Coordinates:</b> %6, %7"
+            ).arg(address.getStreet())
+             .arg(address.getCity())
+             .arg(address.getState())
+             .arg(address.getZip())
+             .arg(address.getCountry())
+             .arg(address.getLatitude(), 0, 'f', 6)
+             .arg(address.getLongitude(), 0, 'f', 6);
+            
+            ui->detailsLabel->setText(details);
+            
+            // Highlight marker on map with auto-refresh
+            if (m_mapWidget && address.hasCoordinates()) {
+                m_mapWidget->highlightMarker(addressId);
             }
         }
     } else {
@@ -448,20 +453,71 @@ void MainWindow::onAddressSelected()
 
 void MainWindow::onSearchTextChanged(const QString& text)
 {
-    for (int i = 0; i < ui->addressListWidget->count(); ++i) {
-        auto item = ui->addressListWidget->item(i);
-        bool matches = text.isEmpty() || item->text().contains(text, Qt::CaseInsensitive);
-        item->setHidden(!matches);
+    if (text.trimmed().isEmpty()) {
+        m_searchTimer->stop();
+        runSearch();
+    } else {
+        m_searchTimer->start();
+    }
+}
+
+void MainWindow::runSearch()
+{
+    TRACE_SCOPE("ui", "MainWindow::runSearch");
+    QString text = ui->searchLineEdit->text().trimmed();
+    if (text.isEmpty()) {
+        m_searchHits.clear();
+        m_addressModel->setFilterText(QString());
+        return;
+    }
+    
+    // The current list is filtered to every hit; the ranked hits across all
+    // lists are kept so Enter can jump to the best one
+    if (m_currentListId != -1) {
+        m_addressModel->setFilterIds(Database::instance().searchAddressIds(text, m_currentListId));
+    }
+    m_searchHits = Database::instance().searchAddresses(text, 20);
+    
+    int otherLists = 0;
+    for (const AddressSearchHit& hit : m_searchHits) {
+        if (hit.listId != m_currentListId) otherLists++;
+    }
+    QString message = QString("%1 matching addresses in this list").arg(m_addressModel->rowCount());
+    if (otherLists > 0) {
+        message += QString(", more in other lists (press Enter for the best match)");
+    }
+    ui->statusbar->showMessage(message, 3000);
+}
+
+void MainWindow::onSearchSubmitted()
+{
+    if (m_searchTimer->isActive()) {
+        m_searchTimer->stop();
+        runSearch();
+    }
+    if (m_searchHits.isEmpty()) return;
+    
+    const AddressSearchHit best = m_searchHits.first();
+    if (best.listId != m_currentListId) {
+        int index = ui->listComboBox->findData(best.listId);
+        if (index < 0) return;
+        ui->listComboBox->setCurrentIndex(index);
+    }
+    
+    int row = m_addressModel->rowForAddressId(best.address.getId());
+    if (row >= 0) {
+        QModelIndex index = m_addressModel->index(row);
+        ui->addressListView->setCurrentIndex(index);
+        ui->addressListView->scrollTo(index);
     }
 }
 
 void MainWindow::onFitAllMarkers()
 {
-    if (m_currentListId != -1 && m_mapWidget->getCurrentProvider()) {
+    if (m_currentListId != -1 && m_mapWidget) {
         auto addresses = Database::instance().getAddressesForList(m_currentListId);
         if (!addresses.isEmpty()) {
-            m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-            m_mapWidget->loadMap();
+            m_mapWidget->fitToAddresses(addresses);
             ui->statusbar->showMessage("Fitted all markers", 1000);
         } else {
             ui->statusbar->showMessage("No addresses to fit", 2000);
@@ -493,86 +549,198 @@ void MainWindow::onImport()
         return;
     }
     
+    if (m_importThread) {
+        ui->statusbar->showMessage("An import is already running", 2000);
+        return;
+    }
+    
     QString fileName = QFileDialog::getOpenFileName(this, "Import Addresses", "", "CSV Files (*.csv)");
     if (fileName.isEmpty()) {
         return;
     }
     
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "Import Error", 
-            "Could not open file: " + file.errorString());
+    m_importListId = m_currentListId;
+    m_importedCount = 0;
+    m_importErrorCount = 0;
+    
+    // Parse on a worker thread; batches come back here and are inserted
+    // through the database connection owned by the GUI thread
+    m_importThread = new QThread(this);
+    m_importWorker = new CsvImportWorker(fileName);
+    m_importWorker->moveToThread(m_importThread);
+    
+    m_importProgress = new QProgressDialog("Importing addresses...", "Cancel", 0, 1000, this);
+    m_importProgress->setWindowTitle("Import Addresses");
+    m_importProgress->setWindowModality(Qt::WindowModal);
+    m_importProgress->setMinimumDuration(500);
+    m_importProgress->setAutoClose(false);
+    m_importProgress->setAutoReset(false);
+    m_importProgress->setValue(0);
+    
+    connect(m_importThread, &QThread::started, m_importWorker, &CsvImportWorker::run);
+    connect(m_importWorker, &CsvImportWorker::batchReady, this, &MainWindow::onImportBatchReady);
+    connect(m_importWorker, &CsvImportWorker::progress, this, &MainWindow::onImportProgress);
+    connect(m_importWorker, &CsvImportWorker::finished, this, &MainWindow::onImportFinished);
+    connect(m_importWorker, &CsvImportWorker::failed, this, &MainWindow::onImportFailed);
+    connect(m_importProgress, &QProgressDialog::canceled, this, [this]() {
+        if (m_importWorker) {
+            m_importWorker->cancel();
+        }
+    });
+    
+    ui->actionImport->setEnabled(false);
+    m_importThread->start();
+}
+
+void MainWindow::onImportBatchReady(const QList<Address>& addresses)
+{
+    TRACE_SCOPE("ui", "MainWindow::onImportBatchReady");
+    // Rows queued before a cancel request are dropped
+    if (!m_importWorker || m_importWorker->isCancelled()) {
         return;
     }
     
-    QTextStream in(&file);
-    int importedCount = 0;
-    int errorCount = 0;
-    bool isFirstLine = true;
-    
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        
-        // Skip header line if it looks like a header
-        if (isFirstLine) {
-            isFirstLine = false;
-            if (line.toLower().contains("street") || line.toLower().contains("address")) {
-                continue;
-            }
-        }
-        
-        if (line.isEmpty()) {
-            continue;
-        }
-        
-        // Parse CSV line (format: street, city, state, zip, country, latitude, longitude)
-        QStringList parts = line.split(',');
-        
-        if (parts.size() < 5) {
-            errorCount++;
-            continue;
-        }
-        
-        Address address;
-        address.setStreet(parts[0].trimmed());
-        address.setCity(parts[1].trimmed());
-        address.setState(parts[2].trimmed());
-        address.setZip(parts[3].trimmed());
-        address.setCountry(parts[4].trimmed());
-        
-        // Optional latitude and longitude
-        if (parts.size() >= 7) {
-            bool latOk, lngOk;
-            double lat = parts[5].trimmed().toDouble(&latOk);
-            double lng = parts[6].trimmed().toDouble(&lngOk);
-            if (latOk && lngOk) {
-                address.setLatitude(lat);
-                address.setLongitude(lng);
-            }
-        }
-        
-        int addressId = Database::instance().addAddress(m_currentListId, address);
+    QList<int> addressIds = Database::instance().addAddresses(m_importListId, addresses);
+    for (int addressId : addressIds) {
         if (addressId > 0) {
-            importedCount++;
+            m_importedCount++;
         } else {
-            errorCount++;
+            m_importErrorCount++;
         }
     }
-    
-    file.close();
+}
+
+void MainWindow::onImportProgress(qint64 bytesRead, qint64 totalBytes)
+{
+    if (m_importProgress && totalBytes > 0) {
+        m_importProgress->setValue(int(bytesRead * 1000 / totalBytes));
+    }
+}
+
+void MainWindow::onImportFinished(int parsedCount, int errorCount, bool cancelled)
+{
+    Q_UNUSED(parsedCount);
+    m_importErrorCount += errorCount;
+    int listId = m_importListId;
+    stopImport();
     
     // Reload addresses to display imported ones
-    loadAddresses(m_currentListId);
+    if (listId == m_currentListId) {
+        loadAddresses(m_currentListId);
+    }
+    
+    QString message = QString("Import %1: %2 addresses imported")
+        .arg(cancelled ? "cancelled" : "complete")
+        .arg(m_importedCount);
+    if (m_importErrorCount > 0) {
+        message += QString(", %1 errors").arg(m_importErrorCount);
+    }
+    
+    QMessageBox::information(this, cancelled ? "Import Cancelled" : "Import Complete", message);
+    ui->statusbar->showMessage(message, 5000);
+}
+
+void MainWindow::onGeocodeMissing()
+{
+    if (m_batchGeocoder->isRunning()) {
+        m_batchGeocoder->cancel();
+        return;
+    }
     
-    QString message = QString("Import complete: %1 addresses imported").arg(importedCount);
-    if (errorCount > 0) {
-        message += QString(", %1 errors").arg(errorCount);
+    if (m_currentListId == -1) return;
+    
+    if (!m_batchGeocoder->start(m_currentListId)) {
+        QMessageBox::information(this, "Geocode Addresses",
+            "All addresses in this list already have coordinates.");
+        return;
     }
     
-    QMessageBox::information(this, "Import Complete", message);
+    ui->actionGeocodeMissing->setText("Stop &Geocoding");
+}
+
+void MainWindow::onBatchGeocodeProgress(int processed, int total)
+{
+    ui->statusbar->showMessage(QString("Geocoding addresses: %1 of %2 (stop from the Edit menu)")
+        .arg(processed).arg(total), 0);
+}
+
+void MainWindow::onBatchAddressGeocoded(const Address& address)
+{
+    if (m_batchGeocoder->getListId() != m_currentListId || !m_mapWidget) return;
+    
+    QString displayText = AddressListModel::displayText(address);
+    m_mapWidget->addMarker(address.getId(), address.getLatitude(), address.getLongitude(), displayText);
+}
+
+void MainWindow::onBatchGeocodeFinished(int geocoded, int failed, bool cancelled)
+{
+    ui->actionGeocodeMissing->setText("&Geocode Missing Coordinates");
+    
+    QString message = QString("Geocoding %1: %2 addresses geocoded")
+        .arg(cancelled ? "stopped" : "complete")
+        .arg(geocoded);
+    if (failed > 0) {
+        message += QString(", %1 not found").arg(failed);
+    }
+    if (cancelled) {
+        message += "; it can be resumed later";
+    }
     ui->statusbar->showMessage(message, 5000);
 }
 
+void MainWindow::offerGeocodeResume()
+{
+    QList<int> listIds = Database::instance().getPendingGeocodeJobs();
+    if (listIds.isEmpty() || m_batchGeocoder->isRunning()) return;
+    
+    // Only one job runs at a time; offer the most recent one
+    int listId = listIds.first();
+    int total = 0;
+    int processed = 0;
+    int failed = 0;
+    Database::instance().loadGeocodeJob(listId, total, processed, failed);
+    AddressList list = Database::instance().getList(listId);
+    
+    auto reply = QMessageBox::question(this, "Resume Geocoding",
+        QString("Geocoding of list \"%1\" stopped after %2 of %3 addresses. Resume it now?")
+            .arg(list.getName()).arg(processed).arg(total));
+    
+    if (reply == QMessageBox::Yes) {
+        if (m_batchGeocoder->resume(listId)) {
+            ui->actionGeocodeMissing->setText("Stop &Geocoding");
+        }
+    } else {
+        Database::instance().clearGeocodeJob(listId, false);
+    }
+}
+
+void MainWindow::onImportFailed(const QString& error)
+{
+    stopImport();
+    QMessageBox::warning(this, "Import Error", error);
+}
+
+void MainWindow::stopImport()
+{
+    if (m_importWorker) {
+        m_importWorker->cancel();
+    }
+    if (m_importThread) {
+        m_importThread->quit();
+        m_importThread->wait();
+        delete m_importWorker;
+        m_importThread->deleteLater();
+    }
+    if (m_importProgress) {
+        m_importProgress->hide();
+        m_importProgress->deleteLater();
+    }
+    m_importThread = nullptr;
+    m_importWorker = nullptr;
+    m_importProgress = nullptr;
+    ui->actionImport->setEnabled(true);
+}
+
 void MainWindow::onExport()
 {
     if (m_currentListId == -1) {
@@ -600,21 +768,10 @@ void MainWindow::onExport()
         return;
     }
     
-    QTextStream out(&file);
-    
-    // Write header
-    out << "Street,City,State,ZIP,Country,Latitude,Longitude\n";
-    
-    // Write addresses
-    for (const auto& address : addresses) {
-        out << QString("\"%1\",\"%2\",\"%3\",\"%4\",\"%5\",%6,%7\n")
-            .arg(address.getStreet())
-            .arg(address.getCity())
-            .arg(address.getState())
-            .arg(address.getZip())
-            .arg(address.getCountry())
-            .arg(address.getLatitude(), 0, 'f', 6)
-            .arg(address.getLongitude(), 0, 'f', 6);
+    if (!CsvWriter::writeAddresses(&file, addresses)) {
+        QMessageBox::warning(this, "Export Error",
+            "Could not write file: " + file.errorString());
+        return;
     }
     
     file.close();
@@ -658,9 +815,23 @@ void MainWindow::applySettings()
     
     ui->mapProviderComboBox->blockSignals(false);
     
+    // Apply marker clustering
+    if (m_mapWidget) {
+        m_mapWidget->setClusteringEnabled(settings.value("Map/ClusterMarkers", false).toBool());
+    }
+    
+    // Apply routing backend
+    if (m_routingService) {
+        applyRoutingSettings(settings);
+    }
+    
     // Apply log level
     int logLevel = settings.value("General/LogLevel", 1).toInt();
     Logger::instance().setLogLevel(static_cast<Logger::Level>(logLevel));
+    Logger::instance().setRotation(
+        settings.value("General/LogMaxSizeMB", 10).toLongLong() * 1024 * 1024,
+        settings.value("General/LogMaxAgeDays", 7).toLongLong() * 24 * 3600,
+        settings.value("General/LogArchives", 5).toInt());
     
     // Setup map provider selector connection after setting initial value
     static bool connected = false;
@@ -677,14 +848,72 @@ void MainWindow::applySettings()
     }
 }
 
-void MainWindow::onMapMarkerClicked(int markerId)
+void MainWindow::applyRoutingSettings(QSettings& settings)
 {
-    for (int i = 0; i < ui->addressListWidget->count(); ++i) {
-        auto item = ui->addressListWidget->item(i);
-        if (item->data(Qt::UserRole).toInt() == markerId) {
-            ui->addressListWidget->setCurrentItem(item);
-            break;
+    QString backend = settings.value("Routing/Backend", "osrm").toString();
+    if (backend == "local") {
+        QString graphPath = settings.value("Routing/RoadGraphPath", "").toString();
+        auto* current = qobject_cast<LocalRoutingBackend*>(m_routingService->getBackend());
+        if (current && current->getGraphPath() == graphPath) {
+            return;
         }
+        if (m_loadingGraphPath != graphPath) {
+            loadRoadGraph(graphPath);
+        }
+        // Routes keep using the current backend until the graph is ready
+        return;
+    }
+
+    m_loadingGraphPath.clear();
+    useOsrmBackend(settings.value("Routing/OsrmServer", "").toString());
+}
+
+void MainWindow::loadRoadGraph(const QString& graphPath)
+{
+    // Reading and indexing a regional graph takes seconds, so it is done
+    // off the GUI thread
+    m_loadingGraphPath = graphPath;
+    auto* local = new LocalRoutingBackend(this);
+    connect(local, &LocalRoutingBackend::graphLoaded, this, [this, local, graphPath](bool loaded) {
+        // Another backend was chosen while the graph was loading
+        if (m_loadingGraphPath != graphPath) {
+            local->deleteLater();
+            return;
+        }
+        m_loadingGraphPath.clear();
+
+        if (loaded) {
+            m_routingService->setBackend(local);
+            LOG_INFO("Routing offline with road graph " + graphPath);
+            ui->statusbar->showMessage("Offline routing ready", 3000);
+            return;
+        }
+        ui->statusbar->showMessage("Offline routing unavailable, using OSRM: " + local->getLastError(), 5000);
+        local->deleteLater();
+        QSettings settings("DataInquiry", "MapAddress");
+        useOsrmBackend(settings.value("Routing/OsrmServer", "").toString());
+    });
+    local->loadGraphAsync(graphPath);
+    ui->statusbar->showMessage("Loading road graph " + graphPath + "...");
+}
+
+void MainWindow::useOsrmBackend(const QString& serverUrl)
+{
+    auto* osrm = qobject_cast<OsrmRoutingBackend*>(m_routingService->getBackend());
+    if (!osrm) {
+        osrm = new OsrmRoutingBackend();
+        m_routingService->setBackend(osrm);
+    }
+    osrm->setServerUrl(serverUrl);
+}
+
+void MainWindow::onMapMarkerClicked(int markerId)
+{
+    int row = m_addressModel->rowForAddressId(markerId);
+    if (row >= 0) {
+        QModelIndex index = m_addressModel->index(row);
+        ui->addressListView->setCurrentIndex(index);
+        ui->addressListView->scrollTo(index);
     }
 }
 
@@ -712,9 +941,8 @@ void MainWindow::onMapClicked(double latitude, double longitude)
         m_mapClickStartAddr = tempAddr;
         
         // Add marker on map
-        if (m_mapWidget && m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->addMarker(-100, latitude, longitude, "Start Point");
-            m_mapWidget->loadMap();
+        if (m_mapWidget) {
+            m_mapWidget->addMarker(-100, latitude, longitude, "Start Point");
         }
         
         saveRouteInfo();
@@ -737,9 +965,8 @@ void MainWindow::onMapClicked(double latitude, double longitude)
         m_mapClickEndAddr = tempAddr;
         
         // Add marker on map
-        if (m_mapWidget && m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->addMarker(-200, latitude, longitude, "End Point");
-            m_mapWidget->loadMap();
+        if (m_mapWidget) {
+            m_mapWidget->addMarker(-200, latitude, longitude, "End Point");
         }
         
         saveRouteInfo();
@@ -763,10 +990,10 @@ void MainWindow::onMapClicked(double latitude, double longitude)
 
 void MainWindow::onShowAddressContextMenu(const QPoint& pos)
 {
-    auto item = ui->addressListWidget->itemAt(pos);
-    if (!item) return;
+    QModelIndex index = ui->addressListView->indexAt(pos);
+    if (!index.isValid()) return;
     
-    int addressId = item->data(Qt::UserRole).toInt();
+    int addressId = index.data(AddressListModel::AddressIdRole).toInt();
     
     QMenu contextMenu(this);
     
@@ -789,7 +1016,7 @@ void MainWindow::onShowAddressContextMenu(const QPoint& pos)
     
     clearRouteAction->setEnabled(m_routeStartId != -1 || m_routeEndId != -1 || m_mapWidget);
     
-    QAction* selectedAction = contextMenu.exec(ui->addressListWidget->mapToGlobal(pos));
+    QAction* selectedAction = contextMenu.exec(ui->addressListView->viewport()->mapToGlobal(pos));
     
     if (selectedAction == setStartAction) {
         m_routeStartId = addressId;
@@ -834,15 +1061,17 @@ void MainWindow::onSetEndPoint()
 
 void MainWindow::onClearRoute()
 {
+    // Drop a plan still being optimized
+    m_routePlanGeneration++;
     m_routeStartId = -1;
     m_routeEndId = -1;
     
     // Clear map-clicked points
-    if (m_mapClickStartAddr.hasCoordinates() && m_mapWidget && m_mapWidget->getCurrentProvider()) {
-        m_mapWidget->getCurrentProvider()->removeMarker(-100);
+    if (m_mapClickStartAddr.hasCoordinates() && m_mapWidget) {
+        m_mapWidget->removeMarker(-100);
     }
-    if (m_mapClickEndAddr.hasCoordinates() && m_mapWidget && m_mapWidget->getCurrentProvider()) {
-        m_mapWidget->getCurrentProvider()->removeMarker(-200);
+    if (m_mapClickEndAddr.hasCoordinates() && m_mapWidget) {
+        m_mapWidget->removeMarker(-200);
     }
     
     m_mapClickStartAddr = Address();
@@ -850,7 +1079,6 @@ void MainWindow::onClearRoute()
     
     if (m_mapWidget) {
         m_mapWidget->clearRoute();
-        m_mapWidget->loadMap();
     }
     
     updateAddressListDisplay();
@@ -865,24 +1093,14 @@ void MainWindow::onClearRoute()
 
 void MainWindow::updateAddressListDisplay()
 {
-    // Update display to show start/end indicators
-    for (int i = 0; i < ui->addressListWidget->count(); ++i) {
-        auto item = ui->addressListWidget->item(i);
-        int addressId = item->data(Qt::UserRole).toInt();
-        QString text = item->text();
-        
-        // Remove existing markers
-        text.remove(QRegularExpression("^[🚩🏁] "));
-        
-        // Add markers
-        if (addressId == m_routeStartId) {
-            text = "🚩 " + text;
-        } else if (addressId == m_routeEndId) {
-            text = "🏁 " + text;
-        }
-        
-        item->setText(text);
-    }
+    // Start/end indicators are drawn by the model; only changed rows repaint
+    m_addressModel->setRouteEndpoints(m_routeStartId, m_routeEndId);
+}
+
+int MainWindow::currentAddressId() const
+{
+    QModelIndex index = ui->addressListView->currentIndex();
+    return index.isValid() ? index.data(AddressListModel::AddressIdRole).toInt() : -1;
 }
 
 void MainWindow::planRoute()
@@ -906,21 +1124,86 @@ void MainWindow::planRoute()
         return;
     }
     
+    // Order the stops locally before asking the routing server
+    int startIndex = -1;
+    int endIndex = -1;
+    for (int i = 0; i < waypoints.size(); ++i) {
+        if (waypoints[i].getId() == m_routeStartId) startIndex = i;
+        if (waypoints[i].getId() == m_routeEndId) endIndex = i;
+    }
+    
+    // Ordering thousands of stops takes up to the optimizer's time budget,
+    // so it runs off the GUI thread
+    int generation = ++m_routePlanGeneration;
+    ui->statusbar->showMessage(QString("Ordering %1 stops...").arg(waypoints.size()), 0);
+    m_optimizerPool.start([this, waypoints, startIndex, endIndex, generation]() {
+        RouteOptimizer optimizer;
+        RouteOptimizationResult optimization = optimizer.optimize(waypoints, startIndex, endIndex);
+        QMetaObject::invokeMethod(this, [this, waypoints, optimization, generation]() {
+            if (generation != m_routePlanGeneration) return;
+            startRoute(waypoints, optimization);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::startRoute(const QList<Address>& stops, const RouteOptimizationResult& optimization)
+{
+    QList<Address> waypoints;
+    waypoints.reserve(stops.size());
+    for (int index : optimization.order) {
+        waypoints.append(stops[index]);
+    }
+    
+    double saved = optimization.savedDistance();
+    double percent = optimization.originalDistance > 0 ? 100.0 * saved / optimization.originalDistance : 0.0;
+    LOG_INFO(QString("Optimized order of %1 stops in %2 ms: %3 km -> %4 km straight-line (%5 improvements%6)")
+        .arg(waypoints.size())
+        .arg(optimization.elapsedMs)
+        .arg(optimization.originalDistance, 0, 'f', 1)
+        .arg(optimization.optimizedDistance, 0, 'f', 1)
+        .arg(optimization.improvements)
+        .arg(optimization.timedOut ? ", time budget reached" : ""));
+    
     // Calculate route through all waypoints
-    ui->statusbar->showMessage(QString("Calculating route through %1 waypoints...").arg(waypoints.size()), 0);
+    ui->statusbar->showMessage(QString("Calculating route through %1 waypoints (reordering saved %2 km, %3%)...")
+        .arg(waypoints.size())
+        .arg(saved, 0, 'f', 1)
+        .arg(percent, 0, 'f', 0), 0);
     m_routingService->calculateRoute(waypoints);
 }
 
-void MainWindow::onRouteCalculated(const QList<QPointF>& routePoints)
+void MainWindow::onRouteCalculated(const RouteResult& route)
 {
-    if (routePoints.isEmpty()) return;
+    if (route.points.isEmpty()) return;
     
     // Display route on map
     if (m_mapWidget) {
-        m_mapWidget->showRoutePolyline(routePoints);
+        m_mapWidget->showRoutePolyline(route.points);
+    }
+    
+    for (int i = 0; i < route.legs.size(); ++i) {
+        LOG_DEBUG(QString("Route leg %1: %2 km, %3 min")
+            .arg(i + 1)
+            .arg(route.legs[i].distanceKm, 0, 'f', 2)
+            .arg(route.legs[i].durationSeconds / 60.0, 0, 'f', 1));
     }
     
-    ui->statusbar->showMessage(QString("Route calculated (%1 km)").arg(routePoints.size() * 0.1, 0, 'f', 1), 3000);
+    QString message = QString("Route calculated (%1 km").arg(route.distanceKm, 0, 'f', 1);
+    if (route.durationSeconds > 0.0) {
+        int minutes = qRound(route.durationSeconds / 60.0);
+        message += minutes >= 60
+            ? QString(", %1 h %2 min").arg(minutes / 60).arg(minutes % 60, 2, 10, QChar('0'))
+            : QString(", %1 min").arg(minutes);
+    }
+    ui->statusbar->showMessage(message + ")", 3000);
+}
+
+void MainWindow::onRouteProgress(int completedSegments, int totalSegments)
+{
+    if (totalSegments < 2) return;
+    
+    ui->statusbar->showMessage(QString("Calculating route: %1 of %2 segments done...")
+        .arg(completedSegments).arg(totalSegments), 0);
 }
 
 void MainWindow::onRouteFailed(const QString& error)
@@ -967,15 +1250,16 @@ void MainWindow::loadRouteInfo(int listId)
     m_mapClickEndAddr = Address();
     
     // Load from database
-    if (Database::instance().loadRouteInfo(listId, m_routeStartId, m_routeEndId,
-                                          m_mapClickStartAddr, m_mapClickEndAddr)) {
-        
-        // Restore address-based start/end markers
-        updateAddressListDisplay();
-        
+    bool loaded = Database::instance().loadRouteInfo(listId, m_routeStartId, m_routeEndId,
+                                                     m_mapClickStartAddr, m_mapClickEndAddr);
+    
+    // Restore address-based start/end markers, or drop the previous list's
+    updateAddressListDisplay();
+    
+    if (loaded) {
         // Restore map-clicked markers
-        if (m_mapClickStartAddr.hasCoordinates() && m_mapWidget && m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->addMarker(
+        if (m_mapClickStartAddr.hasCoordinates() && m_mapWidget) {
+            m_mapWidget->addMarker(
                 -100,
                 m_mapClickStartAddr.getLatitude(),
                 m_mapClickStartAddr.getLongitude(),
@@ -983,19 +1267,14 @@ void MainWindow::loadRouteInfo(int listId)
             );
         }
         
-        if (m_mapClickEndAddr.hasCoordinates() && m_mapWidget && m_mapWidget->getCurrentProvider()) {
-            m_mapWidget->getCurrentProvider()->addMarker(
+        if (m_mapClickEndAddr.hasCoordinates() && m_mapWidget) {
+            m_mapWidget->addMarker(
                 -200,
                 m_mapClickEndAddr.getLatitude(),
                 m_mapClickEndAddr.getLongitude(),
                 m_mapClickEndAddr.getStreet()
             );
         }
-        
-        // Reload map to show restored markers
-        if (m_mapWidget) {
-            m_mapWidget->loadMap();
-        }
     }
 }
 
@@ -1031,22 +1310,16 @@ void MainWindow::onReverseGeocodeCompleted(const QString& street, const QString&
         if (addressId > 0) {
             finalAddress.setId(addressId);
             
-            QString displayText = QString("%1, %2, %3")
-                .arg(finalAddress.getStreet())
-                .arg(finalAddress.getCity())
-                .arg(finalAddress.getState());
-            
-            auto item = new QListWidgetItem(displayText, ui->addressListWidget);
-            item->setData(Qt::UserRole, addressId);
+            QString displayText = AddressListModel::displayText(finalAddress);
+            m_addressModel->addAddress(finalAddress);
             
-            if (finalAddress.hasCoordinates() && m_mapWidget->getCurrentProvider()) {
-                m_mapWidget->getCurrentProvider()->addMarker(addressId, 
+            if (finalAddress.hasCoordinates()) {
+                m_mapWidget->addMarker(addressId, 
                     finalAddress.getLatitude(), finalAddress.getLongitude(), displayText);
                 
                 // Refit map to show all markers including the new one
                 auto addresses = Database::instance().getAddressesForList(m_currentListId);
-                m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-                m_mapWidget->loadMap();
+                m_mapWidget->fitToAddresses(addresses);
             }
             
             ui->statusbar->showMessage("Address added from map location", 2000);
@@ -1086,22 +1359,16 @@ void MainWindow::onReverseGeocodeFailed(const QString& error)
         if (addressId > 0) {
             finalAddress.setId(addressId);
             
-            QString displayText = QString("%1, %2, %3")
-                .arg(finalAddress.getStreet())
-                .arg(finalAddress.getCity())
-                .arg(finalAddress.getState());
-            
-            auto item = new QListWidgetItem(displayText, ui->addressListWidget);
-            item->setData(Qt::UserRole, addressId);
+            QString displayText = AddressListModel::displayText(finalAddress);
+            m_addressModel->addAddress(finalAddress);
             
-            if (finalAddress.hasCoordinates() && m_mapWidget->getCurrentProvider()) {
-                m_mapWidget->getCurrentProvider()->addMarker(addressId, 
+            if (finalAddress.hasCoordinates()) {
+                m_mapWidget->addMarker(addressId, 
                     finalAddress.getLatitude(), finalAddress.getLongitude(), displayText);
                 
                 // Refit map to show all markers including the new one
                 auto addresses = Database::instance().getAddressesForList(m_currentListId);
-                m_mapWidget->getCurrentProvider()->fitBounds(addresses);
-                m_mapWidget->loadMap();
+                m_mapWidget->fitToAddresses(addresses);
             }
             
             ui->statusbar->showMessage("Address added from map location", 2000);
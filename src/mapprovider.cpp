@@ -0,0 +1,134 @@
+#include "mapprovider.h"
+#include <QByteArray>
+
+void MapProvider::addMarker(int id, double latitude, double longitude, const QString& title) {
+    int titleIndex = internTitle(title);
+    auto it = m_markerIndex.constFind(id);
+    if (it != m_markerIndex.constEnd()) {
+        MapMarker& marker = m_markers[it.value()];
+        releaseTitle(marker.title);
+        marker.latitude = latitude;
+        marker.longitude = longitude;
+        marker.title = titleIndex;
+        return;
+    }
+
+    m_markerIndex.insert(id, m_markers.size());
+    m_markers.append(MapMarker{id, latitude, longitude, titleIndex});
+}
+
+void MapProvider::removeMarker(int id) {
+    auto it = m_markerIndex.find(id);
+    if (it == m_markerIndex.end()) return;
+
+    int position = it.value();
+    m_markerIndex.erase(it);
+    releaseTitle(m_markers[position].title);
+
+    int last = m_markers.size() - 1;
+    if (position != last) {
+        m_markers[position] = m_markers[last];
+        m_markerIndex[m_markers[position].id] = position;
+    }
+    m_markers.removeLast();
+}
+
+void MapProvider::clearMarkers() {
+    m_markers.clear();
+    m_markerIndex.clear();
+    m_titles.clear();
+    m_titleRefs.clear();
+    m_freeTitles.clear();
+    m_titleLookup.clear();
+}
+
+void MapProvider::copyMarkers(const MapProvider& other) {
+    m_markers = other.m_markers;
+    m_markerIndex = other.m_markerIndex;
+    m_titles = other.m_titles;
+    m_titleRefs = other.m_titleRefs;
+    m_freeTitles = other.m_freeTitles;
+    m_titleLookup = other.m_titleLookup;
+}
+
+int MapProvider::internTitle(const QString& title) {
+    auto it = m_titleLookup.constFind(title);
+    if (it != m_titleLookup.constEnd()) {
+        m_titleRefs[it.value()]++;
+        return it.value();
+    }
+
+    int index;
+    if (!m_freeTitles.isEmpty()) {
+        index = m_freeTitles.takeLast();
+        m_titles[index] = title;
+        m_titleRefs[index] = 1;
+    } else {
+        index = m_titles.size();
+        m_titles.append(title);
+        m_titleRefs.append(1);
+    }
+    m_titleLookup.insert(title, index);
+    return index;
+}
+
+void MapProvider::releaseTitle(int index) {
+    if (--m_titleRefs[index] > 0) return;
+
+    m_titleLookup.remove(m_titles[index]);
+    m_titles[index].clear();
+    m_freeTitles.append(index);
+}
+
+MarkerPayload MapProvider::packMarkers(const QVector<int>& ids) const {
+    QVector<int> positions;
+    positions.reserve(ids.size());
+    for (int id : ids) {
+        int position = findMarker(id);
+        if (position >= 0) {
+            positions.append(position);
+        }
+    }
+    return pack(positions);
+}
+
+MarkerPayload MapProvider::packAllMarkers() const {
+    QVector<int> positions(m_markers.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        positions[i] = i;
+    }
+    return pack(positions);
+}
+
+MarkerPayload MapProvider::pack(const QVector<int>& positions) const {
+    const int count = positions.size();
+    QByteArray ids(count * int(sizeof(qint32)), Qt::Uninitialized);
+    QByteArray coords(count * 2 * int(sizeof(double)), Qt::Uninitialized);
+    QByteArray titleIndexes(count * int(sizeof(qint32)), Qt::Uninitialized);
+    qint32* idOut = reinterpret_cast<qint32*>(ids.data());
+    double* coordOut = reinterpret_cast<double*>(coords.data());
+    qint32* titleOut = reinterpret_cast<qint32*>(titleIndexes.data());
+
+    // Titles are renumbered so the payload only carries the ones it uses
+    MarkerPayload payload;
+    QHash<int, int> localTitles;
+    for (int i = 0; i < count; ++i) {
+        const MapMarker& marker = m_markers[positions[i]];
+        idOut[i] = marker.id;
+        coordOut[2 * i] = marker.latitude;
+        coordOut[2 * i + 1] = marker.longitude;
+
+        auto it = localTitles.constFind(marker.title);
+        if (it == localTitles.constEnd()) {
+            it = localTitles.insert(marker.title, payload.titles.size());
+            payload.titles.append(m_titles[marker.title]);
+        }
+        titleOut[i] = it.value();
+    }
+
+    payload.count = count;
+    payload.ids = QString::fromLatin1(ids.toBase64());
+    payload.coords = QString::fromLatin1(coords.toBase64());
+    payload.titleIndexes = QString::fromLatin1(titleIndexes.toBase64());
+    return payload;
+}
@@ -6,7 +6,14 @@
 #include <QDebug>
 #include <QSizePolicy>
 #include <QTimer>
+#include <cmath>
 #include "logger.h"
+#include "tracer.h"
+
+namespace {
+// Above this many markers in the viewport the page is sent clusters instead
+const int kMaxViewportMarkers = 5000;
+}
 
 // ConsolePage implementation
 void ConsolePage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel level, const QString &message,
@@ -34,7 +41,22 @@ MapWidget::MapWidget(QWidget* parent)
       m_webView(new QWebEngineView(this)),
       m_currentProvider(nullptr),
       m_bridge(new MapBridge(this)),
-      m_channel(new QWebChannel(this)) {
+      m_channel(new QWebChannel(this)),
+      m_pageReady(false),
+      m_resyncPending(false),
+      m_flushScheduled(false),
+      m_pageLoadStart(0),
+      m_clusteringEnabled(false),
+      m_indexDirty(true),
+      m_showingClusters(false),
+      m_routeGeneration(0),
+      m_routeZoom(-1),
+      m_hasViewport(false),
+      m_viewSouth(0.0),
+      m_viewWest(0.0),
+      m_viewNorth(0.0),
+      m_viewEast(0.0),
+      m_viewZoom(0) {
 
     QVBoxLayout* layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
@@ -73,6 +95,7 @@ MapWidget::MapWidget(QWidget* parent)
     });
     
     setupProviders();
+    m_routePool.setMaxThreadCount(1);
     
     m_channel->registerObject("qtBridge", m_bridge);
     m_webView->page()->setWebChannel(m_channel);
@@ -81,6 +104,10 @@ MapWidget::MapWidget(QWidget* parent)
             this, &MapWidget::markerClicked);
     connect(m_bridge, &MapBridge::mapClickedSignal,
             this, &MapWidget::mapClicked);
+    connect(m_bridge, &MapBridge::pageReadySignal,
+            this, &MapWidget::onPageReady);
+    connect(m_bridge, &MapBridge::viewportChangedSignal,
+            this, &MapWidget::onViewportChanged);
     
     // Load map after a short delay to ensure widget is visible
     QTimer::singleShot(100, this, [this]() {
@@ -89,6 +116,8 @@ MapWidget::MapWidget(QWidget* parent)
 }
 
 MapWidget::~MapWidget() {
+    m_routePool.clear();
+    m_routePool.waitForDone();
 }
 
 void MapWidget::setupProviders() {
@@ -104,16 +133,35 @@ void MapWidget::setupProviders() {
 }
 
 void MapWidget::setMapProvider(MapProvider::ProviderType type) {
+    MapProvider* previous = m_currentProvider;
     if (type == MapProvider::GoogleMaps) {
         m_currentProvider = m_googleMapsProvider;
     } else {
         m_currentProvider = m_osmProvider;
     }
+
+    // The new provider takes over the markers shown so far
+    if (previous && previous != m_currentProvider) {
+        m_indexDirty = true;
+        m_currentProvider->copyMarkers(*previous);
+    }
     loadMap();
 }
 
 void MapWidget::loadMap() {
+    TRACE_SCOPE("map", "MapWidget::loadMap");
     if (m_currentProvider) {
+        // The new page starts empty and asks for its markers once ready, so
+        // nothing queued so far needs to be sent to it
+        m_pageReady = false;
+        m_hasViewport = false;
+        m_resyncPending = false;
+        m_pendingUpserts.clear();
+        m_pendingRemovals.clear();
+        m_pendingViewRequest = nullptr;
+        m_routeZoom = -1;
+        m_pageLoadStart = Tracer::startTime();
+
         QString html = m_currentProvider->getHtml();
         qDebug() << "Loading map HTML, length:" << html.length();
         qDebug() << "WebView size:" << m_webView->size();
@@ -129,20 +177,278 @@ void MapWidget::loadMap() {
         }
         
         // Set base URL to allow loading Qt resources and external content
+        TRACE_SCOPE("map", "QWebEngineView::setHtml");
         m_webView->setHtml(html, QUrl("qrc:///"));
     } else {
         qWarning() << "No current provider set!";
     }
 }
 
-void MapWidget::displayAddresses(const QList<Address>& addresses) {
+void MapWidget::onPageReady() {
+    LOG_DEBUG("Map page ready");
+    Tracer::instance().addAsyncSpan("map", "Map page load", m_pageLoadStart);
+    m_pageLoadStart = 0;
+    m_pageReady = true;
+
+    // The page reports its viewport right after this and gets everything
+    // it shows in reply, including changes made while it was loading
+    m_resyncPending = false;
+    m_pendingUpserts.clear();
+    m_pendingRemovals.clear();
+
+    if (m_pendingViewRequest) {
+        m_pendingViewRequest();
+        m_pendingViewRequest = nullptr;
+    }
+}
+
+void MapWidget::scheduleFlush() {
+    if (!m_pageReady) {
+        m_resyncPending = true;
+        return;
+    }
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, &MapWidget::flushMarkerChanges);
+    }
+}
+
+void MapWidget::requestView(const std::function<void()>& request) {
+    // A view change made while the page loads is applied once it is ready
+    if (m_pageReady) {
+        request();
+    } else {
+        m_pendingViewRequest = request;
+    }
+}
+
+void MapWidget::flushMarkerChanges() {
+    TRACE_SCOPE("map", "MapWidget::flushMarkerChanges");
+    m_flushScheduled = false;
+    if (!m_pageReady || !m_currentProvider) return;
+
+    // Clusters and bulk changes are re-queried for the whole viewport
+    if (m_clusteringEnabled || m_showingClusters || m_resyncPending) {
+        m_resyncPending = false;
+        m_pendingUpserts.clear();
+        m_pendingRemovals.clear();
+        if (m_clusteringEnabled) {
+            sendClusters();
+        } else {
+            sendViewportMarkers();
+        }
+        return;
+    }
+
+    if (m_pendingUpserts.isEmpty() && m_pendingRemovals.isEmpty()) return;
+
+    // The page only holds markers inside its viewport; one that moved out
+    // of it is removed there
+    QVariantList upserts;
+    QVariantList removedIds;
+    upserts.reserve(m_pendingUpserts.size());
+    removedIds.reserve(m_pendingRemovals.size());
+    for (auto it = m_pendingUpserts.constBegin(); it != m_pendingUpserts.constEnd(); ++it) {
+        const QVariantMap& marker = it.value();
+        if (!m_hasViewport || isInViewport(marker["lat"].toDouble(), marker["lng"].toDouble())) {
+            upserts.append(marker);
+        } else {
+            removedIds.append(it.key());
+        }
+    }
+    for (int id : m_pendingRemovals) {
+        removedIds.append(id);
+    }
+
+    m_pendingUpserts.clear();
+    m_pendingRemovals.clear();
+    emit m_bridge->markersChanged(upserts, removedIds);
+}
+
+void MapWidget::addMarker(int id, double latitude, double longitude, const QString& title) {
+    if (!m_currentProvider) return;
+    m_indexDirty = true;
+
+    m_currentProvider->addMarker(id, latitude, longitude, title);
+
+    QVariantMap marker;
+    marker["id"] = id;
+    marker["lat"] = latitude;
+    marker["lng"] = longitude;
+    marker["title"] = title;
+    m_pendingUpserts[id] = marker;
+    m_pendingRemovals.removeAll(id);
+    scheduleFlush();
+}
+
+void MapWidget::removeMarker(int id) {
+    if (!m_currentProvider) return;
+    m_indexDirty = true;
+
+    m_currentProvider->removeMarker(id);
+    m_pendingUpserts.remove(id);
+    if (!m_pendingRemovals.contains(id)) {
+        m_pendingRemovals.append(id);
+    }
+    scheduleFlush();
+}
+
+void MapWidget::clearMarkers() {
     if (!m_currentProvider) return;
+    m_indexDirty = true;
 
     m_currentProvider->clearMarkers();
+    m_resyncPending = true;
+    scheduleFlush();
+}
+
+void MapWidget::setCenter(double latitude, double longitude, int zoom) {
+    if (!m_currentProvider) return;
+
+    m_currentProvider->setCenter(latitude, longitude, zoom);
+    requestView([=]() {
+        emit m_bridge->centerRequested(latitude, longitude, zoom);
+    });
+}
+
+void MapWidget::fitToAddresses(const QList<Address>& addresses) {
+    if (!m_currentProvider) return;
+
+    double south = 90.0, north = -90.0;
+    double west = 180.0, east = -180.0;
+    bool hasPoint = false;
+
+    for (const Address& addr : addresses) {
+        if (!addr.hasCoordinates()) continue;
+        south = qMin(south, addr.getLatitude());
+        north = qMax(north, addr.getLatitude());
+        west = qMin(west, addr.getLongitude());
+        east = qMax(east, addr.getLongitude());
+        hasPoint = true;
+    }
+    if (!hasPoint) return;
+
+    m_currentProvider->fitBounds(addresses);
+    requestView([=]() {
+        emit m_bridge->fitBoundsRequested(south, west, north, east);
+    });
+}
+
+void MapWidget::setClusteringEnabled(bool enabled) {
+    if (m_clusteringEnabled == enabled) return;
+
+    // The page is the same in both modes; only what is streamed changes
+    m_clusteringEnabled = enabled;
+    if (m_clusteringEnabled) {
+        sendClusters();
+    } else {
+        sendViewportMarkers();
+    }
+}
+
+void MapWidget::onViewportChanged(double south, double west, double north, double east, int zoom) {
+    m_hasViewport = true;
+    m_viewSouth = south;
+    m_viewWest = west;
+    m_viewNorth = north;
+    m_viewEast = east;
+    m_viewZoom = zoom;
+
+    if (m_clusteringEnabled) {
+        sendClusters();
+    } else {
+        sendViewportMarkers();
+    }
+
+    // Also restores the route on a page that was just loaded
+    if (m_route && zoom != m_routeZoom) {
+        sendRoute(false);
+    }
+}
+
+bool MapWidget::isInViewport(double latitude, double longitude) const {
+    if (latitude < m_viewSouth || latitude > m_viewNorth) return false;
+    double span = m_viewEast - m_viewWest;
+    if (span >= 360.0) return true;
+    // Padded viewports may extend past the antimeridian
+    double offset = std::fmod(longitude - m_viewWest + 720.0, 360.0);
+    return offset <= span;
+}
+
+void MapWidget::ensureIndex(bool withClusters) {
+    if (!m_currentProvider) return;
+    if (!m_indexDirty && (!withClusters || m_clusterer.hasClusters())) return;
+
+    const QVector<MapMarker>& markers = m_currentProvider->getMarkers();
+    QVector<ClusterItem> items;
+    items.reserve(markers.size());
+    for (const MapMarker& marker : markers) {
+        items.append(ClusterItem{marker.id, marker.latitude, marker.longitude});
+    }
+    m_clusterer.load(items, withClusters);
+    m_indexDirty = false;
+}
+
+void MapWidget::sendViewportMarkers() {
+    TRACE_SCOPE("map", "MapWidget::sendViewportMarkers");
+    if (!m_pageReady || !m_hasViewport || !m_currentProvider) return;
+
+    ensureIndex(false);
+    const QVector<MarkerCluster> points =
+        m_clusterer.points(m_viewSouth, m_viewWest, m_viewNorth, m_viewEast);
+    if (points.size() > kMaxViewportMarkers) {
+        sendClusters();
+        return;
+    }
+
+    QVector<int> ids;
+    ids.reserve(points.size());
+    for (const MarkerCluster& point : points) {
+        ids.append(point.markerId);
+    }
+
+    const MarkerPayload payload = m_currentProvider->packMarkers(ids);
+    m_showingClusters = false;
+    emit m_bridge->viewportMarkers(payload.ids, payload.coords, payload.titleIndexes, payload.titles);
+}
+
+void MapWidget::sendClusters() {
+    TRACE_SCOPE("map", "MapWidget::sendClusters");
+    if (!m_pageReady || !m_hasViewport || !m_currentProvider) return;
+
+    ensureIndex(true);
+    const QVector<MarkerCluster> clusters =
+        m_clusterer.clusters(m_viewSouth, m_viewWest, m_viewNorth, m_viewEast, m_viewZoom);
+
+    QVariantList payload;
+    payload.reserve(clusters.size());
+    for (const MarkerCluster& cluster : clusters) {
+        QVariantMap item;
+        item["lat"] = cluster.latitude;
+        item["lng"] = cluster.longitude;
+        item["count"] = cluster.count;
+        if (cluster.count == 1) {
+            item["id"] = cluster.markerId;
+            int position = m_currentProvider->findMarker(cluster.markerId);
+            if (position >= 0) {
+                item["title"] = m_currentProvider->getMarkerTitle(m_currentProvider->getMarkers()[position]);
+            }
+        }
+        payload.append(item);
+    }
+
+    m_showingClusters = true;
+    emit m_bridge->clustersUpdated(payload);
+}
+
+void MapWidget::displayAddresses(const QList<Address>& addresses) {
+    if (!m_currentProvider) return;
+
+    clearMarkers();
     
     for (const Address& addr : addresses) {
         if (addr.hasCoordinates()) {
-            m_currentProvider->addMarker(
+            addMarker(
                 addr.getId(),
                 addr.getLatitude(),
                 addr.getLongitude(),
@@ -151,30 +457,21 @@ void MapWidget::displayAddresses(const QList<Address>& addresses) {
         }
     }
 
-    if (!addresses.isEmpty()) {
-        m_currentProvider->fitBounds(addresses);
-    }
-
-    loadMap();
+    fitToAddresses(addresses);
 }
 
 void MapWidget::centerOnAddress(const Address& address) {
     if (!m_currentProvider || !address.hasCoordinates()) return;
 
-    m_currentProvider->setCenter(
+    setCenter(
         address.getLatitude(),
         address.getLongitude(),
         15
     );
-    
-    loadMap();
 }
 
 void MapWidget::clearMap() {
-    if (m_currentProvider) {
-        m_currentProvider->clearMarkers();
-        loadMap();
-    }
+    clearMarkers();
 }
 
 void MapWidget::zoomIn() {
@@ -197,6 +494,7 @@ void MapWidget::highlightMarker(int markerId) {
 }
 
 void MapWidget::showRoute(const Address& start, const Address& end) {
+    resetRoute();
     if (!m_webView || !m_webView->page()) return;
     if (!start.hasCoordinates() || !end.hasCoordinates()) return;
     
@@ -213,24 +511,48 @@ void MapWidget::showRoute(const Address& start, const Address& end) {
 }
 
 void MapWidget::showRoutePolyline(const QList<QPointF>& routePoints) {
-    if (!m_webView || !m_webView->page() || routePoints.isEmpty()) return;
-    
-    // Convert route points to JSON array format [[lat, lon], ...]
-    QStringList pointsJson;
-    for (const QPointF& point : routePoints) {
-        pointsJson << QString("[%1, %2]").arg(point.y(), 0, 'f', 6).arg(point.x(), 0, 'f', 6);
-    }
-    
-    QString js = QString(
-        "if (typeof window.showRoutePolyline !== 'undefined') {"
-        "  window.showRoutePolyline([%1]);"
-        "}"
-    ).arg(pointsJson.join(", "));
-    
-    m_webView->page()->runJavaScript(js);
+    resetRoute();
+    if (routePoints.isEmpty()) return;
+
+    // Ranking is O(n log n) on typical routes, too slow for the GUI thread
+    // with hundreds of thousands of points
+    int generation = m_routeGeneration;
+    m_routePool.start([this, routePoints, generation]() {
+        TRACE_SCOPE("map", "PolylineSimplifier::load");
+        QSharedPointer<PolylineSimplifier> route = QSharedPointer<PolylineSimplifier>::create();
+        route->load(routePoints);
+        QMetaObject::invokeMethod(this, [this, route, generation]() {
+            if (generation != m_routeGeneration) return;
+            m_route = route;
+            requestView([this]() { sendRoute(true); });
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MapWidget::sendRoute(bool fitBounds) {
+    TRACE_SCOPE("map", "MapWidget::sendRoute");
+    if (!m_pageReady || !m_route) return;
+
+    // Fitting picks the zoom the page is about to show; its padding is
+    // 50 px on each side
+    int zoom = fitBounds ? m_route->fitZoom(m_webView->width() - 100, m_webView->height() - 100)
+                         : m_viewZoom;
+    const QVector<int> indexes = m_route->simplifyForZoom(zoom);
+    m_routeZoom = zoom;
+    LOG_DEBUGF("Sending route at zoom %1: %2 of %3 points",
+               zoom, indexes.size(), m_route->getPointCount());
+    emit m_bridge->routeChanged(m_route->pack(indexes), fitBounds);
+}
+
+void MapWidget::resetRoute() {
+    // Routes still being ranked are dropped when they finish
+    m_routeGeneration++;
+    m_route.reset();
+    m_routeZoom = -1;
 }
 
 void MapWidget::clearRoute() {
+    resetRoute();
     if (!m_webView || !m_webView->page()) return;
     
     QString js = "if (typeof window.clearRoute !== 'undefined') { window.clearRoute(); }";
@@ -0,0 +1,193 @@
+#include "markerclusterer.h"
+#include <QtMath>
+#include <cmath>
+
+namespace {
+const double kMaxLatitude = 85.05112878;
+}
+
+MarkerClusterer::MarkerClusterer(int radiusPx, int minZoom, int maxZoom)
+    : m_radiusPx(radiusPx), m_minZoom(minZoom), m_maxZoom(maxZoom), m_itemCount(0),
+      m_clustersBuilt(false) {
+}
+
+double MarkerClusterer::lngToX(double lng) {
+    return lng / 360.0 + 0.5;
+}
+
+double MarkerClusterer::latToY(double lat) {
+    lat = qBound(-kMaxLatitude, lat, kMaxLatitude);
+    double s = std::sin(qDegreesToRadians(lat));
+    return 0.5 - 0.25 * std::log((1.0 + s) / (1.0 - s)) / M_PI;
+}
+
+double MarkerClusterer::xToLng(double x) {
+    return (x - 0.5) * 360.0;
+}
+
+double MarkerClusterer::yToLat(double y) {
+    return qRadiansToDegrees(std::atan(std::sinh(M_PI * (1.0 - 2.0 * y))));
+}
+
+quint64 MarkerClusterer::cellKey(int cx, int cy) {
+    return (quint64(quint32(cx)) << 32) | quint64(quint32(cy));
+}
+
+void MarkerClusterer::clear() {
+    m_levels.clear();
+    m_itemCount = 0;
+    m_clustersBuilt = false;
+}
+
+void MarkerClusterer::load(const QVector<ClusterItem>& items, bool buildClusters) {
+    clear();
+    m_itemCount = items.size();
+    m_levels.resize(m_maxZoom - m_minZoom + 2);
+
+    QVector<Node> points;
+    points.reserve(items.size());
+    for (const ClusterItem& item : items) {
+        points.append(Node{lngToX(item.longitude), latToY(item.latitude), 1, item.id});
+    }
+
+    Level& raw = m_levels.last();
+    raw.nodes = points;
+    indexLevel(raw, m_maxZoom + 1);
+    if (!buildClusters) return;
+
+    for (int zoom = m_maxZoom; zoom >= m_minZoom; --zoom) {
+        Level& level = m_levels[zoom - m_minZoom];
+        level.nodes = clusterLevel(m_levels[zoom - m_minZoom + 1].nodes, zoom);
+        indexLevel(level, zoom);
+    }
+    m_clustersBuilt = true;
+}
+
+void MarkerClusterer::indexLevel(Level& level, int zoom) {
+    // One cell per map tile at this zoom level
+    level.cellSize = 1.0 / double(1 << zoom);
+    level.cells.clear();
+    for (int i = 0; i < level.nodes.size(); ++i) {
+        const Node& node = level.nodes[i];
+        int cx = int(node.x / level.cellSize);
+        int cy = int(node.y / level.cellSize);
+        level.cells[cellKey(cx, cy)].append(i);
+    }
+}
+
+QVector<MarkerClusterer::Node> MarkerClusterer::clusterLevel(const QVector<Node>& points, int zoom) const {
+    const double radius = m_radiusPx / (256.0 * double(1 << zoom));
+    const double radius2 = radius * radius;
+
+    QHash<quint64, QVector<int>> grid;
+    grid.reserve(points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        grid[cellKey(int(points[i].x / radius), int(points[i].y / radius))].append(i);
+    }
+
+    QVector<bool> visited(points.size(), false);
+    QVector<Node> result;
+    result.reserve(points.size());
+
+    for (int i = 0; i < points.size(); ++i) {
+        if (visited[i]) continue;
+        visited[i] = true;
+
+        const Node& seed = points[i];
+        double sumX = seed.x * seed.count;
+        double sumY = seed.y * seed.count;
+        int count = seed.count;
+
+        int cx = int(seed.x / radius);
+        int cy = int(seed.y / radius);
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                auto it = grid.constFind(cellKey(cx + dx, cy + dy));
+                if (it == grid.constEnd()) continue;
+                for (int j : it.value()) {
+                    if (visited[j]) continue;
+                    const Node& other = points[j];
+                    double ddx = other.x - seed.x;
+                    double ddy = other.y - seed.y;
+                    if (ddx * ddx + ddy * ddy <= radius2) {
+                        visited[j] = true;
+                        sumX += other.x * other.count;
+                        sumY += other.y * other.count;
+                        count += other.count;
+                    }
+                }
+            }
+        }
+
+        if (count == seed.count) {
+            result.append(seed);
+        } else {
+            result.append(Node{sumX / count, sumY / count, count, -1});
+        }
+    }
+
+    return result;
+}
+
+QVector<MarkerCluster> MarkerClusterer::clusters(double south, double west, double north, double east,
+                                                 int zoom) const {
+    QVector<MarkerCluster> result;
+    if (m_levels.isEmpty()) return result;
+
+    int levelZoom = m_clustersBuilt ? qBound(m_minZoom, zoom, m_maxZoom + 1) : m_maxZoom + 1;
+    const Level& level = m_levels[levelZoom - m_minZoom];
+
+    double y0 = latToY(north);
+    double y1 = latToY(south);
+
+    // Map views can extend past the antimeridian; wrap and split if needed
+    if (east - west >= 360.0) {
+        collect(level, 0.0, 1.0, y0, y1, result);
+        return result;
+    }
+    double x0 = lngToX(std::remainder(west, 360.0));
+    double x1 = lngToX(std::remainder(east, 360.0));
+    if (x0 <= x1) {
+        collect(level, x0, x1, y0, y1, result);
+    } else {
+        collect(level, x0, 1.0, y0, y1, result);
+        collect(level, 0.0, x1, y0, y1, result);
+    }
+    return result;
+}
+
+QVector<MarkerCluster> MarkerClusterer::points(double south, double west, double north, double east) const {
+    return clusters(south, west, north, east, m_maxZoom + 1);
+}
+
+void MarkerClusterer::collect(const Level& level, double x0, double x1, double y0, double y1,
+                              QVector<MarkerCluster>& result) const {
+    auto emitNode = [&](const Node& node) {
+        if (node.x < x0 || node.x > x1 || node.y < y0 || node.y > y1) return;
+        result.append(MarkerCluster{yToLat(node.y), xToLng(node.x), node.count, node.markerId});
+    };
+
+    int cx0 = int(x0 / level.cellSize);
+    int cx1 = int(x1 / level.cellSize);
+    int cy0 = int(y0 / level.cellSize);
+    int cy1 = int(y1 / level.cellSize);
+    qint64 cellCount = qint64(cx1 - cx0 + 1) * qint64(cy1 - cy0 + 1);
+
+    // A scan is cheaper than probing more cells than there are nodes
+    if (cellCount > level.nodes.size()) {
+        for (const Node& node : level.nodes) {
+            emitNode(node);
+        }
+        return;
+    }
+
+    for (int cx = cx0; cx <= cx1; ++cx) {
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            auto it = level.cells.constFind(cellKey(cx, cy));
+            if (it == level.cells.constEnd()) continue;
+            for (int index : it.value()) {
+                emitNode(level.nodes[index]);
+            }
+        }
+    }
+}
@@ -1,11 +1,12 @@
 #include "openstreetmapprovider.h"
+#include "tracer.h"
 
 OpenStreetMapProvider::OpenStreetMapProvider(QObject* parent)
     : MapProvider(parent), m_centerLat(0.0), m_centerLng(0.0), m_zoom(13) {
 }
 
 void OpenStreetMapProvider::initialize() {
-    m_markers.clear();
+    clearMarkers();
     m_centerLat = 0.0;
     m_centerLng = 0.0;
     m_zoom = 2;
@@ -17,19 +18,6 @@ void OpenStreetMapProvider::setCenter(double latitude, double longitude, int zoo
     m_zoom = zoom;
 }
 
-void OpenStreetMapProvider::addMarker(int id, double latitude, double longitude, const QString& title) {
-    QString markerData = QString("%1,%2,%3").arg(latitude).arg(longitude).arg(title);
-    m_markers[id] = markerData;
-}
-
-void OpenStreetMapProvider::removeMarker(int id) {
-    m_markers.remove(id);
-}
-
-void OpenStreetMapProvider::clearMarkers() {
-    m_markers.clear();
-}
-
 void OpenStreetMapProvider::fitBounds(const QList<Address>& addresses) {
     if (addresses.isEmpty()) return;
 
@@ -78,25 +66,7 @@ QString OpenStreetMapProvider::getHtml() const {
 }
 
 QString OpenStreetMapProvider::generateHtml() const {
-    QString markers;
-    for (auto it = m_markers.constBegin(); it != m_markers.constEnd(); ++it) {
-        QStringList parts = it.value().split(',');
-        if (parts.size() >= 3) {
-            QString title = parts.mid(2).join(',');
-            // Escape single quotes in title
-            QString escapedTitle = title;
-            escapedTitle.replace("'", "\\'");
-            markers += QString(R"(
-                {
-                    id: %1,
-                    lat: %2,
-                    lng: %3,
-                    title: '%4'
-                },
-            )").arg(it.key()).arg(parts[0]).arg(parts[1]).arg(escapedTitle);
-        }
-    }
-
+    TRACE_SCOPE("map", "OpenStreetMapProvider::generateHtml");
     QString html = QString(R"(
 <!DOCTYPE html>
 <html>
@@ -120,6 +90,16 @@ QString OpenStreetMapProvider::generateHtml() const {
             height: 24px;
             box-shadow: 0 0 10px rgba(239, 68, 68, 0.8);
         }
+        .marker-cluster {
+            background-color: rgba(37, 99, 235, 0.85);
+            border: 3px solid rgba(255, 255, 255, 0.9);
+            border-radius: 50%;
+            color: #ffffff;
+            font: bold 12px sans-serif;
+            display: flex;
+            align-items: center;
+            justify-content: center;
+        }
     </style>
 </head>
 <body>
@@ -159,14 +139,20 @@ QString OpenStreetMapProvider::generateHtml() const {
             popupAnchor: [0, -12]
         });
 
-        const markerData = [%4];
+        // Only markers or clusters inside the padded viewport are on the page
         const markers = {};
         let currentHighlighted = null;
+        const markerLayer = L.layerGroup().addTo(map);
+        const clusterLayer = L.layerGroup().addTo(map);
 
-        markerData.forEach(data => {
+        function popupHtml(title) {
+            return '<div style="min-width: 150px;"><strong>' + title + '</strong></div>';
+        }
+
+        function createMarker(data) {
             const marker = L.marker([data.lat, data.lng], { icon: customIcon })
-                .addTo(map)
-                .bindPopup('<div style="min-width: 150px;"><strong>' + data.title + '</strong></div>');
+                .addTo(markerLayer)
+                .bindPopup(popupHtml(data.title));
 
             // Show tooltip on hover
             marker.bindTooltip(data.title, {
@@ -182,7 +168,108 @@ QString OpenStreetMapProvider::generateHtml() const {
             });
 
             markers[data.id] = marker;
-        });
+        }
+
+        // Incremental updates pushed from MapWidget
+        function upsertMarker(data) {
+            const marker = markers[data.id];
+            if (marker) {
+                marker.setLatLng([data.lat, data.lng]);
+                marker.setPopupContent(popupHtml(data.title));
+                marker.setTooltipContent(data.title);
+            } else {
+                createMarker(data);
+            }
+        }
+
+        function removeMarker(id) {
+            if (markers[id]) {
+                markerLayer.removeLayer(markers[id]);
+                delete markers[id];
+                if (currentHighlighted === id) {
+                    currentHighlighted = null;
+                }
+            }
+        }
+
+        function decodeBase64(text) {
+            const binary = atob(text);
+            const bytes = new Uint8Array(binary.length);
+            for (let i = 0; i < binary.length; i++) {
+                bytes[i] = binary.charCodeAt(i);
+            }
+            return bytes.buffer;
+        }
+
+        // Markers already on the page are kept unless they moved or were
+        // renamed; the rest are diffed in
+        function showViewportMarkers(idsBase64, coordsBase64, titleIndexesBase64, titles) {
+            const ids = new Int32Array(decodeBase64(idsBase64));
+            const coords = new Float64Array(decodeBase64(coordsBase64));
+            const titleIndexes = new Int32Array(decodeBase64(titleIndexesBase64));
+            clusterLayer.clearLayers();
+
+            const visible = new Set();
+            for (let i = 0; i < ids.length; i++) {
+                visible.add(ids[i]);
+                const marker = markers[ids[i]];
+                const lat = coords[2 * i];
+                const lng = coords[2 * i + 1];
+                const title = titles[titleIndexes[i]];
+                if (!marker) {
+                    createMarker({ id: ids[i], lat: lat, lng: lng, title: title });
+                } else if (!marker.getLatLng().equals([lat, lng], 0) || marker.getTooltip().getContent() !== title) {
+                    upsertMarker({ id: ids[i], lat: lat, lng: lng, title: title });
+                }
+            }
+            Object.keys(markers).forEach(key => {
+                if (!visible.has(Number(key))) {
+                    removeMarker(Number(key));
+                }
+            });
+        }
+
+        // Clustering: only the clusters inside the viewport exist in the DOM
+        function clusterIcon(count) {
+            const size = count < 100 ? 30 : (count < 1000 ? 38 : 46);
+            return L.divIcon({
+                html: String(count),
+                className: 'marker-cluster',
+                iconSize: [size, size]
+            });
+        }
+
+        function showClusters(list) {
+            const highlighted = currentHighlighted;
+            clusterLayer.clearLayers();
+            markerLayer.clearLayers();
+            Object.keys(markers).forEach(id => delete markers[id]);
+            currentHighlighted = null;
+
+            list.forEach(c => {
+                if (c.count === 1) {
+                    createMarker(c);
+                    return;
+                }
+                L.marker([c.lat, c.lng], { icon: clusterIcon(c.count) })
+                    .on('click', () => map.setView([c.lat, c.lng], map.getZoom() + 2))
+                    .addTo(clusterLayer);
+            });
+
+            if (highlighted !== null && markers[highlighted]) {
+                markers[highlighted].setIcon(highlightedIcon);
+                currentHighlighted = highlighted;
+            }
+        }
+
+        function reportViewport() {
+            if (!window.qtBridge) return;
+            const b = map.getBounds().pad(0.25);
+            window.qtBridge.viewportChanged(b.getSouth(), b.getWest(), b.getNorth(), b.getEast(), map.getZoom());
+        }
+
+        // Leaflet also fires moveend at the end of every zoom
+        map.on('moveend', reportViewport);
         
         // Function to highlight a specific marker
         window.highlightMarker = function(markerId) {
@@ -233,23 +320,37 @@ QString OpenStreetMapProvider::generateHtml() const {
             console.log('Route displayed from', startLat, startLng, 'to', endLat, endLng);
         };
         
-        window.showRoutePolyline = function(routePoints) {
+        // Route coordinates arrive as int32 (lat, lng) pairs in 1e-6 degrees,
+        // already simplified for the zoom they are shown at
+        function decodeRoute(coordsBase64) {
+            const coords = new Int32Array(decodeBase64(coordsBase64));
+            const latlngs = new Array(coords.length / 2);
+            for (let i = 0; i < latlngs.length; i++) {
+                latlngs[i] = [coords[2 * i] / 1e6, coords[2 * i + 1] / 1e6];
+            }
+            return latlngs;
+        }
+
+        window.showRoutePolyline = function(coordsBase64, fitBounds) {
             // Clear existing route
             if (routeLayer) {
                 map.removeLayer(routeLayer);
             }
             
             // Draw road-based route through multiple waypoints
-            routeLayer = L.polyline(routePoints, {
+            const latlngs = decodeRoute(coordsBase64);
+            routeLayer = L.polyline(latlngs, {
                 color: '#3b82f6',
                 weight: 5,
                 opacity: 0.8
             }).addTo(map);
             
             // Fit bounds to show the entire route
-            map.fitBounds(routeLayer.getBounds(), { padding: [50, 50] });
+            if (fitBounds) {
+                map.fitBounds(routeLayer.getBounds(), { padding: [50, 50] });
+            }
             
-            console.log('Route polyline displayed with', routePoints.length, 'points');
+            console.log('Route polyline displayed with', latlngs.length, 'points');
         };
         
         window.clearRoute = function() {
@@ -265,8 +366,26 @@ QString OpenStreetMapProvider::generateHtml() const {
         // Initialize QWebChannel when available
         if (typeof QWebChannel !== 'undefined' && typeof qt !== 'undefined') {
             new QWebChannel(qt.webChannelTransport, function(channel) {
-                window.qtBridge = channel.objects.qtBridge;
+                const bridge = channel.objects.qtBridge;
+                window.qtBridge = bridge;
+
+                bridge.markersChanged.connect(function(upserts, removedIds) {
+                    removedIds.forEach(removeMarker);
+                    upserts.forEach(upsertMarker);
+                });
+                bridge.viewportMarkers.connect(showViewportMarkers);
+                bridge.centerRequested.connect(function(lat, lng, zoom) {
+                    map.setView([lat, lng], zoom);
+                });
+                bridge.fitBoundsRequested.connect(function(south, west, north, east) {
+                    map.fitBounds([[south, west], [north, east]], { padding: [30, 30], maxZoom: 15 });
+                });
+                bridge.clustersUpdated.connect(showClusters);
+                bridge.routeChanged.connect(window.showRoutePolyline);
+
                 console.log('QWebChannel initialized successfully');
+                bridge.pageReady();
+                reportViewport();
             });
         } else {
             console.log('QWebChannel not available (running outside Qt)');
@@ -274,7 +393,7 @@ QString OpenStreetMapProvider::generateHtml() const {
     </script>
 </body>
 </html>
-    )").arg(m_centerLat).arg(m_centerLng).arg(m_zoom).arg(markers);
+    )").arg(m_centerLat).arg(m_centerLng).arg(m_zoom);
 
     return html;
 }
@@ -0,0 +1,179 @@
+#include "osrmroutingbackend.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QUrl>
+
+namespace {
+const char* kDefaultServerUrl = "https://router.project-osrm.org";
+}
+
+OsrmRoutingBackend::OsrmRoutingBackend(QObject* parent)
+    : RoutingBackend(parent), m_networkManager(new QNetworkAccessManager(this)),
+      m_serverUrl(kDefaultServerUrl) {
+    m_networkManager->setTransferTimeout(30000); // 30 seconds
+}
+
+OsrmRoutingBackend::~OsrmRoutingBackend() {
+    cancelAll();
+}
+
+void OsrmRoutingBackend::setServerUrl(const QString& url) {
+    QString trimmed = url.trimmed();
+    while (trimmed.endsWith('/')) {
+        trimmed.chop(1);
+    }
+    m_serverUrl = trimmed.isEmpty() ? QString(kDefaultServerUrl) : trimmed;
+}
+
+void OsrmRoutingBackend::requestRoute(int requestId, const QList<Address>& waypoints) {
+    QString url = buildRouteUrl(waypoints);
+    LOG_DEBUGF("Routing URL (request %1): %2", requestId, url);
+
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::UserAgentHeader, "MapAddress/1.0 Qt Application");
+
+    QNetworkReply* reply = m_networkManager->get(request);
+    reply->setProperty("traceStart", Tracer::startTime());
+    m_replies.insert(reply, requestId);
+    connect(reply, &QNetworkReply::finished, this, &OsrmRoutingBackend::onReplyFinished);
+}
+
+void OsrmRoutingBackend::cancelAll() {
+    // Aborting emits finished synchronously; the replies are already
+    // forgotten by then so no result is reported for them
+    QList<QNetworkReply*> replies = m_replies.keys();
+    m_replies.clear();
+    for (QNetworkReply* reply : replies) {
+        reply->abort();
+    }
+}
+
+QString OsrmRoutingBackend::buildRouteUrl(const QList<Address>& waypoints) const {
+    // Build coordinates string: lon,lat;lon,lat;...
+    QStringList coordinates;
+    for (const Address& addr : waypoints) {
+        coordinates << QString("%1,%2")
+            .arg(addr.getLongitude(), 0, 'f', 6)
+            .arg(addr.getLatitude(), 0, 'f', 6);
+    }
+    
+    return QString("%1/route/v1/driving/%2?overview=full&geometries=geojson")
+        .arg(m_serverUrl, coordinates.join(";"));
+}
+
+void OsrmRoutingBackend::onReplyFinished() {
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+    if (!reply) return;
+
+    reply->deleteLater();
+
+    // Replies of cancelled requests are stale
+    auto it = m_replies.find(reply);
+    if (it == m_replies.end()) return;
+    int requestId = it.value();
+    m_replies.erase(it);
+    Tracer::instance().addAsyncSpan("network", "OSRM route request", reply->property("traceStart").toLongLong());
+
+    RoutePath path;
+    QString error;
+    if (reply->error() != QNetworkReply::NoError) {
+        error = describeError(reply);
+    } else {
+        QByteArray data = reply->readAll();
+        LOG_DEBUGF("Routing response: %1", data);
+        path = parseRouteResponse(data);
+        if (path.points.isEmpty()) {
+            error = "No route found between the waypoints";
+        }
+    }
+
+    emit routeFinished(requestId, path, error);
+}
+
+QString OsrmRoutingBackend::describeError(QNetworkReply* reply) const {
+    switch (reply->error()) {
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::HostNotFoundError:
+            return "Cannot reach routing service. Please check your internet connection.";
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::OperationCanceledError:
+            return "Routing request timed out. Please try again.";
+        default:
+            return "Routing error: " + reply->errorString();
+    }
+}
+
+RoutePath OsrmRoutingBackend::parseRouteResponse(const QByteArray& data) {
+    TRACE_SCOPE("routing", "OsrmRoutingBackend::parseRouteResponse");
+    RoutePath path;
+    QList<QPointF>& points = path.points;
+    
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) {
+        LOG_ERROR("Invalid routing response: not a JSON object");
+        return path;
+    }
+    
+    QJsonObject root = doc.object();
+    
+    // Check for errors
+    if (root.contains("code")) {
+        QString code = root["code"].toString();
+        if (code != "Ok") {
+            LOG_ERROR("Routing service returned error: " + code);
+            return path;
+        }
+    }
+    
+    // Parse OSRM GeoJSON response
+    if (!root.contains("routes") || !root["routes"].isArray()) {
+        LOG_ERROR("No routes in response");
+        return path;
+    }
+    
+    QJsonArray routes = root["routes"].toArray();
+    if (routes.isEmpty()) {
+        LOG_ERROR("Routes array is empty");
+        return path;
+    }
+    
+    QJsonObject route = routes[0].toObject();
+    // Distances are in meters; there is one leg per pair of waypoints
+    path.distanceKm = route["distance"].toDouble() / 1000.0;
+    path.durationSeconds = route["duration"].toDouble();
+    const QJsonArray legs = route["legs"].toArray();
+    path.legs.reserve(legs.size());
+    for (const QJsonValue& value : legs) {
+        QJsonObject leg = value.toObject();
+        path.legs.append(RouteLeg{leg["distance"].toDouble() / 1000.0, leg["duration"].toDouble()});
+    }
+    if (!route.contains("geometry") || !route["geometry"].isObject()) {
+        LOG_ERROR("No geometry in route");
+        return path;
+    }
+    
+    QJsonObject geometry = route["geometry"].toObject();
+    if (!geometry.contains("coordinates") || !geometry["coordinates"].isArray()) {
+        LOG_ERROR("No coordinates in geometry");
+        return path;
+    }
+    
+    QJsonArray coordinates = geometry["coordinates"].toArray();
+    
+    // Coordinates are in [lon, lat] format
+    for (const QJsonValue& coord : coordinates) {
+        if (coord.isArray()) {
+            QJsonArray c = coord.toArray();
+            if (c.size() >= 2) {
+                double lon = c[0].toDouble();
+                double lat = c[1].toDouble();
+                points.append(QPointF(lon, lat));
+            }
+        }
+    }
+    
+    return path;
+}
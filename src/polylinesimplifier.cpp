@@ -0,0 +1,136 @@
+#include "polylinesimplifier.h"
+#include <QByteArray>
+#include <QtEndian>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+
+namespace {
+const double kMaxLatitude = 85.05112878;
+const double kTileSize = 256.0;
+
+struct Span {
+    int first;
+    int last;
+    double limit;
+};
+}
+
+PolylineSimplifier::PolylineSimplifier() {
+}
+
+void PolylineSimplifier::clear() {
+    m_points.clear();
+    m_x.clear();
+    m_y.clear();
+    m_significance.clear();
+}
+
+void PolylineSimplifier::load(const QList<QPointF>& points) {
+    clear();
+    m_points = points;
+    const int count = points.size();
+    m_x.resize(count);
+    m_y.resize(count);
+    for (int i = 0; i < count; ++i) {
+        double lat = qBound(-kMaxLatitude, points[i].y(), kMaxLatitude);
+        double s = std::sin(qDegreesToRadians(lat));
+        m_x[i] = points[i].x() / 360.0 + 0.5;
+        m_y[i] = 0.5 - 0.25 * std::log((1.0 + s) / (1.0 - s)) / M_PI;
+    }
+
+    // A vertex's rank is its distance from the chord it splits, capped by
+    // the rank of the vertex that created that chord. Keeping the vertices
+    // ranked at or above a tolerance then gives exactly the Douglas-Peucker
+    // result for that tolerance.
+    const double infinity = std::numeric_limits<double>::infinity();
+    m_significance.fill(0.0, count);
+    if (count == 0) return;
+    m_significance[0] = infinity;
+    m_significance[count - 1] = infinity;
+
+    QVector<Span> stack;
+    stack.append(Span{0, count - 1, infinity});
+    while (!stack.isEmpty()) {
+        Span span = stack.takeLast();
+        if (span.last - span.first < 2) continue;
+
+        int split = -1;
+        double maxDistance = -1.0;
+        for (int i = span.first + 1; i < span.last; ++i) {
+            double distance = segmentDistance(m_x[i], m_y[i], m_x[span.first], m_y[span.first],
+                                              m_x[span.last], m_y[span.last]);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                split = i;
+            }
+        }
+
+        double rank = qMin(maxDistance, span.limit);
+        m_significance[split] = rank;
+        stack.append(Span{span.first, split, rank});
+        stack.append(Span{split, span.last, rank});
+    }
+}
+
+double PolylineSimplifier::segmentDistance(double px, double py, double ax, double ay,
+                                           double bx, double by) {
+    double dx = bx - ax;
+    double dy = by - ay;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (lengthSquared > 0.0) {
+        t = qBound(0.0, ((px - ax) * dx + (py - ay) * dy) / lengthSquared, 1.0);
+    }
+    double ex = px - (ax + t * dx);
+    double ey = py - (ay + t * dy);
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+double PolylineSimplifier::toleranceForZoom(int zoom, double tolerancePx) {
+    return tolerancePx / (kTileSize * std::ldexp(1.0, qMax(0, zoom)));
+}
+
+QVector<int> PolylineSimplifier::simplify(double tolerance) const {
+    QVector<int> indexes;
+    for (int i = 0; i < m_significance.size(); ++i) {
+        if (m_significance[i] >= tolerance) {
+            indexes.append(i);
+        }
+    }
+    return indexes;
+}
+
+QVector<int> PolylineSimplifier::simplifyForZoom(int zoom, double tolerancePx) const {
+    return simplify(toleranceForZoom(zoom, tolerancePx));
+}
+
+int PolylineSimplifier::fitZoom(int widthPx, int heightPx, int maxZoom) const {
+    if (m_points.isEmpty()) return 0;
+
+    double minX = m_x[0], maxX = m_x[0], minY = m_y[0], maxY = m_y[0];
+    for (int i = 1; i < m_x.size(); ++i) {
+        minX = qMin(minX, m_x[i]);
+        maxX = qMax(maxX, m_x[i]);
+        minY = qMin(minY, m_y[i]);
+        maxY = qMax(maxY, m_y[i]);
+    }
+
+    double scale = std::numeric_limits<double>::infinity();
+    if (maxX > minX) scale = qMin(scale, qMax(1, widthPx) / (kTileSize * (maxX - minX)));
+    if (maxY > minY) scale = qMin(scale, qMax(1, heightPx) / (kTileSize * (maxY - minY)));
+    if (std::isinf(scale)) return maxZoom;
+    return qBound(0, int(std::floor(std::log2(scale))), maxZoom);
+}
+
+QString PolylineSimplifier::pack(const QVector<int>& indexes) const {
+    QByteArray data(indexes.size() * 2 * int(sizeof(qint32)), Qt::Uninitialized);
+    uchar* out = reinterpret_cast<uchar*>(data.data());
+    for (int index : indexes) {
+        const QPointF& point = m_points[index];
+        qToLittleEndian<qint32>(qRound(point.y() * 1e6), out);
+        qToLittleEndian<qint32>(qRound(point.x() * 1e6), out + 4);
+        out += 8;
+    }
+    return QString::fromLatin1(data.toBase64());
+}
@@ -0,0 +1,495 @@
+#include "roadgraph.h"
+#include "geoutils.h"
+#include "logger.h"
+#include <QDataStream>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace {
+const char kMagic[4] = {'M', 'A', 'R', 'G'};
+const quint32 kFormatVersion = 1;
+const double kCellDegrees = 0.01;
+const int kCellRows = 18000;
+const int kCellColumns = 36000;
+const double kKmPerDegree = kEarthRadiusKm * M_PI / 180.0;
+
+// Splits a DIMACS line into its whitespace separated fields
+QList<QByteArray> dimacsFields(const QByteArray& line) {
+    return line.simplified().split(' ');
+}
+}
+
+RoadGraph::RoadGraph() : m_maxSpeedKmPerSecond(0.0) {
+}
+
+void RoadGraph::clear() {
+    m_latE7.clear();
+    m_lngE7.clear();
+    m_firstOut.clear();
+    m_edgeHead.clear();
+    m_edgeSeconds.clear();
+    m_firstIn.clear();
+    m_edgeTail.clear();
+    m_inEdgeSeconds.clear();
+    m_cellKeys.clear();
+    m_cellNodes.clear();
+    m_maxSpeedKmPerSecond = 0.0;
+}
+
+void RoadGraph::setLastError(const QString& error) {
+    m_lastError = error;
+}
+
+qint64 RoadGraph::cellKey(int row, int column) {
+    return qint64(row) * kCellColumns + column;
+}
+
+bool RoadGraph::build(const QVector<Node>& nodes, const QVector<Edge>& edges) {
+    clear();
+
+    const int nodeCount = nodes.size();
+    for (const Edge& edge : edges) {
+        if (edge.from < 0 || edge.from >= nodeCount || edge.to < 0 || edge.to >= nodeCount) {
+            setLastError(QString("Edge %1 -> %2 references a missing node").arg(edge.from).arg(edge.to));
+            return false;
+        }
+        if (!std::isfinite(edge.seconds) || edge.seconds < 0.0) {
+            setLastError(QString("Edge %1 -> %2 has an invalid travel time").arg(edge.from).arg(edge.to));
+            return false;
+        }
+    }
+
+    m_latE7.resize(nodeCount);
+    m_lngE7.resize(nodeCount);
+    for (int i = 0; i < nodeCount; ++i) {
+        const Node& node = nodes[i];
+        if (!(qAbs(node.latitude) <= 90.0 && qAbs(node.longitude) <= 180.0)) {
+            clear();
+            setLastError(QString("Node %1 has invalid coordinates").arg(i));
+            return false;
+        }
+        m_latE7[i] = qint32(std::lround(node.latitude * 1e7));
+        m_lngE7[i] = qint32(std::lround(node.longitude * 1e7));
+    }
+
+    // Counting sort of the edges by tail node
+    m_firstOut.fill(0, nodeCount + 1);
+    for (const Edge& edge : edges) {
+        m_firstOut[edge.from + 1]++;
+    }
+    for (int i = 0; i < nodeCount; ++i) {
+        m_firstOut[i + 1] += m_firstOut[i];
+    }
+    m_edgeHead.resize(edges.size());
+    m_edgeSeconds.resize(edges.size());
+    QVector<quint32> next(m_firstOut.begin(), m_firstOut.end() - 1);
+    for (const Edge& edge : edges) {
+        quint32 slot = next[edge.from]++;
+        m_edgeHead[slot] = quint32(edge.to);
+        m_edgeSeconds[slot] = float(edge.seconds);
+    }
+
+    finish();
+    return true;
+}
+
+void RoadGraph::finish() {
+    buildReverse();
+    buildCellIndex();
+
+    // Straight-line distance over an edge never exceeds its road length, so
+    // the fastest edge bounds the speed of any path. A zero-time edge that
+    // covers distance leaves no bound and the search falls back to Dijkstra.
+    m_maxSpeedKmPerSecond = 0.0;
+    bool bounded = true;
+    for (int node = 0; node < getNodeCount() && bounded; ++node) {
+        for (quint32 e = m_firstOut[node]; e < m_firstOut[node + 1]; ++e) {
+            int head = int(m_edgeHead[e]);
+            double km = haversineDistanceKm(getLatitude(node), getLongitude(node),
+                                            getLatitude(head), getLongitude(head));
+            if (m_edgeSeconds[e] > 0.0f) {
+                m_maxSpeedKmPerSecond = qMax(m_maxSpeedKmPerSecond, km / m_edgeSeconds[e]);
+            } else if (km > 0.0) {
+                bounded = false;
+                break;
+            }
+        }
+    }
+    if (!bounded) {
+        m_maxSpeedKmPerSecond = 0.0;
+    }
+    // Leaves room for rounding so the potentials stay consistent
+    m_maxSpeedKmPerSecond *= 1.0 + 1e-9;
+}
+
+void RoadGraph::buildReverse() {
+    const int nodeCount = getNodeCount();
+    m_firstIn.fill(0, nodeCount + 1);
+    for (quint32 head : m_edgeHead) {
+        m_firstIn[head + 1]++;
+    }
+    for (int i = 0; i < nodeCount; ++i) {
+        m_firstIn[i + 1] += m_firstIn[i];
+    }
+
+    m_edgeTail.resize(m_edgeHead.size());
+    m_inEdgeSeconds.resize(m_edgeHead.size());
+    QVector<quint32> next(m_firstIn.begin(), m_firstIn.end() - 1);
+    for (int node = 0; node < nodeCount; ++node) {
+        for (quint32 e = m_firstOut[node]; e < m_firstOut[node + 1]; ++e) {
+            quint32 slot = next[m_edgeHead[e]]++;
+            m_edgeTail[slot] = quint32(node);
+            m_inEdgeSeconds[slot] = m_edgeSeconds[e];
+        }
+    }
+}
+
+void RoadGraph::buildCellIndex() {
+    const int nodeCount = getNodeCount();
+    std::vector<std::pair<qint64, quint32>> cells(nodeCount);
+    for (int node = 0; node < nodeCount; ++node) {
+        int row = qBound(0, int(std::floor((getLatitude(node) + 90.0) / kCellDegrees)), kCellRows - 1);
+        int column = int(std::floor((getLongitude(node) + 180.0) / kCellDegrees)) % kCellColumns;
+        cells[node] = {cellKey(row, column), quint32(node)};
+    }
+    std::sort(cells.begin(), cells.end());
+
+    m_cellKeys.resize(nodeCount);
+    m_cellNodes.resize(nodeCount);
+    for (int i = 0; i < nodeCount; ++i) {
+        m_cellKeys[i] = cells[i].first;
+        m_cellNodes[i] = cells[i].second;
+    }
+}
+
+int RoadGraph::nearestNode(double latitude, double longitude, double maxDistanceKm) const {
+    if (isEmpty()) return -1;
+
+    int row = qBound(0, int(std::floor((latitude + 90.0) / kCellDegrees)), kCellRows - 1);
+    int column = int(std::floor((longitude + 180.0) / kCellDegrees));
+    double cellKm = kKmPerDegree * kCellDegrees;
+    int rowRadius = int(std::ceil(maxDistanceKm / cellKm));
+    double columnKm = cellKm * std::cos(qDegreesToRadians(qBound(-89.0, latitude, 89.0)));
+    int columnRadius = qMin(kCellColumns / 2, int(std::ceil(maxDistanceKm / columnKm)));
+
+    int best = -1;
+    double bestKm = maxDistanceKm;
+    for (int r = qMax(0, row - rowRadius); r <= qMin(kCellRows - 1, row + rowRadius); ++r) {
+        for (int c = column - columnRadius; c <= column + columnRadius; ++c) {
+            qint64 key = cellKey(r, ((c % kCellColumns) + kCellColumns) % kCellColumns);
+            auto range = std::equal_range(m_cellKeys.begin(), m_cellKeys.end(), key);
+            for (auto it = range.first; it != range.second; ++it) {
+                int node = int(m_cellNodes[int(it - m_cellKeys.begin())]);
+                double km = haversineDistanceKm(latitude, longitude,
+                                                getLatitude(node), getLongitude(node));
+                if (km <= bestKm) {
+                    bestKm = km;
+                    best = node;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+double RoadGraph::heuristicSeconds(int from, int to) const {
+    if (m_maxSpeedKmPerSecond <= 0.0) return 0.0;
+    return haversineDistanceKm(getLatitude(from), getLongitude(from),
+                               getLatitude(to), getLongitude(to)) / m_maxSpeedKmPerSecond;
+}
+
+QVector<int> RoadGraph::shortestPath(int source, int target, double* seconds) const {
+    if (seconds) *seconds = 0.0;
+    const int nodeCount = getNodeCount();
+    if (source < 0 || source >= nodeCount || target < 0 || target >= nodeCount) return {};
+    if (source == target) return {source};
+
+    // Both searches use the average potential (h_target - h_source) / 2, so
+    // their reduced edge costs agree and the bidirectional Dijkstra stopping
+    // rule applies to the queue keys directly
+    auto potential = [&](int node) {
+        return 0.5 * (heuristicSeconds(node, target) - heuristicSeconds(source, node));
+    };
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    using QueueEntry = std::pair<double, int>;
+    using Queue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+    std::vector<double> distance[2] = {std::vector<double>(nodeCount, infinity),
+                                       std::vector<double>(nodeCount, infinity)};
+    std::vector<int> parent[2] = {std::vector<int>(nodeCount, -1), std::vector<int>(nodeCount, -1)};
+    std::vector<char> settled[2] = {std::vector<char>(nodeCount, 0), std::vector<char>(nodeCount, 0)};
+    Queue queue[2];
+
+    distance[0][source] = 0.0;
+    distance[1][target] = 0.0;
+    queue[0].push({potential(source), source});
+    queue[1].push({-potential(target), target});
+
+    double best = infinity;
+    int meeting = -1;
+    while (!queue[0].empty() && !queue[1].empty()) {
+        if (queue[0].top().first + queue[1].top().first >= best) break;
+
+        int side = queue[0].top().first <= queue[1].top().first ? 0 : 1;
+        int node = queue[side].top().second;
+        queue[side].pop();
+        if (settled[side][node]) continue;
+        settled[side][node] = 1;
+
+        const QVector<quint32>& first = side == 0 ? m_firstOut : m_firstIn;
+        const QVector<quint32>& other = side == 0 ? m_edgeHead : m_edgeTail;
+        const QVector<float>& weight = side == 0 ? m_edgeSeconds : m_inEdgeSeconds;
+        for (quint32 e = first[node]; e < first[node + 1]; ++e) {
+            int next = int(other[e]);
+            double nextDistance = distance[side][node] + weight[e];
+            if (nextDistance < distance[side][next]) {
+                distance[side][next] = nextDistance;
+                parent[side][next] = node;
+                double key = side == 0 ? nextDistance + potential(next) : nextDistance - potential(next);
+                queue[side].push({key, next});
+            }
+            double total = distance[side][next] + distance[1 - side][next];
+            if (total < best) {
+                best = total;
+                meeting = next;
+            }
+        }
+    }
+
+    if (meeting < 0) return {};
+
+    QVector<int> path;
+    for (int node = meeting; node >= 0; node = parent[0][node]) {
+        path.append(node);
+    }
+    std::reverse(path.begin(), path.end());
+    for (int node = parent[1][meeting]; node >= 0; node = parent[1][node]) {
+        path.append(node);
+    }
+
+    if (seconds) *seconds = best;
+    return path;
+}
+
+QVector<double> RoadGraph::travelTimes(int source, const QVector<int>& targets,
+                                       QVector<double>* distancesKm) const {
+    const double infinity = std::numeric_limits<double>::infinity();
+    const int nodeCount = getNodeCount();
+    QVector<double> seconds(targets.size(), infinity);
+    if (distancesKm) {
+        distancesKm->fill(infinity, targets.size());
+    }
+    if (source < 0 || source >= nodeCount) return seconds;
+
+    std::vector<double> distance(nodeCount, infinity);
+    std::vector<int> parent(nodeCount, -1);
+    std::vector<char> settled(nodeCount, 0);
+    std::vector<char> wanted(nodeCount, 0);
+    int remaining = 0;
+    for (int target : targets) {
+        if (target >= 0 && target < nodeCount && !wanted[target]) {
+            wanted[target] = 1;
+            remaining++;
+        }
+    }
+
+    using QueueEntry = std::pair<double, int>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    distance[source] = 0.0;
+    queue.push({0.0, source});
+    while (!queue.empty() && remaining > 0) {
+        int node = queue.top().second;
+        queue.pop();
+        if (settled[node]) continue;
+        settled[node] = 1;
+        if (wanted[node]) remaining--;
+
+        for (quint32 e = m_firstOut[node]; e < m_firstOut[node + 1]; ++e) {
+            int next = int(m_edgeHead[e]);
+            double nextDistance = distance[node] + m_edgeSeconds[e];
+            if (nextDistance < distance[next]) {
+                distance[next] = nextDistance;
+                parent[next] = node;
+                queue.push({nextDistance, next});
+            }
+        }
+    }
+
+    for (int i = 0; i < targets.size(); ++i) {
+        int target = targets[i];
+        if (target < 0 || target >= nodeCount || !settled[target]) continue;
+        seconds[i] = distance[target];
+        if (distancesKm) {
+            double km = 0.0;
+            for (int node = target; parent[node] >= 0; node = parent[node]) {
+                km += haversineDistanceKm(getLatitude(parent[node]), getLongitude(parent[node]),
+                                          getLatitude(node), getLongitude(node));
+            }
+            (*distancesKm)[i] = km;
+        }
+    }
+    return seconds;
+}
+
+bool RoadGraph::save(const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_ERROR("Cannot write road graph: " + path);
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out.writeRawData(kMagic, sizeof(kMagic));
+    out << kFormatVersion;
+    out << m_latE7 << m_lngE7 << m_firstOut << m_edgeHead << m_edgeSeconds;
+    return out.status() == QDataStream::Ok;
+}
+
+bool RoadGraph::load(const QString& path) {
+    clear();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setLastError("Cannot open road graph: " + path);
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    char magic[sizeof(kMagic)];
+    quint32 version = 0;
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic))
+        || !std::equal(magic, magic + sizeof(magic), kMagic)) {
+        setLastError("Not a road graph file: " + path);
+        return false;
+    }
+    in >> version;
+    if (version != kFormatVersion) {
+        setLastError(QString("Unsupported road graph version %1").arg(version));
+        return false;
+    }
+
+    in >> m_latE7 >> m_lngE7 >> m_firstOut >> m_edgeHead >> m_edgeSeconds;
+    if (in.status() != QDataStream::Ok || !validate()) {
+        clear();
+        setLastError("Road graph file is corrupt: " + path);
+        return false;
+    }
+
+    finish();
+    LOG_INFO(QString("Loaded road graph with %1 nodes and %2 edges")
+        .arg(getNodeCount()).arg(getEdgeCount()));
+    return true;
+}
+
+bool RoadGraph::validate() {
+    const int nodeCount = m_latE7.size();
+    if (m_lngE7.size() != nodeCount || m_firstOut.size() != nodeCount + 1
+        || m_edgeSeconds.size() != m_edgeHead.size()) {
+        return false;
+    }
+    if (m_firstOut.first() != 0 || m_firstOut.last() != quint32(m_edgeHead.size())) {
+        return false;
+    }
+    for (int i = 0; i < nodeCount; ++i) {
+        if (m_firstOut[i] > m_firstOut[i + 1]) return false;
+        if (qAbs(qint64(m_latE7[i])) > 900000000LL || qAbs(qint64(m_lngE7[i])) > 1800000000LL) return false;
+    }
+    for (int e = 0; e < m_edgeHead.size(); ++e) {
+        if (m_edgeHead[e] >= quint32(nodeCount)) return false;
+        if (!std::isfinite(m_edgeSeconds[e]) || m_edgeSeconds[e] < 0.0f) return false;
+    }
+    return true;
+}
+
+bool RoadGraph::importDimacs(const QString& graphPath, const QString& coordinatePath,
+                             double secondsPerUnit) {
+    clear();
+
+    // Coordinates: "v <id> <lng> <lat>" in millionths of a degree
+    QFile coordinateFile(coordinatePath);
+    if (!coordinateFile.open(QIODevice::ReadOnly)) {
+        setLastError("Cannot open road graph coordinates: " + coordinatePath);
+        return false;
+    }
+    QVector<Node> nodes;
+    QVector<bool> hasCoordinates;
+    while (!coordinateFile.atEnd()) {
+        QByteArray line = coordinateFile.readLine();
+        if (line.startsWith("p ")) {
+            QList<QByteArray> fields = dimacsFields(line);
+            if (fields.size() >= 5) {
+                nodes.reserve(fields[4].toInt());
+                hasCoordinates.reserve(fields[4].toInt());
+            }
+        } else if (line.startsWith("v ")) {
+            QList<QByteArray> fields = dimacsFields(line);
+            bool idOk = false;
+            int id = fields.size() >= 4 ? fields[1].toInt(&idOk) : 0;
+            if (!idOk || id < 1) {
+                setLastError(QString("Invalid coordinate line: %1").arg(QString(line.trimmed())));
+                return false;
+            }
+            // Ids need not be in order; gaps are only an error once an
+            // arc uses them, see below
+            if (id > nodes.size()) {
+                nodes.resize(id);
+                hasCoordinates.resize(id);
+            }
+            nodes[id - 1] = Node{fields[3].toDouble() * 1e-6, fields[2].toDouble() * 1e-6};
+            hasCoordinates[id - 1] = true;
+        }
+    }
+
+    // Arcs: "a <from> <to> <weight>" with 1-based node ids
+    QFile graphFile(graphPath);
+    if (!graphFile.open(QIODevice::ReadOnly)) {
+        setLastError("Cannot open road graph: " + graphPath);
+        return false;
+    }
+    QVector<Edge> edges;
+    while (!graphFile.atEnd()) {
+        QByteArray line = graphFile.readLine();
+        if (line.startsWith("p ")) {
+            QList<QByteArray> fields = dimacsFields(line);
+            if (fields.size() >= 4) {
+                edges.reserve(fields[3].toInt());
+            }
+        } else if (line.startsWith("a ")) {
+            QList<QByteArray> fields = dimacsFields(line);
+            if (fields.size() < 4) {
+                setLastError(QString("Invalid arc line: %1").arg(QString(line.trimmed())));
+                return false;
+            }
+            int from = fields[1].toInt() - 1;
+            int to = fields[2].toInt() - 1;
+            // A node without coordinates would sit at 0,0, where it could be
+            // snapped to and would inflate the A* speed bound
+            for (int node : {from, to}) {
+                if (node < 0 || node >= nodes.size() || !hasCoordinates[node]) {
+                    setLastError(QString("Arc references node %1, which has no coordinates")
+                        .arg(node + 1));
+                    return false;
+                }
+            }
+            edges.append(Edge{from, to, fields[3].toDouble() * secondsPerUnit});
+        }
+    }
+
+    if (!build(nodes, edges)) return false;
+    LOG_INFO(QString("Imported road graph with %1 nodes and %2 edges")
+        .arg(getNodeCount()).arg(getEdgeCount()));
+    return true;
+}
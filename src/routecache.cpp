@@ -0,0 +1,139 @@
+#include "routecache.h"
+#include "database.h"
+#include "logger.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QtMath>
+
+namespace {
+const double kKeyScale = 1e5;
+const double kGeometryScale = 1e6;
+}
+
+RouteCache::RouteCache(int maxPoints)
+    : m_routes(qMax(1, maxPoints)), m_persistent(true), m_hits(0), m_misses(0) {
+}
+
+QString RouteCache::cacheKey(const QString& profile, const QList<Address>& waypoints) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(profile.toUtf8());
+
+    QByteArray coordinates;
+    QDataStream stream(&coordinates, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << qint32(waypoints.size());
+    for (const Address& waypoint : waypoints) {
+        stream << qint32(qRound(waypoint.getLatitude() * kKeyScale))
+               << qint32(qRound(waypoint.getLongitude() * kKeyScale));
+    }
+    hash.addData(coordinates);
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool RouteCache::find(const QString& key, RoutePath& path) {
+    if (const RoutePath* cached = m_routes.object(key)) {
+        path = *cached;
+        m_hits++;
+        return true;
+    }
+
+    Database& db = Database::instance();
+    QByteArray geometry;
+    QByteArray legs;
+    if (m_persistent && db.isOpen() &&
+        db.getCachedRoute(key, geometry, legs, path.distanceKm, path.durationSeconds)) {
+        path.points = decodeGeometry(geometry);
+        path.legs = decodeLegs(legs);
+        if (!path.points.isEmpty()) {
+            m_routes.insert(key, new RoutePath(path), path.points.size());
+            m_hits++;
+            return true;
+        }
+        LOG_WARNING("Discarding unreadable cached route " + key);
+    }
+
+    m_misses++;
+    return false;
+}
+
+void RouteCache::insert(const QString& key, const QString& profile, const RoutePath& path) {
+    if (path.points.isEmpty()) return;
+
+    m_routes.insert(key, new RoutePath(path), path.points.size());
+
+    Database& db = Database::instance();
+    if (m_persistent && db.isOpen() &&
+        !db.storeCachedRoute(key, profile, encodeGeometry(path.points), encodeLegs(path.legs),
+                             path.distanceKm, path.durationSeconds)) {
+        LOG_WARNING(db.getLastError());
+    }
+}
+
+QByteArray RouteCache::encodeGeometry(const QList<QPointF>& points) {
+    // Consecutive points are close together, so the deltas are small and
+    // compress well
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << qint32(points.size());
+
+    qint32 previousX = 0;
+    qint32 previousY = 0;
+    for (const QPointF& point : points) {
+        qint32 x = qRound(point.x() * kGeometryScale);
+        qint32 y = qRound(point.y() * kGeometryScale);
+        stream << qint32(x - previousX) << qint32(y - previousY);
+        previousX = x;
+        previousY = y;
+    }
+    return qCompress(data);
+}
+
+QList<QPointF> RouteCache::decodeGeometry(const QByteArray& compressed) {
+    QList<QPointF> points;
+    QByteArray data = qUncompress(compressed);
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    qint32 count = 0;
+    stream >> count;
+    if (stream.status() != QDataStream::Ok || count < 0 ||
+        qint64(count) * 8 != qint64(data.size()) - 4) {
+        return points;
+    }
+
+    points.reserve(count);
+    qint32 x = 0;
+    qint32 y = 0;
+    for (qint32 i = 0; i < count; ++i) {
+        qint32 dx, dy;
+        stream >> dx >> dy;
+        x += dx;
+        y += dy;
+        points.append(QPointF(x / kGeometryScale, y / kGeometryScale));
+    }
+    return points;
+}
+
+QByteArray RouteCache::encodeLegs(const QVector<RouteLeg>& legs) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (const RouteLeg& leg : legs) {
+        stream << leg.distanceKm << leg.durationSeconds;
+    }
+    return data;
+}
+
+QVector<RouteLeg> RouteCache::decodeLegs(const QByteArray& data) {
+    QVector<RouteLeg> legs;
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    legs.reserve(data.size() / 16);
+    for (int i = 0; i < data.size() / 16; ++i) {
+        RouteLeg leg;
+        stream >> leg.distanceKm >> leg.durationSeconds;
+        legs.append(leg);
+    }
+    return legs;
+}
@@ -0,0 +1,551 @@
+#include "routeoptimizer.h"
+#include "geoutils.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int kNeighborCount = 10;
+const int kMaxSegmentLength = 3;
+// Above this many stops the full distance matrix is not precomputed
+const int kMatrixLimit = 2000;
+const double kEpsilon = 1e-9;
+
+struct GeoPoint {
+    double lat;     // Radians
+    double lng;     // Radians
+    double cosLat;
+};
+
+struct HaversineDistance {
+    const QVector<GeoPoint>* points;
+
+    double operator()(int a, int b) const {
+        const GeoPoint& p = (*points)[a];
+        const GeoPoint& q = (*points)[b];
+        double sinLat = std::sin((q.lat - p.lat) * 0.5);
+        double sinLng = std::sin((q.lng - p.lng) * 0.5);
+        double h = sinLat * sinLat + p.cosLat * q.cosLat * sinLng * sinLng;
+        return 2.0 * kEarthRadiusKm * std::asin(std::sqrt(qMin(1.0, h)));
+    }
+};
+
+template <typename T>
+struct MatrixDistance {
+    const T* data;
+    qint64 count;
+
+    double operator()(int a, int b) const {
+        return data[a * count + b];
+    }
+};
+
+template <typename Distance>
+double pathLength(const QVector<int>& order, const Distance& distance) {
+    double total = 0.0;
+    for (int i = 1; i < order.size(); ++i) {
+        total += distance(order[i - 1], order[i]);
+    }
+    return total;
+}
+
+// Input order with the pinned stops moved to the ends
+QVector<int> baselineOrder(int count, int startIndex, int endIndex) {
+    QVector<int> order;
+    order.reserve(count);
+    if (startIndex >= 0) order.append(startIndex);
+    for (int i = 0; i < count; ++i) {
+        if (i != startIndex && i != endIndex) order.append(i);
+    }
+    if (endIndex >= 0) order.append(endIndex);
+    return order;
+}
+
+// Construction and candidate lists check the time budget every this many
+// stops, so huge inputs return a complete (if unimproved) order on time
+const int kBudgetCheckInterval = 64;
+
+// Nearest-stop queries by scanning every stop. For matrix input, which
+// already costs count * count memory, that is proportional to the input.
+// rank(a, b) only has to order candidates correctly.
+template <typename Rank>
+class ScanIndex {
+public:
+    ScanIndex(int count, const Rank& rank) : m_rank(rank), m_visited(count, false) {}
+
+    void visit(int stop) { m_visited[stop] = true; }
+    bool isVisited(int stop) const { return m_visited[stop]; }
+
+    int nearestUnvisited(int from) const {
+        int best = -1;
+        double bestRank = std::numeric_limits<double>::max();
+        for (int i = 0; i < m_visited.size(); ++i) {
+            if (m_visited[i]) continue;
+            double r = m_rank(from, i);
+            if (r < bestRank) {
+                bestRank = r;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void nearest(int from, int k, QVector<int>& out) const {
+        m_candidates.clear();
+        for (int b = 0; b < m_visited.size(); ++b) {
+            if (b != from) m_candidates.append(qMakePair(m_rank(from, b), b));
+        }
+        std::partial_sort(m_candidates.begin(), m_candidates.begin() + k, m_candidates.end());
+        out.clear();
+        for (int i = 0; i < k; ++i) {
+            out.append(m_candidates[i].second);
+        }
+    }
+
+private:
+    const Rank& m_rank;
+    QVector<bool> m_visited;
+    mutable QVector<QPair<double, int>> m_candidates;
+};
+
+// k-d tree over the stops as points on the unit sphere, where straight-line
+// distance orders stops the same way great-circle distance does and the
+// antimeridian needs no special case. Each node keeps a count of unvisited
+// stops below it so nearest-unvisited queries skip exhausted subtrees.
+class KdTreeIndex {
+public:
+    explicit KdTreeIndex(const QVector<GeoPoint>& points)
+        : m_unvisited(points.size()), m_slot(points.size()), m_visited(points.size(), false) {
+        m_nodes.reserve(points.size());
+        for (int i = 0; i < points.size(); ++i) {
+            const GeoPoint& point = points[i];
+            m_nodes.append(Node{{point.cosLat * std::cos(point.lng),
+                                 point.cosLat * std::sin(point.lng),
+                                 std::sin(point.lat)}, i, 0});
+        }
+        build(0, m_nodes.size());
+        for (int i = 0; i < m_nodes.size(); ++i) {
+            m_slot[m_nodes[i].stop] = i;
+        }
+    }
+
+    void visit(int stop) {
+        if (m_visited[stop]) return;
+        m_visited[stop] = true;
+        // The node at a tree position is the middle of its range
+        int lo = 0;
+        int hi = m_nodes.size();
+        int slot = m_slot[stop];
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            m_unvisited[mid]--;
+            if (slot == mid) break;
+            if (slot < mid) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+    }
+
+    bool isVisited(int stop) const { return m_visited[stop]; }
+
+    int nearestUnvisited(int from) const {
+        int best = -1;
+        double bestDistance = std::numeric_limits<double>::max();
+        searchUnvisited(0, m_nodes.size(), m_nodes[m_slot[from]].v, best, bestDistance);
+        return best;
+    }
+
+    void nearest(int from, int k, QVector<int>& out) const {
+        m_best.clear();
+        if (k > 0) searchNearest(0, m_nodes.size(), m_nodes[m_slot[from]].v, from, k);
+        out.clear();
+        for (const auto& candidate : m_best) {
+            out.append(candidate.second);
+        }
+    }
+
+private:
+    struct Node {
+        double v[3];
+        int stop;
+        int axis;   // Split axis
+    };
+
+    QVector<Node> m_nodes;      // In tree order, points copied for locality
+    QVector<int> m_unvisited;   // Unvisited stops in the subtree at each position
+    QVector<int> m_slot;        // Tree position by stop
+    QVector<bool> m_visited;
+    mutable QVector<QPair<double, int>> m_best;
+
+    static double squaredDistance(const double* p, const double* q) {
+        double dx = p[0] - q[0];
+        double dy = p[1] - q[1];
+        double dz = p[2] - q[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void build(int lo, int hi) {
+        if (lo >= hi) return;
+        // Split on the axis with the widest spread
+        double low[3] = {2.0, 2.0, 2.0};
+        double high[3] = {-2.0, -2.0, -2.0};
+        for (int i = lo; i < hi; ++i) {
+            for (int d = 0; d < 3; ++d) {
+                low[d] = qMin(low[d], m_nodes[i].v[d]);
+                high[d] = qMax(high[d], m_nodes[i].v[d]);
+            }
+        }
+        int axis = 0;
+        for (int d = 1; d < 3; ++d) {
+            if (high[d] - low[d] > high[axis] - low[axis]) axis = d;
+        }
+
+        int mid = (lo + hi) / 2;
+        std::nth_element(m_nodes.begin() + lo, m_nodes.begin() + mid, m_nodes.begin() + hi,
+                         [axis](const Node& a, const Node& b) { return a.v[axis] < b.v[axis]; });
+        m_nodes[mid].axis = axis;
+        m_unvisited[mid] = hi - lo;
+        build(lo, mid);
+        build(mid + 1, hi);
+    }
+
+    void searchUnvisited(int lo, int hi, const double* target, int& best, double& bestDistance) const {
+        if (lo >= hi) return;
+        int mid = (lo + hi) / 2;
+        if (m_unvisited[mid] == 0) return;
+
+        const Node& node = m_nodes[mid];
+        if (!m_visited[node.stop]) {
+            double d = squaredDistance(target, node.v);
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = node.stop;
+            }
+        }
+        double diff = target[node.axis] - node.v[node.axis];
+        if (diff < 0.0) {
+            searchUnvisited(lo, mid, target, best, bestDistance);
+            if (diff * diff < bestDistance) searchUnvisited(mid + 1, hi, target, best, bestDistance);
+        } else {
+            searchUnvisited(mid + 1, hi, target, best, bestDistance);
+            if (diff * diff < bestDistance) searchUnvisited(lo, mid, target, best, bestDistance);
+        }
+    }
+
+    // Keeps the k closest stops other than exclude in m_best, nearest first
+    void searchNearest(int lo, int hi, const double* target, int exclude, int k) const {
+        if (lo >= hi) return;
+        int mid = (lo + hi) / 2;
+        const Node& node = m_nodes[mid];
+        if (node.stop != exclude) {
+            double d = squaredDistance(target, node.v);
+            if (m_best.size() < k || d < m_best.last().first) {
+                auto candidate = qMakePair(d, node.stop);
+                m_best.insert(std::upper_bound(m_best.begin(), m_best.end(), candidate), candidate);
+                if (m_best.size() > k) m_best.removeLast();
+            }
+        }
+        double diff = target[node.axis] - node.v[node.axis];
+        bool nearLeft = diff < 0.0;
+        searchNearest(nearLeft ? lo : mid + 1, nearLeft ? mid : hi, target, exclude, k);
+        if (m_best.size() < k || diff * diff < m_best.last().first) {
+            searchNearest(nearLeft ? mid + 1 : lo, nearLeft ? hi : mid, target, exclude, k);
+        }
+    }
+};
+
+template <typename Index>
+QVector<QVector<int>> nearestNeighbors(int count, const Index& index, const QElapsedTimer& timer,
+                                       qint64 budgetMs, bool& timedOut) {
+    int k = qMin(kNeighborCount, count - 1);
+    QVector<QVector<int>> neighbors(count);
+    for (int a = 0; a < count; ++a) {
+        if (a % kBudgetCheckInterval == 0 && timer.elapsed() > budgetMs) {
+            timedOut = true;
+            break;
+        }
+        neighbors[a].reserve(k);
+        index.nearest(a, k, neighbors[a]);
+    }
+    return neighbors;
+}
+
+template <typename Index>
+QVector<int> nearestNeighborTour(int count, int startIndex, int endIndex, Index& index,
+                                 const QElapsedTimer& timer, qint64 budgetMs, bool& timedOut) {
+    // With only the end pinned, grow the path backwards from it
+    bool reversed = startIndex < 0 && endIndex >= 0;
+    int first = startIndex >= 0 ? startIndex : (reversed ? endIndex : 0);
+    int last = reversed ? -1 : endIndex;
+
+    QVector<int> order;
+    order.reserve(count);
+    order.append(first);
+    index.visit(first);
+    if (last >= 0) index.visit(last);
+
+    int remaining = count - (last >= 0 && last != first ? 2 : 1);
+    int current = first;
+    while (remaining > 0) {
+        if (remaining % kBudgetCheckInterval == 0 && timer.elapsed() > budgetMs) {
+            // Out of time; the rest keep their input order
+            timedOut = true;
+            for (int i = 0; i < count; ++i) {
+                if (!index.isVisited(i)) order.append(i);
+            }
+            break;
+        }
+        int best = index.nearestUnvisited(current);
+        index.visit(best);
+        order.append(best);
+        current = best;
+        remaining--;
+    }
+
+    if (last >= 0 && last != first) order.append(last);
+    if (reversed) std::reverse(order.begin(), order.end());
+    return order;
+}
+
+template <typename Distance>
+class LocalSearch {
+public:
+    LocalSearch(QVector<int>& tour, const Distance& distance,
+                const QVector<QVector<int>>& neighbors, bool fixedStart, bool fixedEnd)
+        : m_tour(tour), m_distance(distance), m_neighbors(neighbors),
+          m_count(int(tour.size())), m_pos(tour.size()),
+          m_first(fixedStart ? 1 : 0), m_last(m_count - (fixedEnd ? 2 : 1)) {
+        for (int i = 0; i < m_count; ++i) {
+            m_pos[m_tour[i]] = i;
+        }
+    }
+
+    int run(const QElapsedTimer& timer, qint64 budgetMs, bool& timedOut) {
+        int improvements = 0;
+        timedOut = false;
+        if (m_last - m_first < 1) return 0;
+
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (int city = 0; city < m_count; ++city) {
+                if ((city & 31) == 0 && timer.elapsed() > budgetMs) {
+                    timedOut = true;
+                    return improvements;
+                }
+                while (improveTwoOpt(city) || improveOrOpt(city)) {
+                    improved = true;
+                    improvements++;
+                }
+            }
+        }
+        return improvements;
+    }
+
+private:
+    QVector<int>& m_tour;
+    const Distance& m_distance;
+    const QVector<QVector<int>>& m_neighbors;
+    int m_count;
+    QVector<int> m_pos;
+    // Positions that may move; pinned endpoints lie outside [m_first, m_last]
+    int m_first;
+    int m_last;
+
+    // Distance between the stops at two positions; a missing end costs nothing
+    double cost(int p, int q) const {
+        if (p < 0 || q < 0 || p >= m_count || q >= m_count) return 0.0;
+        return m_distance(m_tour[p], m_tour[q]);
+    }
+
+    void updatePositions(int from, int to) {
+        for (int i = from; i <= to; ++i) {
+            m_pos[m_tour[i]] = i;
+        }
+    }
+
+    // 2-opt: reverse tour[l..r]
+    bool tryReverse(int l, int r) {
+        if (l < m_first || r > m_last || l >= r) return false;
+        double delta = cost(l - 1, r) + cost(l, r + 1) - cost(l - 1, l) - cost(r, r + 1);
+        if (delta >= -kEpsilon) return false;
+        std::reverse(m_tour.begin() + l, m_tour.begin() + r + 1);
+        updatePositions(l, r);
+        return true;
+    }
+
+    bool improveTwoOpt(int city) {
+        for (int other : m_neighbors[city]) {
+            int i = m_pos[city];
+            int j = m_pos[other];
+            int lo = qMin(i, j);
+            int hi = qMax(i, j);
+            if (hi - lo < 2) continue;
+            // Either reversal makes city and other adjacent
+            if (tryReverse(lo + 1, hi) || tryReverse(lo, hi - 1)) return true;
+        }
+        return false;
+    }
+
+    // Or-opt: move the segment of length 1..3 starting at city next to one
+    // of its neighbors, in either orientation
+    bool improveOrOpt(int city) {
+        int i = m_pos[city];
+        for (int length = 1; length <= kMaxSegmentLength; ++length) {
+            int j = i + length - 1;
+            if (i < m_first || j > m_last || length >= m_count - 1) break;
+
+            double removeDelta = cost(i - 1, j + 1) - cost(i - 1, i) - cost(j, j + 1);
+            int head = m_tour[i];
+            int tail = m_tour[j];
+
+            for (int end = 0; end < 2; ++end) {
+                int endpoint = end == 0 ? head : tail;
+                for (int other : m_neighbors[endpoint]) {
+                    int p = m_pos[other];
+                    if (p >= i && p <= j) continue;
+                    // Gaps on either side of the neighbor: between g and g + 1
+                    for (int g = p - 1; g <= p; ++g) {
+                        if (g >= i - 1 && g <= j) continue;
+                        if (g < m_first - 1 || g > m_last) continue;
+                        double joined = cost(g, g + 1);
+                        double forward = segmentCost(g, head, g + 1, tail) - joined;
+                        double backward = segmentCost(g, tail, g + 1, head) - joined;
+                        bool reverse = backward < forward;
+                        double delta = removeDelta + (reverse ? backward : forward);
+                        if (delta < -kEpsilon) {
+                            moveSegment(i, length, g, reverse);
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Cost of linking position before -> stop a ... stop b -> position after
+    double segmentCost(int before, int a, int after, int b) const {
+        double total = 0.0;
+        if (before >= 0 && before < m_count) total += m_distance(m_tour[before], a);
+        if (after >= 0 && after < m_count) total += m_distance(b, m_tour[after]);
+        return total;
+    }
+
+    void moveSegment(int start, int length, int gap, bool reverse) {
+        QVector<int> segment = m_tour.mid(start, length);
+        if (reverse) std::reverse(segment.begin(), segment.end());
+        m_tour.remove(start, length);
+        int insertAt = gap < start ? gap + 1 : gap + 1 - length;
+        for (int k = 0; k < length; ++k) {
+            m_tour.insert(insertAt + k, segment[k]);
+        }
+        updatePositions(qMin(start, insertAt), qMax(start + length, insertAt + length) - 1);
+    }
+};
+
+template <typename Distance, typename Index>
+RouteOptimizationResult solve(int count, int startIndex, int endIndex, const Distance& distance,
+                              Index& index, const QElapsedTimer& timer, qint64 budgetMs) {
+    RouteOptimizationResult result;
+    result.order = baselineOrder(count, startIndex, endIndex);
+    result.originalDistance = pathLength(result.order, distance);
+    result.optimizedDistance = result.originalDistance;
+    if (count < 3) return result;
+
+    QVector<int> tour = nearestNeighborTour(count, startIndex, endIndex, index,
+                                            timer, budgetMs, result.timedOut);
+    if (pathLength(tour, distance) > result.originalDistance) {
+        tour = result.order;
+    }
+
+    if (!result.timedOut) {
+        QVector<QVector<int>> neighbors = nearestNeighbors(count, index, timer, budgetMs, result.timedOut);
+        if (!result.timedOut) {
+            LocalSearch<Distance> search(tour, distance, neighbors, startIndex >= 0, endIndex >= 0);
+            result.improvements = search.run(timer, budgetMs, result.timedOut);
+        }
+    }
+
+    result.order = tour;
+    result.optimizedDistance = pathLength(tour, distance);
+    return result;
+}
+
+int validIndex(int index, int count) {
+    return index >= 0 && index < count ? index : -1;
+}
+
+} // namespace
+
+RouteOptimizer::RouteOptimizer(int timeBudgetMs)
+    : m_timeBudgetMs(timeBudgetMs) {
+}
+
+RouteOptimizationResult RouteOptimizer::optimize(const QList<Address>& stops,
+                                                 int startIndex, int endIndex) const {
+    QElapsedTimer timer;
+    timer.start();
+
+    int count = stops.size();
+    startIndex = validIndex(startIndex, count);
+    endIndex = validIndex(endIndex, count);
+    if (endIndex == startIndex) endIndex = -1;
+
+    QVector<GeoPoint> points;
+    points.reserve(count);
+    for (const Address& stop : stops) {
+        double lat = qDegreesToRadians(stop.getLatitude());
+        points.append(GeoPoint{lat, qDegreesToRadians(stop.getLongitude()), std::cos(lat)});
+    }
+    HaversineDistance haversine{&points};
+
+    // Nearest stops come from a k-d tree, so construction and candidate
+    // lists stay O(n log n) however many stops there are
+    KdTreeIndex index(points);
+    RouteOptimizationResult result;
+    if (count <= kMatrixLimit) {
+        QVector<float> matrix(count * count);
+        for (int a = 0; a < count; ++a) {
+            for (int b = a + 1; b < count; ++b) {
+                float d = float(haversine(a, b));
+                matrix[a * count + b] = d;
+                matrix[b * count + a] = d;
+            }
+        }
+        MatrixDistance<float> lookup{matrix.constData(), count};
+        result = solve(count, startIndex, endIndex, lookup, index, timer, m_timeBudgetMs);
+    } else {
+        result = solve(count, startIndex, endIndex, haversine, index, timer, m_timeBudgetMs);
+    }
+
+    // Report exact distances rather than the single-precision matrix sums
+    result.originalDistance = pathLength(baselineOrder(count, startIndex, endIndex), haversine);
+    result.optimizedDistance = pathLength(result.order, haversine);
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+RouteOptimizationResult RouteOptimizer::optimize(const QVector<double>& matrix, int count,
+                                                 int startIndex, int endIndex) const {
+    QElapsedTimer timer;
+    timer.start();
+
+    if (count < 0 || qint64(count) * count > matrix.size()) {
+        return RouteOptimizationResult();
+    }
+    startIndex = validIndex(startIndex, count);
+    endIndex = validIndex(endIndex, count);
+    if (endIndex == startIndex) endIndex = -1;
+
+    MatrixDistance<double> lookup{matrix.constData(), count};
+    ScanIndex<MatrixDistance<double>> index(count, lookup);
+    RouteOptimizationResult result = solve(count, startIndex, endIndex, lookup, index,
+                                           timer, m_timeBudgetMs);
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
@@ -1,20 +1,36 @@
 #include "routingservice.h"
+#include "osrmroutingbackend.h"
+#include "geoutils.h"
 #include "logger.h"
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QUrlQuery>
-#include <QUrl>
+#include "tracer.h"
 
 RoutingService::RoutingService(QObject* parent)
-    : QObject(parent), m_networkManager(new QNetworkAccessManager(this)) {
-    m_networkManager->setTransferTimeout(30000); // 30 seconds
+    : QObject(parent), m_backend(nullptr), m_maxWaypointsPerRequest(50),
+      m_maxConcurrentRequests(4), m_activeRequests(0), m_nextSegment(0), m_completedSegments(0),
+      m_generation(0), m_traceStart(0) {
+    setBackend(new OsrmRoutingBackend(this));
 }
 
 RoutingService::~RoutingService() {
+    cancel();
+}
+
+void RoutingService::setBackend(RoutingBackend* backend) {
+    if (!backend || backend == m_backend) return;
+
+    cancel();
+    if (m_backend) {
+        m_backend->disconnect(this);
+        m_backend->deleteLater();
+    }
+    m_backend = backend;
+    m_backend->setParent(this);
+    connect(m_backend, &RoutingBackend::routeFinished, this, &RoutingService::onSegmentFinished);
 }
 
 void RoutingService::calculateRoute(const QList<Address>& waypoints) {
+    cancel();
+
     if (waypoints.size() < 2) {
         emit routeFailed("At least 2 waypoints are required for routing");
         return;
@@ -28,132 +44,161 @@ void RoutingService::calculateRoute(const QList<Address>& waypoints) {
         }
     }
 
-    QString url = buildRouteUrl(waypoints);
-    LOG_INFO(QString("Requesting route with %1 waypoints").arg(waypoints.size()));
-    LOG_DEBUG("Routing URL: " + url);
-    
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::UserAgentHeader, "MapAddress/1.0 Qt Application");
-    
-    QNetworkReply* reply = m_networkManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, &RoutingService::onRouteRequestFinished);
+    // Consecutive segments overlap by one waypoint so their geometries join up
+    m_waypoints = waypoints;
+    int step = m_maxWaypointsPerRequest - 1;
+    for (int first = 0; first < waypoints.size() - 1; first += step) {
+        RouteSegment segment;
+        segment.firstWaypoint = first;
+        segment.lastWaypoint = qMin(first + step, int(waypoints.size()) - 1);
+        segment.cached = false;
+        m_segments.append(segment);
+    }
+
+    LOG_INFO(QString("Requesting route with %1 waypoints in %2 segment(s)")
+        .arg(waypoints.size()).arg(m_segments.size()));
+    m_traceStart = Tracer::startTime();
+    startPendingSegments();
 }
 
-QString RoutingService::buildRouteUrl(const QList<Address>& waypoints) const {
-    // Using OpenRouteService (ORS) API
-    // Alternative: OSRM (https://router.project-osrm.org/route/v1/driving/)
-    
-    // Build coordinates string: lon,lat;lon,lat;...
-    QStringList coordinates;
-    for (const Address& addr : waypoints) {
-        coordinates << QString("%1,%2")
-            .arg(addr.getLongitude(), 0, 'f', 6)
-            .arg(addr.getLatitude(), 0, 'f', 6);
+void RoutingService::cancel() {
+    // The backend drops the results of everything requested so far
+    if (m_backend) {
+        m_backend->cancelAll();
     }
-    
-    // Using public OSRM demo server (for testing - consider hosting your own)
-    QString url = QString("https://router.project-osrm.org/route/v1/driving/%1?overview=full&geometries=geojson")
-        .arg(coordinates.join(";"));
-    
-    return url;
+    m_generation++;
+    m_activeRequests = 0;
+    m_waypoints.clear();
+    m_segments.clear();
+    m_nextSegment = 0;
+    m_completedSegments = 0;
+    m_traceStart = 0;
 }
 
-void RoutingService::onRouteRequestFinished() {
-    QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-    if (!reply) return;
-
-    reply->deleteLater();
-
-    if (reply->error() != QNetworkReply::NoError) {
-        QString errorMsg;
-        switch (reply->error()) {
-            case QNetworkReply::ConnectionRefusedError:
-            case QNetworkReply::HostNotFoundError:
-                errorMsg = "Cannot reach routing service. Please check your internet connection.";
-                break;
-            case QNetworkReply::TimeoutError:
-                errorMsg = "Routing request timed out. Please try again.";
-                break;
-            default:
-                errorMsg = "Routing error: " + reply->errorString();
-        }
-        LOG_ERROR("Routing request failed: " + errorMsg);
-        emit routeFailed(errorMsg);
-        return;
-    }
+void RoutingService::startPendingSegments() {
+    QString profile = m_backend->getProfile();
+    while (m_activeRequests < m_maxConcurrentRequests && m_nextSegment < m_segments.size()) {
+        int index = m_nextSegment++;
+        RouteSegment& segment = m_segments[index];
+        QList<Address> waypoints = m_waypoints.mid(segment.firstWaypoint,
+                                                   segment.lastWaypoint - segment.firstWaypoint + 1);
+        m_activeRequests++;
 
-    QByteArray data = reply->readAll();
-    LOG_DEBUG("Routing response: " + QString(data));
-    
-    QList<QPointF> routePoints = parseRouteResponse(data);
-    
-    if (routePoints.isEmpty()) {
-        LOG_WARNING("No route found in response");
-        emit routeFailed("No route found between the waypoints");
-        return;
+        if (!profile.isEmpty()) {
+            segment.cacheKey = RouteCache::cacheKey(profile, waypoints);
+            RoutePath path;
+            if (m_cache.find(segment.cacheKey, path)) {
+                // Keep the asynchronous contract callers rely on
+                segment.cached = true;
+                int generation = m_generation;
+                QMetaObject::invokeMethod(this, [this, index, path, generation]() {
+                    if (generation == m_generation) {
+                        onSegmentFinished(index, path, QString());
+                    }
+                }, Qt::QueuedConnection);
+                continue;
+            }
+        }
+        m_backend->requestRoute(index, waypoints);
     }
-    
-    LOG_INFO(QString("Route calculated with %1 points").arg(routePoints.size()));
-    emit routeCalculated(routePoints);
 }
 
-QList<QPointF> RoutingService::parseRouteResponse(const QByteArray& data) const {
-    QList<QPointF> points;
-    
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (!doc.isObject()) {
-        LOG_ERROR("Invalid routing response: not a JSON object");
-        return points;
-    }
-    
-    QJsonObject root = doc.object();
-    
-    // Check for errors
-    if (root.contains("code")) {
-        QString code = root["code"].toString();
-        if (code != "Ok") {
-            LOG_ERROR("Routing service returned error: " + code);
-            return points;
+void RoutingService::onSegmentFinished(int index, const RoutePath& path, const QString& error) {
+    if (index < 0 || index >= m_segments.size()) return;
+    m_activeRequests--;
+
+    RouteSegment& segment = m_segments[index];
+    segment.path = path;
+    segment.error = error;
+
+    // Fill in what the backend left out before the path is cached
+    if (segment.error.isEmpty() && !segment.cached) {
+        if (segment.path.distanceKm <= 0.0) {
+            segment.path.distanceKm = polylineLengthKm(segment.path.points);
+        }
+        if (segment.path.legs.isEmpty() && segment.lastWaypoint - segment.firstWaypoint == 1) {
+            segment.path.legs.append(RouteLeg{segment.path.distanceKm, segment.path.durationSeconds});
         }
     }
-    
-    // Parse OSRM GeoJSON response
-    if (!root.contains("routes") || !root["routes"].isArray()) {
-        LOG_ERROR("No routes in response");
-        return points;
+
+    if (segment.error.isEmpty() && !segment.cached && !segment.cacheKey.isEmpty()) {
+        m_cache.insert(segment.cacheKey, m_backend->getProfile(), segment.path);
     }
-    
-    QJsonArray routes = root["routes"].toArray();
-    if (routes.isEmpty()) {
-        LOG_ERROR("Routes array is empty");
-        return points;
+
+    if (!segment.error.isEmpty()) {
+        LOG_ERROR(QString("Route segment %1 (waypoints %2-%3) failed: %4")
+            .arg(index).arg(segment.firstWaypoint).arg(segment.lastWaypoint).arg(segment.error));
+        emit segmentFailed(index, segment.firstWaypoint, segment.lastWaypoint, segment.error);
     }
-    
-    QJsonObject route = routes[0].toObject();
-    if (!route.contains("geometry") || !route["geometry"].isObject()) {
-        LOG_ERROR("No geometry in route");
-        return points;
+
+    m_completedSegments++;
+    emit routeProgress(m_completedSegments, m_segments.size());
+
+    if (m_completedSegments == m_segments.size()) {
+        finishRoute();
+    } else {
+        startPendingSegments();
     }
-    
-    QJsonObject geometry = route["geometry"].toObject();
-    if (!geometry.contains("coordinates") || !geometry["coordinates"].isArray()) {
-        LOG_ERROR("No coordinates in geometry");
-        return points;
+}
+
+void RoutingService::finishRoute() {
+    TRACE_SCOPE("routing", "RoutingService::finishRoute");
+    Tracer::instance().addAsyncSpan("routing", "Route calculation", m_traceStart);
+    m_traceStart = 0;
+    RouteResult route;
+    QList<QPointF>& routePoints = route.points;
+    bool hasLegs = true;
+    int cachedSegments = 0;
+    QStringList failures;
+
+    for (int i = 0; i < m_segments.size(); ++i) {
+        const RouteSegment& segment = m_segments[i];
+        if (!segment.error.isEmpty()) {
+            failures << QString("waypoints %1-%2: %3")
+                .arg(segment.firstWaypoint + 1).arg(segment.lastWaypoint + 1).arg(segment.error);
+            continue;
+        }
+
+        // Segments share a waypoint; drop the duplicated joint
+        const QList<QPointF>& points = segment.path.points;
+        int skip = (!routePoints.isEmpty() && points.first() == routePoints.last()) ? 1 : 0;
+        routePoints.reserve(routePoints.size() + points.size() - skip);
+        for (int p = skip; p < points.size(); ++p) {
+            routePoints.append(points[p]);
+        }
+        route.distanceKm += segment.path.distanceKm;
+        route.durationSeconds += segment.path.durationSeconds;
+        if (segment.path.legs.size() == segment.lastWaypoint - segment.firstWaypoint) {
+            route.legs += segment.path.legs;
+        } else {
+            hasLegs = false;
+        }
+        if (segment.cached) cachedSegments++;
     }
-    
-    QJsonArray coordinates = geometry["coordinates"].toArray();
-    
-    // Coordinates are in [lon, lat] format
-    for (const QJsonValue& coord : coordinates) {
-        if (coord.isArray()) {
-            QJsonArray c = coord.toArray();
-            if (c.size() >= 2) {
-                double lon = c[0].toDouble();
-                double lat = c[1].toDouble();
-                points.append(QPointF(lon, lat));
-            }
+
+    int segmentCount = m_segments.size();
+    QString firstError = m_segments.first().error;
+    m_waypoints.clear();
+    m_segments.clear();
+    m_nextSegment = 0;
+    m_completedSegments = 0;
+
+    if (!failures.isEmpty()) {
+        if (segmentCount == 1) {
+            emit routeFailed(firstError);
+        } else {
+            emit routeFailed(QString("%1 of %2 route segments failed:\n%3")
+                .arg(failures.size()).arg(segmentCount).arg(failures.join("\n")));
         }
+        return;
+    }
+
+    if (!hasLegs) {
+        route.legs.clear();
     }
-    
-    return points;
+
+    LOG_INFO(QString("Route calculated with %1 points, %2 km, %3 min (%4 of %5 segments cached)")
+        .arg(routePoints.size()).arg(route.distanceKm, 0, 'f', 1).arg(route.durationSeconds / 60.0, 0, 'f', 0)
+        .arg(cachedSegments).arg(segmentCount));
+    emit routeCalculated(route);
 }
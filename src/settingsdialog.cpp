@@ -1,6 +1,7 @@
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
 #include "logger.h"
+#include <QFileDialog>
 #include <QMessageBox>
 #include <QPushButton>
 
@@ -15,6 +16,8 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     connect(ui->showGoogleKeyCheckBox, &QCheckBox::toggled, this, &SettingsDialog::onShowGoogleKeyToggled);
     connect(ui->buttonBox->button(QDialogButtonBox::RestoreDefaults), &QPushButton::clicked,
             this, &SettingsDialog::onRestoreDefaults);
+    connect(ui->browseRoadGraphButton, &QPushButton::clicked, this, &SettingsDialog::onBrowseRoadGraph);
+    connect(ui->localRoutingRadio, &QRadioButton::toggled, this, &SettingsDialog::updateRoutingControls);
     
     loadSettings();
 }
@@ -38,6 +41,21 @@ void SettingsDialog::loadSettings()
         ui->osmRadio->setChecked(true);
     }
     
+    // Load marker clustering
+    bool clusterMarkers = m_settings->value("Map/ClusterMarkers", false).toBool();
+    ui->clusterMarkersCheckBox->setChecked(clusterMarkers);
+    
+    // Load routing backend
+    QString routingBackend = m_settings->value("Routing/Backend", "osrm").toString();
+    if (routingBackend == "local") {
+        ui->localRoutingRadio->setChecked(true);
+    } else {
+        ui->osrmRadio->setChecked(true);
+    }
+    ui->osrmServerLineEdit->setText(m_settings->value("Routing/OsrmServer", "").toString());
+    ui->roadGraphLineEdit->setText(m_settings->value("Routing/RoadGraphPath", "").toString());
+    updateRoutingControls();
+    
     // Load log level
     int logLevel = m_settings->value("General/LogLevel", 1).toInt(); // 1 = Info
     ui->logLevelComboBox->setCurrentIndex(logLevel);
@@ -56,6 +74,14 @@ void SettingsDialog::saveSettings()
     QString provider = ui->googleMapsRadio->isChecked() ? "google" : "osm";
     m_settings->setValue("Map/DefaultProvider", provider);
     
+    // Save marker clustering
+    m_settings->setValue("Map/ClusterMarkers", ui->clusterMarkersCheckBox->isChecked());
+    
+    // Save routing backend
+    m_settings->setValue("Routing/Backend", getRoutingBackend());
+    m_settings->setValue("Routing/OsrmServer", getOsrmServer());
+    m_settings->setValue("Routing/RoadGraphPath", getRoadGraphPath());
+    
     // Save log level
     m_settings->setValue("General/LogLevel", ui->logLevelComboBox->currentIndex());
     
@@ -76,6 +102,10 @@ void SettingsDialog::restoreDefaults()
 {
     ui->googleMapsApiKeyLineEdit->clear();
     ui->osmRadio->setChecked(true);
+    ui->clusterMarkersCheckBox->setChecked(false);
+    ui->osrmRadio->setChecked(true);
+    ui->osrmServerLineEdit->clear();
+    ui->roadGraphLineEdit->clear();
     ui->logLevelComboBox->setCurrentIndex(1); // Info
     ui->loadLastListCheckBox->setChecked(true);
 }
@@ -90,6 +120,26 @@ QString SettingsDialog::getDefaultMapProvider() const
     return ui->googleMapsRadio->isChecked() ? "google" : "osm";
 }
 
+bool SettingsDialog::getClusterMarkers() const
+{
+    return ui->clusterMarkersCheckBox->isChecked();
+}
+
+QString SettingsDialog::getRoutingBackend() const
+{
+    return ui->localRoutingRadio->isChecked() ? "local" : "osrm";
+}
+
+QString SettingsDialog::getOsrmServer() const
+{
+    return ui->osrmServerLineEdit->text().trimmed();
+}
+
+QString SettingsDialog::getRoadGraphPath() const
+{
+    return ui->roadGraphLineEdit->text().trimmed();
+}
+
 int SettingsDialog::getLogLevel() const
 {
     return ui->logLevelComboBox->currentIndex();
@@ -107,6 +157,23 @@ void SettingsDialog::onShowGoogleKeyToggled(bool checked)
     );
 }
 
+void SettingsDialog::onBrowseRoadGraph()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Select Road Graph", ui->roadGraphLineEdit->text(),
+        "Road graphs (*.graph *.gr);;All files (*)");
+    if (!path.isEmpty()) {
+        ui->roadGraphLineEdit->setText(path);
+    }
+}
+
+void SettingsDialog::updateRoutingControls()
+{
+    bool local = ui->localRoutingRadio->isChecked();
+    ui->osrmServerLineEdit->setEnabled(!local);
+    ui->roadGraphLineEdit->setEnabled(local);
+    ui->browseRoadGraphButton->setEnabled(local);
+}
+
 void SettingsDialog::onRestoreDefaults()
 {
     auto reply = QMessageBox::question(this, "Restore Defaults",
@@ -132,6 +199,14 @@ void SettingsDialog::accept()
         }
     }
     
+    // Offline routing needs a road graph
+    if (ui->localRoutingRadio->isChecked() && getRoadGraphPath().isEmpty()) {
+        QMessageBox::warning(this, "Missing Road Graph",
+            "Select a road graph file for offline routing.");
+        ui->tabWidget->setCurrentWidget(ui->routingTab);
+        return;
+    }
+    
     saveSettings();
     QDialog::accept();
 }
@@ -0,0 +1,61 @@
+#include "tokenbucket.h"
+#include <QtGlobal>
+#include <cmath>
+
+TokenBucket::TokenBucket(double ratePerSecond, double capacity)
+    : m_rate(ratePerSecond), m_capacity(capacity), m_tokens(capacity), m_lastRefillMs(0) {
+    m_clock.start();
+}
+
+void TokenBucket::setRate(double ratePerSecond, double capacity) {
+    m_rate = ratePerSecond;
+    m_capacity = capacity;
+    m_tokens = qMin(m_tokens, m_capacity);
+}
+
+double TokenBucket::tokensAt(qint64 nowMs) const {
+    double elapsed = qMax<qint64>(0, nowMs - m_lastRefillMs) / 1000.0;
+    return qMin(m_capacity, m_tokens + elapsed * m_rate);
+}
+
+bool TokenBucket::tryAcquire() {
+    return tryAcquire(m_clock.elapsed());
+}
+
+bool TokenBucket::tryAcquire(qint64 nowMs) {
+    m_tokens = tokensAt(nowMs);
+    m_lastRefillMs = nowMs;
+    if (m_tokens < 1.0) {
+        return false;
+    }
+    m_tokens -= 1.0;
+    return true;
+}
+
+void TokenBucket::refund() {
+    m_tokens = qMin(m_capacity, m_tokens + 1.0);
+}
+
+qint64 TokenBucket::msUntilAvailable() const {
+    return msUntilAvailable(m_clock.elapsed());
+}
+
+qint64 TokenBucket::msUntilAvailable(qint64 nowMs) const {
+    double missing = 1.0 - tokensAt(nowMs);
+    if (missing <= 0.0) {
+        return 0;
+    }
+    if (m_rate <= 0.0) {
+        return -1;
+    }
+    return qint64(std::ceil(missing * 1000.0 / m_rate));
+}
+
+void TokenBucket::reset() {
+    reset(m_clock.elapsed());
+}
+
+void TokenBucket::reset(qint64 nowMs) {
+    m_tokens = m_capacity;
+    m_lastRefillMs = nowMs;
+}
@@ -0,0 +1,210 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QThread>
+#include <chrono>
+
+namespace {
+const int kDefaultCapacity = 16384;
+
+thread_local std::shared_ptr<void> currentBuffer;
+
+// Names are string literals in the sources, but escape them anyway so a
+// stray quote cannot break the file
+void appendJsonString(QByteArray& out, const char* text) {
+    out.append('"');
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out.append('\\');
+            out.append(*c);
+        } else if (quint8(*c) < 0x20) {
+            out.append(QByteArray("\\u00") + QByteArray::number(quint8(*c), 16).rightJustified(2, '0'));
+        } else {
+            out.append(*c);
+        }
+    }
+    out.append('"');
+}
+
+QByteArray microseconds(qint64 nanoseconds) {
+    return QByteArray::number(nanoseconds / 1000.0, 'f', 3);
+}
+}
+
+std::atomic<bool> Tracer::s_enabled(false);
+
+Tracer& Tracer::instance() {
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer()
+    : m_epoch(now()), m_capacity(kDefaultCapacity), m_nextAsyncId(1) {
+}
+
+void Tracer::setEnabled(bool enabled) {
+    s_enabled.store(enabled);
+}
+
+qint64 Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::addSpan(const char* category, const char* name, qint64 start) {
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = now() - start;
+    record(event);
+}
+
+void Tracer::addAsyncSpan(const char* category, const char* name, qint64 start) {
+    if (start == 0 || !isEnabled()) {
+        return;
+    }
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = now() - start;
+    event.asyncId = m_nextAsyncId.fetch_add(1, std::memory_order_relaxed);
+    record(event);
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    // The registry holds a reference too, so events of threads that have
+    // finished, like thread pool workers, are still exported
+    if (!currentBuffer) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        QThread* thread = QThread::currentThread();
+        buffer->threadName = thread->objectName();
+
+        std::lock_guard<std::mutex> registry(m_registryMutex);
+        buffer->threadId = int(m_buffers.size()) + 1;
+        if (buffer->threadName.isEmpty()) {
+            bool isMain = QCoreApplication::instance() && QCoreApplication::instance()->thread() == thread;
+            buffer->threadName = isMain ? QString("Main thread")
+                                        : QString("Thread %1").arg(buffer->threadId);
+        }
+        m_buffers.push_back(buffer);
+        currentBuffer = buffer;
+    }
+    return *static_cast<ThreadBuffer*>(currentBuffer.get());
+}
+
+void Tracer::record(const Event& event) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::size_t capacity = std::size_t(m_capacity.load(std::memory_order_relaxed));
+
+    // Only the exporter ever waits on this lock
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() < capacity) {
+        buffer.events.push_back(event);
+    } else if (capacity > 0) {
+        buffer.events[buffer.next] = event;
+        buffer.next = (buffer.next + 1) % capacity;
+    }
+}
+
+void Tracer::setBufferCapacity(int events) {
+    m_capacity.store(qMax(0, events));
+    clear();
+}
+
+int Tracer::getBufferCapacity() const {
+    return m_capacity.load();
+}
+
+int Tracer::getEventCount() const {
+    std::lock_guard<std::mutex> registry(m_registryMutex);
+    int count = 0;
+    for (const auto& buffer : m_buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        count += int(buffer->events.size());
+    }
+    return count;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> registry(m_registryMutex);
+    for (const auto& buffer : m_buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        buffer->events.clear();
+        buffer->events.shrink_to_fit();
+        buffer->next = 0;
+    }
+}
+
+QByteArray Tracer::toChromeTrace() const {
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    auto beginEvent = [&out, &first]() {
+        out.append(first ? "\n{" : ",\n{");
+        first = false;
+    };
+
+    std::lock_guard<std::mutex> registry(m_registryMutex);
+    for (const auto& buffer : m_buffers) {
+        std::vector<Event> events;
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            // Oldest first once the ring has wrapped
+            events.reserve(buffer->events.size());
+            events.insert(events.end(), buffer->events.begin() + buffer->next, buffer->events.end());
+            events.insert(events.end(), buffer->events.begin(), buffer->events.begin() + buffer->next);
+        }
+        if (events.empty()) {
+            continue;
+        }
+
+        const QByteArray tid = QByteArray::number(buffer->threadId);
+        const QByteArray ids = ",\"pid\":" + pid + ",\"tid\":" + tid;
+        beginEvent();
+        out.append("\"name\":\"thread_name\",\"ph\":\"M\"" + ids + ",\"args\":{\"name\":");
+        appendJsonString(out, buffer->threadName.toUtf8().constData());
+        out.append("}}");
+
+        for (const Event& event : events) {
+            beginEvent();
+            out.append("\"name\":");
+            appendJsonString(out, event.name);
+            out.append(",\"cat\":");
+            appendJsonString(out, event.category);
+            if (event.asyncId == 0) {
+                out.append(",\"ph\":\"X\",\"ts\":" + microseconds(event.start - m_epoch) +
+                           ",\"dur\":" + microseconds(event.duration) + ids + "}");
+                continue;
+            }
+
+            // Async spans are a begin/end pair matched by category, name and id
+            const QByteArray id = ",\"id\":" + QByteArray::number(event.asyncId);
+            out.append(",\"ph\":\"b\",\"ts\":" + microseconds(event.start - m_epoch) + id + ids + "}");
+            beginEvent();
+            out.append("\"name\":");
+            appendJsonString(out, event.name);
+            out.append(",\"cat\":");
+            appendJsonString(out, event.category);
+            out.append(",\"ph\":\"e\",\"ts\":" + microseconds(event.start + event.duration - m_epoch) +
+                       id + ids + "}");
+        }
+    }
+    out.append("\n]}\n");
+    return out;
+}
+
+bool Tracer::exportChromeTrace(const QString& filePath) {
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_lastError = "Failed to open trace file: " + file.errorString();
+        return false;
+    }
+    QByteArray trace = toChromeTrace();
+    if (file.write(trace) != trace.size() || !file.commit()) {
+        m_lastError = "Failed to write trace file: " + file.errorString();
+        return false;
+    }
+    return true;
+}
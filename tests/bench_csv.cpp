@@ -0,0 +1,136 @@
+#include <QtTest/QtTest>
+#include "csvreader.h"
+#include "csvimportworker.h"
+#include "csvwriter.h"
+#include <QBuffer>
+#include <QTemporaryDir>
+
+// CSV parsing, file import and export benchmarks at 1k to 1M rows. Not
+// registered with ctest; run bench_csv directly or through the benchmarks
+// target.
+class BenchCsv : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void benchReadRecords_data();
+    void benchReadRecords();
+    void benchImportFile_data();
+    void benchImportFile();
+    void benchWriteAddresses_data();
+    void benchWriteAddresses();
+
+private:
+    QTemporaryDir m_tempDir;
+
+    static void addSizes();
+    static QList<Address> makeAddresses(int count);
+    static QByteArray makeCsv(int count);
+};
+
+void BenchCsv::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+}
+
+void BenchCsv::addSizes()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+QList<Address> BenchCsv::makeAddresses(int count)
+{
+    // Every tenth street has an embedded delimiter
+    QList<Address> addresses;
+    addresses.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QString street = i % 10 == 0 ? QString("%1 Elm St, Apt %2").arg(i).arg(i % 40)
+                                     : QString("%1 Elm St").arg(i);
+        addresses.append(Address(0, street, "Springfield", "IL", "62701", "USA",
+                                 39.78 + (i % 1000) * 1e-4, -89.65 - (i / 1000) * 1e-4));
+    }
+    return addresses;
+}
+
+QByteArray BenchCsv::makeCsv(int count)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    CsvWriter::writeAddresses(&buffer, makeAddresses(count));
+    return buffer.data();
+}
+
+void BenchCsv::benchReadRecords_data()
+{
+    addSizes();
+}
+
+void BenchCsv::benchReadRecords()
+{
+    QFETCH(int, count);
+    const QByteArray csv = makeCsv(count);
+
+    // Tokenizing and field conversion without the file and signal overhead
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        CsvReader reader(csv.constData(), csv.size());
+        QVector<CsvField> fields;
+        Address address;
+        reader.readRecord(fields); // Header
+        while (reader.readRecord(fields)) {
+            if (CsvImportWorker::parseAddress(fields, address)) parsed++;
+        }
+    }
+    QCOMPARE(parsed, count);
+}
+
+void BenchCsv::benchImportFile_data()
+{
+    addSizes();
+}
+
+void BenchCsv::benchImportFile()
+{
+    QFETCH(int, count);
+    QString path = m_tempDir.filePath(QString("import-%1.csv").arg(count));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(makeCsv(count));
+    file.close();
+
+    int imported = 0;
+    QBENCHMARK {
+        CsvImportWorker worker(path);
+        connect(&worker, &CsvImportWorker::finished, this,
+                [&imported](int parsedCount, int, bool) { imported = parsedCount; });
+        worker.run();
+    }
+    QCOMPARE(imported, count);
+}
+
+void BenchCsv::benchWriteAddresses_data()
+{
+    addSizes();
+}
+
+void BenchCsv::benchWriteAddresses()
+{
+    QFETCH(int, count);
+    const QList<Address> addresses = makeAddresses(count);
+
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(CsvWriter::writeAddresses(&buffer, addresses));
+    }
+}
+
+QTEST_MAIN(BenchCsv)
+#include "bench_csv.moc"
@@ -0,0 +1,253 @@
+#include <QtTest/QtTest>
+#include "database.h"
+#include <QTemporaryDir>
+#include <QSqlQuery>
+
+// List load, search and spatial query benchmarks against a database holding 1M addresses spread over
+// 1000 lists, plus inserts and list loads at 1k to 1M addresses per list. Not registered with ctest;
+// run bench_database directly or through the benchmarks target (set MAPADDRESS_BENCH_ROWS to change
+// the total row count).
+class BenchDatabase : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    
+    void benchGetAddressesForList();
+    void benchGetAddressCached();
+    void benchGetAddressesForListFullScan();
+    void benchSearchAddresses();
+    void benchSearchAddressIdsInList();
+    void benchAddressesInBounds();
+    void benchNearestAddresses();
+    void benchAddAddress_data();
+    void benchAddAddress();
+    void benchAddAddresses_data();
+    void benchAddAddresses();
+    void benchGetAddressesForListSize_data();
+    void benchGetAddressesForListSize();
+
+private:
+    QTemporaryDir m_tempDir;
+    QList<int> m_listIds;
+    int m_rowsPerList = 0;
+    QHash<int, int> m_sizedLists; // address count -> list id
+
+    static void addSizes();
+    static QList<Address> makeAddresses(int count);
+    int sizedList(int count);
+};
+
+void BenchDatabase::addSizes()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+QList<Address> BenchDatabase::makeAddresses(int count)
+{
+    QList<Address> addresses;
+    addresses.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        addresses.append(Address(0, QString("%1 Oak Ave").arg(i), "Shelbyville", "IL", "62565", "USA",
+                                 39.40 + (i % 1000) * 1e-4, -88.79 - (i / 1000) * 1e-4));
+    }
+    return addresses;
+}
+
+int BenchDatabase::sizedList(int count)
+{
+    if (!m_sizedLists.contains(count)) {
+        int listId = Database::instance().createList(QString("Sized %1").arg(count));
+        Database::instance().addAddresses(listId, makeAddresses(count));
+        m_sizedLists.insert(count, listId);
+    }
+    return m_sizedLists.value(count);
+}
+
+void BenchDatabase::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    QVERIFY(Database::instance().initialize(m_tempDir.path() + "/bench.db"));
+    
+    int totalRows = qEnvironmentVariableIntValue("MAPADDRESS_BENCH_ROWS");
+    if (totalRows <= 0) {
+        totalRows = 1000000;
+    }
+    const int listCount = 1000;
+    m_rowsPerList = qMax(1, totalRows / listCount);
+    
+    QList<Address> batch;
+    for (int i = 0; i < m_rowsPerList; ++i) {
+        batch.append(Address(0, QString("%1 Main St").arg(i), "Springfield", "IL", "62701", "USA",
+                             39.78 + i * 1e-5, -89.65 - i * 1e-5));
+    }
+    
+    // Insert time is measured by benchAddAddresses, not here
+    for (int i = 0; i < listCount; ++i) {
+        int listId = Database::instance().createList(QString("List %1").arg(i));
+        QVERIFY(listId > 0);
+        QCOMPARE(Database::instance().addAddresses(listId, batch).size(), m_rowsPerList);
+        m_listIds.append(listId);
+    }
+}
+
+void BenchDatabase::cleanupTestCase()
+{
+    Database::instance().close();
+}
+
+void BenchDatabase::benchGetAddressesForList()
+{
+    // Switch lists on every iteration so each load misses the list cache
+    int next = 0;
+    QList<Address> addresses;
+    QBENCHMARK {
+        addresses = Database::instance().getAddressesForList(m_listIds[next++ % m_listIds.size()]);
+    }
+    QCOMPARE(addresses.size(), m_rowsPerList);
+}
+
+void BenchDatabase::benchGetAddressCached()
+{
+    int listId = m_listIds[m_listIds.size() / 2];
+    QList<Address> addresses = Database::instance().getAddressesForList(listId);
+    int addressId = addresses[addresses.size() / 2].getId();
+    Address address;
+    QBENCHMARK {
+        address = Database::instance().getAddress(addressId);
+    }
+    QCOMPARE(address.getId(), addressId);
+}
+
+void BenchDatabase::benchGetAddressesForListFullScan()
+{
+    // Same query with the list_id index bypassed, for comparison
+    int listId = m_listIds[m_listIds.size() / 2];
+    int count = 0;
+    QBENCHMARK {
+        QSqlQuery query;
+        query.prepare(R"(
+            SELECT id, street, city, state, zip, country, latitude, longitude
+            FROM addresses NOT INDEXED WHERE list_id = ?
+        )");
+        query.addBindValue(listId);
+        QVERIFY(query.exec());
+        count = 0;
+        while (query.next()) {
+            count++;
+        }
+    }
+    QCOMPARE(count, m_rowsPerList);
+}
+
+void BenchDatabase::benchSearchAddresses()
+{
+    // One street number per list matches, so every list contributes a hit
+    QString text = QString("%1 main").arg(m_rowsPerList / 2);
+    QList<AddressSearchHit> hits;
+    QBENCHMARK {
+        hits = Database::instance().searchAddresses(text, 20);
+    }
+    QCOMPARE(hits.size(), qMin(20, m_listIds.size()));
+}
+
+void BenchDatabase::benchSearchAddressIdsInList()
+{
+    int listId = m_listIds[m_listIds.size() / 2];
+    QSet<int> ids;
+    QBENCHMARK {
+        ids = Database::instance().searchAddressIds("1", listId);
+    }
+    QVERIFY(!ids.isEmpty());
+}
+
+void BenchDatabase::benchAddressesInBounds()
+{
+    // Every list repeats the same coordinates; a box around ten of them
+    // holds ten rows per list
+    double lat = 39.78 + (m_rowsPerList / 2) * 1e-5;
+    double lng = -89.65 - (m_rowsPerList / 2) * 1e-5;
+    QList<Address> addresses;
+    QBENCHMARK {
+        addresses = Database::instance().getAddressesInBounds(lat - 5e-5, lng - 5e-5, lat + 4.5e-5, lng + 4.5e-5);
+    }
+    QVERIFY(!addresses.isEmpty());
+}
+
+void BenchDatabase::benchNearestAddresses()
+{
+    int listId = m_listIds[m_listIds.size() / 2];
+    QList<Address> addresses;
+    QBENCHMARK {
+        addresses = Database::instance().getNearestAddresses(39.0, -89.0, 10, listId);
+    }
+    QCOMPARE(addresses.size(), qMin(10, m_rowsPerList));
+}
+
+void BenchDatabase::benchAddAddress_data()
+{
+    // One transaction per row; larger sizes only repeat the same cost
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+}
+
+void BenchDatabase::benchAddAddress()
+{
+    QFETCH(int, count);
+    const QList<Address> addresses = makeAddresses(count);
+    int listId = Database::instance().createList("Single inserts");
+    int added = 0;
+    QBENCHMARK_ONCE {
+        for (const Address& address : addresses) {
+            if (Database::instance().addAddress(listId, address) > 0) added++;
+        }
+    }
+    QCOMPARE(added, count);
+    QVERIFY(Database::instance().deleteList(listId));
+}
+
+void BenchDatabase::benchAddAddresses_data()
+{
+    addSizes();
+}
+
+void BenchDatabase::benchAddAddresses()
+{
+    QFETCH(int, count);
+    const QList<Address> addresses = makeAddresses(count);
+    int listId = Database::instance().createList("Bulk insert");
+    QList<int> ids;
+    QBENCHMARK_ONCE {
+        ids = Database::instance().addAddresses(listId, addresses);
+    }
+    QCOMPARE(ids.size(), count);
+    QVERIFY(Database::instance().deleteList(listId));
+}
+
+void BenchDatabase::benchGetAddressesForListSize_data()
+{
+    addSizes();
+}
+
+void BenchDatabase::benchGetAddressesForListSize()
+{
+    QFETCH(int, count);
+    int listId = sizedList(count);
+    QList<Address> addresses;
+    QBENCHMARK {
+        // Measure the query, not the single-list cache
+        Database::instance().invalidateCache();
+        addresses = Database::instance().getAddressesForList(listId);
+    }
+    QCOMPARE(addresses.size(), count);
+}
+
+QTEST_MAIN(BenchDatabase)
+#include "bench_database.moc"
@@ -0,0 +1,142 @@
+#include <QtTest/QtTest>
+#include "openstreetmapprovider.h"
+#include "googlemapsprovider.h"
+#include <memory>
+
+// Marker store and page generation benchmarks at 1k to 1M markers. Not
+// registered with ctest; run bench_mapprovider directly or through the
+// benchmarks target.
+class BenchMapProvider : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void benchAddMarkers_data();
+    void benchAddMarkers();
+    void benchPackAllMarkers_data();
+    void benchPackAllMarkers();
+    void benchPackViewport_data();
+    void benchPackViewport();
+    void benchGetHtml_data();
+    void benchGetHtml();
+
+private:
+    void addSizes();
+    void fill(MapProvider& provider, int count);
+};
+
+void BenchMapProvider::initTestCase()
+{
+    // Keeps the Google page from warning about the missing key on every iteration
+    if (qEnvironmentVariableIsEmpty("GOOGLE_MAPS_API_KEY")) {
+        qputenv("GOOGLE_MAPS_API_KEY", "benchmark");
+    }
+}
+
+void BenchMapProvider::addSizes()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+void BenchMapProvider::fill(MapProvider& provider, int count)
+{
+    // Spread over a few hundred cities so titles repeat like real lists do
+    for (int i = 0; i < count; ++i) {
+        provider.addMarker(i + 1, -60.0 + (i % 1200) * 0.1, -180.0 + (i / 1200 % 3600) * 0.1,
+                           QString("%1 Main St, City %2, ST").arg(i % 500).arg(i % 300));
+    }
+}
+
+void BenchMapProvider::benchAddMarkers_data()
+{
+    addSizes();
+}
+
+void BenchMapProvider::benchAddMarkers()
+{
+    QFETCH(int, count);
+    QBENCHMARK {
+        OpenStreetMapProvider provider;
+        fill(provider, count);
+    }
+}
+
+void BenchMapProvider::benchPackAllMarkers_data()
+{
+    addSizes();
+}
+
+void BenchMapProvider::benchPackAllMarkers()
+{
+    QFETCH(int, count);
+    OpenStreetMapProvider provider;
+    fill(provider, count);
+
+    QBENCHMARK {
+        MarkerPayload payload = provider.packAllMarkers();
+        QCOMPARE(payload.count, count);
+    }
+}
+
+void BenchMapProvider::benchPackViewport_data()
+{
+    addSizes();
+}
+
+void BenchMapProvider::benchPackViewport()
+{
+    QFETCH(int, count);
+    OpenStreetMapProvider provider;
+    fill(provider, count);
+
+    // The largest set MapWidget streams before it switches to clusters
+    QVector<int> ids;
+    for (int i = 0; i < 5000; ++i) {
+        ids.append(1 + (i * 7919) % count);
+    }
+
+    QBENCHMARK {
+        MarkerPayload payload = provider.packMarkers(ids);
+        QCOMPARE(payload.count, ids.size());
+    }
+}
+
+void BenchMapProvider::benchGetHtml_data()
+{
+    QTest::addColumn<QString>("providerName");
+    QTest::addColumn<int>("count");
+    const QList<QPair<QString, int>> sizes = {{"1k", 1000}, {"10k", 10000}, {"100k", 100000}, {"1M", 1000000}};
+    for (const QString& providerName : {QString("osm"), QString("google")}) {
+        for (const auto& size : sizes) {
+            QTest::newRow(qPrintable(providerName + " " + size.first)) << providerName << size.second;
+        }
+    }
+}
+
+void BenchMapProvider::benchGetHtml()
+{
+    QFETCH(QString, providerName);
+    QFETCH(int, count);
+    std::unique_ptr<MapProvider> provider;
+    if (providerName == "google") {
+        provider.reset(new GoogleMapsProvider);
+    } else {
+        provider.reset(new OpenStreetMapProvider);
+    }
+    fill(*provider, count);
+
+    // getHtml() generates the page; markers are streamed to it afterwards
+    QBENCHMARK {
+        QString html = provider->getHtml();
+        QVERIFY(!html.isEmpty());
+    }
+}
+
+QTEST_MAIN(BenchMapProvider)
+#include "bench_mapprovider.moc"
@@ -0,0 +1,127 @@
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+// Collects the QtTest XML logs of the benchmark executables into a single
+// JSON report, one entry per benchmark result:
+//   bench_report <output.json> <bench.xml>...
+// Exits with a non-zero status if a log is missing, a benchmark failed or no
+// results were found, so the benchmarks target fails too.
+
+namespace {
+bool readLog(const QString& path, QJsonArray& results, QJsonArray& failures, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("Failed to open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    QXmlStreamReader xml(&file);
+    QString suite;
+    QString function;
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("TestCase")) {
+            suite = attributes.value("name").toString();
+        } else if (xml.name() == QLatin1String("TestFunction")) {
+            function = attributes.value("name").toString();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            QJsonObject result;
+            result["suite"] = suite;
+            result["function"] = function;
+            result["tag"] = attributes.value("tag").toString();
+            result["metric"] = attributes.value("metric").toString();
+            result["value"] = attributes.value("value").toDouble();
+            result["iterations"] = attributes.value("iterations").toInt();
+            results.append(result);
+        } else if (xml.name() == QLatin1String("Incident")) {
+            const QString type = attributes.value("type").toString();
+            if (type != "fail" && type != "xpass") {
+                continue;
+            }
+            QJsonObject failure;
+            failure["suite"] = suite;
+            failure["function"] = function;
+            failure["file"] = attributes.value("file").toString();
+            failure["line"] = attributes.value("line").toInt();
+            // Tag and description are child elements of the incident
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("DataTag")) {
+                    failure["tag"] = xml.readElementText();
+                } else if (xml.name() == QLatin1String("Description")) {
+                    failure["description"] = xml.readElementText();
+                } else {
+                    xml.skipCurrentElement();
+                }
+            }
+            failures.append(failure);
+        }
+    }
+    if (xml.hasError()) {
+        error = QString("Failed to parse %1: %2").arg(path, xml.errorString());
+        return false;
+    }
+    return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    QStringList args = app.arguments().mid(1);
+    if (args.size() < 2) {
+        err << "Usage: bench_report <output.json> <bench.xml>...\n";
+        return 2;
+    }
+    const QString outputPath = args.takeFirst();
+
+    QJsonArray results;
+    QJsonArray failures;
+    bool ok = true;
+    for (const QString& path : args) {
+        QString error;
+        if (!readLog(path, results, failures, error)) {
+            err << error << "\n";
+            ok = false;
+        }
+    }
+
+    QJsonObject report;
+    report["generated"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["host"] = QSysInfo::machineHostName();
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["os"] = QSysInfo::prettyProductName();
+    report["results"] = results;
+    report["failures"] = failures;
+
+    QSaveFile file(outputPath);
+    QByteArray json = QJsonDocument(report).toJson();
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        err << "Failed to write " << outputPath << ": " << file.errorString() << "\n";
+        return 1;
+    }
+
+    QTextStream(stdout) << "Wrote " << results.size() << " benchmark results to " << outputPath << "\n";
+    if (!failures.isEmpty()) {
+        err << failures.size() << " benchmark(s) failed\n";
+        ok = false;
+    }
+    if (results.isEmpty()) {
+        err << "No benchmark results found\n";
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
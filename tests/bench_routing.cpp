@@ -0,0 +1,72 @@
+#include <QtTest/QtTest>
+#include "osrmroutingbackend.h"
+
+// OSRM route response parsing benchmarks on canned payloads with 1k to 1M
+// geometry points. Not registered with ctest; run bench_routing directly or
+// through the benchmarks target.
+class BenchRouting : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void benchParseRouteResponse_data();
+    void benchParseRouteResponse();
+
+private:
+    static QByteArray makeResponse(int points, int legs);
+};
+
+QByteArray BenchRouting::makeResponse(int points, int legs)
+{
+    // Same shape as an OSRM reply with geometries=geojson
+    QByteArray json("{\"code\":\"Ok\",\"routes\":[{\"geometry\":{\"type\":\"LineString\",\"coordinates\":[");
+    json.reserve(points * 24 + legs * 64 + 256);
+    for (int i = 0; i < points; ++i) {
+        if (i > 0) json.append(',');
+        json.append('[');
+        json.append(QByteArray::number(-89.65 + i * 1e-5, 'f', 6));
+        json.append(',');
+        json.append(QByteArray::number(39.78 + (i % 2000) * 1e-5, 'f', 6));
+        json.append(']');
+    }
+    json.append("]},\"legs\":[");
+    for (int i = 0; i < legs; ++i) {
+        if (i > 0) json.append(',');
+        json.append("{\"steps\":[],\"summary\":\"\",\"weight\":120.5,\"duration\":120.5,\"distance\":1500.2}");
+    }
+    json.append("],\"weight_name\":\"routability\",\"weight\":");
+    json.append(QByteArray::number(legs * 120.5, 'f', 1));
+    json.append(",\"duration\":");
+    json.append(QByteArray::number(legs * 120.5, 'f', 1));
+    json.append(",\"distance\":");
+    json.append(QByteArray::number(legs * 1500.2, 'f', 1));
+    json.append("}],\"waypoints\":[]}");
+    return json;
+}
+
+void BenchRouting::benchParseRouteResponse_data()
+{
+    QTest::addColumn<int>("points");
+    QTest::addColumn<int>("legs");
+    QTest::newRow("1k") << 1000 << 2;
+    QTest::newRow("10k") << 10000 << 10;
+    QTest::newRow("100k") << 100000 << 25;
+    QTest::newRow("1M") << 1000000 << 25;
+}
+
+void BenchRouting::benchParseRouteResponse()
+{
+    QFETCH(int, points);
+    QFETCH(int, legs);
+    const QByteArray response = makeResponse(points, legs);
+
+    RoutePath path;
+    QBENCHMARK {
+        path = OsrmRoutingBackend::parseRouteResponse(response);
+    }
+    QCOMPARE(path.points.size(), points);
+    QCOMPARE(path.legs.size(), legs);
+}
+
+QTEST_MAIN(BenchRouting)
+#include "bench_routing.moc"
@@ -0,0 +1,37 @@
+#ifndef GRIDROADGRAPH_H
+#define GRIDROADGRAPH_H
+
+#include "roadgraph.h"
+#include "geoutils.h"
+
+// size x size grid starting at 45 N 7 E, 0.01 degrees apart, two-way
+// streets at 100 s per km (about 36 km/h). Node row * size + column.
+inline RoadGraph gridRoadGraph(int size)
+{
+    QVector<RoadGraph::Node> nodes;
+    QVector<RoadGraph::Edge> edges;
+    for (int row = 0; row < size; ++row) {
+        for (int column = 0; column < size; ++column) {
+            nodes.append(RoadGraph::Node{45.0 + row * 0.01, 7.0 + column * 0.01});
+        }
+    }
+    auto connect = [&](int a, int b) {
+        double km = haversineDistanceKm(nodes[a].latitude, nodes[a].longitude,
+                                        nodes[b].latitude, nodes[b].longitude);
+        edges.append(RoadGraph::Edge{a, b, km * 100.0});
+        edges.append(RoadGraph::Edge{b, a, km * 100.0});
+    };
+    for (int row = 0; row < size; ++row) {
+        for (int column = 0; column < size; ++column) {
+            int node = row * size + column;
+            if (column + 1 < size) connect(node, node + 1);
+            if (row + 1 < size) connect(node, node + size);
+        }
+    }
+
+    RoadGraph graph;
+    graph.build(nodes, edges);
+    return graph;
+}
+
+#endif // GRIDROADGRAPH_H
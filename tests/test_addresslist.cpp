@@ -70,6 +70,11 @@ void TestAddressList::testRemoveAddress()
     
     list.removeAddress(1);
     QCOMPARE(list.getAddressCount(), 1);
+    
+    // Lookups by id still resolve after the remaining entries shift
+    QVERIFY(!list.containsAddress(1));
+    QVERIFY(list.containsAddress(2));
+    QCOMPARE(list.getAddress(2).getStreet(), QString("456 Oak Ave"));
 }
 
 void TestAddressList::testUpdateAddress()
@@ -0,0 +1,169 @@
+#include <QtTest/QtTest>
+#include "addresslistmodel.h"
+
+class TestAddressListModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSetAddresses();
+    void testFilter();
+    void testNarrowingFilter();
+    void testFilterIds();
+    void testAddUpdateRemove();
+    void testRouteEndpoints();
+
+private:
+    QList<Address> sampleAddresses();
+    QString textAt(const AddressListModel& model, int row);
+};
+
+QList<Address> TestAddressListModel::sampleAddresses()
+{
+    return {
+        Address(1, "123 Main St", "Springfield", "IL", "62701", "USA", 0, 0),
+        Address(2, "456 Oak Ave", "Chicago", "IL", "60601", "USA", 0, 0),
+        Address(3, "789 Main St", "Madison", "WI", "53703", "USA", 0, 0)
+    };
+}
+
+QString TestAddressListModel::textAt(const AddressListModel& model, int row)
+{
+    return model.data(model.index(row), Qt::DisplayRole).toString();
+}
+
+void TestAddressListModel::testSetAddresses()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(model.getTotalCount(), 3);
+    QCOMPARE(textAt(model, 1), QString("456 Oak Ave, Chicago, IL"));
+    QCOMPARE(model.data(model.index(2), AddressListModel::AddressIdRole).toInt(), 3);
+    QCOMPARE(model.addressIdAt(0), 1);
+    QCOMPARE(model.rowForAddressId(3), 2);
+    QCOMPARE(model.rowForAddressId(99), -1);
+    QVERIFY(!model.data(model.index(3), Qt::DisplayRole).isValid());
+}
+
+void TestAddressListModel::testFilter()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+
+    model.setFilterText("main st");
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.addressIdAt(0), 1);
+    QCOMPARE(model.addressIdAt(1), 3);
+    QCOMPARE(model.rowForAddressId(2), -1);
+    QCOMPARE(model.rowForAddressId(3), 1);
+
+    // Matches across the separators of the display text
+    model.setFilterText("st, madison");
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.addressIdAt(0), 3);
+
+    model.setFilterText("");
+    QCOMPARE(model.rowCount(), 3);
+}
+
+void TestAddressListModel::testNarrowingFilter()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+
+    model.setFilterText("i");
+    QCOMPARE(model.rowCount(), 3);
+    model.setFilterText("il");
+    QCOMPARE(model.rowCount(), 2);
+    model.setFilterText("il,");
+    QCOMPARE(model.rowCount(), 0);
+
+    // Widening again rescans the whole store
+    model.setFilterText("w");
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(model.addressIdAt(0), 3);
+}
+
+void TestAddressListModel::testFilterIds()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+    model.setFilterText("oak");
+    QCOMPARE(model.rowCount(), 1);
+
+    // Store order is kept regardless of the order of the hits
+    model.setFilterIds({3, 1, 42});
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.addressIdAt(0), 1);
+    QCOMPARE(model.addressIdAt(1), 3);
+    QVERIFY(model.getFilterText().isEmpty());
+
+    model.setFilterText("");
+    QCOMPARE(model.rowCount(), 3);
+}
+
+void TestAddressListModel::testAddUpdateRemove()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+    model.setFilterText("main");
+
+    QSignalSpy insertedSpy(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+
+    // Hidden by the filter: stored but not shown
+    model.addAddress(Address(4, "1 Elm St", "Peoria", "IL", "61602", "USA", 0, 0));
+    QCOMPARE(model.getTotalCount(), 4);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(insertedSpy.count(), 0);
+
+    model.addAddress(Address(5, "9 Main St", "Peoria", "IL", "61602", "USA", 0, 0));
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(insertedSpy.count(), 1);
+    QCOMPARE(model.addressIdAt(2), 5);
+
+    // An update can move a row in or out of the filtered view
+    model.updateAddress(Address(2, "2 Main St", "Chicago", "IL", "60601", "USA", 0, 0));
+    QCOMPARE(model.rowCount(), 4);
+    QCOMPARE(model.rowForAddressId(2), 1);
+    model.updateAddress(Address(1, "1 Lake Dr", "Springfield", "IL", "62701", "USA", 0, 0));
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(removedSpy.count(), 1);
+
+    model.removeAddress(2);
+    QCOMPARE(model.getTotalCount(), 4);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.addressIdAt(0), 3);
+    QCOMPARE(model.addressIdAt(1), 5);
+
+    model.setFilterText("");
+    QCOMPARE(model.rowCount(), 4);
+    QCOMPARE(model.rowForAddressId(4), 2);
+    QCOMPARE(textAt(model, 0), QString("1 Lake Dr, Springfield, IL"));
+
+    model.clear();
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(model.rowForAddressId(3), -1);
+}
+
+void TestAddressListModel::testRouteEndpoints()
+{
+    AddressListModel model;
+    model.setAddresses(sampleAddresses());
+
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+    model.setRouteEndpoints(1, 3);
+    QCOMPARE(changedSpy.count(), 2);
+    QVERIFY(textAt(model, 0).startsWith("🚩 "));
+    QVERIFY(textAt(model, 2).startsWith("🏁 "));
+    QCOMPARE(textAt(model, 1), QString("456 Oak Ave, Chicago, IL"));
+
+    model.setRouteEndpoints(-1, -1);
+    QCOMPARE(textAt(model, 0), QString("123 Main St, Springfield, IL"));
+    QCOMPARE(textAt(model, 2), QString("789 Main St, Madison, WI"));
+}
+
+QTEST_MAIN(TestAddressListModel)
+#include "test_addresslistmodel.moc"
@@ -0,0 +1,211 @@
+#include <QtTest/QtTest>
+#include "csvreader.h"
+#include "csvimportworker.h"
+#include "csvwriter.h"
+#include <QBuffer>
+#include <QTemporaryDir>
+
+class TestCsvReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testPlainFields();
+    void testQuotedFields();
+    void testEscapedQuotes();
+    void testEmbeddedNewline();
+    void testLineEndings();
+    void testByteOrderMark();
+    void testUnterminatedQuote();
+    void testParseAddress();
+    void testWorkerImport();
+    void testWorkerCancel();
+    void testWriteRoundTrip();
+
+private:
+    QStringList readAll(const QByteArray& data);
+};
+
+QStringList TestCsvReader::readAll(const QByteArray& data)
+{
+    // Flatten records as "a|b|c" for easy comparison
+    QStringList records;
+    CsvReader reader(data.constData(), data.size());
+    QVector<CsvField> fields;
+    while (reader.readRecord(fields)) {
+        QStringList values;
+        for (const CsvField& field : fields) {
+            values << field.toString();
+        }
+        records << values.join('|');
+    }
+    return records;
+}
+
+void TestCsvReader::testPlainFields()
+{
+    QStringList records = readAll("a,b,c\n1,,3\n");
+    QCOMPARE(records.size(), 2);
+    QCOMPARE(records[0], QString("a|b|c"));
+    QCOMPARE(records[1], QString("1||3"));
+
+    // Trailing delimiter at end of input yields an empty last field
+    records = readAll("x,y,");
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records[0], QString("x|y|"));
+}
+
+void TestCsvReader::testQuotedFields()
+{
+    QStringList records = readAll("\"123 Main St, Apt 4\",\"Springfield\",IL\n");
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records[0], QString("123 Main St, Apt 4|Springfield|IL"));
+}
+
+void TestCsvReader::testEscapedQuotes()
+{
+    QByteArray data = "\"The \"\"Old\"\" Mill\",x\n";
+    CsvReader reader(data.constData(), data.size());
+    QVector<CsvField> fields;
+    QVERIFY(reader.readRecord(fields));
+    QCOMPARE(fields.size(), 2);
+    QVERIFY(fields[0].quoted);
+    QVERIFY(fields[0].hasEscapedQuotes);
+    QCOMPARE(fields[0].toString(), QString("The \"Old\" Mill"));
+    QVERIFY(!fields[1].hasEscapedQuotes);
+}
+
+void TestCsvReader::testEmbeddedNewline()
+{
+    QStringList records = readAll("\"line one\nline two\",b\nc,d\n");
+    QCOMPARE(records.size(), 2);
+    QCOMPARE(records[0], QString("line one\nline two|b"));
+    QCOMPARE(records[1], QString("c|d"));
+}
+
+void TestCsvReader::testLineEndings()
+{
+    QStringList records = readAll("a,b\r\nc,d\re,f");
+    QCOMPARE(records.size(), 3);
+    QCOMPARE(records[0], QString("a|b"));
+    QCOMPARE(records[1], QString("c|d"));
+    QCOMPARE(records[2], QString("e|f"));
+}
+
+void TestCsvReader::testByteOrderMark()
+{
+    QStringList records = readAll("\xEF\xBB\xBFStreet,City\n");
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records[0], QString("Street|City"));
+}
+
+void TestCsvReader::testUnterminatedQuote()
+{
+    QStringList records = readAll("\"never closed,a\nb");
+    QCOMPARE(records.size(), 1);
+    QCOMPARE(records[0], QString("never closed,a\nb"));
+}
+
+void TestCsvReader::testParseAddress()
+{
+    QByteArray data = "\"1 Elm St, Unit 2\",Springfield,IL,62701,USA,39.78,-89.65\n"
+                      "Short,Row\n";
+    CsvReader reader(data.constData(), data.size());
+    QVector<CsvField> fields;
+
+    QVERIFY(reader.readRecord(fields));
+    Address address;
+    QVERIFY(CsvImportWorker::parseAddress(fields, address));
+    QCOMPARE(address.getStreet(), QString("1 Elm St, Unit 2"));
+    QCOMPARE(address.getCountry(), QString("USA"));
+    QCOMPARE(address.getLatitude(), 39.78);
+    QCOMPARE(address.getLongitude(), -89.65);
+
+    QVERIFY(reader.readRecord(fields));
+    QVERIFY(!CsvImportWorker::parseAddress(fields, address));
+}
+
+void TestCsvReader::testWorkerImport()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/import.csv";
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("Street,City,State,ZIP,Country,Latitude,Longitude\n");
+    for (int i = 0; i < 25; ++i) {
+        file.write(QString("\"%1 Main St\",Springfield,IL,62701,USA,39.7,-89.6\n").arg(i).toUtf8());
+    }
+    file.write("\n");
+    file.write("broken,row\n");
+    file.close();
+
+    CsvImportWorker worker(path, 10);
+    QSignalSpy batchSpy(&worker, &CsvImportWorker::batchReady);
+    QSignalSpy finishedSpy(&worker, &CsvImportWorker::finished);
+    worker.run();
+
+    QCOMPARE(batchSpy.count(), 3);
+    QCOMPARE(batchSpy.at(0).at(0).value<QList<Address>>().size(), 10);
+    QCOMPARE(batchSpy.at(2).at(0).value<QList<Address>>().size(), 5);
+
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toInt(), 25);
+    QCOMPARE(finishedSpy.at(0).at(1).toInt(), 1);
+    QCOMPARE(finishedSpy.at(0).at(2).toBool(), false);
+}
+
+void TestCsvReader::testWorkerCancel()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/cancel.csv";
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("1 Main St,Springfield,IL,62701,USA\n");
+    file.close();
+
+    CsvImportWorker worker(path);
+    QSignalSpy batchSpy(&worker, &CsvImportWorker::batchReady);
+    QSignalSpy finishedSpy(&worker, &CsvImportWorker::finished);
+    worker.cancel();
+    worker.run();
+
+    QCOMPARE(batchSpy.count(), 0);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(2).toBool(), true);
+}
+
+void TestCsvReader::testWriteRoundTrip()
+{
+    QList<Address> addresses = {
+        Address(1, "1 \"Old\" Mill Rd, Unit 2", "Springfield", "IL", "62701", "USA", 39.781721, -89.650148),
+        Address(2, "100% Main St %1", "Line\nBreak", "", "", "", 0.0, 0.0)
+    };
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(CsvWriter::writeAddresses(&buffer, addresses));
+
+    QByteArray data = buffer.data();
+    CsvReader reader(data.constData(), data.size());
+    QVector<CsvField> fields;
+    QVERIFY(reader.readRecord(fields));
+    QVERIFY(CsvImportWorker::isHeaderRecord(fields));
+
+    for (const Address& expected : addresses) {
+        QVERIFY(reader.readRecord(fields));
+        Address address;
+        QVERIFY(CsvImportWorker::parseAddress(fields, address));
+        QCOMPARE(address.getStreet(), expected.getStreet());
+        QCOMPARE(address.getCity(), expected.getCity());
+        QCOMPARE(address.getZip(), expected.getZip());
+        QCOMPARE(address.getLatitude(), expected.getLatitude());
+        QCOMPARE(address.getLongitude(), expected.getLongitude());
+    }
+    QVERIFY(!reader.readRecord(fields));
+}
+
+QTEST_MAIN(TestCsvReader)
+#include "test_csvreader.moc"
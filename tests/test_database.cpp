@@ -1,6 +1,7 @@
 #include <QtTest/QtTest>
 #include "database.h"
 #include <QTemporaryDir>
+#include <QSqlQuery>
 
 class TestDatabase : public QObject
 {
@@ -18,10 +19,20 @@ private slots:
     void testDeleteList();
     void testGetAllLists();
     void testAddAddress();
+    void testAddAddresses();
     void testUpdateAddress();
     void testDeleteAddress();
     void testGetAddressesForList();
     void testCascadeDelete();
+    void testSchemaVersion();
+    void testForeignKeysEnforced();
+    void testAddressCache();
+    void testSearchAddresses();
+    void testSearchIndexBuiltOnOpen();
+    void testSpatialQueries();
+    void testSpatialIndexBuiltOnOpen();
+    void testGeocodeCache();
+    void testGeocodeCacheExpiry();
 
 private:
     QTemporaryDir* m_tempDir;
@@ -113,6 +124,27 @@ void TestDatabase::testAddAddress()
     QCOMPARE(addresses[0].getStreet(), QString("123 Main St"));
 }
 
+void TestDatabase::testAddAddresses()
+{
+    int listId = Database::instance().createList("Test List");
+    
+    QList<Address> batch;
+    for (int i = 0; i < 250; ++i) {
+        batch.append(Address(0, QString("%1 Main St").arg(i), "Springfield", "IL", "62701", "USA", 0, 0));
+    }
+    
+    QList<int> ids = Database::instance().addAddresses(listId, batch);
+    QCOMPARE(ids.size(), 250);
+    for (int id : ids) {
+        QVERIFY(id > 0);
+    }
+    
+    QList<Address> addresses = Database::instance().getAddressesForList(listId);
+    QCOMPARE(addresses.size(), 250);
+    QCOMPARE(addresses.first().getId(), ids.first());
+    QCOMPARE(addresses.last().getStreet(), QString("249 Main St"));
+}
+
 void TestDatabase::testUpdateAddress()
 {
     int listId = Database::instance().createList("Test List");
@@ -176,5 +208,270 @@ void TestDatabase::testCascadeDelete()
     QCOMPARE(addresses.size(), 0);
 }
 
+void TestDatabase::testSchemaVersion()
+{
+    QCOMPARE(Database::instance().schemaVersion(), 2);
+    
+    // Reopening an up-to-date database is a no-op
+    Database::instance().close();
+    QVERIFY(Database::instance().initialize(m_dbPath));
+    QCOMPARE(Database::instance().schemaVersion(), 2);
+}
+
+void TestDatabase::testForeignKeysEnforced()
+{
+    Address addr(0, "123 Main St", "Springfield", "IL", "62701", "USA", 0, 0);
+    QCOMPARE(Database::instance().addAddress(999999, addr), -1);
+}
+
+void TestDatabase::testAddressCache()
+{
+    Database& db = Database::instance();
+    int listId = db.createList("Cached List");
+    int otherListId = db.createList("Other List");
+    
+    Address addr1(0, "123 Main St", "Springfield", "IL", "62701", "USA", 0, 0);
+    int id1 = db.addAddress(listId, addr1);
+    QCOMPARE(db.getAddressesForList(listId).size(), 1);
+    
+    // Writes to the cached list show up without a reload
+    Address addr2(0, "456 Oak Ave", "Chicago", "IL", "60601", "USA", 0, 0);
+    int id2 = db.addAddress(listId, addr2);
+    QList<int> batchIds = db.addAddresses(listId, {addr1, addr2});
+    QCOMPARE(db.getAddressesForList(listId).size(), 4);
+    QCOMPARE(db.getAddress(id2).getStreet(), QString("456 Oak Ave"));
+    QCOMPARE(db.getAddress(batchIds[1]).getCity(), QString("Chicago"));
+    
+    Address updated = db.getAddress(id1);
+    updated.setStreet("789 Elm St");
+    QVERIFY(db.updateAddress(updated));
+    QCOMPARE(db.getAddress(id1).getStreet(), QString("789 Elm St"));
+    
+    QVERIFY(db.updateAddressCoordinates(id2, 41.88, -87.63));
+    QCOMPARE(db.getAddress(id2).getLatitude(), 41.88);
+    
+    QVERIFY(db.deleteAddress(id1));
+    QCOMPARE(db.getAddress(id1).getId(), -1);
+    QCOMPARE(db.getAddressesForList(listId).size(), 3);
+    
+    // Addresses outside the cached list are still found
+    int otherId = db.addAddress(otherListId, addr1);
+    QCOMPARE(db.getAddress(otherId).getStreet(), QString("123 Main St"));
+    
+    // Reloading from SQLite gives the same view
+    db.close();
+    QVERIFY(db.initialize(m_dbPath));
+    QList<Address> reloaded = db.getAddressesForList(listId);
+    QCOMPARE(reloaded.size(), 3);
+    QCOMPARE(db.getAddress(id2).getLongitude(), -87.63);
+}
+
+void TestDatabase::testSearchAddresses()
+{
+    Database& db = Database::instance();
+    int homeId = db.createList("Home");
+    int workId = db.createList("Work");
+    
+    int mainId = db.addAddress(homeId, Address(0, "123 Main St", "Springfield", "IL", "62701", "USA", 0, 0));
+    int oakId = db.addAddress(homeId, Address(0, "456 Oak Ave", "Chicago", "IL", "60601", "USA", 0, 0));
+    QList<int> workIds = db.addAddresses(workId, {
+        Address(0, "9 Springfield Rd", "Madison", "WI", "53703", "USA", 0, 0),
+        Address(0, "77 Main Plaza", "Peoria", "IL", "61602", "USA", 0, 0)
+    });
+    
+    // Prefix terms across all lists
+    QList<AddressSearchHit> hits = db.searchAddresses("spring");
+    QCOMPARE(hits.size(), 2);
+    
+    // Every term has to match
+    hits = db.searchAddresses("main spring");
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].address.getId(), mainId);
+    QCOMPARE(hits[0].listId, homeId);
+    QCOMPARE(hits[0].address.getZip(), QString("62701"));
+    
+    hits = db.searchAddresses("main", 50, workId);
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].address.getId(), workIds[1]);
+    
+    QSet<int> ids = db.searchAddressIds("il", homeId);
+    QCOMPARE(ids, QSet<int>({mainId, oakId}));
+    
+    // A street match outranks a city match
+    if (db.hasSearchIndex()) {
+        hits = db.searchAddresses("springfield");
+        QCOMPARE(hits.size(), 2);
+        QCOMPARE(hits[0].address.getId(), workIds[0]);
+    }
+    
+    // The index follows updates and deletes
+    Address oak = db.getAddress(oakId);
+    oak.setStreet("456 Elm Ave");
+    QVERIFY(db.updateAddress(oak));
+    QVERIFY(db.searchAddresses("oak").isEmpty());
+    QCOMPARE(db.searchAddresses("elm").size(), 1);
+    QVERIFY(db.deleteAddress(oakId));
+    QVERIFY(db.searchAddresses("elm").isEmpty());
+    QVERIFY(db.deleteList(workId));
+    QVERIFY(db.searchAddresses("peoria").isEmpty());
+    
+    // Query syntax in the input is treated as plain text
+    QVERIFY(db.searchAddresses("\"main OR* (").isEmpty());
+    QVERIFY(db.searchAddresses("  ").isEmpty());
+    QCOMPARE(Database::ftsQuery(Database::searchTerms("Main-St  5")), QString("\"Main\"* \"St\"* \"5\"*"));
+}
+
+void TestDatabase::testSearchIndexBuiltOnOpen()
+{
+    Database& db = Database::instance();
+    if (!db.hasSearchIndex()) {
+        QSKIP("SQLite was built without FTS5");
+    }
+    int listId = db.createList("Home");
+    db.addAddress(listId, Address(0, "123 Main St", "Springfield", "IL", "62701", "USA", 0, 0));
+    db.close();
+    
+    // A database migrated by a build without FTS5: current schema version
+    // but no index or triggers
+    {
+        QSqlDatabase raw = QSqlDatabase::addDatabase("QSQLITE", "raw");
+        raw.setDatabaseName(m_dbPath);
+        QVERIFY(raw.open());
+        QSqlQuery query(raw);
+        QVERIFY(query.exec("DROP TRIGGER addresses_fts_insert"));
+        QVERIFY(query.exec("DROP TRIGGER addresses_fts_delete"));
+        QVERIFY(query.exec("DROP TRIGGER addresses_fts_update"));
+        QVERIFY(query.exec("DROP TABLE addresses_fts"));
+        QVERIFY(query.exec("INSERT INTO addresses (list_id, street, city, state, zip, country, latitude, longitude) "
+                           "VALUES (1, '9 Oak Ave', 'Peoria', 'IL', '61602', 'USA', 0, 0)"));
+        raw.close();
+    }
+    QSqlDatabase::removeDatabase("raw");
+    
+    // The index is built on the next open, including rows added meanwhile
+    QVERIFY(db.initialize(m_dbPath));
+    QCOMPARE(db.schemaVersion(), 2);
+    QVERIFY(db.hasSearchIndex());
+    QCOMPARE(db.searchAddresses("main").size(), 1);
+    QCOMPARE(db.searchAddresses("peoria").size(), 1);
+}
+
+void TestDatabase::testSpatialQueries()
+{
+    Database& db = Database::instance();
+    int listId = db.createList("Spatial");
+    int otherListId = db.createList("Other");
+    
+    // Springfield, Chicago, a point just east of the antimeridian and one
+    // without coordinates
+    int springfieldId = db.addAddress(listId, Address(0, "1 Capitol Ave", "Springfield", "IL", "", "USA", 39.7983, -89.6544));
+    int chicagoId = db.addAddress(listId, Address(0, "1 State St", "Chicago", "IL", "", "USA", 41.8781, -87.6298));
+    int fijiId = db.addAddress(listId, Address(0, "1 Beach Rd", "Taveuni", "", "", "Fiji", -16.8, -179.9));
+    db.addAddress(listId, Address(0, "Unknown", "", "", "", "", 0, 0));
+    int otherId = db.addAddress(otherListId, Address(0, "2 Capitol Ave", "Springfield", "IL", "", "USA", 39.7990, -89.6550));
+    
+    QList<Address> inBounds = db.getAddressesInBounds(38.0, -91.0, 43.0, -87.0, listId);
+    QCOMPARE(inBounds.size(), 2);
+    QCOMPARE(db.getAddressesInBounds(38.0, -91.0, 43.0, -87.0).size(), 3);
+    
+    // Bounds crossing the antimeridian, and the null island row left out
+    inBounds = db.getAddressesInBounds(-20.0, 179.0, -10.0, 181.0, listId);
+    QCOMPARE(inBounds.size(), 1);
+    QCOMPARE(inBounds[0].getId(), fijiId);
+    QVERIFY(db.getAddressesInBounds(-1.0, -1.0, 1.0, 1.0).isEmpty());
+    
+    // Springfield to Chicago is about 280 km
+    QList<Address> nearby = db.getAddressesWithinRadius(39.80, -89.65, 2.0);
+    QCOMPARE(nearby.size(), 2);
+    nearby = db.getAddressesWithinRadius(39.80, -89.65, 350.0, listId);
+    QCOMPARE(nearby.size(), 2);
+    QCOMPARE(nearby[0].getId(), springfieldId);
+    QCOMPARE(nearby[1].getId(), chicagoId);
+    QCOMPARE(db.getAddressesWithinRadius(-16.8, 179.95, 20.0).size(), 1);
+    
+    QList<Address> nearest = db.getNearestAddresses(41.0, -88.0, 2);
+    QCOMPARE(nearest.size(), 2);
+    QCOMPARE(nearest[0].getId(), chicagoId);
+    nearest = db.getNearestAddresses(0.0, 0.0, 10, listId);
+    QCOMPARE(nearest.size(), 3);
+    
+    // The index follows coordinate updates and deletes
+    QVERIFY(db.updateAddressCoordinates(chicagoId, 0.0, 0.0));
+    QCOMPARE(db.getAddressesInBounds(38.0, -91.0, 43.0, -87.0, listId).size(), 1);
+    QVERIFY(db.updateAddressCoordinates(chicagoId, 41.8781, -87.6298));
+    QCOMPARE(db.getAddressesInBounds(38.0, -91.0, 43.0, -87.0, listId).size(), 2);
+    QVERIFY(db.deleteAddress(otherId));
+    QCOMPARE(db.getAddressesWithinRadius(39.80, -89.65, 2.0).size(), 1);
+}
+
+void TestDatabase::testSpatialIndexBuiltOnOpen()
+{
+    Database& db = Database::instance();
+    if (!db.hasSpatialIndex()) {
+        QSKIP("SQLite was built without R*Tree");
+    }
+    int listId = db.createList("Spatial");
+    db.addAddress(listId, Address(0, "1 Capitol Ave", "Springfield", "IL", "", "USA", 39.7983, -89.6544));
+    db.close();
+    
+    // Triggers dropped by a build without R*Tree leave the index stale
+    {
+        QSqlDatabase raw = QSqlDatabase::addDatabase("QSQLITE", "raw");
+        raw.setDatabaseName(m_dbPath);
+        QVERIFY(raw.open());
+        QSqlQuery query(raw);
+        QVERIFY(query.exec("DROP TRIGGER addresses_rtree_insert"));
+        QVERIFY(query.exec("DROP TRIGGER addresses_rtree_delete"));
+        QVERIFY(query.exec("DROP TRIGGER addresses_rtree_update"));
+        QVERIFY(query.exec("INSERT INTO addresses (list_id, street, city, state, zip, country, latitude, longitude) "
+                           "VALUES (1, '1 State St', 'Chicago', 'IL', '', 'USA', 41.8781, -87.6298)"));
+        raw.close();
+    }
+    QSqlDatabase::removeDatabase("raw");
+    
+    QVERIFY(db.initialize(m_dbPath));
+    QVERIFY(db.hasSpatialIndex());
+    QCOMPARE(db.getAddressesInBounds(38.0, -91.0, 43.0, -87.0, listId).size(), 2);
+}
+
+void TestDatabase::testGeocodeCache()
+{
+    Database& db = Database::instance();
+    db.clearGeocodeCache();
+    
+    QByteArray payload;
+    QVERIFY(!db.getCachedGeocode("1 main st|springfield|5", payload));
+    QCOMPARE(db.getGeocodeCacheMisses(), 1);
+    
+    QByteArray stored = R"([{"lat":"39.78","lon":"-89.65","display_name":"1 Main St"}])";
+    QVERIFY(db.storeCachedGeocode("1 main st|springfield|5", stored));
+    QVERIFY(db.getCachedGeocode("1 main st|springfield|5", payload));
+    QCOMPARE(payload, stored);
+    QCOMPARE(db.getGeocodeCacheHits(), 1);
+    
+    // Storing again replaces the entry
+    QByteArray updated = "[]";
+    QVERIFY(db.storeCachedGeocode("1 main st|springfield|5", updated));
+    QVERIFY(db.getCachedGeocode("1 main st|springfield|5", payload));
+    QCOMPARE(payload, updated);
+    QCOMPARE(db.getGeocodeCacheHits(), 2);
+}
+
+void TestDatabase::testGeocodeCacheExpiry()
+{
+    Database& db = Database::instance();
+    db.clearGeocodeCache();
+    QVERIFY(db.storeCachedGeocode("key", "[]"));
+    
+    qint64 ttl = db.getGeocodeCacheTtl();
+    db.setGeocodeCacheTtl(0);
+    QByteArray payload;
+    QVERIFY(!db.getCachedGeocode("key", payload));
+    QCOMPARE(db.purgeExpiredGeocodes(), 1);
+    
+    db.setGeocodeCacheTtl(ttl);
+    QVERIFY(!db.getCachedGeocode("key", payload));
+}
+
 QTEST_MAIN(TestDatabase)
 #include "test_database.moc"
@@ -0,0 +1,201 @@
+#include <QtTest/QtTest>
+#include "distancematrixservice.h"
+#include "geoutils.h"
+#include "gridroadgraph.h"
+#include <cmath>
+
+class TestDistanceMatrixService : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testStraightLine();
+    void testCacheReuse();
+    void testInvalidAddresses();
+    void testLocalGraph();
+    void testFailedTablesFallBack();
+    void testCancel();
+
+private:
+    QList<Address> gridAddresses(int count);
+    DistanceMatrix waitForMatrix(DistanceMatrixService& service, int requestId);
+};
+
+QList<Address> TestDistanceMatrixService::gridAddresses(int count)
+{
+    QList<Address> addresses;
+    for (int i = 0; i < count; ++i) {
+        addresses.append(Address(i + 1, QString("Stop %1").arg(i), "", "", "", "",
+                                 45.0 + (i / 5) * 0.01, 7.0 + (i % 5) * 0.01));
+    }
+    return addresses;
+}
+
+DistanceMatrix TestDistanceMatrixService::waitForMatrix(DistanceMatrixService& service, int requestId)
+{
+    QSignalSpy readySpy(&service, &DistanceMatrixService::matrixReady);
+    for (int attempt = 0; attempt < 50 && readySpy.isEmpty(); ++attempt) {
+        readySpy.wait(200);
+    }
+    if (readySpy.isEmpty()) return DistanceMatrix();
+    QList<QVariant> arguments = readySpy.takeFirst();
+    if (arguments[0].toInt() != requestId) return DistanceMatrix();
+    return arguments[1].value<DistanceMatrix>();
+}
+
+void TestDistanceMatrixService::testStraightLine()
+{
+    DistanceMatrixService service;
+    service.setSource(DistanceMatrixService::StraightLine);
+    service.setStraightLineSpeed(36.0);
+    service.setTileSize(4);
+    QSignalSpy progressSpy(&service, &DistanceMatrixService::matrixProgress);
+
+    QList<Address> addresses = gridAddresses(10);
+    int requestId = service.computeMatrix(addresses);
+    QVERIFY(service.isBusy());
+    DistanceMatrix matrix = waitForMatrix(service, requestId);
+    QCOMPARE(matrix.count, 10);
+    QVERIFY(!service.isBusy());
+
+    // Row blocks of 4, 4 and 2 addresses
+    QCOMPARE(progressSpy.count(), 3);
+    QCOMPARE(progressSpy.last()[2].toInt(), 3);
+    QCOMPARE(matrix.estimatedPairs, 0);
+
+    for (int from = 0; from < addresses.size(); ++from) {
+        QCOMPARE(matrix.distanceKm(from, from), 0.0f);
+        for (int to = 0; to < addresses.size(); ++to) {
+            double km = haversineDistanceKm(addresses[from].getLatitude(), addresses[from].getLongitude(),
+                                            addresses[to].getLatitude(), addresses[to].getLongitude());
+            QVERIFY(qAbs(matrix.distanceKm(from, to) - km) < 1e-4);
+            QVERIFY(qAbs(matrix.durationSeconds(from, to) - km * 100.0) < 1e-2);
+        }
+    }
+}
+
+void TestDistanceMatrixService::testCacheReuse()
+{
+    DistanceMatrixService service;
+    service.setSource(DistanceMatrixService::StraightLine);
+    service.setTileSize(3);
+
+    QList<Address> addresses = gridAddresses(6);
+    DistanceMatrix first = waitForMatrix(service, service.computeMatrix(addresses));
+    QCOMPARE(first.count, 6);
+    QCOMPARE(service.getCacheSize(), 30);
+
+    // Same pairs in another order come straight from the cache
+    QSignalSpy progressSpy(&service, &DistanceMatrixService::matrixProgress);
+    QList<Address> reversed(addresses.rbegin(), addresses.rend());
+    DistanceMatrix second = waitForMatrix(service, service.computeMatrix(reversed));
+    QCOMPARE(second.count, 6);
+    QCOMPARE(progressSpy.count(), 0);
+    QCOMPARE(second.distanceKm(0, 5), first.distanceKm(5, 0));
+    QCOMPARE(second.durationSeconds(1, 4), first.durationSeconds(4, 1));
+
+    // Only the new address's row block and its column are computed
+    addresses.append(Address(7, "New", "", "", "", "", 45.5, 7.5));
+    DistanceMatrix third = waitForMatrix(service, service.computeMatrix(addresses));
+    QCOMPARE(third.count, 7);
+    QCOMPARE(progressSpy.count(), 3);
+    QCOMPARE(service.getCacheSize(), 42);
+
+    service.setMaxCacheSize(10);
+    addresses.append(Address(8, "Newer", "", "", "", "", 45.6, 7.6));
+    waitForMatrix(service, service.computeMatrix(addresses));
+    QVERIFY(service.getCacheSize() <= 10);
+
+    service.setSource(DistanceMatrixService::OsrmTable);
+    QCOMPARE(service.getCacheSize(), 0);
+}
+
+void TestDistanceMatrixService::testInvalidAddresses()
+{
+    DistanceMatrixService service;
+    QSignalSpy failedSpy(&service, &DistanceMatrixService::matrixFailed);
+
+    QList<Address> addresses = gridAddresses(3);
+    addresses.append(Address(9, "Nowhere", "", "", "", "", 0.0, 0.0));
+    int requestId = service.computeMatrix(addresses);
+    QCOMPARE(failedSpy.count(), 0);
+    QVERIFY(failedSpy.wait());
+    QCOMPARE(failedSpy.first()[0].toInt(), requestId);
+
+    // An empty list is a valid, empty matrix
+    DistanceMatrix empty = waitForMatrix(service, service.computeMatrix(QList<Address>()));
+    QCOMPARE(empty.count, 0);
+}
+
+void TestDistanceMatrixService::testLocalGraph()
+{
+    RoadGraph graph = gridRoadGraph(5);
+    DistanceMatrixService service;
+    service.setSource(DistanceMatrixService::LocalGraph);
+    service.setRoadGraph(graph);
+    service.setTileSize(4);
+
+    // The last address is far from every road
+    QList<Address> addresses = gridAddresses(10);
+    addresses.append(Address(11, "Far", "", "", "", "", 46.0, 8.0));
+    DistanceMatrix matrix = waitForMatrix(service, service.computeMatrix(addresses));
+    QCOMPARE(matrix.count, 11);
+    QCOMPARE(matrix.estimatedPairs, 20);
+
+    for (int from = 0; from < 10; ++from) {
+        for (int to = 0; to < 10; ++to) {
+            double seconds = 0.0;
+            graph.shortestPath(from, to, &seconds);
+            QVERIFY(qAbs(matrix.durationSeconds(from, to) - seconds) < 1e-2);
+        }
+    }
+
+    // Grid paths are never shorter than straight lines and add up block by block
+    double block = haversineDistanceKm(45.0, 7.0, 45.0, 7.01);
+    QVERIFY(qAbs(matrix.distanceKm(0, 4) - 4 * block) < 1e-3);
+    QVERIFY(matrix.distanceKm(0, 6) > haversineDistanceKm(45.0, 7.0, 45.01, 7.01));
+    double farKm = haversineDistanceKm(45.0, 7.0, 46.0, 8.0);
+    QVERIFY(qAbs(matrix.distanceKm(0, 10) - farKm) < 1e-3);
+}
+
+void TestDistanceMatrixService::testFailedTablesFallBack()
+{
+    // Nothing listens on the discard port, so every tile fails quickly
+    DistanceMatrixService service;
+    service.setOsrmServerUrl("http://127.0.0.1:9/");
+    QCOMPARE(service.getOsrmServerUrl(), QString("http://127.0.0.1:9"));
+    service.setTileSize(2);
+    service.setMaxConcurrentRequests(2);
+    QSignalSpy progressSpy(&service, &DistanceMatrixService::matrixProgress);
+
+    QList<Address> addresses = gridAddresses(5);
+    DistanceMatrix matrix = waitForMatrix(service, service.computeMatrix(addresses));
+    QCOMPARE(matrix.count, 5);
+    QCOMPARE(progressSpy.count(), 9);
+    QCOMPARE(matrix.estimatedPairs, 20);
+    QVERIFY(qAbs(matrix.distanceKm(0, 1) - haversineDistanceKm(45.0, 7.0, 45.0, 7.01)) < 1e-4);
+
+    // Estimates are never cached
+    QCOMPARE(service.getCacheSize(), 0);
+}
+
+void TestDistanceMatrixService::testCancel()
+{
+    DistanceMatrixService service;
+    service.setSource(DistanceMatrixService::StraightLine);
+    service.setTileSize(2);
+    QSignalSpy readySpy(&service, &DistanceMatrixService::matrixReady);
+
+    int cancelled = service.computeMatrix(gridAddresses(20));
+    int kept = service.computeMatrix(gridAddresses(4));
+    service.cancel(cancelled);
+
+    DistanceMatrix matrix = waitForMatrix(service, kept);
+    QCOMPARE(matrix.count, 4);
+    QVERIFY(!readySpy.wait(200));
+    QCOMPARE(readySpy.count(), 1);
+    QVERIFY(!service.isBusy());
+}
+
+QTEST_MAIN(TestDistanceMatrixService)
+#include "test_distancematrixservice.moc"
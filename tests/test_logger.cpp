@@ -0,0 +1,360 @@
+#include <QtTest/QtTest>
+#include "logger.h"
+#include "mpscringbuffer.h"
+#include "gziputils.h"
+#include <QTemporaryDir>
+#include <thread>
+#include <vector>
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testRingBufferFull();
+    void testRingBufferProducers();
+    void testWritesAfterFlush();
+    void testLevelFilter();
+    void testLazyArguments();
+    void testFormatMessage();
+    void testDeferredFormat();
+    void testDropPolicy();
+    void testBlockPolicy();
+    void testGzipCompress();
+    void testRotationBySize();
+    void testRotationAtStartup();
+
+private:
+    QTemporaryDir m_tempDir;
+    QString m_logPath;
+    QStringList readLog();
+    static bool gunzipMatches(const QByteArray& gzip, const QByteArray& expected);
+};
+
+void TestLogger::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    m_logPath = m_tempDir.path() + "/test.log";
+    Logger::instance().setLogFile(m_logPath);
+    Logger::instance().setConsoleOutput(false);
+    Logger::instance().setRotation(0, 0, 5);
+}
+
+void TestLogger::cleanupTestCase()
+{
+    Logger::instance().setConsoleOutput(true);
+    Logger::instance().setLogLevel(Logger::Info);
+    Logger::instance().setOverflowPolicy(Logger::DropMessages);
+}
+
+QStringList TestLogger::readLog()
+{
+    QFile file(m_logPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return QStringList();
+    return QString::fromUtf8(file.readAll()).split('\n', Qt::SkipEmptyParts);
+}
+
+void TestLogger::testRingBufferFull()
+{
+    MpscRingBuffer<QString> buffer(3);
+    QCOMPARE(buffer.capacity(), std::size_t(4));
+
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(buffer.tryPush(QString::number(i)));
+    }
+    QVERIFY(!buffer.tryPush(QString("overflow")));
+
+    QString value;
+    QVERIFY(buffer.tryPop(value));
+    QCOMPARE(value, QString("0"));
+    QVERIFY(buffer.tryPush(QString("4")));
+    for (int i = 1; i <= 4; ++i) {
+        QVERIFY(buffer.tryPop(value));
+        QCOMPARE(value, QString::number(i));
+    }
+    QVERIFY(!buffer.tryPop(value));
+    QCOMPARE(buffer.pushCount(), std::size_t(5));
+}
+
+void TestLogger::testRingBufferProducers()
+{
+    // Every value arrives exactly once and each producer's values in order
+    const int producers = 4;
+    const int perProducer = 50000;
+    MpscRingBuffer<QPair<int, int>> buffer(256);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&buffer, p, perProducer]() {
+            for (int i = 0; i < perProducer; ++i) {
+                while (!buffer.tryPush(qMakePair(p, i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    QVector<int> next(producers, 0);
+    bool ordered = true;
+    int received = 0;
+    QPair<int, int> value;
+    while (received < producers * perProducer) {
+        if (buffer.tryPop(value)) {
+            ordered = ordered && value.second == next[value.first];
+            next[value.first] = value.second + 1;
+            ++received;
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    QVERIFY(ordered);
+    QVERIFY(!buffer.tryPop(value));
+}
+
+void TestLogger::testWritesAfterFlush()
+{
+    Logger& logger = Logger::instance();
+    LOG_INFO("first message");
+    LOG_ERROR("second message");
+    logger.flush();
+
+    QStringList lines = readLog();
+    QVERIFY(lines.size() >= 2);
+    QVERIFY(lines[lines.size() - 2].endsWith("[INFO] first message"));
+    QVERIFY(lines.last().endsWith("[ERROR] second message"));
+
+    // Messages from other threads are written too
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 100; ++i) {
+                LOG_INFO(QString("thread %1 message %2").arg(t).arg(i));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    logger.flush();
+    QCOMPARE(readLog().filter(" message ").size(), 400);
+}
+
+void TestLogger::testLevelFilter()
+{
+    Logger& logger = Logger::instance();
+    logger.setLogLevel(Logger::Warning);
+    LOG_DEBUG("filtered debug");
+    LOG_INFO("filtered info");
+    LOG_WARNING("kept warning");
+    logger.flush();
+
+    QStringList lines = readLog();
+    QVERIFY(lines.filter("filtered").isEmpty());
+    QVERIFY(lines.last().endsWith("[WARNING] kept warning"));
+    logger.setLogLevel(Logger::Info);
+}
+
+void TestLogger::testLazyArguments()
+{
+    Logger& logger = Logger::instance();
+    int evaluated = 0;
+    auto message = [&evaluated]() {
+        ++evaluated;
+        return QString("lazy message");
+    };
+
+    logger.setLogLevel(Logger::Warning);
+    QVERIFY(!logger.isEnabled(Logger::Info));
+    LOG_INFO(message());
+    LOG_INFOF("lazy %1", message());
+    QCOMPARE(evaluated, 0);
+
+    logger.setLogLevel(Logger::Info);
+    LOG_INFO(message());
+    QCOMPARE(evaluated, 1);
+}
+
+void TestLogger::testFormatMessage()
+{
+    QCOMPARE(Logger::formatMessage("%1 of %2", {3, QString("ten")}), QString("3 of ten"));
+    QCOMPARE(Logger::formatMessage("%2%1", {"a", "b"}), QString("ba"));
+
+    // Arguments are not scanned again, and unknown placeholders are kept
+    QCOMPARE(Logger::formatMessage("%1 %2", {QString("%2"), QString("x")}), QString("%2 x"));
+    QCOMPARE(Logger::formatMessage("%3 at 100%", {1}), QString("%3 at 100%"));
+
+    QVariantList many;
+    for (int i = 1; i <= 12; ++i) {
+        many.append(i * 10);
+    }
+    QCOMPARE(Logger::formatMessage("%12 %1", many), QString("120 10"));
+}
+
+void TestLogger::testDeferredFormat()
+{
+    Logger& logger = Logger::instance();
+    QByteArray response("{\"code\":\"Ok\"}");
+    LOG_WARNINGF("Response %1 from %2: %3", 200, "server", response);
+    LOG_INFOF("No arguments %1");
+    logger.flush();
+
+    QStringList lines = readLog();
+    QVERIFY(lines[lines.size() - 2].endsWith("[WARNING] Response 200 from server: {\"code\":\"Ok\"}"));
+    QVERIFY(lines.last().endsWith("[INFO] No arguments %1"));
+}
+
+void TestLogger::testDropPolicy()
+{
+    // Far more messages than the queue holds, logged faster than written
+    Logger& logger = Logger::instance();
+    logger.setOverflowPolicy(Logger::DropMessages);
+    quint64 droppedBefore = logger.getDroppedCount();
+    const int total = 100000;
+    QString payload(200, QChar('x'));
+    for (int i = 0; i < total; ++i) {
+        LOG_INFO("drop test " + payload);
+    }
+    logger.flush();
+
+    // Dropped messages are counted, and the count is reported in the log
+    int dropped = int(logger.getDroppedCount() - droppedBefore);
+    LOG_INFO("after drop test");
+    logger.flush();
+    QStringList lines = readLog();
+    QCOMPARE(lines.filter("drop test").size(), total - dropped);
+    if (dropped > 0) {
+        QVERIFY(!lines.filter("log messages were dropped").isEmpty());
+    }
+}
+
+void TestLogger::testBlockPolicy()
+{
+    Logger& logger = Logger::instance();
+    logger.setOverflowPolicy(Logger::BlockCaller);
+    quint64 droppedBefore = logger.getDroppedCount();
+    const int total = 50000;
+    for (int i = 0; i < total; ++i) {
+        LOG_INFO(QString("block test %1").arg(i));
+    }
+    logger.flush();
+
+    QCOMPARE(logger.getDroppedCount(), droppedBefore);
+    QStringList lines = readLog().filter("block test ");
+    QCOMPARE(lines.size(), total);
+    QVERIFY(lines.last().endsWith(QString("block test %1").arg(total - 1)));
+    logger.setOverflowPolicy(Logger::DropMessages);
+}
+
+bool TestLogger::gunzipMatches(const QByteArray& gzip, const QByteArray& expected)
+{
+    if (gzip.size() < 18 || !gzip.startsWith("\x1f\x8b\x08")) return false;
+    QDataStream trailer(gzip.right(8));
+    trailer.setByteOrder(QDataStream::LittleEndian);
+    quint32 crc, size;
+    trailer >> crc >> size;
+    if (crc != crc32(expected) || size != quint32(expected.size())) return false;
+
+    // Rewrap the deflate payload as qUncompress() input: length prefix,
+    // zlib header, payload and the Adler-32 that zlib checks at the end
+    quint32 a = 1, b = 0;
+    for (char byte : expected) {
+        a = (a + quint8(byte)) % 65521;
+        b = (b + a) % 65521;
+    }
+    QByteArray zlib;
+    QDataStream out(&zlib, QIODevice::WriteOnly);
+    out << size;
+    zlib.append("\x78\x9c", 2);
+    zlib.append(gzip.mid(10, gzip.size() - 18));
+    QDataStream checksum(&zlib, QIODevice::Append);
+    checksum << quint32((b << 16) | a);
+    return qUncompress(zlib) == expected;
+}
+
+void TestLogger::testGzipCompress()
+{
+    QCOMPARE(crc32("123456789"), quint32(0xCBF43926));
+
+    QByteArray data;
+    for (int i = 0; i < 1000; ++i) {
+        data += "[2026-10-17 10:00:00] [INFO] line " + QByteArray::number(i) + "\n";
+    }
+    QByteArray gzip = gzipCompress(data);
+    QVERIFY(gzip.startsWith("\x1f\x8b\x08"));
+    QVERIFY(gzip.size() < data.size() / 4);
+    QVERIFY(gunzipMatches(gzip, data));
+}
+
+void TestLogger::testRotationBySize()
+{
+    Logger& logger = Logger::instance();
+    QDir dir(m_tempDir.path() + "/rotate");
+    QVERIFY(dir.mkpath("."));
+    logger.setRotation(2000, 0, 2);
+    logger.setLogFile(dir.filePath("app.log"));
+
+    // Each flush ends a batch, and the file is checked after every batch
+    for (int round = 0; round < 6; ++round) {
+        for (int i = 0; i < 30; ++i) {
+            LOG_INFOF("rotation round %1 line %2", round, i);
+        }
+        logger.flush();
+    }
+
+    // Archives are compressed once the writer is idle; only two are kept
+    QStringList archives;
+    QTRY_VERIFY_WITH_TIMEOUT((archives = dir.entryList({"app.log.*"}, QDir::Files, QDir::Name)).size() == 2 &&
+                             archives.filter(QRegularExpression("\\.gz$")).size() == 2, 5000);
+    QFile archive(dir.filePath(archives.last()));
+    QVERIFY(archive.open(QIODevice::ReadOnly));
+    QVERIFY(archive.readAll().startsWith("\x1f\x8b"));
+    QVERIFY(QFileInfo(dir.filePath("app.log")).size() < 2000);
+
+    logger.setRotation(0, 0, 5);
+    logger.setLogFile(m_logPath);
+}
+
+void TestLogger::testRotationAtStartup()
+{
+    // A file left by an earlier session is archived once it is too old
+    QDir dir(m_tempDir.path() + "/startup");
+    QVERIFY(dir.mkpath("."));
+    QFile old(dir.filePath("app.log"));
+    QVERIFY(old.open(QIODevice::WriteOnly | QIODevice::Text));
+    QString stamp = QDateTime::currentDateTime().addDays(-2).toString("yyyy-MM-dd HH:mm:ss");
+    QByteArray oldContent = QString("[%1] [INFO] old session\n").arg(stamp).toUtf8();
+    old.write(oldContent);
+    old.close();
+
+    Logger& logger = Logger::instance();
+    logger.setRotation(0, 24 * 3600, 5);
+    logger.setLogFile(dir.filePath("app.log"));
+    LOG_INFO("new session");
+    logger.flush();
+
+    QStringList archives;
+    QTRY_VERIFY_WITH_TIMEOUT((archives = dir.entryList({"app.log.*.gz"}, QDir::Files)).size() == 1, 5000);
+    QFile archive(dir.filePath(archives.first()));
+    QVERIFY(archive.open(QIODevice::ReadOnly));
+    QVERIFY(gunzipMatches(archive.readAll(), oldContent));
+
+    QFile current(dir.filePath("app.log"));
+    QVERIFY(current.open(QIODevice::ReadOnly | QIODevice::Text));
+    QVERIFY(QString::fromUtf8(current.readAll()).trimmed().endsWith("[INFO] new session"));
+
+    // A recent file is appended to
+    logger.setLogFile(dir.filePath("app.log"));
+    LOG_INFO("same session");
+    logger.flush();
+    QTRY_COMPARE(dir.entryList({"app.log.*"}, QDir::Files).size(), 1);
+
+    logger.setRotation(0, 0, 5);
+    logger.setLogFile(m_logPath);
+}
+
+QTEST_MAIN(TestLogger)
+#include "test_logger.moc"
@@ -0,0 +1,142 @@
+#include <QtTest/QtTest>
+#include <cstring>
+#include "openstreetmapprovider.h"
+
+class TestMapProvider : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAddUpdateRemove();
+    void testTitleInterning();
+    void testCopyMarkers();
+    void testPackMarkers();
+    void testPackEmpty();
+
+private:
+    template <typename T>
+    QVector<T> decode(const QString& base64);
+};
+
+template <typename T>
+QVector<T> TestMapProvider::decode(const QString& base64)
+{
+    QByteArray bytes = QByteArray::fromBase64(base64.toLatin1());
+    QVector<T> values(bytes.size() / int(sizeof(T)));
+    memcpy(values.data(), bytes.constData(), size_t(values.size()) * sizeof(T));
+    return values;
+}
+
+void TestMapProvider::testAddUpdateRemove()
+{
+    OpenStreetMapProvider provider;
+    provider.addMarker(10, 1.0, 2.0, "A");
+    provider.addMarker(20, 3.0, 4.0, "B");
+    provider.addMarker(30, 5.0, 6.0, "C");
+    QCOMPARE(provider.getMarkerCount(), 3);
+
+    // Adding an existing id updates it in place
+    provider.addMarker(20, 7.0, 8.0, "B2");
+    QCOMPARE(provider.getMarkerCount(), 3);
+    int position = provider.findMarker(20);
+    QCOMPARE(position, 1);
+    const MapMarker& updated = provider.getMarkers()[position];
+    QCOMPARE(updated.latitude, 7.0);
+    QCOMPARE(updated.longitude, 8.0);
+    QCOMPARE(provider.getMarkerTitle(updated), QString("B2"));
+
+    // The last record takes the place of a removed one
+    provider.removeMarker(10);
+    QCOMPARE(provider.getMarkerCount(), 2);
+    QCOMPARE(provider.findMarker(10), -1);
+    QCOMPARE(provider.findMarker(30), 0);
+    QCOMPARE(provider.getMarkerTitle(provider.getMarkers()[0]), QString("C"));
+
+    provider.removeMarker(99);
+    QCOMPARE(provider.getMarkerCount(), 2);
+
+    provider.initialize();
+    QCOMPARE(provider.getMarkerCount(), 0);
+    QCOMPARE(provider.getTitleCount(), 0);
+    QCOMPARE(provider.findMarker(20), -1);
+}
+
+void TestMapProvider::testTitleInterning()
+{
+    OpenStreetMapProvider provider;
+    provider.addMarker(1, 0.5, 0.5, "Same");
+    provider.addMarker(2, 0.6, 0.6, "Same");
+    provider.addMarker(3, 0.7, 0.7, "Other");
+    QCOMPARE(provider.getTitleCount(), 2);
+    QCOMPARE(provider.getMarkers()[0].title, provider.getMarkers()[1].title);
+
+    // A title is dropped once no marker refers to it
+    provider.removeMarker(3);
+    QCOMPARE(provider.getTitleCount(), 1);
+    provider.removeMarker(1);
+    QCOMPARE(provider.getTitleCount(), 1);
+    provider.addMarker(2, 0.6, 0.6, "Renamed");
+    QCOMPARE(provider.getTitleCount(), 1);
+    QCOMPARE(provider.getMarkerTitle(provider.getMarkers()[0]), QString("Renamed"));
+
+    // Released slots are reused
+    provider.addMarker(4, 0.8, 0.8, "New");
+    QCOMPARE(provider.getTitleCount(), 2);
+    QVERIFY(provider.getMarkers()[1].title < 2);
+    QCOMPARE(provider.getMarkerTitle(provider.getMarkers()[1]), QString("New"));
+}
+
+void TestMapProvider::testCopyMarkers()
+{
+    OpenStreetMapProvider source;
+    source.addMarker(1, 10.0, 20.0, "One");
+    source.addMarker(2, 11.0, 21.0, "Two");
+
+    OpenStreetMapProvider target;
+    target.addMarker(5, 0.5, 0.5, "Stale");
+    target.copyMarkers(source);
+    QCOMPARE(target.getMarkerCount(), 2);
+    QCOMPARE(target.findMarker(5), -1);
+    QCOMPARE(target.getMarkerTitle(target.getMarkers()[target.findMarker(2)]), QString("Two"));
+
+    // The copy is independent of the source
+    source.removeMarker(1);
+    QCOMPARE(target.getMarkerCount(), 2);
+}
+
+void TestMapProvider::testPackMarkers()
+{
+    OpenStreetMapProvider provider;
+    provider.addMarker(7, 40.5, -3.5, "Shared");
+    provider.addMarker(8, 41.5, -4.5, "Own");
+    provider.addMarker(9, 42.5, -5.5, "Shared");
+
+    MarkerPayload all = provider.packAllMarkers();
+    QCOMPARE(all.count, 3);
+    QCOMPARE(decode<qint32>(all.ids), QVector<qint32>({7, 8, 9}));
+    QCOMPARE(decode<double>(all.coords), QVector<double>({40.5, -3.5, 41.5, -4.5, 42.5, -5.5}));
+    QCOMPARE(all.titles, QStringList({"Shared", "Own"}));
+    QCOMPARE(decode<qint32>(all.titleIndexes), QVector<qint32>({0, 1, 0}));
+
+    // Subsets keep the requested order, skip unknown ids and only carry
+    // the titles they use
+    MarkerPayload subset = provider.packMarkers({9, 42, 7});
+    QCOMPARE(subset.count, 2);
+    QCOMPARE(decode<qint32>(subset.ids), QVector<qint32>({9, 7}));
+    QCOMPARE(decode<double>(subset.coords), QVector<double>({42.5, -5.5, 40.5, -3.5}));
+    QCOMPARE(subset.titles, QStringList({"Shared"}));
+    QCOMPARE(decode<qint32>(subset.titleIndexes), QVector<qint32>({0, 0}));
+}
+
+void TestMapProvider::testPackEmpty()
+{
+    OpenStreetMapProvider provider;
+    MarkerPayload payload = provider.packAllMarkers();
+    QCOMPARE(payload.count, 0);
+    QVERIFY(payload.ids.isEmpty());
+    QVERIFY(payload.coords.isEmpty());
+    QVERIFY(payload.titles.isEmpty());
+}
+
+QTEST_MAIN(TestMapProvider)
+#include "test_mapprovider.moc"
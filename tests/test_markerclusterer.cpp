@@ -0,0 +1,154 @@
+#include <QtTest/QtTest>
+#include "markerclusterer.h"
+
+class TestMarkerClusterer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEmpty();
+    void testNearbyPointsMerge();
+    void testMaxZoomKeepsMarkers();
+    void testViewportFilter();
+    void testAntimeridianViewport();
+    void testCountsArePreserved();
+    void testPointsWithoutClusters();
+};
+
+void TestMarkerClusterer::testEmpty()
+{
+    MarkerClusterer clusterer;
+    QVERIFY(clusterer.clusters(-90, -180, 90, 180, 5).isEmpty());
+
+    clusterer.load({});
+    QCOMPARE(clusterer.itemCount(), 0);
+    QVERIFY(clusterer.clusters(-90, -180, 90, 180, 5).isEmpty());
+}
+
+void TestMarkerClusterer::testNearbyPointsMerge()
+{
+    MarkerClusterer clusterer;
+    clusterer.load({
+        {1, 40.7128, -74.0060},
+        {2, 40.7130, -74.0062},
+        {3, 51.5074, -0.1278}
+    });
+
+    QVector<MarkerCluster> clusters = clusterer.clusters(-85, -180, 85, 180, 3);
+    QCOMPARE(clusters.size(), 2);
+
+    int merged = 0;
+    int single = 0;
+    for (const MarkerCluster& cluster : clusters) {
+        if (cluster.count == 2) {
+            merged++;
+            QCOMPARE(cluster.markerId, -1);
+            QVERIFY(qAbs(cluster.latitude - 40.7129) < 0.01);
+        } else {
+            single++;
+            QCOMPARE(cluster.count, 1);
+            QCOMPARE(cluster.markerId, 3);
+        }
+    }
+    QCOMPARE(merged, 1);
+    QCOMPARE(single, 1);
+}
+
+void TestMarkerClusterer::testMaxZoomKeepsMarkers()
+{
+    MarkerClusterer clusterer(60, 0, 16);
+    clusterer.load({
+        {1, 40.7128, -74.0060},
+        {2, 40.7130, -74.0062}
+    });
+
+    // Past maxZoom the raw points are returned unclustered
+    QVector<MarkerCluster> clusters = clusterer.clusters(40.70, -74.02, 40.72, -73.99, 18);
+    QCOMPARE(clusters.size(), 2);
+    for (const MarkerCluster& cluster : clusters) {
+        QCOMPARE(cluster.count, 1);
+        QVERIFY(cluster.markerId == 1 || cluster.markerId == 2);
+    }
+}
+
+void TestMarkerClusterer::testViewportFilter()
+{
+    MarkerClusterer clusterer;
+    clusterer.load({
+        {1, 40.7128, -74.0060},
+        {2, 51.5074, -0.1278},
+        {3, 35.6762, 139.6503}
+    });
+
+    QVector<MarkerCluster> clusters = clusterer.clusters(50, -2, 53, 2, 10);
+    QCOMPARE(clusters.size(), 1);
+    QCOMPARE(clusters[0].markerId, 2);
+}
+
+void TestMarkerClusterer::testAntimeridianViewport()
+{
+    MarkerClusterer clusterer;
+    clusterer.load({
+        {1, -17.7, 178.0},
+        {2, -14.3, -170.7},
+        {3, 0.0, 0.0}
+    });
+
+    // West edge greater than east edge: the view straddles the antimeridian
+    QVector<MarkerCluster> clusters = clusterer.clusters(-20, 175, -10, -165, 12);
+    QCOMPARE(clusters.size(), 2);
+
+    // Unwrapped longitudes, as reported by some map libraries
+    clusters = clusterer.clusters(-20, 175, -10, 195, 12);
+    QCOMPARE(clusters.size(), 2);
+}
+
+void TestMarkerClusterer::testCountsArePreserved()
+{
+    QVector<ClusterItem> items;
+    for (int i = 0; i < 1000; ++i) {
+        items.append({i, 30.0 + (i % 40) * 0.5, -100.0 + (i / 40) * 0.5});
+    }
+
+    MarkerClusterer clusterer;
+    clusterer.load(items);
+    QCOMPARE(clusterer.itemCount(), 1000);
+
+    for (int zoom = clusterer.minZoom(); zoom <= clusterer.maxZoom() + 1; ++zoom) {
+        int total = 0;
+        for (const MarkerCluster& cluster : clusterer.clusters(-85, -180, 85, 180, zoom)) {
+            total += cluster.count;
+        }
+        QCOMPARE(total, 1000);
+    }
+}
+
+void TestMarkerClusterer::testPointsWithoutClusters()
+{
+    MarkerClusterer clusterer;
+    clusterer.load({
+        {1, 40.7128, -74.0060},
+        {2, 40.7130, -74.0062},
+        {3, 51.5074, -0.1278}
+    }, false);
+    QVERIFY(!clusterer.hasClusters());
+
+    // Raw points only, at any zoom
+    QCOMPARE(clusterer.clusters(-85, -180, 85, 180, 3).size(), 3);
+
+    QVector<MarkerCluster> points = clusterer.points(40, -75, 41, -73);
+    QCOMPARE(points.size(), 2);
+    for (const MarkerCluster& point : points) {
+        QCOMPARE(point.count, 1);
+        QVERIFY(point.markerId == 1 || point.markerId == 2);
+        QVERIFY(qAbs(point.latitude - 40.7129) < 0.001);
+    }
+
+    clusterer.load({{1, 40.7128, -74.0060}, {2, 40.7130, -74.0062}});
+    QVERIFY(clusterer.hasClusters());
+    QCOMPARE(clusterer.clusters(-85, -180, 85, 180, 3).size(), 1);
+    QCOMPARE(clusterer.points(-85, -180, 85, 180).size(), 2);
+}
+
+QTEST_MAIN(TestMarkerClusterer)
+#include "test_markerclusterer.moc"
@@ -0,0 +1,170 @@
+#include <QtTest/QtTest>
+#include "polylinesimplifier.h"
+#include <QRandomGenerator>
+#include <QSet>
+#include <QtEndian>
+#include <cmath>
+
+class TestPolylineSimplifier : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEmptyAndShort();
+    void testStraightLineCollapses();
+    void testZoomLevels();
+    void testMatchesRecursiveDouglasPeucker();
+    void testFitZoom();
+    void testPack();
+
+private:
+    static double mercatorY(double lat);
+    static void douglasPeucker(const QVector<QPointF>& points, int first, int last, double tolerance,
+                               QSet<int>& kept);
+};
+
+double TestPolylineSimplifier::mercatorY(double lat)
+{
+    double s = std::sin(qDegreesToRadians(lat));
+    return 0.5 - 0.25 * std::log((1.0 + s) / (1.0 - s)) / M_PI;
+}
+
+// Textbook recursive version over Web Mercator points, for comparison
+void TestPolylineSimplifier::douglasPeucker(const QVector<QPointF>& points, int first, int last,
+                                            double tolerance, QSet<int>& kept)
+{
+    if (last - first < 2) return;
+    const QPointF& a = points[first];
+    const QPointF& b = points[last];
+    int split = -1;
+    double maxDistance = -1.0;
+    for (int i = first + 1; i < last; ++i) {
+        QPointF d = b - a;
+        double lengthSquared = QPointF::dotProduct(d, d);
+        double t = lengthSquared > 0.0 ? qBound(0.0, QPointF::dotProduct(points[i] - a, d) / lengthSquared, 1.0)
+                                       : 0.0;
+        QPointF e = points[i] - (a + t * d);
+        double distance = std::sqrt(QPointF::dotProduct(e, e));
+        if (distance > maxDistance) {
+            maxDistance = distance;
+            split = i;
+        }
+    }
+    if (maxDistance < tolerance) return;
+    kept.insert(split);
+    douglasPeucker(points, first, split, tolerance, kept);
+    douglasPeucker(points, split, last, tolerance, kept);
+}
+
+void TestPolylineSimplifier::testEmptyAndShort()
+{
+    PolylineSimplifier simplifier;
+    QVERIFY(simplifier.isEmpty());
+    QVERIFY(simplifier.simplifyForZoom(10).isEmpty());
+    QCOMPARE(simplifier.fitZoom(800, 600), 0);
+
+    simplifier.load({QPointF(7.0, 45.0)});
+    QCOMPARE(simplifier.simplifyForZoom(0), QVector<int>({0}));
+
+    simplifier.load({QPointF(7.0, 45.0), QPointF(7.1, 45.1)});
+    QCOMPARE(simplifier.simplifyForZoom(0), QVector<int>({0, 1}));
+}
+
+void TestPolylineSimplifier::testStraightLineCollapses()
+{
+    QList<QPointF> points;
+    for (int i = 0; i <= 1000; ++i) {
+        points.append(QPointF(-100.0 + i * 0.01, 40.0));
+    }
+    PolylineSimplifier simplifier;
+    simplifier.load(points);
+    QCOMPARE(simplifier.getPointCount(), 1001);
+    QCOMPARE(simplifier.simplifyForZoom(18), QVector<int>({0, 1000}));
+}
+
+void TestPolylineSimplifier::testZoomLevels()
+{
+    // A wiggly route across the continent
+    QList<QPointF> points;
+    for (int i = 0; i <= 20000; ++i) {
+        double t = i / 20000.0;
+        points.append(QPointF(-120.0 + 45.0 * t + 0.01 * std::sin(i * 0.7),
+                              35.0 + 5.0 * std::sin(t * 6.0) + 0.01 * std::cos(i * 1.3)));
+    }
+    PolylineSimplifier simplifier;
+    simplifier.load(points);
+
+    // Each zoom keeps a superset of the vertices of the zoom below it
+    QVector<int> previous;
+    for (int zoom = 0; zoom <= 18; ++zoom) {
+        QVector<int> kept = simplifier.simplifyForZoom(zoom);
+        QCOMPARE(kept.first(), 0);
+        QCOMPARE(kept.last(), 20000);
+        QVERIFY(kept.size() >= previous.size());
+        QSet<int> keptSet(kept.begin(), kept.end());
+        for (int index : previous) {
+            QVERIFY(keptSet.contains(index));
+        }
+        previous = kept;
+    }
+    QVERIFY(simplifier.simplifyForZoom(4).size() < 200);
+    QVERIFY(simplifier.simplifyForZoom(18).size() > 19000);
+}
+
+void TestPolylineSimplifier::testMatchesRecursiveDouglasPeucker()
+{
+    QRandomGenerator random(7);
+    for (int trial = 0; trial < 20; ++trial) {
+        QList<QPointF> points;
+        QVector<QPointF> projected;
+        int count = 2 + random.bounded(300);
+        for (int i = 0; i < count; ++i) {
+            QPointF point(-10.0 + random.generateDouble() * 20.0, 40.0 + random.generateDouble() * 10.0);
+            points.append(point);
+            projected.append(QPointF(point.x() / 360.0 + 0.5, mercatorY(point.y())));
+        }
+
+        PolylineSimplifier simplifier;
+        simplifier.load(points);
+        for (int zoom : {0, 3, 6, 9}) {
+            double tolerance = PolylineSimplifier::toleranceForZoom(zoom, 0.5);
+            QSet<int> expected = {0, count - 1};
+            douglasPeucker(projected, 0, count - 1, tolerance, expected);
+            QVector<int> kept = simplifier.simplify(tolerance);
+            QCOMPARE(QSet<int>(kept.begin(), kept.end()), expected);
+        }
+    }
+}
+
+void TestPolylineSimplifier::testFitZoom()
+{
+    // 360 degrees of longitude are 256 px at zoom 0
+    PolylineSimplifier simplifier;
+    simplifier.load({QPointF(0.0, 0.0), QPointF(1.40625, 0.0)});
+    QCOMPARE(simplifier.fitZoom(1024, 1024), 10);
+    QCOMPARE(simplifier.fitZoom(1023, 1024), 9);
+    QCOMPARE(simplifier.fitZoom(1024, 1024, 8), 8);
+
+    // A single location fits at any zoom
+    simplifier.load({QPointF(7.0, 45.0), QPointF(7.0, 45.0)});
+    QCOMPARE(simplifier.fitZoom(800, 600), 18);
+}
+
+void TestPolylineSimplifier::testPack()
+{
+    PolylineSimplifier simplifier;
+    simplifier.load({QPointF(-87.629798, 41.878114), QPointF(-87.6, 41.9), QPointF(179.999999, -89.5)});
+
+    QByteArray data = QByteArray::fromBase64(simplifier.pack({0, 2}).toLatin1());
+    QCOMPARE(data.size(), 16);
+    const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+    QCOMPARE(qFromLittleEndian<qint32>(bytes), 41878114);
+    QCOMPARE(qFromLittleEndian<qint32>(bytes + 4), -87629798);
+    QCOMPARE(qFromLittleEndian<qint32>(bytes + 8), -89500000);
+    QCOMPARE(qFromLittleEndian<qint32>(bytes + 12), 179999999);
+
+    QVERIFY(simplifier.pack({}).isEmpty());
+}
+
+QTEST_MAIN(TestPolylineSimplifier)
+#include "test_polylinesimplifier.moc"
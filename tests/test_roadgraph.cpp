@@ -0,0 +1,419 @@
+#include <QtTest/QtTest>
+#include "roadgraph.h"
+#include "localroutingbackend.h"
+#include "routingservice.h"
+#include "geoutils.h"
+#include "gridroadgraph.h"
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <limits>
+
+class TestRoadGraph : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBuildRejectsBadInput();
+    void testGridPath();
+    void testOneWayAndUnreachable();
+    void testMatchesDijkstra();
+    void testNearestNode();
+    void testSaveAndLoad();
+    void testImportDimacs();
+    void testLocalBackend();
+    void testLocalBackendLoadAsync();
+    void testRoutingServiceWithLocalBackend();
+    void testRoutingServiceCache();
+    void testPolylineLength();
+
+private:
+    double referenceSeconds(const QVector<RoadGraph::Node>& nodes,
+                            const QVector<RoadGraph::Edge>& edges, int source, int target);
+};
+
+double TestRoadGraph::referenceSeconds(const QVector<RoadGraph::Node>& nodes,
+                                       const QVector<RoadGraph::Edge>& edges, int source, int target)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    QVector<double> distance(nodes.size(), infinity);
+    QVector<bool> done(nodes.size(), false);
+    distance[source] = 0.0;
+    for (int round = 0; round < nodes.size(); ++round) {
+        int best = -1;
+        for (int i = 0; i < nodes.size(); ++i) {
+            if (!done[i] && (best < 0 || distance[i] < distance[best])) best = i;
+        }
+        if (best < 0 || distance[best] == infinity) break;
+        done[best] = true;
+        for (const RoadGraph::Edge& edge : edges) {
+            if (edge.from == best) {
+                distance[edge.to] = qMin(distance[edge.to], distance[best] + float(edge.seconds));
+            }
+        }
+    }
+    return distance[target];
+}
+
+void TestRoadGraph::testBuildRejectsBadInput()
+{
+    RoadGraph graph;
+    QVector<RoadGraph::Node> nodes = {{45.0, 7.0}, {45.01, 7.0}};
+    QVERIFY(!graph.build(nodes, {{0, 2, 1.0}}));
+    QVERIFY(!graph.getLastError().isEmpty());
+    QVERIFY(!graph.build(nodes, {{0, 1, -1.0}}));
+    QVERIFY(!graph.build({{95.0, 7.0}}, {}));
+    QVERIFY(graph.isEmpty());
+
+    QVERIFY(graph.build(nodes, {{0, 1, 60.0}}));
+    QCOMPARE(graph.getNodeCount(), 2);
+    QCOMPARE(graph.getEdgeCount(), 1);
+    QCOMPARE(graph.getLatitude(1), 45.01);
+}
+
+void TestRoadGraph::testGridPath()
+{
+    RoadGraph graph = gridRoadGraph(10);
+
+    // Corner to corner takes 18 blocks whichever way it turns
+    double seconds = 0.0;
+    QVector<int> path = graph.shortestPath(0, 99, &seconds);
+    QCOMPARE(path.size(), 19);
+    QCOMPARE(path.first(), 0);
+    QCOMPARE(path.last(), 99);
+    for (int i = 0; i + 1 < path.size(); ++i) {
+        int step = qAbs(path[i + 1] - path[i]);
+        QVERIFY(step == 1 || step == 10);
+    }
+    double blockNorthSouth = haversineDistanceKm(45.0, 7.0, 45.01, 7.0) * 100.0;
+    double blockEastWest = haversineDistanceKm(45.0, 7.0, 45.0, 7.01) * 100.0;
+    QVERIFY(seconds >= 9 * (blockNorthSouth + blockEastWest) * 0.98);
+    QVERIFY(seconds <= 9 * (blockNorthSouth + blockEastWest) * 1.01);
+
+    QCOMPARE(graph.shortestPath(5, 5), QVector<int>({5}));
+    QVERIFY(graph.shortestPath(0, 100).isEmpty());
+}
+
+void TestRoadGraph::testOneWayAndUnreachable()
+{
+    // 0 -> 1 -> 2 is one-way; 3 is isolated
+    QVector<RoadGraph::Node> nodes = {{45.0, 7.0}, {45.0, 7.01}, {45.0, 7.02}, {46.0, 8.0}};
+    QVector<RoadGraph::Edge> edges = {{0, 1, 60.0}, {1, 2, 60.0}, {2, 0, 600.0}};
+    RoadGraph graph;
+    QVERIFY(graph.build(nodes, edges));
+
+    double seconds = 0.0;
+    QCOMPARE(graph.shortestPath(0, 2, &seconds), QVector<int>({0, 1, 2}));
+    QCOMPARE(seconds, 120.0);
+    QCOMPARE(graph.shortestPath(2, 1, &seconds), QVector<int>({2, 0, 1}));
+    QCOMPARE(seconds, 660.0);
+    QVERIFY(graph.shortestPath(0, 3, &seconds).isEmpty());
+    QCOMPARE(seconds, 0.0);
+}
+
+void TestRoadGraph::testMatchesDijkstra()
+{
+    QRandomGenerator rng(7);
+    QVector<RoadGraph::Node> nodes;
+    for (int i = 0; i < 300; ++i) {
+        nodes.append(RoadGraph::Node{45.0 + rng.generateDouble() * 0.2, 7.0 + rng.generateDouble() * 0.2});
+    }
+    // Random one-way streets with speeds and detours that vary per edge
+    QVector<RoadGraph::Edge> edges;
+    for (int i = 0; i < nodes.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            int j = rng.bounded(nodes.size());
+            if (j == i) continue;
+            double km = haversineDistanceKm(nodes[i].latitude, nodes[i].longitude,
+                                            nodes[j].latitude, nodes[j].longitude);
+            double kmPerSecond = 0.008 + rng.generateDouble() * 0.03;
+            edges.append(RoadGraph::Edge{i, j, km * (1.0 + rng.generateDouble()) / kmPerSecond});
+        }
+    }
+    RoadGraph graph;
+    QVERIFY(graph.build(nodes, edges));
+
+    for (int query = 0; query < 40; ++query) {
+        int source = rng.bounded(nodes.size());
+        int target = rng.bounded(nodes.size());
+        double expected = referenceSeconds(nodes, edges, source, target);
+        double seconds = 0.0;
+        QVector<int> path = graph.shortestPath(source, target, &seconds);
+        if (expected == std::numeric_limits<double>::infinity()) {
+            QVERIFY(path.isEmpty());
+            continue;
+        }
+        QVERIFY(!path.isEmpty());
+        QCOMPARE(path.first(), source);
+        QCOMPARE(path.last(), target);
+        QVERIFY2(qAbs(seconds - expected) < 1e-3 * qMax(1.0, expected),
+                 qPrintable(QString("%1 -> %2: %3 vs %4").arg(source).arg(target).arg(seconds).arg(expected)));
+    }
+}
+
+void TestRoadGraph::testNearestNode()
+{
+    RoadGraph graph = gridRoadGraph(10);
+    QCOMPARE(graph.nearestNode(45.0001, 7.0001), 0);
+    QCOMPARE(graph.nearestNode(45.052, 7.038), 5 * 10 + 4);
+    // Off the grid but within reach of its edge
+    QCOMPARE(graph.nearestNode(44.99, 7.09), 9);
+    QCOMPARE(graph.nearestNode(44.0, 7.0), -1);
+    QCOMPARE(graph.nearestNode(44.0, 7.0, 200.0), 0);
+    QCOMPARE(RoadGraph().nearestNode(45.0, 7.0), -1);
+
+    // Cells wrap around the antimeridian
+    RoadGraph wrapped;
+    QVERIFY(wrapped.build({{-17.0, 179.999}}, {}));
+    QCOMPARE(wrapped.nearestNode(-17.0, -179.999), 0);
+}
+
+void TestRoadGraph::testSaveAndLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/grid.graph";
+
+    RoadGraph graph = gridRoadGraph(6);
+    QVERIFY(graph.save(path));
+
+    RoadGraph loaded;
+    QVERIFY(loaded.load(path));
+    QCOMPARE(loaded.getNodeCount(), graph.getNodeCount());
+    QCOMPARE(loaded.getEdgeCount(), graph.getEdgeCount());
+    QCOMPARE(loaded.getLongitude(7), graph.getLongitude(7));
+    double expected = 0.0;
+    double seconds = 0.0;
+    QCOMPARE(loaded.shortestPath(0, 35, &seconds), graph.shortestPath(0, 35, &expected));
+    QCOMPARE(seconds, expected);
+
+    // Truncated and foreign files are rejected
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 8));
+    file.close();
+    QVERIFY(!loaded.load(path));
+    QVERIFY(loaded.isEmpty());
+
+    QFile other(dir.path() + "/other.graph");
+    QVERIFY(other.open(QIODevice::WriteOnly));
+    other.write("not a graph");
+    other.close();
+    QVERIFY(!loaded.load(other.fileName()));
+    QVERIFY(loaded.getLastError().contains("Not a road graph"));
+    QVERIFY(!loaded.load(dir.path() + "/missing.graph"));
+}
+
+void TestRoadGraph::testImportDimacs()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QFile graphFile(dir.path() + "/area.gr");
+    QVERIFY(graphFile.open(QIODevice::WriteOnly));
+    graphFile.write("c travel times\np sp 3 3\na 1 2 600\na 2 3 600\na 1 3 1500\n");
+    graphFile.close();
+    QFile coordinateFile(dir.path() + "/area.co");
+    QVERIFY(coordinateFile.open(QIODevice::WriteOnly));
+    coordinateFile.write("p aux sp co 3\nv 1 7000000 45000000\nv 2 7010000 45000000\nv 3 7020000 45000000\n");
+    coordinateFile.close();
+
+    RoadGraph graph;
+    QVERIFY(graph.importDimacs(graphFile.fileName(), coordinateFile.fileName()));
+    QCOMPARE(graph.getNodeCount(), 3);
+    QCOMPARE(graph.getEdgeCount(), 3);
+    QCOMPARE(graph.getLatitude(1), 45.0);
+    QCOMPARE(graph.getLongitude(1), 7.01);
+
+    double seconds = 0.0;
+    QCOMPARE(graph.shortestPath(0, 2, &seconds), QVector<int>({0, 1, 2}));
+    QCOMPARE(seconds, 120.0);
+
+    QVERIFY(!graph.importDimacs(graphFile.fileName(), dir.path() + "/missing.co"));
+
+    // Node 2 used by arcs but missing from the coordinates
+    QFile gapFile(dir.path() + "/gap.co");
+    QVERIFY(gapFile.open(QIODevice::WriteOnly));
+    gapFile.write("p aux sp co 3\nv 1 7000000 45000000\nv 3 7020000 45000000\n");
+    gapFile.close();
+    QVERIFY(!graph.importDimacs(graphFile.fileName(), gapFile.fileName()));
+    QVERIFY(graph.getLastError().contains("node 2"));
+    QCOMPARE(graph.getNodeCount(), 0);
+}
+
+void TestRoadGraph::testLocalBackend()
+{
+    LocalRoutingBackend backend;
+    backend.setGraph(gridRoadGraph(10));
+    QSignalSpy spy(&backend, &RoutingBackend::routeFinished);
+
+    QList<Address> waypoints = {
+        Address(1, "A", "", "", "", "", 45.0001, 7.0001),
+        Address(2, "B", "", "", "", "", 45.0001, 7.0899),
+        Address(3, "C", "", "", "", "", 45.0899, 7.0899)
+    };
+    backend.requestRoute(4, waypoints);
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(spy.wait());
+
+    QList<QVariant> arguments = spy.takeFirst();
+    QCOMPARE(arguments[0].toInt(), 4);
+    RoutePath path = arguments[1].value<RoutePath>();
+    QList<QPointF> points = path.points;
+    QVERIFY(arguments[2].toString().isEmpty());
+    // Along the bottom row, then up the right column; the corner is shared
+    QCOMPARE(points.size(), 19);
+    QCOMPARE(points.first(), QPointF(7.0, 45.0));
+    QCOMPARE(points[9], QPointF(7.09, 45.0));
+    QCOMPARE(points.last(), QPointF(7.09, 45.09));
+    double expectedKm = 9 * haversineDistanceKm(45.0, 7.0, 45.0, 7.01) +
+                        9 * haversineDistanceKm(45.0, 7.09, 45.01, 7.09);
+    QVERIFY(qAbs(path.distanceKm - expectedKm) < 1e-3);
+    QVERIFY(path.durationSeconds > 0.0);
+    QCOMPARE(path.legs.size(), 2);
+    QVERIFY(qAbs(path.legs[1].distanceKm - 9 * haversineDistanceKm(45.0, 7.09, 45.01, 7.09)) < 1e-6);
+
+    // Waypoints off the network fail the request
+    backend.requestRoute(5, {waypoints[0], Address(4, "Far", "", "", "", "", 50.0, 7.0)});
+    QVERIFY(spy.wait());
+    QVERIFY(!spy.takeFirst()[2].toString().isEmpty());
+
+    // Cancelled requests report nothing
+    backend.requestRoute(6, waypoints);
+    backend.cancelAll();
+    QVERIFY(!spy.wait(100));
+}
+
+void TestRoadGraph::testLocalBackendLoadAsync()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/grid.graph";
+    QVERIFY(gridRoadGraph(5).save(path));
+
+    LocalRoutingBackend backend;
+    QSignalSpy loadedSpy(&backend, &LocalRoutingBackend::graphLoaded);
+    backend.loadGraphAsync(path);
+    QVERIFY(backend.getGraph().isEmpty());
+    QVERIFY(loadedSpy.wait());
+    QCOMPARE(loadedSpy.takeFirst()[0].toBool(), true);
+    QCOMPARE(backend.getGraph().getNodeCount(), 25);
+    QCOMPARE(backend.getGraphPath(), path);
+    QVERIFY(!backend.getProfile().isEmpty());
+
+    backend.loadGraphAsync(dir.path() + "/missing.graph");
+    QVERIFY(loadedSpy.wait());
+    QCOMPARE(loadedSpy.takeFirst()[0].toBool(), false);
+    QVERIFY(!backend.getLastError().isEmpty());
+    QVERIFY(backend.getGraphPath().isEmpty());
+}
+
+void TestRoadGraph::testRoutingServiceWithLocalBackend()
+{
+    RoutingService service;
+    auto* backend = new LocalRoutingBackend();
+    backend->setGraph(gridRoadGraph(10));
+    service.setBackend(backend);
+    QCOMPARE(service.getBackend()->getType(), RoutingBackend::Local);
+
+    // Small segments so the route is stitched from several requests
+    service.setMaxWaypointsPerRequest(2);
+    QSignalSpy routeSpy(&service, &RoutingService::routeCalculated);
+    QSignalSpy failedSpy(&service, &RoutingService::routeFailed);
+
+    QList<Address> waypoints = {
+        Address(1, "A", "", "", "", "", 45.0001, 7.0001),
+        Address(2, "B", "", "", "", "", 45.0001, 7.0499),
+        Address(3, "C", "", "", "", "", 45.0499, 7.0499)
+    };
+    service.calculateRoute(waypoints);
+    QVERIFY(service.isBusy());
+    QVERIFY(routeSpy.wait());
+    QCOMPARE(failedSpy.count(), 0);
+    QVERIFY(!service.isBusy());
+
+    RouteResult route = routeSpy.takeFirst()[0].value<RouteResult>();
+    QList<QPointF> points = route.points;
+    QCOMPARE(points.size(), 11);
+    QCOMPARE(points.first(), QPointF(7.0, 45.0));
+    QCOMPARE(points.last(), QPointF(7.05, 45.05));
+
+    // One leg per pair of waypoints, adding up to the whole route
+    QCOMPARE(route.legs.size(), 2);
+    QVERIFY(qAbs(route.legs[0].distanceKm - 5 * haversineDistanceKm(45.0, 7.0, 45.0, 7.01)) < 1e-6);
+    QVERIFY(qAbs(route.legs[0].distanceKm + route.legs[1].distanceKm - route.distanceKm) < 1e-9);
+    QVERIFY(qAbs(route.legs[0].durationSeconds + route.legs[1].durationSeconds - route.durationSeconds) < 1e-9);
+    QVERIFY(qAbs(route.distanceKm - polylineLengthKm(points)) < 1e-6);
+}
+
+void TestRoadGraph::testRoutingServiceCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/grid.graph";
+    QVERIFY(gridRoadGraph(10).save(path));
+
+    RoutingService service;
+    service.getCache().setPersistent(false);
+    auto* backend = new LocalRoutingBackend();
+    service.setBackend(backend);
+    QVERIFY(backend->getProfile().isEmpty());
+    QVERIFY(backend->loadGraph(path));
+    QVERIFY(backend->getProfile().startsWith("graph:"));
+
+    service.setMaxWaypointsPerRequest(2);
+    QSignalSpy routeSpy(&service, &RoutingService::routeCalculated);
+    QList<Address> waypoints = {
+        Address(1, "A", "", "", "", "", 45.0001, 7.0001),
+        Address(2, "B", "", "", "", "", 45.0001, 7.0499),
+        Address(3, "C", "", "", "", "", 45.0499, 7.0499)
+    };
+    service.calculateRoute(waypoints);
+    QVERIFY(routeSpy.wait());
+    QList<QPointF> first = routeSpy.takeFirst()[0].value<RouteResult>().points;
+    QCOMPARE(service.getCache().getSize(), 2);
+    QCOMPARE(service.getCache().getHits(), 0);
+
+    // Both segments come from the cache, still asynchronously
+    service.calculateRoute(waypoints);
+    QCOMPARE(routeSpy.count(), 0);
+    QVERIFY(routeSpy.wait());
+    QCOMPARE(service.getCache().getHits(), 2);
+    QCOMPARE(routeSpy.takeFirst()[0].value<RouteResult>().points, first);
+
+    // A hit still queued when the route is replaced is dropped
+    service.calculateRoute(waypoints);
+    service.calculateRoute(waypoints.mid(0, 2));
+    QVERIFY(routeSpy.wait());
+    QCOMPARE(routeSpy.takeFirst()[0].value<RouteResult>().points.size(), 6);
+    QVERIFY(!routeSpy.wait(100));
+
+    // Graphs set in memory are never cached
+    backend->setGraph(gridRoadGraph(10));
+    service.getCache().clear();
+    service.calculateRoute(waypoints);
+    QVERIFY(routeSpy.wait());
+    QCOMPARE(service.getCache().getSize(), 0);
+}
+
+void TestRoadGraph::testPolylineLength()
+{
+    QCOMPARE(polylineLengthKm({}), 0.0);
+    QCOMPARE(polylineLengthKm({QPointF(7.0, 45.0)}), 0.0);
+
+    // Agrees with summed haversine distances, from centimeters to
+    // antipodal hops
+    QList<QPointF> points = {
+        QPointF(-87.629798, 41.878114), QPointF(-87.6297982, 41.8781145), QPointF(-87.6, 41.9),
+        QPointF(2.3522, 48.8566), QPointF(-177.6478, -48.8566), QPointF(179.9, -48.8)
+    };
+    double expected = 0.0;
+    for (int i = 1; i < points.size(); ++i) {
+        double km = haversineDistanceKm(points[i - 1].y(), points[i - 1].x(), points[i].y(), points[i].x());
+        QVERIFY(qAbs(polylineLengthKm({points[i - 1], points[i]}) - km) < 1e-6);
+        expected += km;
+    }
+    QVERIFY(qAbs(polylineLengthKm(points) - expected) < 1e-6);
+}
+
+QTEST_MAIN(TestRoadGraph)
+#include "test_roadgraph.moc"
@@ -0,0 +1,164 @@
+#include <QtTest/QtTest>
+#include "routecache.h"
+#include "database.h"
+#include <QTemporaryDir>
+
+class TestRouteCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testGeometryRoundTrip();
+    void testCacheKey();
+    void testMemoryEviction();
+    void testPersistence();
+    void testExpiry();
+
+private:
+    QTemporaryDir m_tempDir;
+    RoutePath samplePath(int count);
+};
+
+void TestRouteCache::initTestCase()
+{
+    QVERIFY(m_tempDir.isValid());
+    QVERIFY(Database::instance().initialize(m_tempDir.path() + "/routes.db"));
+}
+
+void TestRouteCache::cleanupTestCase()
+{
+    Database::instance().close();
+}
+
+RoutePath TestRouteCache::samplePath(int count)
+{
+    RoutePath path;
+    for (int i = 0; i < count; ++i) {
+        path.points.append(QPointF(-87.629798 + i * 0.000123, 41.878114 - i * 0.000045));
+    }
+    path.distanceKm = count * 0.013;
+    path.durationSeconds = count * 1.5;
+    path.legs = {RouteLeg{path.distanceKm * 0.25, path.durationSeconds * 0.5},
+                 RouteLeg{path.distanceKm * 0.75, path.durationSeconds * 0.5}};
+    return path;
+}
+
+void TestRouteCache::testGeometryRoundTrip()
+{
+    RoutePath path = samplePath(500);
+    path.points.append(QPointF(179.999999, -89.999999));
+    QByteArray encoded = RouteCache::encodeGeometry(path.points);
+    QVERIFY(encoded.size() < path.points.size() * 4);
+
+    QList<QPointF> decoded = RouteCache::decodeGeometry(encoded);
+    QCOMPARE(decoded.size(), path.points.size());
+    for (int i = 0; i < decoded.size(); ++i) {
+        QVERIFY(qAbs(decoded[i].x() - path.points[i].x()) < 1e-6);
+        QVERIFY(qAbs(decoded[i].y() - path.points[i].y()) < 1e-6);
+    }
+
+    QVERIFY(RouteCache::decodeGeometry(QByteArray()).isEmpty());
+    QVERIFY(RouteCache::decodeGeometry(encoded.left(encoded.size() / 2)).isEmpty());
+}
+
+void TestRouteCache::testCacheKey()
+{
+    QList<Address> waypoints = {
+        Address(1, "A", "", "", "", "", 41.878114, -87.629798),
+        Address(2, "B", "", "", "", "", 41.881832, -87.623177)
+    };
+    QString key = RouteCache::cacheKey("osrm:a/driving", waypoints);
+    QCOMPARE(key.size(), 40);
+
+    // Sub-meter differences and ids don't matter; order and profile do
+    QList<Address> nudged = {
+        Address(7, "A", "", "", "", "", 41.8781141, -87.6297979),
+        Address(8, "B", "", "", "", "", 41.881832, -87.623177)
+    };
+    QCOMPARE(RouteCache::cacheKey("osrm:a/driving", nudged), key);
+    QVERIFY(RouteCache::cacheKey("osrm:b/driving", waypoints) != key);
+    QList<Address> reversed = {waypoints[1], waypoints[0]};
+    QVERIFY(RouteCache::cacheKey("osrm:a/driving", reversed) != key);
+}
+
+void TestRouteCache::testMemoryEviction()
+{
+    RouteCache cache(250);
+    cache.setPersistent(false);
+    cache.insert("a", "test", samplePath(100));
+    cache.insert("b", "test", samplePath(100));
+
+    // Touching a makes b the least recently used route
+    RoutePath path;
+    QVERIFY(cache.find("a", path));
+    cache.insert("c", "test", samplePath(100));
+    QCOMPARE(cache.getSize(), 2);
+    QVERIFY(!cache.find("b", path));
+    QVERIFY(cache.find("c", path));
+    QCOMPARE(path.points.size(), 100);
+    QCOMPARE(path.durationSeconds, 150.0);
+    QCOMPARE(cache.getHits(), 2);
+    QCOMPARE(cache.getMisses(), 1);
+
+    // Failed routes are never cached
+    cache.insert("d", "test", RoutePath());
+    QVERIFY(!cache.find("d", path));
+}
+
+void TestRouteCache::testPersistence()
+{
+    Database::instance().clearRouteCache();
+    RoutePath stored = samplePath(50);
+    {
+        RouteCache cache;
+        cache.insert("persisted", "osrm:a/driving", stored);
+        cache.insert("other", "graph:b", stored);
+    }
+
+    // A new cache, as in the next session, loads the route from the database
+    RouteCache cache;
+    RoutePath path;
+    QVERIFY(cache.find("persisted", path));
+    QCOMPARE(path.points.size(), 50);
+    QCOMPARE(path.distanceKm, stored.distanceKm);
+    QCOMPARE(path.durationSeconds, stored.durationSeconds);
+    QVERIFY(qAbs(path.points.last().x() - stored.points.last().x()) < 1e-6);
+    QCOMPARE(path.legs.size(), 2);
+    QCOMPARE(path.legs[1].distanceKm, stored.legs[1].distanceKm);
+    QCOMPARE(path.legs[0].durationSeconds, stored.legs[0].durationSeconds);
+    QCOMPARE(cache.getSize(), 1);
+
+    // Clearing one profile leaves the other
+    Database::instance().clearRouteCache("graph:b");
+    RouteCache fresh;
+    QVERIFY(!fresh.find("other", path));
+    QVERIFY(fresh.find("persisted", path));
+
+    fresh.clear();
+    fresh.setPersistent(false);
+    QVERIFY(!fresh.find("persisted", path));
+}
+
+void TestRouteCache::testExpiry()
+{
+    Database& db = Database::instance();
+    db.clearRouteCache();
+    RouteCache cache;
+    cache.insert("old", "osrm:a/driving", samplePath(10));
+
+    qint64 ttl = db.getRouteCacheTtl();
+    db.setRouteCacheTtl(0);
+    RouteCache later;
+    RoutePath path;
+    QVERIFY(!later.find("old", path));
+    QCOMPARE(db.purgeExpiredRoutes(), 1);
+
+    db.setRouteCacheTtl(ttl);
+    QVERIFY(!later.find("old", path));
+}
+
+QTEST_MAIN(TestRouteCache)
+#include "test_routecache.moc"
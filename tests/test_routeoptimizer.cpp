@@ -0,0 +1,160 @@
+#include <QtTest/QtTest>
+#include "routeoptimizer.h"
+#include "geoutils.h"
+#include <QRandomGenerator>
+#include <QSet>
+
+class TestRouteOptimizer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testHaversine();
+    void testTrivialInputs();
+    void testCollinearStops();
+    void testFixedEndpoints();
+    void testMatrixDistances();
+    void testLargeInput();
+    void testBudgetCoversConstruction();
+
+private:
+    QList<Address> randomStops(int count, quint32 seed);
+    bool isPermutation(const QVector<int>& order, int count);
+};
+
+QList<Address> TestRouteOptimizer::randomStops(int count, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    QList<Address> stops;
+    for (int i = 0; i < count; ++i) {
+        stops.append(Address(i + 1, QString("Stop %1").arg(i), "", "", "", "",
+                             40.0 + rng.generateDouble(), -74.0 + rng.generateDouble()));
+    }
+    return stops;
+}
+
+bool TestRouteOptimizer::isPermutation(const QVector<int>& order, int count)
+{
+    if (order.size() != count) return false;
+    QSet<int> seen;
+    for (int index : order) {
+        if (index < 0 || index >= count || seen.contains(index)) return false;
+        seen.insert(index);
+    }
+    return true;
+}
+
+void TestRouteOptimizer::testHaversine()
+{
+    // New York to London is about 5570 km
+    double distance = haversineDistanceKm(40.7128, -74.0060, 51.5074, -0.1278);
+    QVERIFY(qAbs(distance - 5570.0) < 10.0);
+    QCOMPARE(haversineDistanceKm(10.0, 20.0, 10.0, 20.0), 0.0);
+}
+
+void TestRouteOptimizer::testTrivialInputs()
+{
+    RouteOptimizer optimizer;
+    QVERIFY(optimizer.optimize(QList<Address>()).order.isEmpty());
+
+    QList<Address> stops = randomStops(2, 1);
+    RouteOptimizationResult result = optimizer.optimize(stops, 1, -1);
+    QCOMPARE(result.order, QVector<int>({1, 0}));
+    QCOMPARE(result.optimizedDistance, result.originalDistance);
+}
+
+void TestRouteOptimizer::testCollinearStops()
+{
+    // Stops along the equator in shuffled order; the best path is a sweep
+    QList<Address> stops;
+    for (int i = 0; i < 20; ++i) {
+        stops.append(Address(i + 1, "", "", "", "", "", 0.0, ((i * 7) % 20) * 0.01));
+    }
+
+    RouteOptimizationResult result = RouteOptimizer().optimize(stops);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    double sweep = haversineDistanceKm(0.0, 0.0, 0.0, 0.19);
+    QVERIFY(qAbs(result.optimizedDistance - sweep) < 1e-3);
+    QVERIFY(result.savedDistance() > 0.0);
+}
+
+void TestRouteOptimizer::testFixedEndpoints()
+{
+    QList<Address> stops = randomStops(60, 7);
+    RouteOptimizer optimizer;
+
+    RouteOptimizationResult result = optimizer.optimize(stops, 10, 20);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.first(), 10);
+    QCOMPARE(result.order.last(), 20);
+    QVERIFY(result.optimizedDistance <= result.originalDistance);
+
+    result = optimizer.optimize(stops, -1, 5);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.last(), 5);
+
+    // The same stop as start and end only pins the start
+    result = optimizer.optimize(stops, 3, 3);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.first(), 3);
+}
+
+void TestRouteOptimizer::testMatrixDistances()
+{
+    // Points on a line at 0, 5, 1, 4, 2, 3
+    const QVector<double> positions = {0, 5, 1, 4, 2, 3};
+    int count = positions.size();
+    QVector<double> matrix(count * count);
+    for (int a = 0; a < count; ++a) {
+        for (int b = 0; b < count; ++b) {
+            matrix[a * count + b] = qAbs(positions[a] - positions[b]);
+        }
+    }
+
+    RouteOptimizationResult result = RouteOptimizer().optimize(matrix, count, 0, -1);
+    QCOMPARE(result.originalDistance, 5.0 + 4.0 + 3.0 + 2.0 + 1.0);
+    QCOMPARE(result.optimizedDistance, 5.0);
+    QCOMPARE(result.order, QVector<int>({0, 2, 4, 5, 3, 1}));
+
+    // Matrix too small for the requested count
+    QVERIFY(RouteOptimizer().optimize(matrix, count + 1).order.isEmpty());
+}
+
+void TestRouteOptimizer::testLargeInput()
+{
+    QList<Address> stops = randomStops(1500, 42);
+    RouteOptimizer optimizer(500);
+
+    RouteOptimizationResult result = optimizer.optimize(stops, 0, 1499);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.first(), 0);
+    QCOMPARE(result.order.last(), 1499);
+    QVERIFY(result.elapsedMs < 1000);
+    // Random order is several times longer than a locally optimized path
+    QVERIFY(result.optimizedDistance * 4 < result.originalDistance);
+}
+
+void TestRouteOptimizer::testBudgetCoversConstruction()
+{
+    // Far above the precomputed matrix limit; construction used to scan all
+    // pairs before the budget was first checked
+    QList<Address> stops = randomStops(50000, 7);
+    RouteOptimizer optimizer(100);
+
+    RouteOptimizationResult result = optimizer.optimize(stops, 10, -1);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.first(), 10);
+    QVERIFY(result.timedOut);
+    QVERIFY(result.elapsedMs < 2000);
+    QVERIFY(result.optimizedDistance <= result.originalDistance);
+
+    // An exhausted budget still yields a complete order
+    optimizer.setTimeBudget(0);
+    result = optimizer.optimize(stops, -1, 5);
+    QVERIFY(isPermutation(result.order, stops.size()));
+    QCOMPARE(result.order.last(), 5);
+    QVERIFY(result.timedOut);
+}
+
+QTEST_MAIN(TestRouteOptimizer)
+#include "test_routeoptimizer.moc"
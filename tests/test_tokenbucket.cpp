@@ -0,0 +1,76 @@
+#include <QtTest/QtTest>
+#include "tokenbucket.h"
+
+class TestTokenBucket : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testStartsFull();
+    void testRefill();
+    void testBurstCapacity();
+    void testRefund();
+    void testWaitTime();
+};
+
+void TestTokenBucket::testStartsFull()
+{
+    TokenBucket bucket(1.0, 1.0);
+    bucket.reset(0);
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(!bucket.tryAcquire(0));
+}
+
+void TestTokenBucket::testRefill()
+{
+    TokenBucket bucket(1.0, 1.0);
+    bucket.reset(0);
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(!bucket.tryAcquire(500));
+    QVERIFY(!bucket.tryAcquire(999));
+    QVERIFY(bucket.tryAcquire(1000));
+
+    // Idle time never accumulates beyond the capacity
+    QVERIFY(bucket.tryAcquire(10000));
+    QVERIFY(!bucket.tryAcquire(10000));
+}
+
+void TestTokenBucket::testBurstCapacity()
+{
+    TokenBucket bucket(2.0, 3.0);
+    bucket.reset(0);
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(!bucket.tryAcquire(0));
+    QVERIFY(bucket.tryAcquire(500));
+}
+
+void TestTokenBucket::testRefund()
+{
+    TokenBucket bucket(1.0, 1.0);
+    bucket.reset(0);
+    QVERIFY(bucket.tryAcquire(0));
+    bucket.refund();
+    QVERIFY(bucket.tryAcquire(0));
+
+    // Refunds never exceed the capacity
+    bucket.refund();
+    bucket.refund();
+    QVERIFY(bucket.tryAcquire(0));
+    QVERIFY(!bucket.tryAcquire(0));
+}
+
+void TestTokenBucket::testWaitTime()
+{
+    TokenBucket bucket(1.0, 1.0);
+    bucket.reset(0);
+    QCOMPARE(bucket.msUntilAvailable(0), qint64(0));
+    QVERIFY(bucket.tryAcquire(0));
+    QCOMPARE(bucket.msUntilAvailable(0), qint64(1000));
+    QCOMPARE(bucket.msUntilAvailable(250), qint64(750));
+    QCOMPARE(bucket.msUntilAvailable(1000), qint64(0));
+}
+
+QTEST_MAIN(TestTokenBucket)
+#include "test_tokenbucket.moc"
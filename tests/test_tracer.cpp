@@ -0,0 +1,198 @@
+#include <QtTest/QtTest>
+#include "tracer.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <thread>
+
+class TestTracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanupTestCase();
+
+    void testDisabled();
+    void testNestedSpans();
+    void testRingBufferKeepsNewest();
+    void testThreads();
+    void testAsyncSpan();
+    void testExport();
+
+private:
+    static QJsonArray traceEvents();
+    static QJsonArray eventsNamed(const QString& name);
+};
+
+void TestTracer::init()
+{
+    Tracer::instance().setBufferCapacity(16384);
+    Tracer::instance().setEnabled(true);
+}
+
+void TestTracer::cleanupTestCase()
+{
+    Tracer::instance().setEnabled(false);
+    Tracer::instance().clear();
+}
+
+QJsonArray TestTracer::traceEvents()
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(Tracer::instance().toChromeTrace(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Trace is not valid JSON:" << error.errorString();
+        return QJsonArray();
+    }
+    return doc.object().value("traceEvents").toArray();
+}
+
+QJsonArray TestTracer::eventsNamed(const QString& name)
+{
+    QJsonArray matching;
+    for (const QJsonValue& value : traceEvents()) {
+        if (value.toObject().value("name").toString() == name) {
+            matching.append(value);
+        }
+    }
+    return matching;
+}
+
+void TestTracer::testDisabled()
+{
+    Tracer::instance().setEnabled(false);
+    {
+        TRACE_SCOPE("test", "ignored");
+    }
+    Tracer::instance().addAsyncSpan("test", "ignored async", Tracer::startTime());
+    QCOMPARE(Tracer::startTime(), qint64(0));
+    QCOMPARE(Tracer::instance().getEventCount(), 0);
+}
+
+void TestTracer::testNestedSpans()
+{
+    {
+        TRACE_SCOPE("test", "outer");
+        QThread::msleep(5);
+        {
+            TRACE_SCOPE("test", "inner");
+            QThread::msleep(5);
+        }
+    }
+    QCOMPARE(Tracer::instance().getEventCount(), 2);
+
+    QJsonObject outer = eventsNamed("outer").first().toObject();
+    QJsonObject inner = eventsNamed("inner").first().toObject();
+    QCOMPARE(outer.value("ph").toString(), QString("X"));
+    QCOMPARE(outer.value("cat").toString(), QString("test"));
+    QCOMPARE(outer.value("tid").toInt(), inner.value("tid").toInt());
+
+    // Microseconds; the inner span lies within the outer one
+    double outerStart = outer.value("ts").toDouble();
+    double innerStart = inner.value("ts").toDouble();
+    QVERIFY(outer.value("dur").toDouble() >= 10000.0);
+    QVERIFY(inner.value("dur").toDouble() >= 5000.0);
+    QVERIFY(innerStart >= outerStart);
+    QVERIFY(innerStart + inner.value("dur").toDouble() <= outerStart + outer.value("dur").toDouble());
+}
+
+void TestTracer::testRingBufferKeepsNewest()
+{
+    Tracer& tracer = Tracer::instance();
+    tracer.setBufferCapacity(4);
+    static const char* const names[] = {"span 0", "span 1", "span 2", "span 3", "span 4", "span 5"};
+    for (const char* name : names) {
+        TRACE_SCOPE("test", name);
+    }
+    QCOMPARE(tracer.getEventCount(), 4);
+
+    // Oldest first, the first two overwritten
+    QStringList exported;
+    for (const QJsonValue& value : traceEvents()) {
+        QJsonObject event = value.toObject();
+        if (event.value("ph").toString() == "X") {
+            exported << event.value("name").toString();
+        }
+    }
+    QCOMPARE(exported, QStringList({"span 2", "span 3", "span 4", "span 5"}));
+}
+
+void TestTracer::testThreads()
+{
+    // Every thread records into its own buffer and shows up as its own track
+    {
+        TRACE_SCOPE("test", "main span");
+    }
+    std::thread worker([]() {
+        for (int i = 0; i < 1000; ++i) {
+            TRACE_SCOPE("test", "worker span");
+        }
+    });
+    worker.join();
+
+    // Events of a thread that has finished are still exported
+    QCOMPARE(Tracer::instance().getEventCount(), 1001);
+    QJsonArray workerSpans = eventsNamed("worker span");
+    QCOMPARE(workerSpans.size(), 1000);
+    int workerTid = workerSpans.first().toObject().value("tid").toInt();
+    QVERIFY(workerTid != eventsNamed("main span").first().toObject().value("tid").toInt());
+
+    QStringList threadNames;
+    for (const QJsonValue& value : eventsNamed("thread_name")) {
+        QJsonObject event = value.toObject();
+        QCOMPARE(event.value("ph").toString(), QString("M"));
+        threadNames << event.value("args").toObject().value("name").toString();
+    }
+    QVERIFY(threadNames.contains("Main thread"));
+    QCOMPARE(threadNames.size(), 2);
+}
+
+void TestTracer::testAsyncSpan()
+{
+    qint64 start = Tracer::startTime();
+    QVERIFY(start != 0);
+    QThread::msleep(2);
+    Tracer::instance().addAsyncSpan("network", "request", start);
+    Tracer::instance().addAsyncSpan("network", "request", Tracer::startTime());
+
+    // Begin/end pairs with one id per span
+    QJsonArray events = eventsNamed("request");
+    QCOMPARE(events.size(), 4);
+    QJsonObject begin = events[0].toObject();
+    QJsonObject end = events[1].toObject();
+    QCOMPARE(begin.value("ph").toString(), QString("b"));
+    QCOMPARE(end.value("ph").toString(), QString("e"));
+    QCOMPARE(begin.value("id").toInt(), end.value("id").toInt());
+    QVERIFY(begin.value("id").toInt() != events[2].toObject().value("id").toInt());
+    QVERIFY(end.value("ts").toDouble() - begin.value("ts").toDouble() >= 2000.0);
+
+    // A start taken while tracing was off records nothing
+    Tracer::instance().addAsyncSpan("network", "request", 0);
+    QCOMPARE(Tracer::instance().getEventCount(), 2);
+}
+
+void TestTracer::testExport()
+{
+    {
+        TRACE_SCOPE("test", "quoted \"name\"");
+    }
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + "/trace.json";
+    QVERIFY(Tracer::instance().exportChromeTrace(path));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    QVERIFY(doc.isObject());
+    QCOMPARE(doc.object().value("displayTimeUnit").toString(), QString("ms"));
+    QCOMPARE(eventsNamed("quoted \"name\"").size(), 1);
+
+    QVERIFY(!Tracer::instance().exportChromeTrace(dir.path() + "/missing/trace.json"));
+    QVERIFY(!Tracer::instance().getLastError().isEmpty());
+}
+
+QTEST_MAIN(TestTracer)
+#include "test_tracer.moc"